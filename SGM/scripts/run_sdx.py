@@ -31,6 +31,7 @@ subprocess.call(["mkdir", "-p", workspace])
 # shd_window = 3
 # p1 = 7
 # p2 = 86
+# npc = 1
 
 height = sys.argv[1]
 width = sys.argv[2]
@@ -45,8 +46,11 @@ filter_win = sys.argv[10]
 shd_window = sys.argv[11]
 p1 = sys.argv[12]
 p2 = sys.argv[13]
+npc = sys.argv[14] if len(sys.argv) > 14 else 1
 
 configuration = workspace + "/" + str(height) + "_" + str(width) + "_" + str(max_disp) + "_" + str(parallel_disp) + "_" + str(num_dir) + "_" + str(p1) + "_" + str(p2) + "_" + str(cost_function) + "_" + str(window_size) + "_" + str(filter_win) + "_" + str(shd_window) + "_" + str(uniqueness) + "_" + str(lr_check)
+if int(npc) > 1:
+    configuration += "_npc" + str(npc)
 subprocess.call(["mkdir", "-p", configuration])
 
 # copy source code to HLS project
@@ -59,8 +63,8 @@ shutil.copy(FP_Stereo+'fp_sgbm_tb.cpp',src)
 shutil.copy(FP_Stereo+'fp_config_params.h',src)
 shutil.copy(FP_Stereo+'fp_config_arch.h',src)
 
-KEYWORDS = ["HEIGHT", "WIDTH", "NUM_DISPARITY", "SMALL_PENALTY", "LARGE_PENALTY", "WINDOW_SIZE", "SHD_WINDOW", "FilterWin", "PARALLEL_DISPARITIES"]
-VALUES = [height, width, max_disp, p1, p2, window_size, shd_window, filter_win, parallel_disp]
+KEYWORDS = ["HEIGHT", "WIDTH", "NUM_DISPARITY", "SMALL_PENALTY", "LARGE_PENALTY", "WINDOW_SIZE", "SHD_WINDOW", "FilterWin", "PARALLEL_DISPARITIES", "NPPC"]
+VALUES = [height, width, max_disp, p1, p2, window_size, shd_window, filter_win, parallel_disp, npc]
 
 ARCH_KEYWORDS = ["NUM_DIR", "COST_FUNCTION", "UNIQ", "LR_CHECK", "MAX_PORT_BW", "PARALLELISM", "PENALTY2", "COST_WIN", "SHD_WIN"]
 ARCH_VALUES = [num_dir, cost_function, uniqueness, lr_check, 128, parallel_disp, p2, window_size, shd_window]
@@ -90,15 +94,25 @@ lib_accel = src + "/" + "lib_accel"
 subprocess.call(["mkdir", "-p", lib_accel])
 shutil.copy(FP_Stereo+'lib_accel/fp_AggregateCost.hpp',lib_accel)
 shutil.copy(FP_Stereo+'lib_accel/fp_common.h',lib_accel)
+shutil.copy(FP_Stereo+'lib_accel/fp_bitwidth.h',lib_accel)
+shutil.copy(FP_Stereo+'lib_accel/fp_dataflow.h',lib_accel)
+shutil.copy(FP_Stereo+'lib_accel/fp_fifo_profile.h',lib_accel)
 shutil.copy(FP_Stereo+'lib_accel/fp_ComputeCost.hpp',lib_accel)
 shutil.copy(FP_Stereo+'lib_accel/fp_ComputeDisparity.hpp',lib_accel)
 shutil.copy(FP_Stereo+'lib_accel/fp_PostProcessing.hpp',lib_accel)
 shutil.copy(FP_Stereo+'lib_accel/fp_sgbm.hpp',lib_accel)
 
+# headers from lib_cpu the testbench includes (synthetic pair, bit-exact model)
+lib_cpu = src + "/" + "lib_cpu"
+subprocess.call(["mkdir", "-p", lib_cpu])
+shutil.copy(FP_Stereo+'lib_cpu/fp_synthetic_stereo.hpp',lib_cpu)
+shutil.copy(FP_Stereo+'lib_cpu/fp_hw_model.hpp',lib_cpu)
+shutil.copy(FP_Stereo+'lib_cpu/fp_thread_pool.hpp',lib_cpu)
+
 build_folder = configuration + "/" + "build"
 subprocess.call(["mkdir", "-p", build_folder])
 os.chdir(build_folder)
 shutil.copy(FP_Stereo+'Makefile',build_folder)
 
 # invoke HLS tool for synthesis
-subprocess.call(["make", "NUM_DIR="+str(num_dir), "WINDOW_SIZE="+str(window_size), "SHD_WINDOW="+str(shd_window), "NUM_DISPARITY="+str(max_disp), "PARALLEL_DISPARITIES="+str(parallel_disp), "FilterWin="+str(filter_win), "HEIGHT="+str(height), "WIDTH="+str(width), "SMALL_PENALTY="+str(p1), "LARGE_PENALTY="+str(p2)])
+subprocess.call(["make", "NUM_DIR="+str(num_dir), "WINDOW_SIZE="+str(window_size), "SHD_WINDOW="+str(shd_window), "NUM_DISPARITY="+str(max_disp), "PARALLEL_DISPARITIES="+str(parallel_disp), "FilterWin="+str(filter_win), "HEIGHT="+str(height), "WIDTH="+str(width), "SMALL_PENALTY="+str(p1), "LARGE_PENALTY="+str(p2), "NPPC="+str(npc)])
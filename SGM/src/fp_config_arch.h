@@ -5,7 +5,7 @@
 #error C++ is needed to use this file!
 #endif
 
-#include "lib_accel/fp_common.h"
+#include "lib_accel/fp_bitwidth.h"
 
 /* Architecture parameters */
 /*-------------------------------------To decide the components-------------------------------------*/
@@ -11,13 +11,19 @@
 #define HEIGHT 375
 #define WIDTH  1242
 
-/* NO_OF_DISPARITIES must be greater than '0' and less than the image width */
+/* NO_OF_DISPARITIES must be greater than '0' and less than the image width.
+   It is the largest range of the hardware: a smaller one is set at run time. The kernel rounds the run-time range
+   down to a multiple of PARALLEL_DISPARITIES and keeps it within 2*PARALLEL_DISPARITIES..NUM_DISPARITY; with
+   NUM_DISPARITY == PARALLEL_DISPARITIES (every NPPC 2/4 build) it always runs NUM_DISPARITY */
 #define NUM_DISPARITY 128
 
-/* set penalties for SGM */
+/* set penalties for SGM: the largest values of the run-time penalties, which size the aggregated costs */
 #define SMALL_PENALTY   7
 #define LARGE_PENALTY 	86
 
+/* Default uniqueness ratio in percent, set at run time (5 is the ratio of 20:19) */
+#define UNIQ_RATIO   5
+
 /* Window size for cost computation: census, rank, SAD, ZSAD...*/
 #define WINDOW_SIZE   7 
 
@@ -37,6 +43,11 @@
 /*-------------------------------------------------------------------------------------------------*/
 /* NO_OF_DISPARITIES must not be lesser than PARALLEL_UNITS and NO_OF_DISPARITIES/PARALLEL_UNITS must be a non-fractional number */
 #define PARALLEL_DISPARITIES 16 
+/* Pixels per clock: 1, 2 or 4. 2 and 4 only exist for ITERATION == 1, i.e. NUM_DISPARITY == PARALLEL_DISPARITIES
+   with all disparities unrolled, and only with the census cost and no L-R check; designs with ITERATION > 1 have
+   to raise PARALLEL_DISPARITIES instead. WIDTH must be a multiple of 2*NPPC: KITTI's 1242 is cropped to 1240
+   for both NPPC 2 and 4 */
+#define NPPC 1
 /*-------------------------------------------------------------------------------------------------*/
 
 
@@ -2,8 +2,9 @@
 
 #if (NUM_DIR==4)
 /* For 4 paths aggregation */
-void semiglobalbm_accel(xf::Mat<IN_T, HEIGHT, WIDTH, XF_NPPC1> &_srcL, xf::Mat<IN_T, HEIGHT, WIDTH, XF_NPPC1> &_srcR, xf::Mat<OUT_T, HEIGHT, WIDTH, XF_NPPC1> &_dst)
+void semiglobalbm_accel(xf::Mat<IN_T, HEIGHT, WIDTH, NPPC> &_srcL, xf::Mat<IN_T, HEIGHT, WIDTH, NPPC> &_srcR, xf::Mat<OUT_T, HEIGHT, WIDTH, NPPC> &_dst,
+		ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity, ap_uint<BIT_WIDTH(SMALL_PENALTY)> p1, ap_uint<BIT_WIDTH(LARGE_PENALTY)> p2, ap_uint<7> uniq_ratio)
 {
-    fp::SemiGlobalBM<WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES,FilterWin,IN_T,OUT_T,HEIGHT,WIDTH,XF_NPPC1,SMALL_PENALTY,LARGE_PENALTY>(_srcL,_srcR,_dst);
+    fp::SemiGlobalBM<WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES,FilterWin,IN_T,OUT_T,HEIGHT,WIDTH,NPPC,SMALL_PENALTY,LARGE_PENALTY>(_srcL,_srcR,_dst,num_disparity,p1,p2,uniq_ratio);
 }
 #endif		
@@ -16,8 +16,9 @@
 #define OUT_T XF_8UC1
 
 #if (NUM_DIR==4)
-/* For 4 paths aggregation */
-void semiglobalbm_accel(xf::Mat<IN_T, HEIGHT, WIDTH, XF_NPPC1> &_srcL, xf::Mat<IN_T, HEIGHT, WIDTH, XF_NPPC1> &_srcR, xf::Mat<OUT_T, HEIGHT, WIDTH, XF_NPPC1> &_dst);
+/* For 4 paths aggregation. The scalar arguments are AXI-Lite registers bounded by NUM_DISPARITY, SMALL_PENALTY and LARGE_PENALTY */
+void semiglobalbm_accel(xf::Mat<IN_T, HEIGHT, WIDTH, NPPC> &_srcL, xf::Mat<IN_T, HEIGHT, WIDTH, NPPC> &_srcR, xf::Mat<OUT_T, HEIGHT, WIDTH, NPPC> &_dst,
+		ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity, ap_uint<BIT_WIDTH(SMALL_PENALTY)> p1, ap_uint<BIT_WIDTH(LARGE_PENALTY)> p2, ap_uint<7> uniq_ratio);
 
 #endif
 
@@ -8,6 +8,8 @@
 
 #include "fp_headers.h"
 #include "fp_sgbm_accel.h"
+#include "lib_cpu/fp_synthetic_stereo.hpp"
+#include "lib_cpu/fp_hw_model.hpp"
 
 template <typename T>
 T ABSdiff(T a, T b){
@@ -1226,19 +1228,81 @@ void saveDisparityMap(float *disparity, int rows, int cols, int ndisparity, char
 } // end saveDisparityMap
 
 
+// one byte per pixel of the kernel output, NPPC pixels are packed in each word
+void unpack_output(xf::Mat<OUT_T, HEIGHT, WIDTH, NPPC> &imgOutput, cv::Mat &hls_out)
+{
+	for (int k=0; k<hls_out.rows*hls_out.cols; k++)
+	{
+		int lane = k & (NPPC-1);
+		hls_out.data[k] = (unsigned char)imgOutput.data[k>>XF_BITSHIFT(NPPC)].range(lane*8+7,lane*8);
+	}
+}
+
+int count_mismatches(const cv::Mat &hls_out, const cv::Mat &model_out)
+{
+	int mismatches = 0;
+	for (int i=0; i<hls_out.rows; i++)
+	{
+		for (int j=0; j<hls_out.cols; j++)
+		{
+			if (hls_out.at<unsigned char>(i,j) != model_out.at<unsigned char>(i,j))
+				mismatches++;
+		}
+	}
+	return mismatches;
+}
+
 int main(int argc, char** argv)
 {
-	if (argc != 3)
+	if (argc != 3 && argc != 7)
 	{
 		fprintf(stderr,"Invalid Number of Arguments!\nUsage:\n");
-		fprintf(stderr,"<Executable Name> <left image path> <right image path> \n");
+		fprintf(stderr,"<Executable Name> <left image path> <right image path> [<num_disparity> <p1> <p2> <uniq_ratio>] \n");
+		fprintf(stderr,"<Executable Name> synthetic <dots|planes> [<num_disparity> <p1> <p2> <uniq_ratio>] \n");
+		fprintf(stderr,"num_disparity runs rounded down to a multiple of %d, from %d up to %d; it is always %d when NUM_DISPARITY == PARALLEL_DISPARITIES\n",
+				PARALLEL_DISPARITIES, (NUM_DISPARITY == PARALLEL_DISPARITIES) ? NUM_DISPARITY : 2*PARALLEL_DISPARITIES, NUM_DISPARITY, NUM_DISPARITY);
 		return -1;
 	}
 
+	// Run-time arguments of the accelerator, the configured values by default
+	fp::HwSgbmArgs hw_args = {NUM_DISPARITY, SMALL_PENALTY, LARGE_PENALTY, UNIQ_RATIO};
+	if (argc == 7)
+	{
+		hw_args.num_disparity = atoi(argv[3]);
+		hw_args.p1 = atoi(argv[4]);
+		hw_args.p2 = atoi(argv[5]);
+		hw_args.uniq_ratio = atoi(argv[6]);
+	}
+	fp::HwSgbmConfig hw_config = {COST_FUNCTION, WINDOW_SIZE, SHD_WINDOW, NUM_DISPARITY, PARALLEL_DISPARITIES,
+			SMALL_PENALTY, LARGE_PENALTY, UNIQ, LR_CHECK, FilterWin, NUM_DIR, NPPC};
+	fp::HwSgbmModel hw_model(hw_config);
+	if (hw_model.set_args(hw_args) != 0)
+		return -1;
+	// the kernel gets hw_args as given and clamps num_disparity itself, the reference runs the clamped range
+	int legal_disparity = fp::hw_legal_disparity(hw_config, hw_args.num_disparity);
+
 	cv::Mat in_imgL, in_imgR;
 
-	in_imgL = cv::imread(argv[1],0);
-	in_imgR = cv::imread(argv[2],0);
+	// A generated HEIGHT x WIDTH pair instead of images on disk
+	bool synthetic = (std::string(argv[1]) == "synthetic");
+	if (synthetic)
+	{
+		int scene = fp::synthetic_scene(argv[2]);
+		if (scene < 0)
+		{
+			fprintf(stderr,"Unknown synthetic scene %s\n",argv[2]);
+			return -1;
+		}
+		fp::SyntheticPair pair;
+		fp::make_synthetic_pair(scene, HEIGHT, WIDTH, NUM_DISPARITY, 0, pair);
+		in_imgL = pair.left;
+		in_imgR = pair.right;
+	}
+	else
+	{
+		in_imgL = cv::imread(argv[1],0);
+		in_imgR = cv::imread(argv[2],0);
+	}
 
 	if (in_imgL.data == NULL)
 	{
@@ -1254,15 +1318,23 @@ int main(int argc, char** argv)
 	unsigned short height  = in_imgL.rows;
 	unsigned short width  = in_imgL.cols;
 
-	static xf::Mat<IN_T, HEIGHT, WIDTH, XF_NPPC1> imgInputL(height,width);
-	static xf::Mat<IN_T, HEIGHT, WIDTH, XF_NPPC1> imgInputR(height,width);
-	static xf::Mat<IN_T, HEIGHT, WIDTH, XF_NPPC1> copy_imgInputL(height,width);
-	static xf::Mat<IN_T, HEIGHT, WIDTH, XF_NPPC1> copy_imgInputR(height,width);
+	static xf::Mat<IN_T, HEIGHT, WIDTH, NPPC> imgInputL(height,width);
+	static xf::Mat<IN_T, HEIGHT, WIDTH, NPPC> imgInputR(height,width);
+	static xf::Mat<IN_T, HEIGHT, WIDTH, NPPC> copy_imgInputL(height,width);
+	static xf::Mat<IN_T, HEIGHT, WIDTH, NPPC> copy_imgInputR(height,width);
 
-	static xf::Mat<OUT_T, HEIGHT, WIDTH, XF_NPPC1> imgOutput(height,width);
+	static xf::Mat<OUT_T, HEIGHT, WIDTH, NPPC> imgOutput(height,width);
 
-	imgInputL = xf::imread<XF_8UC1, HEIGHT, WIDTH, XF_NPPC1>(argv[1], 0);
-	imgInputR = xf::imread<XF_8UC1, HEIGHT, WIDTH, XF_NPPC1>(argv[2], 0);
+	if (synthetic)
+	{
+		imgInputL.copyTo(in_imgL.data);
+		imgInputR.copyTo(in_imgR.data);
+	}
+	else
+	{
+		imgInputL = xf::imread<XF_8UC1, HEIGHT, WIDTH, NPPC>(argv[1], 0);
+		imgInputR = xf::imread<XF_8UC1, HEIGHT, WIDTH, NPPC>(argv[2], 0);
+	}
 
 
 #if __SDSCC__
@@ -1271,7 +1343,7 @@ int main(int argc, char** argv)
 #endif
 
 	/* For 4 paths aggregation */
-	semiglobalbm_accel(imgInputL,imgInputR,imgOutput);
+	semiglobalbm_accel(imgInputL,imgInputR,imgOutput,hw_args.num_disparity,hw_args.p1,hw_args.p2,hw_args.uniq_ratio);
 
 #if __SDSCC__
 	hw_ctr.stop();
@@ -1280,6 +1352,20 @@ int main(int argc, char** argv)
 
 	xf::imwrite("hls_out.png", imgOutput);
 
+	cv::Mat hls_out(height,width,CV_8UC1);
+	unpack_output(imgOutput, hls_out);
+
+#ifdef FP_CSIM_PROFILE
+	// FIFO occupancy and stalls of this configuration
+	char profile_name[128];
+	sprintf(profile_name,"fifo_profile_cost%d_win%d_disp%d_par%d_lr%d_uniq%d_npc%d",COST_FUNCTION,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES,LR_CHECK,UNIQ,NPPC);
+	char profile_title[256];
+	sprintf(profile_title,"COST_FUNCTION=%d WINDOW_SIZE=%d SHD_WINDOW=%d NUM_DISPARITY=%d PARALLEL_DISPARITIES=%d P1=%d P2=%d LR_CHECK=%d UNIQ=%d NPPC=%d %dx%d",
+			COST_FUNCTION,WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES,SMALL_PENALTY,LARGE_PENALTY,LR_CHECK,UNIQ,NPPC,width,height);
+	if (fp::csim::write_fifo_report(profile_name,profile_title) == 0)
+		std::cout<<"FIFO profile written to "<<profile_name<<".txt"<<std::endl;
+#endif
+
 	// reference code
 	// Array to store disparity
 	float *disparity = (float*)malloc(height*width*sizeof(float));
@@ -1289,26 +1375,26 @@ int main(int argc, char** argv)
 	}
 
 	if(UNIQ==0&&LR_CHECK==0){
-		compute_SGM(in_imgL,in_imgR,disparity,NUM_DIR,NUM_DISPARITY,SMALL_PENALTY,LARGE_PENALTY,COST_FUNCTION,WINDOW_SIZE,FilterWin,SHD_WINDOW,0);
+		compute_SGM(in_imgL,in_imgR,disparity,NUM_DIR,legal_disparity,hw_args.p1,hw_args.p2,COST_FUNCTION,WINDOW_SIZE,FilterWin,SHD_WINDOW,0);
 	}
 	else if(UNIQ==0&&LR_CHECK==1){
-		compute_SGM(in_imgL,in_imgR,disparity,NUM_DIR,NUM_DISPARITY,SMALL_PENALTY,LARGE_PENALTY,COST_FUNCTION,WINDOW_SIZE,FilterWin,SHD_WINDOW,1);
+		compute_SGM(in_imgL,in_imgR,disparity,NUM_DIR,legal_disparity,hw_args.p1,hw_args.p2,COST_FUNCTION,WINDOW_SIZE,FilterWin,SHD_WINDOW,1);
 	}
 	else if(UNIQ==1&&LR_CHECK==0){
-		compute_SGM(in_imgL,in_imgR,disparity,NUM_DIR,NUM_DISPARITY,SMALL_PENALTY,LARGE_PENALTY,COST_FUNCTION,WINDOW_SIZE,FilterWin,SHD_WINDOW,2);
+		compute_SGM(in_imgL,in_imgR,disparity,NUM_DIR,legal_disparity,hw_args.p1,hw_args.p2,COST_FUNCTION,WINDOW_SIZE,FilterWin,SHD_WINDOW,2);
 	}
 	else if(UNIQ==1&&LR_CHECK==1){
-		compute_SGM(in_imgL,in_imgR,disparity,NUM_DIR,NUM_DISPARITY,SMALL_PENALTY,LARGE_PENALTY,COST_FUNCTION,WINDOW_SIZE,FilterWin,SHD_WINDOW,3);
+		compute_SGM(in_imgL,in_imgR,disparity,NUM_DIR,legal_disparity,hw_args.p1,hw_args.p2,COST_FUNCTION,WINDOW_SIZE,FilterWin,SHD_WINDOW,3);
 	}
 	else if(UNIQ==0&&LR_CHECK==2){
-		compute_SGM_lr(in_imgL,in_imgR,disparity,NUM_DIR,NUM_DISPARITY,SMALL_PENALTY,LARGE_PENALTY,COST_FUNCTION,WINDOW_SIZE,FilterWin,SHD_WINDOW,4);
+		compute_SGM_lr(in_imgL,in_imgR,disparity,NUM_DIR,legal_disparity,hw_args.p1,hw_args.p2,COST_FUNCTION,WINDOW_SIZE,FilterWin,SHD_WINDOW,4);
 	}
 	else if(UNIQ==1&&LR_CHECK==2){
-		compute_SGM_lr(in_imgL,in_imgR,disparity,NUM_DIR,NUM_DISPARITY,SMALL_PENALTY,LARGE_PENALTY,COST_FUNCTION,WINDOW_SIZE,FilterWin,SHD_WINDOW,5);
+		compute_SGM_lr(in_imgL,in_imgR,disparity,NUM_DIR,legal_disparity,hw_args.p1,hw_args.p2,COST_FUNCTION,WINDOW_SIZE,FilterWin,SHD_WINDOW,5);
 	}
 
 	// Write disparity to file
-	saveDisparityMap(disparity, height, width, NUM_DISPARITY, "disp_map.png");
+	saveDisparityMap(disparity, height, width, legal_disparity, "disp_map.png");
 
 	cv::Mat disp_mat(height,width,CV_8UC1);
 	for (int r = 0; r < height; r++)
@@ -1327,7 +1413,7 @@ int main(int argc, char** argv)
 	{
 		for (int j=0; j<width; j++)
 		{
-			int d_val = (unsigned char)imgOutput.data[i*width+j] - disp_mat.at<unsigned char>(i,j);
+			int d_val = hls_out.at<unsigned char>(i,j) - disp_mat.at<unsigned char>(i,j);
 
 			if (d_val > 0)
 			{
@@ -1341,6 +1427,34 @@ int main(int argc, char** argv)
 
 	cv::imwrite("diff.png",diff);
 	std::cout<<"Number of erroneous pixels:"<<cnt<<std::endl;
+
+	// Bit-exact CPU model of the accelerator: its output has to match the kernel's pixel for pixel. Checked in
+	// C-simulation once fpAggregateCost4Path stopped touching Lr/Lr_min left of the first column; before that the
+	// kernel itself was undefined at col 1.
+	fp::ThreadPool pool(std::max(1, (int)std::thread::hardware_concurrency()));
+	cv::Mat model_out(height,width,CV_8UC1);
+	if (hw_model.run(in_imgL.data, in_imgR.data, height, width, model_out.data, &pool) != 0)
+		return -1;
+	int mismatches = count_mismatches(hls_out, model_out);
+	cv::imwrite("model_out.png",model_out);
+	std::cout<<"Number of pixels differing from the hardware model:"<<mismatches<<std::endl;
+	if (mismatches != 0)
+		return -1;
+
+	// Reduced range on the same build: NUM_DISPARITY-1 is below the range of the build and not a multiple of
+	// PARALLEL_DISPARITIES, so the kernel has to clamp it to the range the model runs
+	fp::HwSgbmArgs reduced_args = hw_args;
+	reduced_args.num_disparity = NUM_DISPARITY-1;
+	if (hw_model.set_args(reduced_args) != 0)
+		return -1;
+	semiglobalbm_accel(imgInputL,imgInputR,imgOutput,reduced_args.num_disparity,reduced_args.p1,reduced_args.p2,reduced_args.uniq_ratio);
+	unpack_output(imgOutput, hls_out);
+	if (hw_model.run(in_imgL.data, in_imgR.data, height, width, model_out.data, &pool) != 0)
+		return -1;
+	mismatches = count_mismatches(hls_out, model_out);
+	std::cout<<"Number of pixels differing from the hardware model with num_disparity "<<reduced_args.num_disparity<<":"<<mismatches<<std::endl;
+	if (mismatches != 0)
+		return -1;
 	std::cout<<"run success!"<<std::endl;
 
 	return 0;
@@ -59,7 +59,7 @@ int main(int argc, char** argv)
 for(int j=0; j<5; j++){
 	for(int i=0; i<200; i++){
 		/* For 4 paths aggregation */
-		semiglobalbm_accel(imgInputL[i],imgInputR[i],imgOutput[i]);
+		semiglobalbm_accel(imgInputL[i],imgInputR[i],imgOutput[i],NUM_DISPARITY,SMALL_PENALTY,LARGE_PENALTY,UNIQ_RATIO);
 	}
 }
 
@@ -109,8 +109,9 @@ DATA_TYPE(SHD_COST(CENSUS_VALUE,SHD_WINDOW))
 
 // Four-path cost aggregation
 template<int ROWS, int COLS, int COST_VALUE, int NUM_DISPARITY, int PARALLEL_DISPARITIES, int P1, int P2>
-void fpAggregateCost4Path(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DISPARITIES], hls::stream< AGGR4_DISPARITY_TYPE(COST_VALUE,P2) > aggregated_cost[PARALLEL_DISPARITIES], 
-		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpAggregateCost4Path(FP_STREAM< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DISPARITIES], FP_STREAM< AGGR4_DISPARITY_TYPE(COST_VALUE,P2) > aggregated_cost[PARALLEL_DISPARITIES], 
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity,
+		ap_uint<BIT_WIDTH(P1)> p1, ap_uint<BIT_WIDTH(P2)> p2)
 {
 	assert((AGGR_DISPARITY_WIDTH(COST_VALUE,P2) <= 20 ) && "The bit width of the aggregated cost should not exceed 20");
 
@@ -119,24 +120,28 @@ void fpAggregateCost4Path(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DIS
 	#pragma HLS ARRAY_PARTITION variable=cost complete dim=1
 	#pragma HLS ARRAY_PARTITION variable=aggregated_cost complete dim=1
 	
-    ap_uint<BIT_WIDTH(ROWS+1)> row;
-	ap_uint<BIT_WIDTH(COLS+1)> col;
-	
 	const int ITERATION = NUM_DISPARITY/PARALLEL_DISPARITIES;
+	/* The run-time range has at least two sets of disparities when ITERATION>1: the dependence distances hold for it */
+	const int MIN_ITERATION = (ITERATION>1) ? 2 : 1;
+	ap_uint<BIT_WIDTH(ITERATION)> iterations = num_disparity/PARALLEL_DISPARITIES;
 
 	/* Two FIFOs to reschedule the pixels at intervals */	
-	static hls::stream< ap_uint<BIT_WIDTH(COST_VALUE)*PARALLEL_DISPARITIES> > cost_tmp_0;
+	static FP_STREAM< ap_uint<BIT_WIDTH(COST_VALUE)*PARALLEL_DISPARITIES> > cost_tmp_0;
 	#pragma HLS STREAM variable=cost_tmp_0 depth=COLS*ITERATION/4 //The minimum length to disable stall
+	FP_STREAM_DEPTH(cost_tmp_0, COLS*ITERATION/4);
 
-	static hls::stream< ap_uint<BIT_WIDTH(COST_VALUE)*PARALLEL_DISPARITIES> > cost_tmp_1;
+	static FP_STREAM< ap_uint<BIT_WIDTH(COST_VALUE)*PARALLEL_DISPARITIES> > cost_tmp_1;
 	#pragma HLS STREAM variable=cost_tmp_1 depth=COLS*ITERATION/2 //The minimum length to disable stall
+	FP_STREAM_DEPTH(cost_tmp_1, COLS*ITERATION/2);
 
 	/* Two FIFOs to reorder the pixels and output them in the original order */
-	static hls::stream< ap_uint<AGGR4_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES> > aggregated_cost_tmp_0;
+	static FP_STREAM< ap_uint<AGGR4_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES> > aggregated_cost_tmp_0;
 	#pragma HLS STREAM variable=aggregated_cost_tmp_0 depth=COLS*ITERATION/2
+	FP_STREAM_DEPTH(aggregated_cost_tmp_0, COLS*ITERATION/2);
 
-	static hls::stream< ap_uint<AGGR4_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES> > aggregated_cost_tmp_1;
+	static FP_STREAM< ap_uint<AGGR4_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES> > aggregated_cost_tmp_1;
 	#pragma HLS STREAM variable=aggregated_cost_tmp_1 depth=COLS*ITERATION/4
+	FP_STREAM_DEPTH(aggregated_cost_tmp_1, COLS*ITERATION/4);
 
 	/* Array to store the temporary costs from previous pixels in r1, r2, r3 directions */
 	ap_uint<AGGR_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES> Lr[3][(COLS+2)*ITERATION];
@@ -190,7 +195,11 @@ void fpAggregateCost4Path(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DIS
 
 	const AGGR_DISPARITY_TYPE(COST_VALUE,P2) max_value_bound = (AGGR_DISPARITY_TYPE(COST_VALUE,P2))MAX_VALUE_BOUND;
 
+	FP_DATAFLOW_BEGIN
 	/* Interleave the matching costs */
+	FP_PROCESS_BEGIN("interleave")
+	ap_uint<BIT_WIDTH(ROWS+1)> row;
+	ap_uint<BIT_WIDTH(COLS+1)> col;
 	for(row = 0; row < img_height; row++)
 	{
 		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS
@@ -201,8 +210,9 @@ void fpAggregateCost4Path(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DIS
 			{
 				#pragma HLS PIPELINE II=1 //If equal, pipeline the outer loop. 
 			}
-			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < ITERATION; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 				ap_uint<BIT_WIDTH(COST_VALUE)*PARALLEL_DISPARITIES> input_data = 0;
@@ -221,8 +231,12 @@ void fpAggregateCost4Path(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DIS
 			}
 		}
 	}
+	FP_PROCESS_END
 
 	/* Process matching costs every clock cycle after interleaving */
+	FP_PROCESS_BEGIN("aggregate")
+	ap_uint<BIT_WIDTH(ROWS+1)> row;
+	ap_uint<BIT_WIDTH(COLS+1)> col;
 	for (row = 0; row < img_height + 1; row++)
 	{
 		#pragma HLS LOOP_TRIPCOUNT min=ROWS+1 max=ROWS+1
@@ -233,8 +247,9 @@ void fpAggregateCost4Path(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DIS
 			{
 				#pragma HLS PIPELINE II=2 //If equal, pipeline the outer loop. 
 			}			
-			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < ITERATION; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				if(PARALLEL_DISPARITIES < NUM_DISPARITY){
 					#pragma HLS PIPELINE II=1
 				}
@@ -246,22 +261,26 @@ void fpAggregateCost4Path(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DIS
 					#pragma HLS DEPENDENCE variable=Lr_r0_1 inter distance=2 true
 				}
 				else{
-					#pragma HLS DEPENDENCE variable=Lr_r0_0 inter distance=ITERATION*2-1 true
-					#pragma HLS DEPENDENCE variable=Lr_r0_1 inter distance=ITERATION*2-1 true					
+					#pragma HLS DEPENDENCE variable=Lr_r0_0 inter distance=MIN_ITERATION*2-1 true
+					#pragma HLS DEPENDENCE variable=Lr_r0_1 inter distance=MIN_ITERATION*2-1 true					
 				}
-				#pragma HLS DEPENDENCE variable=Lr_r0_border inter distance=ITERATION true
-				#pragma HLS DEPENDENCE variable=Lr_r1_0 inter distance=ITERATION*2 true
-				#pragma HLS DEPENDENCE variable=Lr_r1_1 inter distance=ITERATION*2 true
-				#pragma HLS DEPENDENCE variable=Lr_r1_border inter distance=ITERATION true				
+				#pragma HLS DEPENDENCE variable=Lr_r0_border inter distance=MIN_ITERATION true
+				#pragma HLS DEPENDENCE variable=Lr_r1_0 inter distance=MIN_ITERATION*2 true
+				#pragma HLS DEPENDENCE variable=Lr_r1_1 inter distance=MIN_ITERATION*2 true
+				#pragma HLS DEPENDENCE variable=Lr_r1_border inter distance=MIN_ITERATION true				
 				
 				#pragma HLS DEPENDENCE variable=Lr_min array inter false
-				#pragma HLS DEPENDENCE variable=Lr_r0_min_0 inter distance=ITERATION+1 true
-				#pragma HLS DEPENDENCE variable=Lr_r0_min_1 inter distance=ITERATION true
-				#pragma HLS DEPENDENCE variable=Lr_r1_min_0 inter distance=ITERATION+1 true
-				#pragma HLS DEPENDENCE variable=Lr_r1_min_1 inter distance=ITERATION true
+				#pragma HLS DEPENDENCE variable=Lr_r0_min_0 inter distance=MIN_ITERATION+1 true
+				#pragma HLS DEPENDENCE variable=Lr_r0_min_1 inter distance=MIN_ITERATION true
+				#pragma HLS DEPENDENCE variable=Lr_r1_min_0 inter distance=MIN_ITERATION+1 true
+				#pragma HLS DEPENDENCE variable=Lr_r1_min_1 inter distance=MIN_ITERATION true
 
 				/* Pack data to save memory usage */
-				ap_uint< AGGR_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES > Lr0 = Lr[0][(COLS+2)*iter+(col-2)];
+				// the r1 path restarts at col 1, nothing to read left of the first column
+				ap_uint< AGGR_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES > Lr0 = 0;
+				if(col>1){
+					Lr0 = Lr[0][(COLS+2)*iter+(col-2)];
+				}
 				ap_uint< AGGR_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES > Lr1 = Lr[1][(COLS+2)*iter+(col)];
 				ap_uint< AGGR_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES > Lr2 = Lr[2][(COLS+2)*iter+(col+2)];
 
@@ -313,7 +332,10 @@ void fpAggregateCost4Path(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DIS
 					else if(col.range(0,0)==1){
 						Lr_min_tmp[0] = Lr_r0_min_1;
 					}
-					Lr_min_tmp[1] = Lr_min[0][col-2];
+					Lr_min_tmp[1] = max_value_bound;
+					if(col>1){
+						Lr_min_tmp[1] = Lr_min[0][col-2];
+					}
 					Lr_min_tmp[2] = Lr_min[1][col];
 					Lr_min_tmp[3] = Lr_min[2][col+2];				
 				}
@@ -397,19 +419,19 @@ void fpAggregateCost4Path(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DIS
 						ap_uint<BIT_WIDTH(NUM_DISPARITY)> disparity_idx = iter*PARALLEL_DISPARITIES + num;
 
 						if (disparity_idx==0){
-							lr_dp = max_value_bound - P1;
+							lr_dp = max_value_bound - p1;
 						}
-						else if (disparity_idx >= (NUM_DISPARITY-1)){
-							lr_dn = max_value_bound - P1;
+						else if (disparity_idx >= (num_disparity-1)){
+							lr_dn = max_value_bound - p1;
 						}
 
 						AGGR_DISPARITY_TYPE(COST_VALUE,P2*2) min_val;
 						AGGR_DISPARITY_TYPE(COST_VALUE,P2*2) min_array[4];
 						#pragma HLS ARRAY_PARTITION variable=min_array complete dim=1
 						min_array[0] = lr_d;
-						min_array[1] = lr_dp + P1;
-						min_array[2] = lr_dn + P1;
-						min_array[3] = lr_minimum + P2;
+						min_array[1] = lr_dp + p1;
+						min_array[2] = lr_dn + p1;
+						min_array[3] = lr_minimum + p2;
 	
 						fpMinArrVal<4>::find(min_array,min_val);
 
@@ -493,8 +515,11 @@ void fpAggregateCost4Path(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DIS
 					}
 				}
 				else{
-					Lr[0][(COLS+2)*iter+col-2] = Lr_r1_1[iter];
-					Lr_Disparity[0][(COLS+2)*iter+(col-2)] = Lr_r1_1[iter].range(AGGR_DISPARITY_WIDTH(COST_VALUE,P2)-1,0);
+					// nothing is stored left of the first column
+					if(col>1){
+						Lr[0][(COLS+2)*iter+col-2] = Lr_r1_1[iter];
+						Lr_Disparity[0][(COLS+2)*iter+(col-2)] = Lr_r1_1[iter].range(AGGR_DISPARITY_WIDTH(COST_VALUE,P2)-1,0);
+					}
 					Lr_r1_1[iter] = combined_lr0;
 				}
 
@@ -508,7 +533,7 @@ void fpAggregateCost4Path(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DIS
 						Lr_min_post_tmp[r] = min_cost;
 				}
 
-				if (iter >= (ITERATION-1))// when its the last set of disparities update the min arrays
+				if (iter >= (iterations-1))// when its the last set of disparities update the min arrays
 				{
 					if(col.range(0,0)==0){
 						Lr_r0_min_0 = Lr_min_post_tmp[0];
@@ -528,7 +553,9 @@ void fpAggregateCost4Path(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DIS
 						}
 					}
 					else{
-						Lr_min[0][col-2] = Lr_r1_min_1;
+						if(col>1){
+							Lr_min[0][col-2] = Lr_r1_min_1;
+						}
 						Lr_r1_min_1 = Lr_min_post_tmp[1];
 					}
 
@@ -544,8 +571,12 @@ void fpAggregateCost4Path(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DIS
 			}			
 		}		
 	}
+	FP_PROCESS_END
 
 	/* Output aggregated costs to the next stage after reordering */
+	FP_PROCESS_BEGIN("reorder")
+	ap_uint<BIT_WIDTH(ROWS+1)> row;
+	ap_uint<BIT_WIDTH(COLS+1)> col;
 	for (row = 0; row < img_height; row++)
 	{
 		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS
@@ -556,8 +587,9 @@ void fpAggregateCost4Path(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DIS
 			{
 				#pragma HLS PIPELINE II=1 //If equal, pipeline the outer loop. 
 			}			
-			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < ITERATION; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 				ap_uint<AGGR4_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES> aggregated_data = 0;
@@ -576,13 +608,16 @@ void fpAggregateCost4Path(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DIS
 			}
 		}
 	}
+	FP_PROCESS_END
+	FP_DATAFLOW_END
 
 }
 
 /* The same copy of fpAggregateCost4Path, which is used to ensure parallel path aggregation with HLS tools when considering L-R consistency check. */
 template<int ROWS, int COLS, int COST_VALUE, int NUM_DISPARITY, int PARALLEL_DISPARITIES, int P1, int P2>
-void fpAggregateCost4Path_copy(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DISPARITIES], hls::stream< AGGR4_DISPARITY_TYPE(COST_VALUE,P2) > aggregated_cost[PARALLEL_DISPARITIES], 
-		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpAggregateCost4Path_copy(FP_STREAM< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DISPARITIES], FP_STREAM< AGGR4_DISPARITY_TYPE(COST_VALUE,P2) > aggregated_cost[PARALLEL_DISPARITIES], 
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity,
+		ap_uint<BIT_WIDTH(P1)> p1, ap_uint<BIT_WIDTH(P2)> p2)
 {
 	assert((AGGR_DISPARITY_WIDTH(COST_VALUE,P2) <= 20 ) && "The bit width of the aggregated cost should not exceed 20");
 
@@ -591,24 +626,28 @@ void fpAggregateCost4Path_copy(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLE
 	#pragma HLS ARRAY_PARTITION variable=cost complete dim=1
 	#pragma HLS ARRAY_PARTITION variable=aggregated_cost complete dim=1
 	
-    ap_uint<BIT_WIDTH(ROWS+1)> row;
-	ap_uint<BIT_WIDTH(COLS+1)> col;
-	
 	const int ITERATION = NUM_DISPARITY/PARALLEL_DISPARITIES;
+	/* The run-time range has at least two sets of disparities when ITERATION>1: the dependence distances hold for it */
+	const int MIN_ITERATION = (ITERATION>1) ? 2 : 1;
+	ap_uint<BIT_WIDTH(ITERATION)> iterations = num_disparity/PARALLEL_DISPARITIES;
 
 	/* Two FIFOs to reschedule the pixels at intervals */	
-	static hls::stream< ap_uint<BIT_WIDTH(COST_VALUE)*PARALLEL_DISPARITIES> > cost_tmp_0;
+	static FP_STREAM< ap_uint<BIT_WIDTH(COST_VALUE)*PARALLEL_DISPARITIES> > cost_tmp_0;
 	#pragma HLS STREAM variable=cost_tmp_0 depth=COLS*ITERATION/4 //The minimum length to disable stall
+	FP_STREAM_DEPTH(cost_tmp_0, COLS*ITERATION/4);
 
-	static hls::stream< ap_uint<BIT_WIDTH(COST_VALUE)*PARALLEL_DISPARITIES> > cost_tmp_1;
+	static FP_STREAM< ap_uint<BIT_WIDTH(COST_VALUE)*PARALLEL_DISPARITIES> > cost_tmp_1;
 	#pragma HLS STREAM variable=cost_tmp_1 depth=COLS*ITERATION/2 //The minimum length to disable stall
+	FP_STREAM_DEPTH(cost_tmp_1, COLS*ITERATION/2);
 
 	/* Two FIFOs to reorder the pixels and output them in the original order */
-	static hls::stream< ap_uint<AGGR4_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES> > aggregated_cost_tmp_0;
+	static FP_STREAM< ap_uint<AGGR4_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES> > aggregated_cost_tmp_0;
 	#pragma HLS STREAM variable=aggregated_cost_tmp_0 depth=COLS*ITERATION/2
+	FP_STREAM_DEPTH(aggregated_cost_tmp_0, COLS*ITERATION/2);
 
-	static hls::stream< ap_uint<AGGR4_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES> > aggregated_cost_tmp_1;
+	static FP_STREAM< ap_uint<AGGR4_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES> > aggregated_cost_tmp_1;
 	#pragma HLS STREAM variable=aggregated_cost_tmp_1 depth=COLS*ITERATION/4
+	FP_STREAM_DEPTH(aggregated_cost_tmp_1, COLS*ITERATION/4);
 
 	/* Array to store the temporary costs from previous pixels in r1, r2, r3 directions */
 	ap_uint<AGGR_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES> Lr[3][(COLS+2)*ITERATION];
@@ -662,6 +701,10 @@ void fpAggregateCost4Path_copy(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLE
 
 	const AGGR_DISPARITY_TYPE(COST_VALUE,P2) max_value_bound = (AGGR_DISPARITY_TYPE(COST_VALUE,P2))MAX_VALUE_BOUND;
 
+	FP_DATAFLOW_BEGIN
+	FP_PROCESS_BEGIN("interleave")
+	ap_uint<BIT_WIDTH(ROWS+1)> row;
+	ap_uint<BIT_WIDTH(COLS+1)> col;
 	for(row = 0; row < img_height; row++)
 	{
 		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS
@@ -672,8 +715,9 @@ void fpAggregateCost4Path_copy(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLE
 			{
 				#pragma HLS PIPELINE II=1 //If equal, pipeline the outer loop. 
 			}
-			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < ITERATION; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 				ap_uint<BIT_WIDTH(COST_VALUE)*PARALLEL_DISPARITIES> input_data = 0;
@@ -692,7 +736,11 @@ void fpAggregateCost4Path_copy(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLE
 			}
 		}
 	}
+	FP_PROCESS_END
 
+	FP_PROCESS_BEGIN("aggregate")
+	ap_uint<BIT_WIDTH(ROWS+1)> row;
+	ap_uint<BIT_WIDTH(COLS+1)> col;
 	for (row = 0; row < img_height + 1; row++)
 	{
 		#pragma HLS LOOP_TRIPCOUNT min=ROWS+1 max=ROWS+1
@@ -703,8 +751,9 @@ void fpAggregateCost4Path_copy(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLE
 			{
 				#pragma HLS PIPELINE II=2 //If equal, pipeline the outer loop. 
 			}			
-			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < ITERATION; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				if(PARALLEL_DISPARITIES < NUM_DISPARITY){
 					#pragma HLS PIPELINE II=1
 				}
@@ -716,21 +765,25 @@ void fpAggregateCost4Path_copy(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLE
 					#pragma HLS DEPENDENCE variable=Lr_r0_1 inter distance=2 true
 				}
 				else{
-					#pragma HLS DEPENDENCE variable=Lr_r0_0 inter distance=ITERATION*2-1 true
-					#pragma HLS DEPENDENCE variable=Lr_r0_1 inter distance=ITERATION*2-1 true					
+					#pragma HLS DEPENDENCE variable=Lr_r0_0 inter distance=MIN_ITERATION*2-1 true
+					#pragma HLS DEPENDENCE variable=Lr_r0_1 inter distance=MIN_ITERATION*2-1 true					
 				}
-				#pragma HLS DEPENDENCE variable=Lr_r0_border inter distance=ITERATION true
-				#pragma HLS DEPENDENCE variable=Lr_r1_0 inter distance=ITERATION*2 true
-				#pragma HLS DEPENDENCE variable=Lr_r1_1 inter distance=ITERATION*2 true
-				#pragma HLS DEPENDENCE variable=Lr_r1_border inter distance=ITERATION true				
+				#pragma HLS DEPENDENCE variable=Lr_r0_border inter distance=MIN_ITERATION true
+				#pragma HLS DEPENDENCE variable=Lr_r1_0 inter distance=MIN_ITERATION*2 true
+				#pragma HLS DEPENDENCE variable=Lr_r1_1 inter distance=MIN_ITERATION*2 true
+				#pragma HLS DEPENDENCE variable=Lr_r1_border inter distance=MIN_ITERATION true				
 				
 				#pragma HLS DEPENDENCE variable=Lr_min array inter false
-				#pragma HLS DEPENDENCE variable=Lr_r0_min_0 inter distance=ITERATION+1 true
-				#pragma HLS DEPENDENCE variable=Lr_r0_min_1 inter distance=ITERATION true
-				#pragma HLS DEPENDENCE variable=Lr_r1_min_0 inter distance=ITERATION+1 true
-				#pragma HLS DEPENDENCE variable=Lr_r1_min_1 inter distance=ITERATION true
-
-				ap_uint< AGGR_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES > Lr0 = Lr[0][(COLS+2)*iter+(col-2)];
+				#pragma HLS DEPENDENCE variable=Lr_r0_min_0 inter distance=MIN_ITERATION+1 true
+				#pragma HLS DEPENDENCE variable=Lr_r0_min_1 inter distance=MIN_ITERATION true
+				#pragma HLS DEPENDENCE variable=Lr_r1_min_0 inter distance=MIN_ITERATION+1 true
+				#pragma HLS DEPENDENCE variable=Lr_r1_min_1 inter distance=MIN_ITERATION true
+
+				// the r1 path restarts at col 1, nothing to read left of the first column
+				ap_uint< AGGR_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES > Lr0 = 0;
+				if(col>1){
+					Lr0 = Lr[0][(COLS+2)*iter+(col-2)];
+				}
 				ap_uint< AGGR_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES > Lr1 = Lr[1][(COLS+2)*iter+(col)];
 				ap_uint< AGGR_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES > Lr2 = Lr[2][(COLS+2)*iter+(col+2)];
 
@@ -782,7 +835,10 @@ void fpAggregateCost4Path_copy(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLE
 					else if(col.range(0,0)==1){
 						Lr_min_tmp[0] = Lr_r0_min_1;
 					}
-					Lr_min_tmp[1] = Lr_min[0][col-2];
+					Lr_min_tmp[1] = max_value_bound;
+					if(col>1){
+						Lr_min_tmp[1] = Lr_min[0][col-2];
+					}
 					Lr_min_tmp[2] = Lr_min[1][col];
 					Lr_min_tmp[3] = Lr_min[2][col+2];				
 				}
@@ -864,19 +920,19 @@ void fpAggregateCost4Path_copy(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLE
 						ap_uint<BIT_WIDTH(NUM_DISPARITY)> disparity_idx = iter*PARALLEL_DISPARITIES + num;
 
 						if (disparity_idx==0){
-							lr_dp = max_value_bound - P1;
+							lr_dp = max_value_bound - p1;
 						}
-						else if (disparity_idx >= (NUM_DISPARITY-1)){
-							lr_dn = max_value_bound - P1;
+						else if (disparity_idx >= (num_disparity-1)){
+							lr_dn = max_value_bound - p1;
 						}
 
 						AGGR_DISPARITY_TYPE(COST_VALUE,P2*2) min_val;
 						AGGR_DISPARITY_TYPE(COST_VALUE,P2*2) min_array[4];
 						#pragma HLS ARRAY_PARTITION variable=min_array complete dim=1
 						min_array[0] = lr_d;
-						min_array[1] = lr_dp + P1;
-						min_array[2] = lr_dn + P1;
-						min_array[3] = lr_minimum + P2;
+						min_array[1] = lr_dp + p1;
+						min_array[2] = lr_dn + p1;
+						min_array[3] = lr_minimum + p2;
 	
 						fpMinArrVal<4>::find(min_array,min_val);
 
@@ -954,8 +1010,11 @@ void fpAggregateCost4Path_copy(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLE
 					}
 				}
 				else{
-					Lr[0][(COLS+2)*iter+col-2] = Lr_r1_1[iter];
-					Lr_Disparity[0][(COLS+2)*iter+(col-2)] = Lr_r1_1[iter].range(AGGR_DISPARITY_WIDTH(COST_VALUE,P2)-1,0);
+					// nothing is stored left of the first column
+					if(col>1){
+						Lr[0][(COLS+2)*iter+col-2] = Lr_r1_1[iter];
+						Lr_Disparity[0][(COLS+2)*iter+(col-2)] = Lr_r1_1[iter].range(AGGR_DISPARITY_WIDTH(COST_VALUE,P2)-1,0);
+					}
 					Lr_r1_1[iter] = combined_lr0;
 				}
 
@@ -969,7 +1028,7 @@ void fpAggregateCost4Path_copy(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLE
 						Lr_min_post_tmp[r] = min_cost;
 				}
 
-				if (iter >= (ITERATION-1))// when its the last set of disparities update the min arrays
+				if (iter >= (iterations-1))// when its the last set of disparities update the min arrays
 				{
 					if(col.range(0,0)==0){
 						Lr_r0_min_0 = Lr_min_post_tmp[0];
@@ -989,7 +1048,9 @@ void fpAggregateCost4Path_copy(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLE
 						}
 					}
 					else{
-						Lr_min[0][col-2] = Lr_r1_min_1;
+						if(col>1){
+							Lr_min[0][col-2] = Lr_r1_min_1;
+						}
 						Lr_r1_min_1 = Lr_min_post_tmp[1];
 					}
 
@@ -1005,7 +1066,11 @@ void fpAggregateCost4Path_copy(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLE
 			}			
 		}		
 	}
+	FP_PROCESS_END
 
+	FP_PROCESS_BEGIN("reorder")
+	ap_uint<BIT_WIDTH(ROWS+1)> row;
+	ap_uint<BIT_WIDTH(COLS+1)> col;
 	for (row = 0; row < img_height; row++)
 	{
 		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS
@@ -1016,8 +1081,9 @@ void fpAggregateCost4Path_copy(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLE
 			{
 				#pragma HLS PIPELINE II=1 //If equal, pipeline the outer loop. 
 			}			
-			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < ITERATION; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 				ap_uint<AGGR4_DISPARITY_WIDTH(COST_VALUE,P2)*PARALLEL_DISPARITIES> aggregated_data = 0;
@@ -1036,6 +1102,344 @@ void fpAggregateCost4Path_copy(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLE
 			}
 		}
 	}
+	FP_PROCESS_END
+	FP_DATAFLOW_END
+
+}
+
+// One direction of the aggregation for a pixel with all its disparities. prev and the result hold the costs of the
+// path with the minimum cost in the last entry.
+template<int COST_VALUE, int NUM_DISPARITY, int P1, int P2>
+ap_uint<AGGR_DISPARITY_WIDTH(COST_VALUE,P2)*(NUM_DISPARITY+1)> fpAggregatePathNPC(ap_uint<BIT_WIDTH(COST_VALUE)*NUM_DISPARITY> pixel_cost,
+		ap_uint<AGGR_DISPARITY_WIDTH(COST_VALUE,P2)*(NUM_DISPARITY+1)> prev, bool restart, ap_uint<BIT_WIDTH(P1)> p1, ap_uint<BIT_WIDTH(P2)> p2)
+{
+	#pragma HLS INLINE
+	const int AW = AGGR_DISPARITY_WIDTH(COST_VALUE,P2);
+	const AGGR_DISPARITY_TYPE(COST_VALUE,P2) max_value_bound = (AGGR_DISPARITY_TYPE(COST_VALUE,P2))MAX_VALUE_BOUND;
+
+	AGGR_DISPARITY_TYPE(COST_VALUE,P2) lr_minimum = prev.range((NUM_DISPARITY+1)*AW-1,NUM_DISPARITY*AW);
+	AGGR_DISPARITY_TYPE(COST_VALUE,P2) store_lr_for_min[NUM_DISPARITY];
+	#pragma HLS ARRAY_PARTITION variable=store_lr_for_min complete dim=1
+	ap_uint<AW*(NUM_DISPARITY+1)> path = 0;
+	for(int num = 0; num < NUM_DISPARITY; num++)
+	{
+		#pragma HLS UNROLL
+		AGGR_DISPARITY_TYPE(COST_VALUE,P2) initial_cost = (AGGR_DISPARITY_TYPE(COST_VALUE,P2)) pixel_cost.range((num+1)*BIT_WIDTH(COST_VALUE)-1,num*BIT_WIDTH(COST_VALUE));
+		AGGR_DISPARITY_TYPE(COST_VALUE,P2) lr, lr_d, lr_dp, lr_dn;
+		lr_d = prev.range((num+1)*AW-1,num*AW);
+		if (num==0){
+			lr_dp = max_value_bound - p1;
+		}
+		else{
+			lr_dp = prev.range(num*AW-1,(num-1)*AW);
+		}
+		if (num==NUM_DISPARITY-1){
+			lr_dn = max_value_bound - p1;
+		}
+		else{
+			lr_dn = prev.range((num+2)*AW-1,(num+1)*AW);
+		}
+
+		AGGR_DISPARITY_TYPE(COST_VALUE,P2*2) min_val;
+		AGGR_DISPARITY_TYPE(COST_VALUE,P2*2) min_array[4];
+		#pragma HLS ARRAY_PARTITION variable=min_array complete dim=1
+		min_array[0] = lr_d;
+		min_array[1] = lr_dp + p1;
+		min_array[2] = lr_dn + p1;
+		min_array[3] = lr_minimum + p2;
+		fpMinArrVal<4>::find(min_array,min_val);
+
+		AGGR_DISPARITY_TYPE(COST_VALUE,P2) lr_tmp;
+		lr_tmp = initial_cost - lr_minimum; //unsigned substraction follows modulo computation: will not overflow.
+		lr = AGGR_DISPARITY_TYPE(COST_VALUE,P2)(min_val) + lr_tmp;
+		if (restart){
+			lr = initial_cost;
+		}
+		path.range((num+1)*AW-1,num*AW) = lr;
+		store_lr_for_min[num] = lr;
+	}
+	AGGR_DISPARITY_TYPE(COST_VALUE,P2) min_cost;
+	fpMinArrVal<NUM_DISPARITY>::find(store_lr_for_min, min_cost);
+	path.range((NUM_DISPARITY+1)*AW-1,NUM_DISPARITY*AW) = min_cost;
+	return path;
+}
+
+// Four-path cost aggregation of NPC pixels per clock with all the disparities at once. As in fpAggregateCost4Path,
+// the steps of the left half of a row alternate with the steps of the right half of the row above, which gives the
+// r0 direction two cycles; within a step the r0 direction runs through the NPC pixels.
+template<int ROWS, int COLS, int COST_VALUE, int NUM_DISPARITY, int NPC, int P1, int P2>
+void fpAggregateCost4PathNPC(FP_STREAM< ap_uint<BIT_WIDTH(COST_VALUE)*XF_NPIXPERCYCLE(NPC)> > cost[NUM_DISPARITY], 
+		FP_STREAM< ap_uint<AGGR4_DISPARITY_WIDTH(COST_VALUE,P2)*XF_NPIXPERCYCLE(NPC)> > aggregated_cost[NUM_DISPARITY], 
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(P1)> p1, ap_uint<BIT_WIDTH(P2)> p2)
+{
+	assert((AGGR_DISPARITY_WIDTH(COST_VALUE,P2) <= 20 ) && "The bit width of the aggregated cost should not exceed 20");
+	assert(((img_width % (2*XF_NPIXPERCYCLE(NPC))) == 0) && "The width must be a multiple of 2*NPC");
+
+	#pragma HLS DATAFLOW 
+	#pragma HLS INLINE OFF
+	#pragma HLS ARRAY_PARTITION variable=cost complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=aggregated_cost complete dim=1
+
+	const int NPIX = XF_NPIXPERCYCLE(NPC);
+	const int STEPS = COLS/NPIX;
+	const int AW = AGGR_DISPARITY_WIDTH(COST_VALUE,P2);
+	const int AW4 = AGGR4_DISPARITY_WIDTH(COST_VALUE,P2);
+	const int CW = BIT_WIDTH(COST_VALUE);
+
+	/* Two FIFOs to reschedule the steps at intervals */	
+	static FP_STREAM< ap_uint<CW*NUM_DISPARITY*NPIX> > cost_tmp_0;
+	#pragma HLS STREAM variable=cost_tmp_0 depth=STEPS/4 //The minimum length to disable stall
+	FP_STREAM_DEPTH(cost_tmp_0, STEPS/4);
+
+	static FP_STREAM< ap_uint<CW*NUM_DISPARITY*NPIX> > cost_tmp_1;
+	#pragma HLS STREAM variable=cost_tmp_1 depth=STEPS/2 //The minimum length to disable stall
+	FP_STREAM_DEPTH(cost_tmp_1, STEPS/2);
+
+	/* Two FIFOs to reorder the steps and output them in the original order */
+	static FP_STREAM< ap_uint<AW4*NUM_DISPARITY*NPIX> > aggregated_cost_tmp_0;
+	#pragma HLS STREAM variable=aggregated_cost_tmp_0 depth=STEPS/2
+	FP_STREAM_DEPTH(aggregated_cost_tmp_0, STEPS/2);
+
+	static FP_STREAM< ap_uint<AW4*NUM_DISPARITY*NPIX> > aggregated_cost_tmp_1;
+	#pragma HLS STREAM variable=aggregated_cost_tmp_1 depth=STEPS/4
+	FP_STREAM_DEPTH(aggregated_cost_tmp_1, STEPS/4);
+
+	/* Costs and minimum of the previous row in r1, r2, r3 directions, per pixel of a step.
+	   The last pixel of r1 is stored one step late, as Lr[0] in fpAggregateCost4Path */
+	ap_uint<AW*(NUM_DISPARITY+1)> Lr[3][NPIX][STEPS+3];
+	#pragma HLS ARRAY_PARTITION variable=Lr complete dim=1
+	#pragma HLS ARRAY_PARTITION variable=Lr complete dim=2
+
+	/* Registers of the last pixel of a step in r1 direction, until it is stored */
+	ap_uint<AW*(NUM_DISPARITY+1)> Lr_r1_0;
+	ap_uint<AW*(NUM_DISPARITY+1)> Lr_r1_1;
+	ap_uint<AW*(NUM_DISPARITY+1)> Lr_r1_border;
+
+	/* Registers of the last pixel of a step in r0 direction */
+	ap_uint<AW*(NUM_DISPARITY+1)> Lr_r0_0;
+	ap_uint<AW*(NUM_DISPARITY+1)> Lr_r0_1;
+	ap_uint<AW*(NUM_DISPARITY+1)> Lr_r0_border;
+
+	FP_DATAFLOW_BEGIN
+	/* Interleave the matching costs */
+	FP_PROCESS_BEGIN("interleave")
+	ap_uint<BIT_WIDTH(ROWS+1)> row;
+	ap_uint<BIT_WIDTH(COLS+1)> col;
+	ap_uint<BIT_WIDTH(COLS+1)> steps = img_width >> XF_BITSHIFT(NPC);
+	for(row = 0; row < img_height; row++)
+	{
+		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS
+		for (col = 0; col < steps; col++)
+		{
+			#pragma HLS LOOP_TRIPCOUNT min=STEPS max=STEPS
+			#pragma HLS PIPELINE II=1
+			ap_uint<CW*NUM_DISPARITY*NPIX> input_data = 0;
+			for(int num = 0; num < NUM_DISPARITY; num++)
+			{
+				#pragma HLS UNROLL
+				ap_uint<CW*NPIX> pixels = cost[num].read();
+				for(int p = 0; p < NPIX; p++)
+				{
+					#pragma HLS UNROLL
+					input_data.range((p*NUM_DISPARITY+num+1)*CW-1,(p*NUM_DISPARITY+num)*CW) = pixels.range((p+1)*CW-1,p*CW);
+				}
+			}
+			if (col<(steps>>1))
+			{
+				cost_tmp_0.write(input_data);
+			}
+			else{
+				cost_tmp_1.write(input_data);
+			}
+		}
+	}
+	FP_PROCESS_END
+
+	/* Process a step every clock cycle after interleaving */
+	FP_PROCESS_BEGIN("aggregate")
+	ap_uint<BIT_WIDTH(ROWS+1)> row;
+	ap_uint<BIT_WIDTH(COLS+1)> col;
+	ap_uint<BIT_WIDTH(COLS+1)> steps = img_width >> XF_BITSHIFT(NPC);
+	for (row = 0; row < img_height + 1; row++)
+	{
+		#pragma HLS LOOP_TRIPCOUNT min=ROWS+1 max=ROWS+1
+		for (col = 1; col < steps + 1; col++)
+		{
+			#pragma HLS LOOP_TRIPCOUNT min=STEPS max=STEPS
+			#pragma HLS PIPELINE II=2
+			#pragma HLS DEPENDENCE variable=Lr array inter false
+			#pragma HLS DEPENDENCE variable=Lr_r0_0 inter distance=2 true
+			#pragma HLS DEPENDENCE variable=Lr_r0_1 inter distance=2 true
+			#pragma HLS DEPENDENCE variable=Lr_r0_border inter distance=1 true
+			#pragma HLS DEPENDENCE variable=Lr_r1_0 inter distance=2 true
+			#pragma HLS DEPENDENCE variable=Lr_r1_1 inter distance=2 true
+			#pragma HLS DEPENDENCE variable=Lr_r1_border inter distance=1 true
+
+			bool odd = (col.range(0,0)==1);
+			ap_uint<BIT_WIDTH(COLS+1)> left_col = (col>1) ? (col-2) : 0;
+
+			/* Get the costs of previous pixels */
+			ap_uint<AW*(NUM_DISPARITY+1)> Lr_prev[3][NPIX];
+			#pragma HLS ARRAY_PARTITION variable=Lr_prev complete dim=0
+			for(int p = 0; p < NPIX; p++)
+			{
+				#pragma HLS UNROLL
+				if (p==0){
+					Lr_prev[0][p] = Lr[0][NPIX-1][left_col];
+				}
+				else{
+					Lr_prev[0][p] = Lr[0][p-1][col];
+				}
+				Lr_prev[1][p] = Lr[1][p][col];
+				if (p==NPIX-1){
+					Lr_prev[2][p] = Lr[2][0][col+2];
+				}
+				else{
+					Lr_prev[2][p] = Lr[2][p+1][col];
+				}
+			}
+
+			/* Read input matching costs */
+			ap_uint<CW*NUM_DISPARITY*NPIX> input_data = 0;
+			if (odd)
+			{
+				if(row!=img_height){
+					input_data = cost_tmp_0.read();
+				}
+			}
+			else{
+				if(row!=0){
+					input_data = cost_tmp_1.read();
+				}
+			}
+
+			// Do the computation for aggregation
+			bool top = (row==0) || ((row==1)&&(!odd));
+			ap_uint<AW*(NUM_DISPARITY+1)> lr0 = odd ? Lr_r0_1 : Lr_r0_0;
+			ap_uint<AW*(NUM_DISPARITY+1)> Lr_cur[3][NPIX];
+			#pragma HLS ARRAY_PARTITION variable=Lr_cur complete dim=0
+			ap_uint<AW4*NUM_DISPARITY*NPIX> aggregated_data = 0;
+			for(int p = 0; p < NPIX; p++)
+			{
+				#pragma HLS UNROLL
+				ap_uint<CW*NUM_DISPARITY> pixel_cost = input_data.range((p+1)*NUM_DISPARITY*CW-1,p*NUM_DISPARITY*CW);
+				bool first = odd && (col==1) && (p==0);
+				bool last = (!odd) && (col==steps) && (p==NPIX-1);
+				lr0 = fpAggregatePathNPC<COST_VALUE,NUM_DISPARITY,P1,P2>(pixel_cost, lr0, first, p1, p2);
+				Lr_cur[0][p] = fpAggregatePathNPC<COST_VALUE,NUM_DISPARITY,P1,P2>(pixel_cost, Lr_prev[0][p], first || top, p1, p2);
+				Lr_cur[1][p] = fpAggregatePathNPC<COST_VALUE,NUM_DISPARITY,P1,P2>(pixel_cost, Lr_prev[1][p], top, p1, p2);
+				Lr_cur[2][p] = fpAggregatePathNPC<COST_VALUE,NUM_DISPARITY,P1,P2>(pixel_cost, Lr_prev[2][p], top || last, p1, p2);
+				for(int num = 0; num < NUM_DISPARITY; num++)
+				{
+					#pragma HLS UNROLL
+					// accumulate results from all the directions
+					AGGR4_DISPARITY_TYPE(COST_VALUE,P2) aggregated_val = AGGR_DISPARITY_TYPE(COST_VALUE,P2)(lr0.range((num+1)*AW-1,num*AW));
+					for(int r = 0; r < 3; r++)
+					{
+						#pragma HLS UNROLL
+						aggregated_val += AGGR_DISPARITY_TYPE(COST_VALUE,P2)(Lr_cur[r][p].range((num+1)*AW-1,num*AW));
+					}
+					aggregated_data.range((p*NUM_DISPARITY+num+1)*AW4-1,(p*NUM_DISPARITY+num)*AW4) = aggregated_val;
+				}
+			}
+			/* Reorder aggregated costs */
+			if (odd) 
+			{
+				if (row!=img_height){
+					aggregated_cost_tmp_0.write(aggregated_data);
+				}
+			}
+			else{ 
+				if (row!=0){
+					aggregated_cost_tmp_1.write(aggregated_data);
+				}
+			}
+
+			/* Update aggregated costs in r0 direction */
+			if (odd){
+				Lr_r0_1 = lr0;
+				if(col==(steps-1)){
+					Lr_r0_border = lr0;
+				}
+			}
+			else{
+				Lr_r0_0 = lr0;
+				if(col==steps){
+					Lr_r0_0 = Lr_r0_border;
+				}
+			}
+			/* Update aggregated costs in r2 and r3 directions */
+			for(int p = 0; p < NPIX; p++)
+			{
+				#pragma HLS UNROLL
+				Lr[1][p][col] = Lr_cur[1][p];
+				if ((p==0)&&(col==2)){
+					Lr[2][p][steps+1] = Lr_cur[2][p];
+				}
+				else{
+					Lr[2][p][col] = Lr_cur[2][p];
+				}
+				if (p<NPIX-1){
+					Lr[0][p][col] = Lr_cur[0][p];
+				}
+			}
+			// updating the last pixel of the previous col-2 step in r1 direction
+			if (odd){
+				// nothing is stored left of the first step
+				if(col>1){
+					Lr[0][NPIX-1][left_col] = Lr_r1_1;
+				}
+				Lr_r1_1 = Lr_cur[0][NPIX-1];
+				if(col==(steps-1)){
+					Lr_r1_border = Lr_cur[0][NPIX-1];
+				}
+			}
+			else{
+				Lr[0][NPIX-1][left_col] = Lr_r1_0;
+				Lr_r1_0 = Lr_cur[0][NPIX-1];
+				if(col==steps){
+					Lr_r1_0 = Lr_r1_border;
+				}
+			}
+		}
+	}
+	FP_PROCESS_END
+
+	/* Output aggregated costs to the next stage after reordering */
+	FP_PROCESS_BEGIN("reorder")
+	ap_uint<BIT_WIDTH(ROWS+1)> row;
+	ap_uint<BIT_WIDTH(COLS+1)> col;
+	ap_uint<BIT_WIDTH(COLS+1)> steps = img_width >> XF_BITSHIFT(NPC);
+	for (row = 0; row < img_height; row++)
+	{
+		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS
+		for (col = 0; col < steps; col++)
+		{
+			#pragma HLS LOOP_TRIPCOUNT min=STEPS max=STEPS
+			#pragma HLS PIPELINE II=1
+			ap_uint<AW4*NUM_DISPARITY*NPIX> aggregated_data = 0;
+			if (col<(steps>>1))
+			{
+				aggregated_data = aggregated_cost_tmp_0.read();
+			}
+			else{
+				aggregated_data = aggregated_cost_tmp_1.read();
+			}
+			for(int num = 0; num < NUM_DISPARITY; num++)
+			{
+				#pragma HLS UNROLL
+				ap_uint<AW4*NPIX> pixels = 0;
+				for(int p = 0; p < NPIX; p++)
+				{
+					#pragma HLS UNROLL
+					pixels.range((p+1)*AW4-1,p*AW4) = aggregated_data.range((p*NUM_DISPARITY+num+1)*AW4-1,(p*NUM_DISPARITY+num)*AW4);
+				}
+				aggregated_cost[num].write(pixels);
+			}
+		}
+	}
+	FP_PROCESS_END
+	FP_DATAFLOW_END
 
 }
 
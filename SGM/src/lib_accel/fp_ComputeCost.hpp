@@ -26,15 +26,16 @@ namespace fp{
 /*------------------------------------------------SAD: Sum of Absolute Differences-------------------------------------------------*/
 // Matching cost computation: SAD
 template<int BW_INPUT, int ROWS, int COLS, int WINDOW_SIZE, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpComputeSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap_uint<BW_INPUT> > &src_r, 
-		hls::stream< DATA_TYPE(SAD_COST(BW_INPUT,WINDOW_SIZE)) > cost[PARALLEL_DISPARITIES], 
-        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpComputeSADCost(FP_STREAM< ap_uint<BW_INPUT> > &src_l, FP_STREAM< ap_uint<BW_INPUT> > &src_r, 
+		FP_STREAM< DATA_TYPE(SAD_COST(BW_INPUT,WINDOW_SIZE)) > cost[PARALLEL_DISPARITIES], 
+        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS DATAFLOW
 	#pragma HLS ARRAY_PARTITION variable=cost complete dim=1
 
 	const int ITERATION = NUM_DISPARITY/PARALLEL_DISPARITIES;
+	ap_uint<BIT_WIDTH(ITERATION)> iterations = num_disparity/PARALLEL_DISPARITIES;
 
 	hls::Window<WINDOW_SIZE, WINDOW_SIZE, ap_uint<BW_INPUT> > left_window_buf;
 	hls::Window<WINDOW_SIZE, NUM_DISPARITY+WINDOW_SIZE-1, ap_uint<BW_INPUT> > right_window_buf;  
@@ -108,8 +109,9 @@ void fpComputeSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap_u
 			{
 				#pragma HLS PIPELINE II=1 //If equal, pipeline the outer loop. 
 			}			
-			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < ITERATION; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 				#pragma HLS DEPENDENCE variable=left_line_buf.val array inter false
@@ -202,10 +204,10 @@ void fpComputeSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap_u
 
 // Matching cost computation: SAD for L-R consistency check (LR2 method)
 template<int BW_INPUT, int ROWS, int COLS, int WINDOW_SIZE, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpLRComputeSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap_uint<BW_INPUT> > &src_r, 
-		hls::stream< DATA_TYPE(SAD_COST(BW_INPUT,WINDOW_SIZE)) > left_cost[PARALLEL_DISPARITIES], 
-        hls::stream< DATA_TYPE(SAD_COST(BW_INPUT,WINDOW_SIZE)) > right_cost[PARALLEL_DISPARITIES],
-        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpLRComputeSADCost(FP_STREAM< ap_uint<BW_INPUT> > &src_l, FP_STREAM< ap_uint<BW_INPUT> > &src_r, 
+		FP_STREAM< DATA_TYPE(SAD_COST(BW_INPUT,WINDOW_SIZE)) > left_cost[PARALLEL_DISPARITIES], 
+        FP_STREAM< DATA_TYPE(SAD_COST(BW_INPUT,WINDOW_SIZE)) > right_cost[PARALLEL_DISPARITIES],
+        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS DATAFLOW	
@@ -213,6 +215,9 @@ void fpLRComputeSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap
     #pragma HLS ARRAY_PARTITION variable=right_cost complete dim=1
 
 	const int ITERATION = NUM_DISPARITY/PARALLEL_DISPARITIES;
+	ap_uint<BIT_WIDTH(ITERATION)> iterations = num_disparity/PARALLEL_DISPARITIES;
+	/* The right view lags num_disparity-1 columns behind the left one: its matches sit disparity_offset further in the left buffers */
+	ap_uint<BIT_WIDTH(NUM_DISPARITY)> disparity_offset = NUM_DISPARITY-num_disparity;
 
 	hls::Window<WINDOW_SIZE, NUM_DISPARITY+WINDOW_SIZE-1, ap_uint<BW_INPUT> > left_window_buf;
 	hls::Window<WINDOW_SIZE, NUM_DISPARITY+WINDOW_SIZE-1, ap_uint<BW_INPUT> > right_window_buf; 
@@ -272,15 +277,16 @@ void fpLRComputeSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap
 				right_window_buf.val[win_row][win_col] = 0;
 			}
 		}		
-        for(col = 0; col < img_width+half_win+NUM_DISPARITY-1; col++)
+        for(col = 0; col < img_width+half_win+num_disparity-1; col++)
 		{
 			#pragma HLS LOOP_TRIPCOUNT min=COLS+(WINDOW_SIZE>>1)+NUM_DISPARITY-1 max=COLS+(WINDOW_SIZE>>1)+NUM_DISPARITY-1
 			if (NUM_DISPARITY == PARALLEL_DISPARITIES)
 			{
 				#pragma HLS PIPELINE II=1 //If equal, pipeline the outer loop. 
 			}			
-			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < ITERATION; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 				#pragma HLS DEPENDENCE variable=left_line_buf.val array inter false
@@ -324,13 +330,13 @@ void fpLRComputeSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap
 					for(ap_uint<BIT_WIDTH(PARALLEL_DISPARITIES)> num = 0; num < PARALLEL_DISPARITIES; num++)
 					{
 						#pragma HLS UNROLL
-						tmp_left_window_buf.val[win_row][num] = left_window_buf.val[win_row][iter*PARALLEL_DISPARITIES+num];
+						tmp_left_window_buf.val[win_row][num] = left_window_buf.val[win_row][disparity_offset+iter*PARALLEL_DISPARITIES+num];
 						tmp_right_window_buf.val[win_row][num] = right_window_buf.val[win_row][iter*PARALLEL_DISPARITIES+num];
 					}
 					for(ap_uint<BIT_WIDTH(WINDOW_SIZE)> num = 0; num < WINDOW_SIZE-1; num++)
 					{
 						#pragma HLS UNROLL
-						tmp_left_window_buf.val[win_row][PARALLEL_DISPARITIES+num] = left_window_buf.val[win_row][(iter+1)*PARALLEL_DISPARITIES+num];
+						tmp_left_window_buf.val[win_row][PARALLEL_DISPARITIES+num] = left_window_buf.val[win_row][disparity_offset+(iter+1)*PARALLEL_DISPARITIES+num];
 						tmp_right_window_buf.val[win_row][PARALLEL_DISPARITIES+num] = right_window_buf.val[win_row][(iter+1)*PARALLEL_DISPARITIES+num];
 					}
 				}
@@ -371,7 +377,7 @@ void fpLRComputeSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap
 					for(ap_uint<BIT_WIDTH(WINDOW_SIZE)> win_col = 0; win_col < WINDOW_SIZE; win_col++)
 					{
 						#pragma HLS UNROLL
-						right_window.val[win_row][win_col] = right_window_buf.getval(win_row,NUM_DISPARITY+WINDOW_SIZE-2-win_col);
+						right_window.val[win_row][win_col] = right_window_buf.getval(win_row,num_disparity+WINDOW_SIZE-2-win_col);
 					}
 				}				
 				for(ap_uint<BIT_WIDTH(WINDOW_SIZE)> win_row = 0; win_row < WINDOW_SIZE; win_row++)
@@ -400,7 +406,7 @@ void fpLRComputeSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap
 						left_cost[num].write(left_SAD_value_buf[num]);
 					}
 				}
-				if (col>=(half_win+NUM_DISPARITY-1)) 
+				if (col>=(half_win+num_disparity-1)) 
 				{
 					for(ap_uint<BIT_WIDTH(PARALLEL_DISPARITIES)> num = 0; num < PARALLEL_DISPARITIES; num++)
 					{
@@ -437,15 +443,16 @@ ap_ufixed<BW_INPUT+3,BW_INPUT> fpComputeMean(hls::Window<WINDOW_SIZE, WINDOW_SIZ
 
 // Matching cost computation: ZSAD 
 template<int BW_INPUT, int ROWS, int COLS, int WINDOW_SIZE, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpComputeZSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap_uint<BW_INPUT> > &src_r, 
-		hls::stream< DATA_TYPE(ZSAD_COST(BW_INPUT,WINDOW_SIZE)) > cost[PARALLEL_DISPARITIES], 
-        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpComputeZSADCost(FP_STREAM< ap_uint<BW_INPUT> > &src_l, FP_STREAM< ap_uint<BW_INPUT> > &src_r, 
+		FP_STREAM< DATA_TYPE(ZSAD_COST(BW_INPUT,WINDOW_SIZE)) > cost[PARALLEL_DISPARITIES], 
+        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS DATAFLOW	
 	#pragma HLS ARRAY_PARTITION variable=cost complete dim=1
 
 	const int ITERATION = NUM_DISPARITY/PARALLEL_DISPARITIES;
+	ap_uint<BIT_WIDTH(ITERATION)> iterations = num_disparity/PARALLEL_DISPARITIES;
 	
 	hls::Window<WINDOW_SIZE, WINDOW_SIZE, ap_uint<BW_INPUT> > left_window_buf;
 	hls::Window<WINDOW_SIZE, NUM_DISPARITY+WINDOW_SIZE-1, ap_uint<BW_INPUT> > right_window_buf; 
@@ -529,8 +536,9 @@ void fpComputeZSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap_
 			{
 				#pragma HLS PIPELINE II=1 //If equal, pipeline the outer loop. 
 			}			
-			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < ITERATION; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 				#pragma HLS DEPENDENCE variable=left_line_buf.val array inter false
@@ -652,10 +660,10 @@ void fpComputeZSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap_
 
 // Matching cost computation: ZSAD for L-R consistency check (LR2 method)
 template<int BW_INPUT, int ROWS, int COLS, int WINDOW_SIZE, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpLRComputeZSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap_uint<BW_INPUT> > &src_r, 
-		hls::stream< DATA_TYPE(ZSAD_COST(BW_INPUT,WINDOW_SIZE)) > left_cost[PARALLEL_DISPARITIES], 
-        hls::stream< DATA_TYPE(ZSAD_COST(BW_INPUT,WINDOW_SIZE)) > right_cost[PARALLEL_DISPARITIES],
-        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpLRComputeZSADCost(FP_STREAM< ap_uint<BW_INPUT> > &src_l, FP_STREAM< ap_uint<BW_INPUT> > &src_r, 
+		FP_STREAM< DATA_TYPE(ZSAD_COST(BW_INPUT,WINDOW_SIZE)) > left_cost[PARALLEL_DISPARITIES], 
+        FP_STREAM< DATA_TYPE(ZSAD_COST(BW_INPUT,WINDOW_SIZE)) > right_cost[PARALLEL_DISPARITIES],
+        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS DATAFLOW	
@@ -663,6 +671,9 @@ void fpLRComputeZSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< a
     #pragma HLS ARRAY_PARTITION variable=right_cost complete dim=1
 
 	const int ITERATION = NUM_DISPARITY/PARALLEL_DISPARITIES;
+	ap_uint<BIT_WIDTH(ITERATION)> iterations = num_disparity/PARALLEL_DISPARITIES;
+	/* The right view lags num_disparity-1 columns behind the left one: its matches sit disparity_offset further in the left buffers */
+	ap_uint<BIT_WIDTH(NUM_DISPARITY)> disparity_offset = NUM_DISPARITY-num_disparity;
 
 	hls::Window<WINDOW_SIZE, NUM_DISPARITY+WINDOW_SIZE-1, ap_uint<BW_INPUT> > left_window_buf;
 	hls::Window<WINDOW_SIZE, NUM_DISPARITY+WINDOW_SIZE-1, ap_uint<BW_INPUT> > right_window_buf; 
@@ -733,15 +744,16 @@ void fpLRComputeZSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< a
 			left_mean_buf[i] = 0;
 			right_mean_buf[i] = 0;
 		}				
-        for(col = 0; col < img_width+half_win+NUM_DISPARITY-1; col++)
+        for(col = 0; col < img_width+half_win+num_disparity-1; col++)
 		{
 			#pragma HLS LOOP_TRIPCOUNT min=COLS+(WINDOW_SIZE>>1)+NUM_DISPARITY-1 max=COLS+(WINDOW_SIZE>>1)+NUM_DISPARITY-1
 			if (NUM_DISPARITY == PARALLEL_DISPARITIES)
 			{
 				#pragma HLS PIPELINE II=1 //If equal, pipeline the outer loop. 
 			}			
-			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < ITERATION; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 				#pragma HLS DEPENDENCE variable=left_line_buf.val array inter false
@@ -809,13 +821,13 @@ void fpLRComputeZSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< a
 					for(ap_uint<BIT_WIDTH(PARALLEL_DISPARITIES)> num = 0; num < PARALLEL_DISPARITIES; num++)
 					{
 						#pragma HLS UNROLL
-						tmp_left_window_buf.val[win_row][num] = left_window_buf.val[win_row][iter*PARALLEL_DISPARITIES+num];
+						tmp_left_window_buf.val[win_row][num] = left_window_buf.val[win_row][disparity_offset+iter*PARALLEL_DISPARITIES+num];
 						tmp_right_window_buf.val[win_row][num] = right_window_buf.val[win_row][iter*PARALLEL_DISPARITIES+num];
 					}
 					for(ap_uint<BIT_WIDTH(WINDOW_SIZE)> num = 0; num < WINDOW_SIZE-1; num++)
 					{
 						#pragma HLS UNROLL
-						tmp_left_window_buf.val[win_row][PARALLEL_DISPARITIES+num] = left_window_buf.val[win_row][(iter+1)*PARALLEL_DISPARITIES+num];
+						tmp_left_window_buf.val[win_row][PARALLEL_DISPARITIES+num] = left_window_buf.val[win_row][disparity_offset+(iter+1)*PARALLEL_DISPARITIES+num];
 						tmp_right_window_buf.val[win_row][PARALLEL_DISPARITIES+num] = right_window_buf.val[win_row][(iter+1)*PARALLEL_DISPARITIES+num];
 					}
 				}
@@ -867,7 +879,7 @@ void fpLRComputeZSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< a
 					for(ap_uint<BIT_WIDTH(WINDOW_SIZE)> win_col = 0; win_col < WINDOW_SIZE; win_col++)
 					{
 						#pragma HLS UNROLL
-						right_window.val[win_row][win_col] = right_window_buf.getval(win_row,NUM_DISPARITY+WINDOW_SIZE-2-win_col);
+						right_window.val[win_row][win_col] = right_window_buf.getval(win_row,num_disparity+WINDOW_SIZE-2-win_col);
 					}
 				}
 				for(ap_uint<BIT_WIDTH(WINDOW_SIZE)> win_row = 0; win_row < WINDOW_SIZE; win_row++)
@@ -881,9 +893,9 @@ void fpLRComputeZSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< a
 						{
 							#pragma HLS UNROLL
 							ap_uint<BW_INPUT> left_pixel = tmp_left_window_buf.val[win_row][num];
-							ap_ufixed<BW_INPUT+4,BW_INPUT+1> tmp2 = right_mean_buf[NUM_DISPARITY-1] + left_pixel;
+							ap_ufixed<BW_INPUT+4,BW_INPUT+1> tmp2 = right_mean_buf[num_disparity-1] + left_pixel;
 							if(num>=win_col){
-								int index = iter*PARALLEL_DISPARITIES + num - win_col;
+								int index = disparity_offset + iter*PARALLEL_DISPARITIES + num - win_col;
 								if(index>=NUM_DISPARITY){
 									index = NUM_DISPARITY-1; 
 								}
@@ -908,7 +920,7 @@ void fpLRComputeZSADCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< a
 						left_cost[num].write(left_ZSAD_value_buf[num]);
 					}
 				}
-				if (col>=(half_win+NUM_DISPARITY-1)) 
+				if (col>=(half_win+num_disparity-1)) 
 				{
 					for(ap_uint<BIT_WIDTH(PARALLEL_DISPARITIES)> num = 0; num < PARALLEL_DISPARITIES; num++)
 					{
@@ -949,7 +961,7 @@ DATA_TYPE(RANK_VALUE) fpComputeRank(hls::Window<WINDOW_SIZE, WINDOW_SIZE, ap_uin
 }
 // Matching cost computation: Rank transform 
 template<int BW_INPUT, int ROWS, int COLS, int WINDOW_SIZE, int RANK_VALUE>
-void fpRankTransformKernel(hls::stream< ap_uint<BW_INPUT> > &src, hls::stream< DATA_TYPE(RANK_VALUE) > &dst, 
+void fpRankTransformKernel(FP_STREAM< ap_uint<BW_INPUT> > &src, FP_STREAM< DATA_TYPE(RANK_VALUE) > &dst, 
         ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
 {
 	#pragma HLS INLINE off
@@ -1044,8 +1056,8 @@ void fpRankTransformKernel(hls::stream< ap_uint<BW_INPUT> > &src, hls::stream< D
 
 //compute absolute difference
 template<int ROWS, int COLS, int RANK_VALUE, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpRankComputationKernel(hls::stream< DATA_TYPE(RANK_VALUE) > &src_l, hls::stream< DATA_TYPE(RANK_VALUE) > &src_r, 
-		hls::stream< DATA_TYPE(RANK_VALUE) > cost[PARALLEL_DISPARITIES], ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpRankComputationKernel(FP_STREAM< DATA_TYPE(RANK_VALUE) > &src_l, FP_STREAM< DATA_TYPE(RANK_VALUE) > &src_r, 
+		FP_STREAM< DATA_TYPE(RANK_VALUE) > cost[PARALLEL_DISPARITIES], ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS ARRAY_PARTITION variable=cost complete dim=1
@@ -1057,6 +1069,8 @@ void fpRankComputationKernel(hls::stream< DATA_TYPE(RANK_VALUE) > &src_l, hls::s
 	
 	ap_uint<BIT_WIDTH(COLS)> col;
 	ap_uint<BIT_WIDTH(ROWS)> row;
+	const int ITERATION = NUM_DISPARITY/PARALLEL_DISPARITIES;
+	ap_uint<BIT_WIDTH(ITERATION)> iterations = num_disparity/PARALLEL_DISPARITIES;
 
 	for(row = 0; row < img_height; row++)
 	{
@@ -1073,8 +1087,9 @@ void fpRankComputationKernel(hls::stream< DATA_TYPE(RANK_VALUE) > &src_l, hls::s
 			{
 				#pragma HLS PIPELINE II=1 //If equal, pipeline the outer loop. 
 			}			
-			for(ap_uint<BIT_WIDTH(NUM_DISPARITY/PARALLEL_DISPARITIES)> iter = 0; iter < NUM_DISPARITY/PARALLEL_DISPARITIES; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 				if (iter==0)
@@ -1100,8 +1115,8 @@ void fpRankComputationKernel(hls::stream< DATA_TYPE(RANK_VALUE) > &src_l, hls::s
 }
 // compute absolute difference for LR consistency check
 template<int ROWS, int COLS, int RANK_VALUE, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpLRRankComputationKernel(hls::stream< DATA_TYPE(RANK_VALUE) > &src_l, hls::stream< DATA_TYPE(RANK_VALUE) > &src_r, hls::stream< DATA_TYPE(RANK_VALUE) > left_cost[PARALLEL_DISPARITIES],
-        hls::stream< DATA_TYPE(RANK_VALUE) > right_cost[PARALLEL_DISPARITIES], ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpLRRankComputationKernel(FP_STREAM< DATA_TYPE(RANK_VALUE) > &src_l, FP_STREAM< DATA_TYPE(RANK_VALUE) > &src_r, FP_STREAM< DATA_TYPE(RANK_VALUE) > left_cost[PARALLEL_DISPARITIES],
+        FP_STREAM< DATA_TYPE(RANK_VALUE) > right_cost[PARALLEL_DISPARITIES], ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS ARRAY_PARTITION variable=left_cost complete dim=1
@@ -1116,6 +1131,10 @@ void fpLRRankComputationKernel(hls::stream< DATA_TYPE(RANK_VALUE) > &src_l, hls:
 
 	ap_uint<BIT_WIDTH(COLS+NUM_DISPARITY-1)> col;
 	ap_uint<BIT_WIDTH(ROWS)> row;
+	const int ITERATION = NUM_DISPARITY/PARALLEL_DISPARITIES;
+	ap_uint<BIT_WIDTH(ITERATION)> iterations = num_disparity/PARALLEL_DISPARITIES;
+	/* The right view lags num_disparity-1 columns behind the left one: its matches sit disparity_offset further in the left buffers */
+	ap_uint<BIT_WIDTH(NUM_DISPARITY)> disparity_offset = NUM_DISPARITY-num_disparity;
 
 	for(row = 0; row < img_height; row++)
 	{
@@ -1126,15 +1145,16 @@ void fpLRRankComputationKernel(hls::stream< DATA_TYPE(RANK_VALUE) > &src_l, hls:
 			left_rank_buffer[i] = 0;
             right_rank_buffer[i] = 0;
 		}
-		for(col = 0; col < img_width + NUM_DISPARITY-1; col++)
+		for(col = 0; col < img_width + num_disparity-1; col++)
 		{
 			#pragma HLS LOOP_TRIPCOUNT min=COLS+NUM_DISPARITY-1 max=COLS+NUM_DISPARITY-1
 			if (NUM_DISPARITY == PARALLEL_DISPARITIES)
 			{
 				#pragma HLS PIPELINE II=1 //If equal, pipeline the outer loop. 
 			}			
-			for(ap_uint<BIT_WIDTH(NUM_DISPARITY/PARALLEL_DISPARITIES)> iter = 0; iter < NUM_DISPARITY/PARALLEL_DISPARITIES; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 				if (iter==0)
@@ -1164,11 +1184,11 @@ void fpLRRankComputationKernel(hls::stream< DATA_TYPE(RANK_VALUE) > &src_l, hls:
 				{
 					#pragma HLS UNROLL
 					DATA_TYPE(RANK_VALUE) left_sub_result = fpABSdiff< DATA_TYPE(RANK_VALUE) >(left_rank,right_rank_buffer[iter*PARALLEL_DISPARITIES+num]);
-                    DATA_TYPE(RANK_VALUE) right_sub_result = fpABSdiff< DATA_TYPE(RANK_VALUE) >(right_rank_buffer[NUM_DISPARITY-1],left_rank_buffer[iter*PARALLEL_DISPARITIES+num]);
+                    DATA_TYPE(RANK_VALUE) right_sub_result = fpABSdiff< DATA_TYPE(RANK_VALUE) >(right_rank_buffer[num_disparity-1],left_rank_buffer[disparity_offset+iter*PARALLEL_DISPARITIES+num]);
 					if(col<img_width){
 						left_cost[num].write(left_sub_result);
 					}
-					if(col>=(NUM_DISPARITY-1)){
+					if(col>=(num_disparity-1)){
 						right_cost[num].write(right_sub_result);	
 					}
 				}
@@ -1179,38 +1199,42 @@ void fpLRRankComputationKernel(hls::stream< DATA_TYPE(RANK_VALUE) > &src_l, hls:
 
 // Matching cost computation: rank transform
 template<int BW_INPUT, int ROWS, int COLS, int WINDOW_SIZE, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpComputeRankCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap_uint<BW_INPUT> > &src_r, 
-		hls::stream< DATA_TYPE(RANK_COST(WINDOW_SIZE)) > cost[PARALLEL_DISPARITIES], 
-		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpComputeRankCost(FP_STREAM< ap_uint<BW_INPUT> > &src_l, FP_STREAM< ap_uint<BW_INPUT> > &src_r, 
+		FP_STREAM< DATA_TYPE(RANK_COST(WINDOW_SIZE)) > cost[PARALLEL_DISPARITIES], 
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS DATAFLOW
 	#pragma HLS ARRAY_PARTITION variable=cost complete dim=1
 
-	hls::stream< DATA_TYPE(RANK_COST(WINDOW_SIZE)) > dst_l;
-	hls::stream< DATA_TYPE(RANK_COST(WINDOW_SIZE)) > dst_r;
-	fpRankTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,RANK_COST(WINDOW_SIZE)>(src_l,dst_l,img_height,img_width);
-	fpRankTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,RANK_COST(WINDOW_SIZE)>(src_r,dst_r,img_height,img_width);
-	fpRankComputationKernel<ROWS,COLS,RANK_COST(WINDOW_SIZE),NUM_DISPARITY,PARALLEL_DISPARITIES>(dst_l,dst_r,cost,img_height,img_width);
+	FP_STREAM< DATA_TYPE(RANK_COST(WINDOW_SIZE)) > dst_l;
+	FP_STREAM< DATA_TYPE(RANK_COST(WINDOW_SIZE)) > dst_r;
+	FP_DATAFLOW_BEGIN
+	FP_DATAFLOW_PROCESS(fpRankTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,RANK_COST(WINDOW_SIZE)>(src_l,dst_l,img_height,img_width));
+	FP_DATAFLOW_PROCESS(fpRankTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,RANK_COST(WINDOW_SIZE)>(src_r,dst_r,img_height,img_width));
+	FP_DATAFLOW_PROCESS(fpRankComputationKernel<ROWS,COLS,RANK_COST(WINDOW_SIZE),NUM_DISPARITY,PARALLEL_DISPARITIES>(dst_l,dst_r,cost,img_height,img_width,num_disparity));
+	FP_DATAFLOW_END
 }
 
 // Matching cost computation: rank transform for L-R consistency check
 template<int BW_INPUT, int ROWS, int COLS, int WINDOW_SIZE, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpLRComputeRankCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap_uint<BW_INPUT> > &src_r, 
-		hls::stream< DATA_TYPE(RANK_COST(WINDOW_SIZE)) > left_cost[PARALLEL_DISPARITIES], 
-		hls::stream< DATA_TYPE(RANK_COST(WINDOW_SIZE)) > right_cost[PARALLEL_DISPARITIES],
-		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpLRComputeRankCost(FP_STREAM< ap_uint<BW_INPUT> > &src_l, FP_STREAM< ap_uint<BW_INPUT> > &src_r, 
+		FP_STREAM< DATA_TYPE(RANK_COST(WINDOW_SIZE)) > left_cost[PARALLEL_DISPARITIES], 
+		FP_STREAM< DATA_TYPE(RANK_COST(WINDOW_SIZE)) > right_cost[PARALLEL_DISPARITIES],
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS DATAFLOW
 	#pragma HLS ARRAY_PARTITION variable=left_cost complete dim=1
 	#pragma HLS ARRAY_PARTITION variable=right_cost complete dim=1
 
-	hls::stream< DATA_TYPE(RANK_COST(WINDOW_SIZE)) > dst_l;
-	hls::stream< DATA_TYPE(RANK_COST(WINDOW_SIZE)) > dst_r;
-	fpRankTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,RANK_COST(WINDOW_SIZE)>(src_l,dst_l,img_height,img_width);
-	fpRankTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,RANK_COST(WINDOW_SIZE)>(src_r,dst_r,img_height,img_width);
-	fpLRRankComputationKernel<ROWS,COLS,RANK_COST(WINDOW_SIZE),NUM_DISPARITY,PARALLEL_DISPARITIES>(dst_l,dst_r,left_cost,right_cost,img_height,img_width);
+	FP_STREAM< DATA_TYPE(RANK_COST(WINDOW_SIZE)) > dst_l;
+	FP_STREAM< DATA_TYPE(RANK_COST(WINDOW_SIZE)) > dst_r;
+	FP_DATAFLOW_BEGIN
+	FP_DATAFLOW_PROCESS(fpRankTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,RANK_COST(WINDOW_SIZE)>(src_l,dst_l,img_height,img_width));
+	FP_DATAFLOW_PROCESS(fpRankTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,RANK_COST(WINDOW_SIZE)>(src_r,dst_r,img_height,img_width));
+	FP_DATAFLOW_PROCESS(fpLRRankComputationKernel<ROWS,COLS,RANK_COST(WINDOW_SIZE),NUM_DISPARITY,PARALLEL_DISPARITIES>(dst_l,dst_r,left_cost,right_cost,img_height,img_width,num_disparity));
+	FP_DATAFLOW_END
 }
 
 /*---------------------------------------------------Census Transform-----------------------------------------------------------*/
@@ -1241,7 +1265,7 @@ ap_uint<CENSUS_VALUE> fpComputeCensus(hls::Window<WINDOW_SIZE, WINDOW_SIZE, ap_u
 
 // Census transform
 template<int BW_INPUT, int ROWS, int COLS, int WINDOW_SIZE, int CENSUS_VALUE>
-void fpCensusTransformKernel(hls::stream< ap_uint<BW_INPUT> > &src, hls::stream< ap_uint<CENSUS_VALUE> > &dst, 
+void fpCensusTransformKernel(FP_STREAM< ap_uint<BW_INPUT> > &src, FP_STREAM< ap_uint<CENSUS_VALUE> > &dst, 
         ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
 {
 	#pragma HLS INLINE off
@@ -1339,8 +1363,8 @@ void fpCensusTransformKernel(hls::stream< ap_uint<BW_INPUT> > &src, hls::stream<
 
 // Compute hamming distance between census values
 template<int ROWS, int COLS, int WINDOW_SIZE, int CENSUS_VALUE, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l_census_fifo, hls::stream< ap_uint<CENSUS_VALUE> > &src_r_census_fifo, 
-		hls::stream< DATA_TYPE(CENSUS_VALUE) > cost[PARALLEL_DISPARITIES], ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpHammingDistance(FP_STREAM< ap_uint<CENSUS_VALUE> > &src_l_census_fifo, FP_STREAM< ap_uint<CENSUS_VALUE> > &src_r_census_fifo, 
+		FP_STREAM< DATA_TYPE(CENSUS_VALUE) > cost[PARALLEL_DISPARITIES], ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS ARRAY_PARTITION variable=cost complete dim=1
@@ -1353,6 +1377,8 @@ void fpHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l_census_fifo,
 	//ap_uint<13> col, row;
 	ap_uint<BIT_WIDTH(COLS)> col;
 	ap_uint<BIT_WIDTH(ROWS)> row;
+	const int ITERATION = NUM_DISPARITY/PARALLEL_DISPARITIES;
+	ap_uint<BIT_WIDTH(ITERATION)> iterations = num_disparity/PARALLEL_DISPARITIES;
 
 	for(row = 0; row < img_height; row++)
 	{
@@ -1370,8 +1396,9 @@ void fpHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l_census_fifo,
 			{
 				#pragma HLS PIPELINE II=1 //If equal, pipeline the outer loop. 
 			}			
-			for(ap_uint<BIT_WIDTH(NUM_DISPARITY/PARALLEL_DISPARITIES)> iter = 0; iter < NUM_DISPARITY/PARALLEL_DISPARITIES; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 
@@ -1407,9 +1434,9 @@ void fpHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l_census_fifo,
 
 // Compute hamming distance for L-R consistency check (LR2)
 template<int ROWS, int COLS, int WINDOW_SIZE, int CENSUS_VALUE, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpLRHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l_census_fifo, hls::stream< ap_uint<CENSUS_VALUE> > &src_r_census_fifo, 
-        hls::stream< DATA_TYPE(CENSUS_VALUE) > left_cost[PARALLEL_DISPARITIES], hls::stream< DATA_TYPE(CENSUS_VALUE) > right_cost[PARALLEL_DISPARITIES], 
-        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpLRHammingDistance(FP_STREAM< ap_uint<CENSUS_VALUE> > &src_l_census_fifo, FP_STREAM< ap_uint<CENSUS_VALUE> > &src_r_census_fifo, 
+        FP_STREAM< DATA_TYPE(CENSUS_VALUE) > left_cost[PARALLEL_DISPARITIES], FP_STREAM< DATA_TYPE(CENSUS_VALUE) > right_cost[PARALLEL_DISPARITIES], 
+        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS ARRAY_PARTITION variable=left_cost complete dim=1
@@ -1424,6 +1451,10 @@ void fpLRHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l_census_fifo
 	
 	ap_uint<BIT_WIDTH(COLS+NUM_DISPARITY-1)> col;
 	ap_uint<BIT_WIDTH(ROWS)> row;
+	const int ITERATION = NUM_DISPARITY/PARALLEL_DISPARITIES;
+	ap_uint<BIT_WIDTH(ITERATION)> iterations = num_disparity/PARALLEL_DISPARITIES;
+	/* The right view lags num_disparity-1 columns behind the left one: its matches sit disparity_offset further in the left buffers */
+	ap_uint<BIT_WIDTH(NUM_DISPARITY)> disparity_offset = NUM_DISPARITY-num_disparity;
 
 	for(row = 0; row < img_height; row++)
 	{
@@ -1435,15 +1466,16 @@ void fpLRHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l_census_fifo
 			left_census_buffer[i] = 0;
 		}
 
-		for(col = 0; col < img_width + NUM_DISPARITY-1; col++)
+		for(col = 0; col < img_width + num_disparity-1; col++)
 		{
 			#pragma HLS LOOP_TRIPCOUNT min=COLS+NUM_DISPARITY-1 max=COLS+NUM_DISPARITY-1
 			if (NUM_DISPARITY == PARALLEL_DISPARITIES)
 			{
 				#pragma HLS PIPELINE II=1 //If equal, pipeline the outer loop. 
 			}			
-			for(ap_uint<BIT_WIDTH(NUM_DISPARITY/PARALLEL_DISPARITIES)> iter = 0; iter < NUM_DISPARITY/PARALLEL_DISPARITIES; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 
@@ -1476,7 +1508,7 @@ void fpLRHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l_census_fifo
 					#pragma HLS UNROLL
 					ap_uint<CENSUS_VALUE> left_xor_result = left_census ^ right_census_buffer[iter*PARALLEL_DISPARITIES+num];
 					DATA_TYPE(CENSUS_VALUE) left_sum = 0;
-					ap_uint<CENSUS_VALUE> right_xor_result = right_census_buffer[NUM_DISPARITY-1] ^ left_census_buffer[iter*PARALLEL_DISPARITIES+num];
+					ap_uint<CENSUS_VALUE> right_xor_result = right_census_buffer[num_disparity-1] ^ left_census_buffer[disparity_offset+iter*PARALLEL_DISPARITIES+num];
 					DATA_TYPE(CENSUS_VALUE) right_sum = 0;					
 					for(DATA_TYPE(CENSUS_VALUE) j = 0; j < CENSUS_VALUE; j++)
 					{
@@ -1487,7 +1519,7 @@ void fpLRHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l_census_fifo
 					if(col<img_width){
 						left_cost[num].write(left_sum);
 					}
-					if(col>=(NUM_DISPARITY-1)){
+					if(col>=(num_disparity-1)){
 						right_cost[num].write(right_sum);	
 					}				
 				}
@@ -1498,40 +1530,261 @@ void fpLRHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l_census_fifo
 
 // Matching cost computation: Census transform 
 template<int BW_INPUT, int ROWS, int COLS, int WINDOW_SIZE, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpComputeCensusCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap_uint<BW_INPUT> > &src_r, 
-		hls::stream< DATA_TYPE(CENSUS_COST(WINDOW_SIZE)) > cost[PARALLEL_DISPARITIES], 
-		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpComputeCensusCost(FP_STREAM< ap_uint<BW_INPUT> > &src_l, FP_STREAM< ap_uint<BW_INPUT> > &src_r, 
+		FP_STREAM< DATA_TYPE(CENSUS_COST(WINDOW_SIZE)) > cost[PARALLEL_DISPARITIES], 
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS DATAFLOW
 	#pragma HLS ARRAY_PARTITION variable=cost complete dim=1
 
-	hls::stream< ap_uint<CENSUS_COST(WINDOW_SIZE)> > src_l_census_fifo;
-	hls::stream< ap_uint<CENSUS_COST(WINDOW_SIZE)> > src_r_census_fifo;
+	FP_STREAM< ap_uint<CENSUS_COST(WINDOW_SIZE)> > src_l_census_fifo;
+	FP_STREAM< ap_uint<CENSUS_COST(WINDOW_SIZE)> > src_r_census_fifo;
 
-	fpCensusTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_l,src_l_census_fifo,img_height,img_width);
-	fpCensusTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_r,src_r_census_fifo,img_height,img_width);
-	fpHammingDistance<ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE),NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l_census_fifo,src_r_census_fifo,cost,img_height,img_width);
+	FP_DATAFLOW_BEGIN
+	FP_DATAFLOW_PROCESS(fpCensusTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_l,src_l_census_fifo,img_height,img_width));
+	FP_DATAFLOW_PROCESS(fpCensusTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_r,src_r_census_fifo,img_height,img_width));
+	FP_DATAFLOW_PROCESS(fpHammingDistance<ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE),NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l_census_fifo,src_r_census_fifo,cost,img_height,img_width,num_disparity));
+	FP_DATAFLOW_END
 }
 
 // Matching cost computation: Census transform for L-R consistency check (LR2 method)
 template<int BW_INPUT, int ROWS, int COLS, int WINDOW_SIZE, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpLRComputeCensusCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap_uint<BW_INPUT> > &src_r, 
-		hls::stream< DATA_TYPE(CENSUS_COST(WINDOW_SIZE)) > left_cost[PARALLEL_DISPARITIES], 
-		hls::stream< DATA_TYPE(CENSUS_COST(WINDOW_SIZE)) > right_cost[PARALLEL_DISPARITIES],
-		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpLRComputeCensusCost(FP_STREAM< ap_uint<BW_INPUT> > &src_l, FP_STREAM< ap_uint<BW_INPUT> > &src_r, 
+		FP_STREAM< DATA_TYPE(CENSUS_COST(WINDOW_SIZE)) > left_cost[PARALLEL_DISPARITIES], 
+		FP_STREAM< DATA_TYPE(CENSUS_COST(WINDOW_SIZE)) > right_cost[PARALLEL_DISPARITIES],
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS DATAFLOW
 	#pragma HLS ARRAY_PARTITION variable=left_cost complete dim=1
 	#pragma HLS ARRAY_PARTITION variable=right_cost complete dim=1
 
-	hls::stream< ap_uint<CENSUS_COST(WINDOW_SIZE)> > src_l_census_fifo;
-	hls::stream< ap_uint<CENSUS_COST(WINDOW_SIZE)> > src_r_census_fifo;
+	FP_STREAM< ap_uint<CENSUS_COST(WINDOW_SIZE)> > src_l_census_fifo;
+	FP_STREAM< ap_uint<CENSUS_COST(WINDOW_SIZE)> > src_r_census_fifo;
 
-	fpCensusTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_l,src_l_census_fifo,img_height,img_width);
-	fpCensusTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_r,src_r_census_fifo,img_height,img_width);
-	fpLRHammingDistance<ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE),NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l_census_fifo,src_r_census_fifo,left_cost,right_cost,img_height,img_width);
+	FP_DATAFLOW_BEGIN
+	FP_DATAFLOW_PROCESS(fpCensusTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_l,src_l_census_fifo,img_height,img_width));
+	FP_DATAFLOW_PROCESS(fpCensusTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_r,src_r_census_fifo,img_height,img_width));
+	FP_DATAFLOW_PROCESS(fpLRHammingDistance<ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE),NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l_census_fifo,src_r_census_fifo,left_cost,right_cost,img_height,img_width,num_disparity));
+	FP_DATAFLOW_END
+}
+
+// Census transform of NPC pixels per clock: the window holds the NPC windows of a step and the columns still to come
+template<int BW_INPUT, int ROWS, int COLS, int NPC, int WINDOW_SIZE, int CENSUS_VALUE>
+void fpCensusTransformKernelNPC(FP_STREAM< ap_uint<BW_INPUT*XF_NPIXPERCYCLE(NPC)> > &src, FP_STREAM< ap_uint<CENSUS_VALUE*XF_NPIXPERCYCLE(NPC)> > &dst, 
+        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+{
+	#pragma HLS INLINE off
+	assert(((img_height <= ROWS ) && (img_width <= COLS)) && "ROWS and COLS should be greater than input image");
+
+	const int NPIX = XF_NPIXPERCYCLE(NPC);
+	const int HALF_WIN = WINDOW_SIZE >> 1;
+	const int BORDER_STEPS = (HALF_WIN+NPIX-1)/NPIX; //steps of zero columns at the right border
+	const int WIN_COLS = (BORDER_STEPS+1)*NPIX + HALF_WIN;
+
+	hls::Window<WINDOW_SIZE, WIN_COLS, ap_uint<BW_INPUT> > window_buf; //store the windows of NPIX pixels.
+	#pragma HLS ARRAY_PARTITION variable=window_buf.val complete dim=0
+	hls::LineBuffer<WINDOW_SIZE-1, (COLS>>XF_BITSHIFT(NPC)), ap_uint<BW_INPUT*NPIX> > line_buf; //store lines of packed pixels.
+	#pragma HLS RESOURCE variable=line_buf.val core=RAM_S2P_BRAM
+
+	ap_uint<BIT_WIDTH(WINDOW_SIZE)> half_win = HALF_WIN;
+	ap_uint<BIT_WIDTH(WINDOW_SIZE)> initial_row;
+	ap_uint<BIT_WIDTH(COLS)> steps = img_width >> XF_BITSHIFT(NPC);
+	ap_uint<BIT_WIDTH(COLS)> col;
+	ap_uint<BIT_WIDTH(ROWS)> row;
+	
+	//Initialize the line buffer
+	for( col = 0; col < steps; col++)
+	{
+		#pragma HLS LOOP_TRIPCOUNT min=COLS/NPIX max=COLS/NPIX
+		#pragma HLS pipeline
+		for(initial_row = 0; initial_row < half_win; initial_row++)
+		{
+			#pragma HLS UNROLL
+			line_buf.val[initial_row][col] = 0;
+		}
+		line_buf.val[half_win][col]=src.read();
+	}
+    ap_uint<BIT_WIDTH(WINDOW_SIZE)> next_row = half_win + 1;
+	for(ap_uint<BIT_WIDTH(WINDOW_SIZE)> i = 0; i < half_win-1; i++)
+	{
+		for( col = 0; col < steps; col++)
+		{
+			#pragma HLS LOOP_TRIPCOUNT min=COLS/NPIX max=COLS/NPIX
+			#pragma HLS pipeline
+			line_buf.val[next_row][col]=src.read();
+		}
+		next_row++;
+	}
+
+	//Initialize the window buffer
+	for(int win_row = 0; win_row < WINDOW_SIZE; win_row++)
+	{
+		#pragma HLS UNROLL
+		for(int win_col = 0; win_col < WIN_COLS; win_col++)
+		{
+			#pragma HLS UNROLL
+			window_buf.val[win_row][win_col] = 0;		
+		}
+	}
+	//Process the image
+	for(row = 0; row < img_height; row++)
+	{
+		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS
+		for(col = 0; col < steps + BORDER_STEPS; col++)
+		{
+			#pragma HLS LOOP_TRIPCOUNT min=COLS/NPIX+BORDER_STEPS max=COLS/NPIX+BORDER_STEPS
+			#pragma HLS pipeline
+			for(int win_row = 0; win_row < WINDOW_SIZE; win_row++)
+			{
+				#pragma HLS UNROLL
+				for(int win_col = 0; win_col < WIN_COLS-NPIX; win_col++)
+				{
+					#pragma HLS UNROLL
+					window_buf.val[win_row][win_col] = window_buf.val[win_row][win_col+NPIX];
+				}
+			}
+			ap_uint<BW_INPUT*NPIX> lines[WINDOW_SIZE];
+			#pragma HLS ARRAY_PARTITION variable=lines complete dim=1
+			for(int line_row = 0; line_row < WINDOW_SIZE; line_row++)
+			{
+				#pragma HLS UNROLL
+				lines[line_row] = 0;
+			}
+			if(col < steps)
+			{
+				for(int line_row = 0; line_row < WINDOW_SIZE-1; line_row++)
+				{
+					#pragma HLS UNROLL
+					lines[line_row] = line_buf.val[line_row][col];
+				}
+				if(row < img_height-half_win){
+					lines[WINDOW_SIZE-1] = src.read();
+				}
+				line_buf.shift_pixels_up(col);
+				line_buf.val[WINDOW_SIZE-2][col] = lines[WINDOW_SIZE-1];
+			}
+			for(int win_row = 0; win_row < WINDOW_SIZE; win_row++)
+			{
+				#pragma HLS UNROLL
+				for(int p = 0; p < NPIX; p++)
+				{
+					#pragma HLS UNROLL
+					window_buf.val[win_row][WIN_COLS-NPIX+p] = lines[win_row].range((p+1)*BW_INPUT-1,p*BW_INPUT);
+				}
+			}
+
+			ap_uint<CENSUS_VALUE*NPIX> census_value = 0;
+			for(int p = 0; p < NPIX; p++)
+			{
+				#pragma HLS UNROLL
+				hls::Window<WINDOW_SIZE, WINDOW_SIZE, ap_uint<BW_INPUT> > pixel_window;
+				for(int win_row = 0; win_row < WINDOW_SIZE; win_row++)
+				{
+					#pragma HLS UNROLL
+					for(int win_col = 0; win_col < WINDOW_SIZE; win_col++)
+					{
+						#pragma HLS UNROLL
+						pixel_window.val[win_row][win_col] = window_buf.val[win_row][p+win_col];
+					}
+				}
+				census_value.range((p+1)*CENSUS_VALUE-1,p*CENSUS_VALUE) = fpComputeCensus<BW_INPUT,WINDOW_SIZE,CENSUS_VALUE>(pixel_window);
+			}
+			if (col >= BORDER_STEPS) 
+			{
+				dst.write(census_value);
+			}
+		}
+	}	
+} 
+
+// Compute hamming distances of NPC pixels per clock, all disparities at once
+template<int ROWS, int COLS, int NPC, int CENSUS_VALUE, int NUM_DISPARITY>
+void fpHammingDistanceNPC(FP_STREAM< ap_uint<CENSUS_VALUE*XF_NPIXPERCYCLE(NPC)> > &src_l_census_fifo, FP_STREAM< ap_uint<CENSUS_VALUE*XF_NPIXPERCYCLE(NPC)> > &src_r_census_fifo, 
+		FP_STREAM< ap_uint<BIT_WIDTH(CENSUS_VALUE)*XF_NPIXPERCYCLE(NPC)> > cost[NUM_DISPARITY], ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+{
+	#pragma HLS INLINE OFF
+	#pragma HLS ARRAY_PARTITION variable=cost complete dim=1
+
+	const int NPIX = XF_NPIXPERCYCLE(NPC);
+	ap_uint<CENSUS_VALUE*NPIX> left_census;
+	ap_uint<CENSUS_VALUE*NPIX> right_census;
+	/* census_buffer[k] holds the right census value k pixels left of the last pixel of the step */
+	ap_uint<CENSUS_VALUE> census_buffer[NUM_DISPARITY+NPIX-1];
+	#pragma HLS ARRAY_PARTITION variable=census_buffer complete dim=1
+	
+	ap_uint<BIT_WIDTH(COLS)> steps = img_width >> XF_BITSHIFT(NPC);
+	ap_uint<BIT_WIDTH(COLS)> col;
+	ap_uint<BIT_WIDTH(ROWS)> row;
+
+	for(row = 0; row < img_height; row++)
+	{
+		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS
+		for(int i = 0; i < NUM_DISPARITY+NPIX-1; i++)
+		{
+			#pragma HLS UNROLL
+			census_buffer[i] = 0;
+		}
+
+		for(col = 0; col < steps; col++)
+		{
+			#pragma HLS LOOP_TRIPCOUNT min=COLS/NPIX max=COLS/NPIX
+			#pragma HLS PIPELINE II=1
+			left_census = src_l_census_fifo.read();
+			right_census = src_r_census_fifo.read();
+			for(int i = NUM_DISPARITY+NPIX-2; i >= NPIX; i--)
+			{
+				#pragma HLS UNROLL
+				census_buffer[i] = census_buffer[i-NPIX];
+			}
+			for(int p = 0; p < NPIX; p++)
+			{
+				#pragma HLS UNROLL
+				census_buffer[NPIX-1-p] = right_census.range((p+1)*CENSUS_VALUE-1,p*CENSUS_VALUE);
+			}
+			
+			for(int num = 0; num < NUM_DISPARITY; num++)
+			{
+				#pragma HLS UNROLL
+				ap_uint<BIT_WIDTH(CENSUS_VALUE)*NPIX> sums = 0;
+				for(int p = 0; p < NPIX; p++)
+				{
+					#pragma HLS UNROLL
+					ap_uint<CENSUS_VALUE> xor_result;
+					xor_result = ap_uint<CENSUS_VALUE>(left_census.range((p+1)*CENSUS_VALUE-1,p*CENSUS_VALUE)) ^ census_buffer[NPIX-1-p+num];
+					DATA_TYPE(CENSUS_VALUE) sum = 0;
+					for(DATA_TYPE(CENSUS_VALUE) j = 0; j < CENSUS_VALUE; j++)
+					{
+						#pragma HLS UNROLL
+						sum += xor_result.range(j,j);
+					}
+					sums.range((p+1)*BIT_WIDTH(CENSUS_VALUE)-1,p*BIT_WIDTH(CENSUS_VALUE)) = sum;
+				}
+				cost[num].write(sums);
+			}
+		}
+	}
+}
+
+// Matching cost computation: Census transform of NPC pixels per clock
+template<int BW_INPUT, int ROWS, int COLS, int NPC, int WINDOW_SIZE, int NUM_DISPARITY>
+void fpComputeCensusCostNPC(FP_STREAM< ap_uint<BW_INPUT*XF_NPIXPERCYCLE(NPC)> > &src_l, FP_STREAM< ap_uint<BW_INPUT*XF_NPIXPERCYCLE(NPC)> > &src_r, 
+		FP_STREAM< ap_uint<BIT_WIDTH(CENSUS_COST(WINDOW_SIZE))*XF_NPIXPERCYCLE(NPC)> > cost[NUM_DISPARITY], 
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+{
+	#pragma HLS INLINE OFF
+	#pragma HLS DATAFLOW
+	#pragma HLS ARRAY_PARTITION variable=cost complete dim=1
+
+	FP_STREAM< ap_uint<CENSUS_COST(WINDOW_SIZE)*XF_NPIXPERCYCLE(NPC)> > src_l_census_fifo;
+	FP_STREAM< ap_uint<CENSUS_COST(WINDOW_SIZE)*XF_NPIXPERCYCLE(NPC)> > src_r_census_fifo;
+
+	FP_DATAFLOW_BEGIN
+	FP_DATAFLOW_PROCESS(fpCensusTransformKernelNPC<BW_INPUT,ROWS,COLS,NPC,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_l,src_l_census_fifo,img_height,img_width));
+	FP_DATAFLOW_PROCESS(fpCensusTransformKernelNPC<BW_INPUT,ROWS,COLS,NPC,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_r,src_r_census_fifo,img_height,img_width));
+	FP_DATAFLOW_PROCESS(fpHammingDistanceNPC<ROWS,COLS,NPC,CENSUS_COST(WINDOW_SIZE),NUM_DISPARITY>(src_l_census_fifo,src_r_census_fifo,cost,img_height,img_width));
+	FP_DATAFLOW_END
 }
 
 /*------------------------------------------------SHD: Sum of Hamming distances-------------------------------------------------*/
@@ -1562,9 +1815,9 @@ DATA_TYPE(SHD_COST(CENSUS_VALUE,SHD_WINDOW)) fpComputeSHD(hls::Window<SHD_WINDOW
 }
 
 template<int ROWS, int COLS, int SHD_WINDOW, int CENSUS_VALUE, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpSumHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l, hls::stream< ap_uint<CENSUS_VALUE> > &src_r, 
-		hls::stream< DATA_TYPE(SHD_COST(CENSUS_VALUE,SHD_WINDOW)) > cost[PARALLEL_DISPARITIES], 
-        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpSumHammingDistance(FP_STREAM< ap_uint<CENSUS_VALUE> > &src_l, FP_STREAM< ap_uint<CENSUS_VALUE> > &src_r, 
+		FP_STREAM< DATA_TYPE(SHD_COST(CENSUS_VALUE,SHD_WINDOW)) > cost[PARALLEL_DISPARITIES], 
+        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS ARRAY_PARTITION variable=cost complete dim=1
@@ -1583,6 +1836,7 @@ void fpSumHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l, hls::stre
 	ap_uint<BIT_WIDTH(COLS)> col;
 	ap_uint<BIT_WIDTH(ROWS)> row;
 	const int ITERATION = NUM_DISPARITY/PARALLEL_DISPARITIES;
+	ap_uint<BIT_WIDTH(ITERATION)> iterations = num_disparity/PARALLEL_DISPARITIES;
 
 	//Initialize the line buffer
 	for( col = 0; col < img_width; col++)
@@ -1644,8 +1898,9 @@ void fpSumHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l, hls::stre
 			{
 				#pragma HLS PIPELINE II=1 //If equal, pipeline the outer loop. 
 			}			
-			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < ITERATION; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 				if (iter==0)
@@ -1709,10 +1964,10 @@ void fpSumHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l, hls::stre
 }
 
 template<int ROWS, int COLS, int SHD_WINDOW, int CENSUS_VALUE, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpLRSumHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l, hls::stream< ap_uint<CENSUS_VALUE> > &src_r, 
-		hls::stream< DATA_TYPE(SHD_COST(CENSUS_VALUE,SHD_WINDOW)) > left_cost[PARALLEL_DISPARITIES], 
-        hls::stream< DATA_TYPE(SHD_COST(CENSUS_VALUE,SHD_WINDOW)) > right_cost[PARALLEL_DISPARITIES],
-        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpLRSumHammingDistance(FP_STREAM< ap_uint<CENSUS_VALUE> > &src_l, FP_STREAM< ap_uint<CENSUS_VALUE> > &src_r, 
+		FP_STREAM< DATA_TYPE(SHD_COST(CENSUS_VALUE,SHD_WINDOW)) > left_cost[PARALLEL_DISPARITIES], 
+        FP_STREAM< DATA_TYPE(SHD_COST(CENSUS_VALUE,SHD_WINDOW)) > right_cost[PARALLEL_DISPARITIES],
+        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS ARRAY_PARTITION variable=left_cost complete dim=1
@@ -1733,6 +1988,9 @@ void fpLRSumHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l, hls::st
 	ap_uint<BIT_WIDTH(COLS)> col;
 	ap_uint<BIT_WIDTH(ROWS)> row;
 	const int ITERATION = NUM_DISPARITY/PARALLEL_DISPARITIES;
+	ap_uint<BIT_WIDTH(ITERATION)> iterations = num_disparity/PARALLEL_DISPARITIES;
+	/* The right view lags num_disparity-1 columns behind the left one: its matches sit disparity_offset further in the left buffers */
+	ap_uint<BIT_WIDTH(NUM_DISPARITY)> disparity_offset = NUM_DISPARITY-num_disparity;
 
 	//Initialize the line buffer
 	for( col = 0; col < img_width; col++)
@@ -1778,15 +2036,16 @@ void fpLRSumHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l, hls::st
                 }
             }        
         }		
-        for(col = 0; col < img_width+half_win+NUM_DISPARITY-1; col++)
+        for(col = 0; col < img_width+half_win+num_disparity-1; col++)
 		{
 			#pragma HLS LOOP_TRIPCOUNT min=COLS+(SHD_WINDOW>>1)+NUM_DISPARITY-1 max=COLS+(SHD_WINDOW>>1)+NUM_DISPARITY-1
 			if (NUM_DISPARITY == PARALLEL_DISPARITIES)
 			{
 				#pragma HLS PIPELINE II=1 //If equal, pipeline the outer loop. 
 			}			
-			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < ITERATION; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 				if (iter==0)
@@ -1852,11 +2111,11 @@ void fpLRSumHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l, hls::st
 				{
 					#pragma HLS UNROLL
                     DATA_TYPE(SHD_COST(CENSUS_VALUE,SHD_WINDOW)) left_SHD_value = fpComputeSHD<CENSUS_VALUE,SHD_WINDOW>(left_window_buf[NUM_DISPARITY-1], right_window_buf[iter*PARALLEL_DISPARITIES+num]);
-                    DATA_TYPE(SHD_COST(CENSUS_VALUE,SHD_WINDOW)) right_SHD_value = fpComputeSHD<CENSUS_VALUE,SHD_WINDOW>(right_window_buf[NUM_DISPARITY-1], left_window_buf[iter*PARALLEL_DISPARITIES+num]);
+                    DATA_TYPE(SHD_COST(CENSUS_VALUE,SHD_WINDOW)) right_SHD_value = fpComputeSHD<CENSUS_VALUE,SHD_WINDOW>(right_window_buf[num_disparity-1], left_window_buf[disparity_offset+iter*PARALLEL_DISPARITIES+num]);
                     if((col<img_width+half_win)&&(col>=half_win)){
 						left_cost[num].write(left_SHD_value);
 					}
-					if(col>=(half_win+NUM_DISPARITY-1)){
+					if(col>=(half_win+num_disparity-1)){
 						right_cost[num].write(right_SHD_value);	
 					}
 				}
@@ -1867,39 +2126,43 @@ void fpLRSumHammingDistance(hls::stream< ap_uint<CENSUS_VALUE> > &src_l, hls::st
 
 
 template<int BW_INPUT, int ROWS, int COLS, int WINDOW_SIZE, int SHD_WINDOW, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpComputeSHDCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap_uint<BW_INPUT> > &src_r, 
-		hls::stream< DATA_TYPE(SHD_COST(CENSUS_COST(WINDOW_SIZE),SHD_WINDOW)) > cost[PARALLEL_DISPARITIES], 
-		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpComputeSHDCost(FP_STREAM< ap_uint<BW_INPUT> > &src_l, FP_STREAM< ap_uint<BW_INPUT> > &src_r, 
+		FP_STREAM< DATA_TYPE(SHD_COST(CENSUS_COST(WINDOW_SIZE),SHD_WINDOW)) > cost[PARALLEL_DISPARITIES], 
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS DATAFLOW
 	#pragma HLS ARRAY_PARTITION variable=cost complete dim=1
 
-	hls::stream< ap_uint<CENSUS_COST(WINDOW_SIZE)> > src_l_census_fifo;
-	hls::stream< ap_uint<CENSUS_COST(WINDOW_SIZE)> > src_r_census_fifo;
+	FP_STREAM< ap_uint<CENSUS_COST(WINDOW_SIZE)> > src_l_census_fifo;
+	FP_STREAM< ap_uint<CENSUS_COST(WINDOW_SIZE)> > src_r_census_fifo;
 
-	fpCensusTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_l,src_l_census_fifo,img_height,img_width);
-	fpCensusTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_r,src_r_census_fifo,img_height,img_width);
-	fpSumHammingDistance<ROWS,COLS,SHD_WINDOW,CENSUS_COST(WINDOW_SIZE),NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l_census_fifo,src_r_census_fifo,cost,img_height,img_width);
+	FP_DATAFLOW_BEGIN
+	FP_DATAFLOW_PROCESS(fpCensusTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_l,src_l_census_fifo,img_height,img_width));
+	FP_DATAFLOW_PROCESS(fpCensusTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_r,src_r_census_fifo,img_height,img_width));
+	FP_DATAFLOW_PROCESS(fpSumHammingDistance<ROWS,COLS,SHD_WINDOW,CENSUS_COST(WINDOW_SIZE),NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l_census_fifo,src_r_census_fifo,cost,img_height,img_width,num_disparity));
+	FP_DATAFLOW_END
 }
 
 template<int BW_INPUT, int ROWS, int COLS, int WINDOW_SIZE, int SHD_WINDOW, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpLRComputeSHDCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap_uint<BW_INPUT> > &src_r, 
-		hls::stream< DATA_TYPE(SHD_COST(CENSUS_COST(WINDOW_SIZE),SHD_WINDOW)) > left_cost[PARALLEL_DISPARITIES], 
-		hls::stream< DATA_TYPE(SHD_COST(CENSUS_COST(WINDOW_SIZE),SHD_WINDOW)) > right_cost[PARALLEL_DISPARITIES],
-		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpLRComputeSHDCost(FP_STREAM< ap_uint<BW_INPUT> > &src_l, FP_STREAM< ap_uint<BW_INPUT> > &src_r, 
+		FP_STREAM< DATA_TYPE(SHD_COST(CENSUS_COST(WINDOW_SIZE),SHD_WINDOW)) > left_cost[PARALLEL_DISPARITIES], 
+		FP_STREAM< DATA_TYPE(SHD_COST(CENSUS_COST(WINDOW_SIZE),SHD_WINDOW)) > right_cost[PARALLEL_DISPARITIES],
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS DATAFLOW
 	#pragma HLS ARRAY_PARTITION variable=left_cost complete dim=1
 	#pragma HLS ARRAY_PARTITION variable=right_cost complete dim=1
 
-	hls::stream< ap_uint<CENSUS_COST(WINDOW_SIZE)> > src_l_census_fifo;
-	hls::stream< ap_uint<CENSUS_COST(WINDOW_SIZE)> > src_r_census_fifo;
+	FP_STREAM< ap_uint<CENSUS_COST(WINDOW_SIZE)> > src_l_census_fifo;
+	FP_STREAM< ap_uint<CENSUS_COST(WINDOW_SIZE)> > src_r_census_fifo;
 
-	fpCensusTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_l,src_l_census_fifo,img_height,img_width);
-	fpCensusTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_r,src_r_census_fifo,img_height,img_width);
-	fpLRSumHammingDistance<ROWS,COLS,SHD_WINDOW,CENSUS_COST(WINDOW_SIZE),NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l_census_fifo,src_r_census_fifo,left_cost,right_cost,img_height,img_width);
+	FP_DATAFLOW_BEGIN
+	FP_DATAFLOW_PROCESS(fpCensusTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_l,src_l_census_fifo,img_height,img_width));
+	FP_DATAFLOW_PROCESS(fpCensusTransformKernel<BW_INPUT,ROWS,COLS,WINDOW_SIZE,CENSUS_COST(WINDOW_SIZE)>(src_r,src_r_census_fifo,img_height,img_width));
+	FP_DATAFLOW_PROCESS(fpLRSumHammingDistance<ROWS,COLS,SHD_WINDOW,CENSUS_COST(WINDOW_SIZE),NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l_census_fifo,src_r_census_fifo,left_cost,right_cost,img_height,img_width,num_disparity));
+	FP_DATAFLOW_END
 }
 
 
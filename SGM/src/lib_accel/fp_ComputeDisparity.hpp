@@ -103,12 +103,13 @@ public:
 };
 
 template<typename T, int ROWS, int COLS, int DST_TYPE, int NPC, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpComputeDisparity(hls::stream< T > aggregated_cost[PARALLEL_DISPARITIES], hls::stream< XF_TNAME(DST_TYPE,NPC) > &dst_fifo, 
-		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpComputeDisparity(FP_STREAM< T > aggregated_cost[PARALLEL_DISPARITIES], FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &dst_fifo, 
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS array_partition variable=aggregated_cost complete dim=1
 	const int ITERATION = NUM_DISPARITY/PARALLEL_DISPARITIES;
+	ap_uint<BIT_WIDTH(ITERATION)> iterations = num_disparity/PARALLEL_DISPARITIES;
 	const T max_value_bound = (T)MAX_VALUE_BOUND;
 	
 	ap_uint<BIT_WIDTH(ROWS)> row;
@@ -126,8 +127,9 @@ void fpComputeDisparity(hls::stream< T > aggregated_cost[PARALLEL_DISPARITIES],
 
 			T min_aggregated_cost = max_value_bound;
 			XF_TNAME(DST_TYPE,NPC) min_disp;
-			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < ITERATION; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 				T tmp[PARALLEL_DISPARITIES];
@@ -152,12 +154,13 @@ void fpComputeDisparity(hls::stream< T > aggregated_cost[PARALLEL_DISPARITIES],
 
 
 template<typename T, int ROWS, int COLS, int DST_TYPE, int NPC, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpLRComputeDisparity(hls::stream< T > aggregated_cost[PARALLEL_DISPARITIES], hls::stream< XF_TNAME(DST_TYPE,NPC) > &left_dst_fifo, 
-		hls::stream< XF_TNAME(DST_TYPE,NPC) > &right_dst_fifo, ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpLRComputeDisparity(FP_STREAM< T > aggregated_cost[PARALLEL_DISPARITIES], FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &left_dst_fifo, 
+		FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &right_dst_fifo, ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS array_partition variable=aggregated_cost complete dim=1
 	const int ITERATION = NUM_DISPARITY/PARALLEL_DISPARITIES;
+	ap_uint<BIT_WIDTH(ITERATION)> iterations = num_disparity/PARALLEL_DISPARITIES;
 	const T max_value_bound = (T)MAX_VALUE_BOUND;
 	
 	T right_min[NUM_DISPARITY];
@@ -178,7 +181,7 @@ void fpLRComputeDisparity(hls::stream< T > aggregated_cost[PARALLEL_DISPARITIES]
 	for(row = 0; row < img_height; row++)
 	{
 		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS
-		for (col = 0; col < img_width + NUM_DISPARITY-1; col++)
+		for (col = 0; col < img_width + num_disparity-1; col++)
 		{
 			#pragma HLS LOOP_TRIPCOUNT min=COLS+NUM_DISPARITY-1 max=COLS+NUM_DISPARITY-1
 			if (NUM_DISPARITY == PARALLEL_DISPARITIES)
@@ -187,8 +190,9 @@ void fpLRComputeDisparity(hls::stream< T > aggregated_cost[PARALLEL_DISPARITIES]
 			}
 			T min_aggregated_cost = max_value_bound;
 			XF_TNAME(DST_TYPE,NPC) min_disp;
-			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < ITERATION; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 				T tmp[PARALLEL_DISPARITIES];
@@ -219,12 +223,12 @@ void fpLRComputeDisparity(hls::stream< T > aggregated_cost[PARALLEL_DISPARITIES]
 						right_min_disp[disparity_idx] = disparity_idx;
 					}
 				}				
-				if(iter>=(ITERATION-1)){
+				if(iter>=(iterations-1)){
 					if(col<img_width){
 						left_dst_fifo.write(min_disp);
 					}
-					if(col>=NUM_DISPARITY-1){
-						right_dst_fifo.write(right_min_disp[NUM_DISPARITY-1]);
+					if(col>=num_disparity-1){
+						right_dst_fifo.write(right_min_disp[num_disparity-1]);
 					}
 					for(int i = NUM_DISPARITY-1; i > 0; i--)
 					{
@@ -275,13 +279,15 @@ void fpSortArray(T sort_array[SIZE], T min_value[3], T_width &index, T_width &se
 }
 
 template<typename T, int ROWS, int COLS, int DST_TYPE, int NPC, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpComputeDisparityUniqueness(hls::stream< T > aggregated_cost[PARALLEL_DISPARITIES], hls::stream< XF_TNAME(DST_TYPE,NPC) > &dst_fifo, 
-		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpComputeDisparityUniqueness(FP_STREAM< T > aggregated_cost[PARALLEL_DISPARITIES], FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &dst_fifo, 
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity, ap_uint<7> uniq_ratio)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS array_partition variable=aggregated_cost complete dim=1
 	const int ITERATION = NUM_DISPARITY/PARALLEL_DISPARITIES;
+	ap_uint<BIT_WIDTH(ITERATION)> iterations = num_disparity/PARALLEL_DISPARITIES;
 	const T max_value_bound = (T)MAX_VALUE_BOUND;
+	ap_uint<7> uniq_factor = 100 - uniq_ratio;
 	
 	ap_uint<BIT_WIDTH(ROWS)> row;
 	ap_uint<BIT_WIDTH(COLS)> col;
@@ -304,8 +310,9 @@ void fpComputeDisparityUniqueness(hls::stream< T > aggregated_cost[PARALLEL_DISP
 			XF_TNAME(DST_TYPE,NPC) min_disp = 0;
 			XF_TNAME(DST_TYPE,NPC) second_min_disp = 0;
 			
-			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < ITERATION; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 				T tmp[PARALLEL_DISPARITIES];
@@ -347,11 +354,12 @@ void fpComputeDisparityUniqueness(hls::stream< T > aggregated_cost[PARALLEL_DISP
 				if(min_aggregated_cost_tmp[2]<min_aggregated_cost[2]){
 					min_aggregated_cost[2] = min_aggregated_cost_tmp[2];
 				}
-				if(iter>=ITERATION-1){
+				if(iter>=iterations-1){
 					XF_TNAME(DST_TYPE,NPC) abs_diff = fpABSdiff<XF_TNAME(DST_TYPE,NPC) >(min_disp,second_min_disp);
-					int min0 = (int(min_aggregated_cost[0])<<2)+(int(min_aggregated_cost[0])<<4);
-					int min1 = int(min_aggregated_cost[1])+(int(min_aggregated_cost[1])<<1)+(int(min_aggregated_cost[1])<<4);
-					int min2 = int(min_aggregated_cost[2])+(int(min_aggregated_cost[2])<<1)+(int(min_aggregated_cost[2])<<4);
+					// the best cost must be uniq_ratio percent below the others
+					int min0 = int(min_aggregated_cost[0])*100;
+					int min1 = int(min_aggregated_cost[1])*uniq_factor;
+					int min2 = int(min_aggregated_cost[2])*uniq_factor;
 					if( (abs_diff>1) && (min0>min1) ){
 						min_disp = 0;
 					}
@@ -366,13 +374,15 @@ void fpComputeDisparityUniqueness(hls::stream< T > aggregated_cost[PARALLEL_DISP
 }
 
 template<typename T, int ROWS, int COLS, int DST_TYPE, int NPC, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpLRComputeDisparityUniqueness(hls::stream< T > aggregated_cost[PARALLEL_DISPARITIES], hls::stream< XF_TNAME(DST_TYPE,NPC) > &left_dst_fifo, 
-		hls::stream< XF_TNAME(DST_TYPE,NPC) > &right_dst_fifo, ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpLRComputeDisparityUniqueness(FP_STREAM< T > aggregated_cost[PARALLEL_DISPARITIES], FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &left_dst_fifo, 
+		FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &right_dst_fifo, ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity, ap_uint<7> uniq_ratio)
 {
 	#pragma HLS INLINE OFF
 	#pragma HLS array_partition variable=aggregated_cost complete dim=1
 	const int ITERATION = NUM_DISPARITY/PARALLEL_DISPARITIES;
+	ap_uint<BIT_WIDTH(ITERATION)> iterations = num_disparity/PARALLEL_DISPARITIES;
 	const T max_value_bound = (T)MAX_VALUE_BOUND;
+	ap_uint<7> uniq_factor = 100 - uniq_ratio;
 	
 	T right_min[NUM_DISPARITY];
 	#pragma HLS ARRAY_PARTITION variable=right_min complete dim=1
@@ -392,7 +402,7 @@ void fpLRComputeDisparityUniqueness(hls::stream< T > aggregated_cost[PARALLEL_DI
 	for(row = 0; row < img_height; row++)
 	{
 		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS
-		for (col = 0; col < img_width + NUM_DISPARITY-1; col++)
+		for (col = 0; col < img_width + num_disparity-1; col++)
 		{
 			#pragma HLS LOOP_TRIPCOUNT min=COLS+NUM_DISPARITY-1 max=COLS+NUM_DISPARITY-1
 			if (NUM_DISPARITY == PARALLEL_DISPARITIES)
@@ -408,8 +418,9 @@ void fpLRComputeDisparityUniqueness(hls::stream< T > aggregated_cost[PARALLEL_DI
 			XF_TNAME(DST_TYPE,NPC) min_disp = 0;
 			XF_TNAME(DST_TYPE,NPC) second_min_disp = 0;
 
-			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < ITERATION; iter++)
+			for(ap_uint<BIT_WIDTH(ITERATION)> iter = 0; iter < iterations; iter++)
 			{
+				#pragma HLS LOOP_TRIPCOUNT min=1 max=ITERATION
 				#pragma HLS PIPELINE II=1
 				#pragma HLS loop_flatten
 				T tmp[PARALLEL_DISPARITIES];
@@ -464,11 +475,12 @@ void fpLRComputeDisparityUniqueness(hls::stream< T > aggregated_cost[PARALLEL_DI
 						right_min_disp[disparity_idx] = disparity_idx;
 					}
 				}				
-				if(iter>=(ITERATION-1)){
+				if(iter>=(iterations-1)){
 					XF_TNAME(DST_TYPE,NPC) abs_diff = fpABSdiff<XF_TNAME(DST_TYPE,NPC) >(min_disp,second_min_disp);
-					int min0 = (int(min_aggregated_cost[0])<<2)+(int(min_aggregated_cost[0])<<4);
-					int min1 = int(min_aggregated_cost[1])+(int(min_aggregated_cost[1])<<1)+(int(min_aggregated_cost[1])<<4);
-					int min2 = int(min_aggregated_cost[2])+(int(min_aggregated_cost[2])<<1)+(int(min_aggregated_cost[2])<<4);
+					// the best cost must be uniq_ratio percent below the others
+					int min0 = int(min_aggregated_cost[0])*100;
+					int min1 = int(min_aggregated_cost[1])*uniq_factor;
+					int min2 = int(min_aggregated_cost[2])*uniq_factor;
 					if( (abs_diff>1) && (min0>min1) ){
 						min_disp = 0;
 					}
@@ -478,8 +490,8 @@ void fpLRComputeDisparityUniqueness(hls::stream< T > aggregated_cost[PARALLEL_DI
 					if(col<img_width){
 						left_dst_fifo.write(min_disp);
 					}
-					if(col>=NUM_DISPARITY-1){
-						right_dst_fifo.write(right_min_disp[NUM_DISPARITY-1]);
+					if(col>=num_disparity-1){
+						right_dst_fifo.write(right_min_disp[num_disparity-1]);
 					}
 					for(int i = NUM_DISPARITY-1; i > 0; i--)
 					{
@@ -495,6 +507,154 @@ void fpLRComputeDisparityUniqueness(hls::stream< T > aggregated_cost[PARALLEL_DI
 	}
 }
 
+// Winner-takes-all of NPC pixels per clock with all the disparities at once
+template<int AGGR_WIDTH, int ROWS, int COLS, int DST_TYPE, int NPC, int NUM_DISPARITY>
+void fpComputeDisparityNPC(FP_STREAM< ap_uint<AGGR_WIDTH*XF_NPIXPERCYCLE(NPC)> > aggregated_cost[NUM_DISPARITY], FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &dst_fifo, 
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+{
+	#pragma HLS INLINE OFF
+	#pragma HLS array_partition variable=aggregated_cost complete dim=1
+	const int NPIX = XF_NPIXPERCYCLE(NPC);
+	const ap_uint<AGGR_WIDTH> max_value_bound = (ap_uint<AGGR_WIDTH>)MAX_VALUE_BOUND;
+	
+	ap_uint<BIT_WIDTH(COLS)> steps = img_width >> XF_BITSHIFT(NPC);
+	ap_uint<BIT_WIDTH(ROWS)> row;
+	ap_uint<BIT_WIDTH(COLS)> col;
+	for(row = 0; row < img_height; row++)
+	{
+		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS
+		for (col = 0; col < steps; col++)
+		{
+			#pragma HLS LOOP_TRIPCOUNT min=COLS/NPIX max=COLS/NPIX
+			#pragma HLS PIPELINE II=1
+			ap_uint<AGGR_WIDTH*NPIX> pixels[NUM_DISPARITY];
+			#pragma HLS ARRAY_PARTITION variable=pixels complete dim=1
+			for(int num = 0; num < NUM_DISPARITY; num++)
+			{
+				#pragma HLS UNROLL
+				pixels[num]=aggregated_cost[num].read();
+			}
+			XF_TNAME(DST_TYPE,NPC) min_disp = 0;
+			for(int p = 0; p < NPIX; p++)
+			{
+				#pragma HLS UNROLL
+				ap_uint<AGGR_WIDTH> tmp[NUM_DISPARITY];
+				#pragma HLS ARRAY_PARTITION variable=tmp complete dim=1
+				for(int num = 0; num < NUM_DISPARITY; num++)
+				{
+					#pragma HLS UNROLL
+					tmp[num] = pixels[num].range((p+1)*AGGR_WIDTH-1,p*AGGR_WIDTH);
+				}
+				ap_uint<AGGR_WIDTH> min_aggregated_cost;
+				ap_uint<BIT_WIDTH(NUM_DISPARITY)> min_disp_tmp;
+				fpMinArrIndexVal<NUM_DISPARITY>::find(tmp,min_disp_tmp,min_aggregated_cost);
+				if(min_aggregated_cost < max_value_bound){
+					min_disp.range((p+1)*XF_DTPIXELDEPTH(DST_TYPE,NPC)-1,p*XF_DTPIXELDEPTH(DST_TYPE,NPC)) = min_disp_tmp;
+				}
+			}
+			dst_fifo.write(min_disp);
+		}
+	}
+}
+
+// Winner-takes-all with uniqueness check of NPC pixels per clock with all the disparities at once
+template<int AGGR_WIDTH, int ROWS, int COLS, int DST_TYPE, int NPC, int NUM_DISPARITY>
+void fpComputeDisparityUniquenessNPC(FP_STREAM< ap_uint<AGGR_WIDTH*XF_NPIXPERCYCLE(NPC)> > aggregated_cost[NUM_DISPARITY], FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &dst_fifo, 
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<7> uniq_ratio)
+{
+	#pragma HLS INLINE OFF
+	#pragma HLS array_partition variable=aggregated_cost complete dim=1
+	const int NPIX = XF_NPIXPERCYCLE(NPC);
+	const ap_uint<AGGR_WIDTH> max_value_bound = (ap_uint<AGGR_WIDTH>)MAX_VALUE_BOUND;
+	ap_uint<7> uniq_factor = 100 - uniq_ratio;
+	
+	ap_uint<BIT_WIDTH(COLS)> steps = img_width >> XF_BITSHIFT(NPC);
+	ap_uint<BIT_WIDTH(ROWS)> row;
+	ap_uint<BIT_WIDTH(COLS)> col;
+	for(row = 0; row < img_height; row++)
+	{
+		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS
+		for (col = 0; col < steps; col++)
+		{
+			#pragma HLS LOOP_TRIPCOUNT min=COLS/NPIX max=COLS/NPIX
+			#pragma HLS PIPELINE II=1
+			ap_uint<AGGR_WIDTH*NPIX> pixels[NUM_DISPARITY];
+			#pragma HLS ARRAY_PARTITION variable=pixels complete dim=1
+			for(int num = 0; num < NUM_DISPARITY; num++)
+			{
+				#pragma HLS UNROLL
+				pixels[num]=aggregated_cost[num].read();
+			}
+			XF_TNAME(DST_TYPE,NPC) disparities = 0;
+			for(int p = 0; p < NPIX; p++)
+			{
+				#pragma HLS UNROLL
+				ap_uint<AGGR_WIDTH> tmp[NUM_DISPARITY];
+				#pragma HLS ARRAY_PARTITION variable=tmp complete dim=1
+				for(int num = 0; num < NUM_DISPARITY; num++)
+				{
+					#pragma HLS UNROLL
+					tmp[num] = pixels[num].range((p+1)*AGGR_WIDTH-1,p*AGGR_WIDTH);
+				}
+				ap_uint<AGGR_WIDTH> min_aggregated_cost[3];
+				#pragma HLS ARRAY_PARTITION variable=min_aggregated_cost complete dim=1
+				min_aggregated_cost[0] = max_value_bound;
+				min_aggregated_cost[1] = max_value_bound;
+				min_aggregated_cost[2] = max_value_bound;
+				ap_uint<XF_DTPIXELDEPTH(DST_TYPE,NPC)> min_disp = 0;
+				ap_uint<XF_DTPIXELDEPTH(DST_TYPE,NPC)> second_min_disp = 0;
+
+				ap_uint<AGGR_WIDTH> min_aggregated_cost_tmp[3];
+				#pragma HLS ARRAY_PARTITION variable=min_aggregated_cost_tmp complete dim=1
+				ap_uint<BIT_WIDTH(NUM_DISPARITY)> min_disp_tmp = 0;
+				ap_uint<BIT_WIDTH(NUM_DISPARITY)> second_min_disp_tmp = 0;
+				fpSortArray<NUM_DISPARITY,ap_uint<AGGR_WIDTH>,ap_uint<BIT_WIDTH(NUM_DISPARITY)> >(tmp,min_aggregated_cost_tmp,min_disp_tmp,second_min_disp_tmp);
+
+				// same order of updates as the single pixel version with one set of disparities
+				if(min_aggregated_cost_tmp[0]<min_aggregated_cost[0]){
+					min_aggregated_cost[2] = min_aggregated_cost[1];
+					min_aggregated_cost[1] = min_aggregated_cost[0];
+					min_aggregated_cost[0] = min_aggregated_cost_tmp[0];
+					second_min_disp = min_disp;
+					min_disp = min_disp_tmp;
+				}
+				else if(min_aggregated_cost_tmp[0]<min_aggregated_cost[1]){
+					min_aggregated_cost[2] = min_aggregated_cost[1];
+					min_aggregated_cost[1] = min_aggregated_cost_tmp[0];
+					second_min_disp = min_disp_tmp;
+				}
+				else if(min_aggregated_cost_tmp[0]<min_aggregated_cost[2]){
+					min_aggregated_cost[2] = min_aggregated_cost_tmp[0];
+				}
+				if(min_aggregated_cost_tmp[1]<min_aggregated_cost[1]){
+					min_aggregated_cost[2] = min_aggregated_cost[1];
+					min_aggregated_cost[1] = min_aggregated_cost_tmp[1];
+					second_min_disp = second_min_disp_tmp;
+				}
+				else if(min_aggregated_cost_tmp[1]<min_aggregated_cost[2]){
+					min_aggregated_cost[2] = min_aggregated_cost_tmp[1];
+				}
+				if(min_aggregated_cost_tmp[2]<min_aggregated_cost[2]){
+					min_aggregated_cost[2] = min_aggregated_cost_tmp[2];
+				}
+				ap_uint<XF_DTPIXELDEPTH(DST_TYPE,NPC)> abs_diff = fpABSdiff<ap_uint<XF_DTPIXELDEPTH(DST_TYPE,NPC)> >(min_disp,second_min_disp);
+				// the best cost must be uniq_ratio percent below the others
+				int min0 = int(min_aggregated_cost[0])*100;
+				int min1 = int(min_aggregated_cost[1])*uniq_factor;
+				int min2 = int(min_aggregated_cost[2])*uniq_factor;
+				if( (abs_diff>1) && (min0>min1) ){
+					min_disp = 0;
+				}
+				else if(min0>min2){
+					min_disp = 0;
+				}
+				disparities.range((p+1)*XF_DTPIXELDEPTH(DST_TYPE,NPC)-1,p*XF_DTPIXELDEPTH(DST_TYPE,NPC)) = min_disp;
+			}
+			dst_fifo.write(disparities);
+		}
+	}
+}
+
 }
 #endif
 
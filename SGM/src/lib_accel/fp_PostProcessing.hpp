@@ -30,8 +30,8 @@ T fpABSdiff(T a, T b)
 }
 
 template<int ROWS, int COLS, int DST_TYPE, int NPC, int NUM_DISPARITY>
-void fpLRCheckConsistency(hls::stream< XF_TNAME(DST_TYPE,NPC) > &left_fifo, hls::stream< XF_TNAME(DST_TYPE,NPC) > &right_fifo,
-		hls::stream< XF_TNAME(DST_TYPE,NPC) > &dst_fifo, ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpLRCheckConsistency(FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &left_fifo, FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &right_fifo,
+		FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &dst_fifo, ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
 {
 	#pragma HLS INLINE OFF
 	
@@ -110,7 +110,7 @@ XF_TNAME(DST_TYPE,NPC) fpValidatePixel(XF_TNAME(DST_TYPE,NPC) right_disp[GAP_THR
 
 
 template<int ROWS, int COLS, int DST_TYPE, int NPC, int NUM_DISPARITY, int GAP_THRESHOLD>
-void fpInterpolation(hls::stream< XF_TNAME(DST_TYPE,NPC) > &src_fifo, hls::stream< XF_TNAME(DST_TYPE,NPC) > &dst_fifo,
+void fpInterpolation(FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &src_fifo, FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &dst_fifo,
         ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
 {
 	#pragma HLS INLINE OFF
@@ -217,7 +217,7 @@ T fpSortMedian(hls::Window<FilterWin, FilterWin, T > window_buf)
 }
 
 template<int ROWS, int COLS, int DST_TYPE, int NPC, int FilterWin>
-void fpMedianFilter(hls::stream< XF_TNAME(DST_TYPE,NPC) > &src_fifo, hls::stream< XF_TNAME(DST_TYPE,NPC) > &dst_fifo,
+void fpMedianFilter(FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &src_fifo, FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &dst_fifo,
         ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
 {
     #pragma HLS INLINE OFF
@@ -324,6 +324,143 @@ void fpMedianFilter(hls::stream< XF_TNAME(DST_TYPE,NPC) > &src_fifo, hls::stream
 
 }
 
+// Median filter of NPC pixels per clock: the window holds the NPC windows of a step and the columns still to come
+template<int ROWS, int COLS, int DST_TYPE, int NPC, int FilterWin>
+void fpMedianFilterNPC(FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &src_fifo, FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &dst_fifo,
+        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+{
+    #pragma HLS INLINE OFF
+
+	const int NPIX = XF_NPIXPERCYCLE(NPC);
+	const int PIXEL_WIDTH = XF_DTPIXELDEPTH(DST_TYPE,NPC);
+	const int HALF_WIN = FilterWin >> 1;
+	const int BORDER_STEPS = (HALF_WIN+NPIX-1)/NPIX; //steps of replicated columns at the right border
+	const int WIN_COLS = (BORDER_STEPS+1)*NPIX + HALF_WIN;
+
+    hls::Window<FilterWin, WIN_COLS, ap_uint<PIXEL_WIDTH> > window_buf;
+	#pragma HLS ARRAY_PARTITION variable=window_buf.val complete dim=0
+    hls::LineBuffer<FilterWin-1, (COLS>>XF_BITSHIFT(NPC)), XF_TNAME(DST_TYPE,NPC)> line_buf;
+	#pragma HLS RESOURCE variable=line_buf.val core=RAM_S2P_BRAM
+
+	ap_uint<BIT_WIDTH(COLS)> steps = img_width >> XF_BITSHIFT(NPC);
+	ap_uint<BIT_WIDTH(COLS+BORDER_STEPS)> col;
+	ap_uint<BIT_WIDTH(ROWS)> row;
+
+	//Initialize the line buffer
+	for( col = 0; col < steps; col++)
+	{
+		#pragma HLS LOOP_TRIPCOUNT min=1 max=COLS/NPIX
+		#pragma HLS pipeline
+		XF_TNAME(DST_TYPE,NPC) tmp_read = src_fifo.read();
+        line_buf.val[HALF_WIN][col] = tmp_read;
+		for(int initial_row = 0; initial_row < HALF_WIN; initial_row++)
+		{
+			#pragma HLS UNROLL
+			line_buf.val[initial_row][col] = tmp_read; //top border
+		}
+	}
+	for(int next_row = HALF_WIN + 1; next_row < FilterWin-1; next_row++)
+	{
+		for( col = 0; col < steps; col++)
+		{
+			#pragma HLS LOOP_TRIPCOUNT min=1 max=COLS/NPIX
+			#pragma HLS pipeline
+			line_buf.val[next_row][col] = src_fifo.read();
+		}
+	}
+
+	//Process the image
+	for(row = 0; row < img_height; row++)
+	{
+		#pragma HLS LOOP_TRIPCOUNT min=1 max=ROWS
+		for(col = 0; col < steps + BORDER_STEPS; col++)
+		{
+			#pragma HLS LOOP_TRIPCOUNT min=1 max=COLS/NPIX+BORDER_STEPS
+			#pragma HLS pipeline
+            for(int win_row = 0; win_row < FilterWin; win_row++)
+            {
+                #pragma HLS UNROLL
+                for(int win_col = 0; win_col < WIN_COLS-NPIX; win_col++)
+                {
+                    #pragma HLS UNROLL
+                    window_buf.val[win_row][win_col] = window_buf.val[win_row][win_col+NPIX];
+                }
+            }
+            if(col<steps)
+            {
+				XF_TNAME(DST_TYPE,NPC) lines[FilterWin];
+				#pragma HLS ARRAY_PARTITION variable=lines complete dim=1
+                for(int line_row = 0; line_row < FilterWin-1; line_row++)
+                {
+                    #pragma HLS UNROLL
+                    lines[line_row] = line_buf.val[line_row][col];
+                }
+                if(row < img_height-HALF_WIN){ //bottom border
+                    lines[FilterWin-1] = src_fifo.read();
+                }
+                else{
+                    lines[FilterWin-1] = lines[FilterWin-2];
+                }
+                line_buf.shift_pixels_up(col);
+                line_buf.val[FilterWin-2][col] = lines[FilterWin-1];
+                for(int win_row = 0; win_row < FilterWin; win_row++)
+                {
+                    #pragma HLS UNROLL
+                    for(int p = 0; p < NPIX; p++)
+                    {
+                        #pragma HLS UNROLL
+                        window_buf.val[win_row][WIN_COLS-NPIX+p] = lines[win_row].range((p+1)*PIXEL_WIDTH-1,p*PIXEL_WIDTH);
+                    }
+                }
+            }
+            else{ //right border
+                for(int win_row = 0; win_row < FilterWin; win_row++)
+                {
+                    #pragma HLS UNROLL
+                    for(int p = 0; p < NPIX; p++)
+                    {
+                        #pragma HLS UNROLL
+                        window_buf.val[win_row][WIN_COLS-NPIX+p] = window_buf.val[win_row][WIN_COLS-NPIX-1];
+                    }
+                }
+            }
+            if(col==0){ //left border
+                for(int win_row = 0; win_row < FilterWin; win_row++)
+                {
+                    #pragma HLS UNROLL
+                    for(int win_col = 0; win_col < WIN_COLS-NPIX; win_col++)
+                    {
+                        #pragma HLS UNROLL
+                        window_buf.val[win_row][win_col] = window_buf.val[win_row][WIN_COLS-NPIX];
+                    }
+                }
+            }
+
+            XF_TNAME(DST_TYPE,NPC) MedianValues = 0;
+            for(int p = 0; p < NPIX; p++)
+            {
+                #pragma HLS UNROLL
+                hls::Window<FilterWin, FilterWin, ap_uint<PIXEL_WIDTH> > pixel_window;
+                for(int win_row = 0; win_row < FilterWin; win_row++)
+                {
+                    #pragma HLS UNROLL
+                    for(int win_col = 0; win_col < FilterWin; win_col++)
+                    {
+                        #pragma HLS UNROLL
+                        pixel_window.val[win_row][win_col] = window_buf.val[win_row][p+win_col];
+                    }
+                }
+                MedianValues.range((p+1)*PIXEL_WIDTH-1,p*PIXEL_WIDTH) = fpSortMedian<ap_uint<PIXEL_WIDTH>,FilterWin>(pixel_window);
+            }
+			if (col >= BORDER_STEPS) 
+			{
+				dst_fifo.write(MedianValues);
+			}
+		}
+	}	
+
+}
+
 
 }
 #endif
@@ -0,0 +1,379 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+#ifndef _FP_DATAFLOW_H_
+#define _FP_DATAFLOW_H_
+
+#ifndef __cplusplus
+#error C++ is needed to use this file!
+#endif
+
+/*
+ * Streams and processes of the DATAFLOW regions.
+ *
+ * By default FP_STREAM is hls::stream and the processes of a region run one after the other, as in the
+ * C-simulation of Vivado HLS, where every stream has to hold a whole frame.
+ *
+ * Compiling the C-simulation with -DFP_CSIM_THREADS (C++11, linked with -pthread) runs every process of a
+ * region on its own thread. The streams become bounded lock-free single-producer single-consumer FIFOs, with
+ * the depth given by FP_STREAM_DEPTH next to the STREAM pragma, or 2 as in synthesis. A process blocks on a
+ * full or an empty FIFO. When every process has been blocked for FP_CSIM_DEADLOCK_MS, the simulation prints
+ * the blocked FIFOs and aborts, so an undersized FIFO shows up before synthesis.
+ * -DFP_CSIM_PROFILE also records the occupancy and the stalls of every FIFO (lib_accel/fp_fifo_profile.h).
+ *
+ *	FP_DATAFLOW_BEGIN                              after the declarations of the region
+ *	FP_DATAFLOW_PROCESS(fpKernel<...>(a, b));      a function call as a process
+ *	FP_PROCESS_BEGIN("name") for(...){...} FP_PROCESS_END      a loop as a process
+ *	FP_DATAFLOW_END                                waits for the processes of the region
+ */
+
+#if defined(FP_CSIM_PROFILE) && !defined(FP_CSIM_THREADS)
+#define FP_CSIM_THREADS
+#endif
+
+#if defined(FP_CSIM_THREADS) && !defined(__SYNTHESIS__)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+#ifdef FP_CSIM_PROFILE
+#include "lib_accel/fp_fifo_profile.h"
+#endif
+
+#ifndef FP_CSIM_DEADLOCK_MS
+#define FP_CSIM_DEADLOCK_MS 2000
+#endif
+
+namespace fp{
+namespace csim{
+
+/* Processes running and blocked on a FIFO, for the deadlock detection */
+class Runtime {
+public:
+	struct Wait {
+		const char *process;
+		const char *op;
+		const char *fifo;
+		const void *address;
+		int depth;
+	};
+
+	static Runtime &get() {
+		static Runtime runtime;
+		return runtime;
+	}
+
+	/* Name of the process running on this thread, 0 outside the processes */
+	static const char *&current() {
+		static thread_local const char *process = 0;
+		return process;
+	}
+
+	void enter() {
+		std::lock_guard<std::mutex> lock(mutex);
+		live++;
+		all_blocked = false;
+	}
+
+	void leave() {
+		std::lock_guard<std::mutex> lock(mutex);
+		live--;
+		check();
+	}
+
+	void block(Wait *wait) {
+		std::lock_guard<std::mutex> lock(mutex);
+		waits.push_back(wait);
+		check();
+	}
+
+	void unblock(Wait *wait) {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t k=0; k<waits.size(); k++) {
+			if (waits[k] == wait) {
+				waits.erase(waits.begin()+k);
+				break;
+			}
+		}
+		all_blocked = false;
+	}
+
+	/* Called by the blocked processes while they poll: reports and aborts once nothing has moved for too long */
+	void poll() {
+		std::lock_guard<std::mutex> lock(mutex);
+		check();
+		if (!all_blocked)
+			return;
+		double ms = std::chrono::duration<double, std::milli>(Clock::now()-since).count();
+		if (ms < FP_CSIM_DEADLOCK_MS)
+			return;
+		fprintf(stderr, "C-simulation deadlock: all %d dataflow processes blocked for %.0f ms\n", live, ms);
+		for (size_t k=0; k<waits.size(); k++) {
+			fprintf(stderr, "  %s waits to %s FIFO %s (%p, depth %d)\n", waits[k]->process, waits[k]->op,
+					waits[k]->fifo, waits[k]->address, waits[k]->depth);
+		}
+		fflush(stderr);
+		abort();
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	Runtime() : live(0), all_blocked(false) {}
+
+	void check() {
+		bool blocked = (live > 0) && ((int)waits.size() >= live);
+		if (blocked && !all_blocked)
+			since = Clock::now();
+		all_blocked = blocked;
+	}
+
+	std::mutex mutex;
+	int live;
+	std::vector<Wait*> waits;
+	bool all_blocked;
+	Clock::time_point since;
+};
+
+/* Yields a few times, then sleeps, until ready() holds */
+template<typename Ready>
+void wait_until(const Ready &ready, const char *op, const char *fifo, const void *address, int depth) {
+	for (int spin=0; spin<256; spin++) {
+		if (ready())
+			return;
+		std::this_thread::yield();
+	}
+	const char *process = Runtime::current();
+	Runtime::Wait wait = {process ? process : "main", op, fifo, address, depth};
+	Runtime &runtime = Runtime::get();
+	runtime.block(&wait);
+	while (!ready()) {
+		std::this_thread::sleep_for(std::chrono::microseconds(20));
+		runtime.poll();
+	}
+	runtime.unblock(&wait);
+}
+
+/*
+ * Bounded FIFO between one producer and one consumer thread, with the read()/write() of hls::stream. head and
+ * tail count the values read and written; each is only stored by its own side.
+ */
+template<typename T>
+class stream {
+public:
+	stream() : name("unnamed"), depth(2), buffer(2), head(0), tail(0) {
+		attach();
+	}
+
+	explicit stream(const char *name) : name(name), depth(2), buffer(2), head(0), tail(0) {
+		attach();
+	}
+
+	~stream() {
+		size_t left = tail.load()-head.load();
+		if (left)
+			fprintf(stderr, "WARNING: FIFO %s still holds %lu values at the end of the simulation\n", name.c_str(), (unsigned long)left);
+#ifdef FP_CSIM_PROFILE
+		FifoProfile::get().detach(&stats);
+#endif
+	}
+
+	/* Only while the FIFO is empty and no process uses it */
+	void set_depth(int fifo_depth, const char *fifo_name) {
+		if (tail.load() != head.load()) {
+			fprintf(stderr, "FIFO %s resized to %d while holding values\n", fifo_name, fifo_depth);
+			abort();
+		}
+#ifdef FP_CSIM_PROFILE
+		fifo_depth = FifoProfile::get().depth(fifo_name, fifo_depth);
+		stats.name = fifo_name;
+#endif
+		depth = (fifo_depth > 0) ? fifo_depth : 1;
+		buffer.assign(depth, T());
+		name = fifo_name;
+#ifdef FP_CSIM_PROFILE
+		stats.depth = depth;
+#endif
+		head.store(0);
+		tail.store(0);
+	}
+
+	void write(const T &value) {
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t-head.load(std::memory_order_acquire) >= (size_t)depth) {
+#ifdef FP_CSIM_PROFILE
+			double start = FifoProfile::get().now_us();
+#endif
+			wait_until([&]() { return t-head.load(std::memory_order_acquire) < (size_t)depth; }, "write into full", name.c_str(), this, depth);
+#ifdef FP_CSIM_PROFILE
+			stats.stall(FIFO_FULL, start, FifoProfile::get().now_us());
+#endif
+		}
+		buffer[t%depth] = value;
+		tail.store(t+1, std::memory_order_release);
+#ifdef FP_CSIM_PROFILE
+		if (stats.writes++ == 0)
+			stats.producer = process();
+		size_t occupancy = t+1-head.load(std::memory_order_acquire);
+		if (occupancy > stats.max_occupancy)
+			stats.max_occupancy = occupancy;
+#endif
+	}
+
+	T read() {
+		size_t h = head.load(std::memory_order_relaxed);
+		if (tail.load(std::memory_order_acquire) == h) {
+#ifdef FP_CSIM_PROFILE
+			double start = FifoProfile::get().now_us();
+#endif
+			wait_until([&]() { return tail.load(std::memory_order_acquire) != h; }, "read from empty", name.c_str(), this, depth);
+#ifdef FP_CSIM_PROFILE
+			stats.stall(FIFO_EMPTY, start, FifoProfile::get().now_us());
+#endif
+		}
+		T value = buffer[h%depth];
+		head.store(h+1, std::memory_order_release);
+#ifdef FP_CSIM_PROFILE
+		if (stats.reads++ == 0)
+			stats.consumer = process();
+#endif
+		return value;
+	}
+
+	void read(T &value) {
+		value = read();
+	}
+
+	void operator>>(T &value) {
+		value = read();
+	}
+
+	void operator<<(const T &value) {
+		write(value);
+	}
+
+private:
+	stream(const stream &);
+	stream &operator=(const stream &);
+
+	void attach() {
+#ifdef FP_CSIM_PROFILE
+		stats.bits = fifo_bits<T>::value;
+		stats.depth = depth;
+		FifoProfile::get().attach(&stats);
+#endif
+	}
+
+#ifdef FP_CSIM_PROFILE
+	static const char *process() {
+		const char *current = Runtime::current();
+		return current ? current : "main";
+	}
+#endif
+
+	std::string name;
+	int depth;
+	std::vector<T> buffer;
+	std::atomic<size_t> head;
+	std::atomic<size_t> tail;
+#ifdef FP_CSIM_PROFILE
+	FifoStats stats;
+#endif
+};
+
+template<typename T>
+void set_depth(stream<T> &fifo, int depth, const char *name) {
+	fifo.set_depth(depth, name);
+}
+
+template<typename T, int N>
+void set_depth(stream<T> (&fifos)[N], int depth, const char *name) {
+	for (int k=0; k<N; k++) {
+		fifos[k].set_depth(depth, name);
+	}
+}
+
+/* The processes of one DATAFLOW region, each on its own thread */
+class Dataflow {
+public:
+	Dataflow() {}
+
+	~Dataflow() {
+		join();
+	}
+
+	/* name is the call or the label of the process, reported up to its template arguments */
+	void spawn(const char *name, const std::function<void()> &process) {
+		std::string label(name, strcspn(name, "<("));
+		Runtime::get().enter();
+		threads.push_back(std::thread(&Dataflow::run, label, process));
+	}
+
+	/* A process waiting for the region it runs does not count as live */
+	void join() {
+		if (threads.empty())
+			return;
+		bool nested = (Runtime::current() != 0);
+		if (nested)
+			Runtime::get().leave();
+		for (size_t k=0; k<threads.size(); k++) {
+			threads[k].join();
+		}
+		threads.clear();
+		if (nested)
+			Runtime::get().enter();
+	}
+
+private:
+	Dataflow(const Dataflow &);
+	Dataflow &operator=(const Dataflow &);
+
+	static void run(std::string label, std::function<void()> process) {
+		Runtime::current() = label.c_str();
+		process();
+		Runtime::current() = 0;
+		Runtime::get().leave();
+	}
+
+	std::vector<std::thread> threads;
+};
+
+}
+}
+
+#define FP_STREAM fp::csim::stream
+#define FP_STREAM_DEPTH(variable, depth) fp::csim::set_depth(variable, depth, #variable)
+#define FP_DATAFLOW_BEGIN fp::csim::Dataflow fp_dataflow_region;
+#define FP_DATAFLOW_PROCESS(...) fp_dataflow_region.spawn(#__VA_ARGS__, [&]() { __VA_ARGS__; })
+#define FP_PROCESS_BEGIN(name) fp_dataflow_region.spawn(name, [&]() {
+#define FP_PROCESS_END });
+#define FP_DATAFLOW_END fp_dataflow_region.join();
+
+#else
+
+#include "hls_stream.h"
+
+#define FP_STREAM hls::stream
+#define FP_STREAM_DEPTH(variable, depth)
+#define FP_DATAFLOW_BEGIN
+#define FP_DATAFLOW_PROCESS(...) __VA_ARGS__
+#define FP_PROCESS_BEGIN(name) {
+#define FP_PROCESS_END }
+#define FP_DATAFLOW_END
+
+#endif
+
+#endif//_FP_DATAFLOW_H_
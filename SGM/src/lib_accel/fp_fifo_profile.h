@@ -0,0 +1,273 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+#ifndef _FP_FIFO_PROFILE_H_
+#define _FP_FIFO_PROFILE_H_
+
+#ifndef __cplusplus
+#error C++ is needed to use this file!
+#endif
+
+/*
+ * FIFO profile of the threaded C-simulation, enabled with -DFP_CSIM_PROFILE (which implies FP_CSIM_THREADS).
+ *
+ * Every FP_STREAM records its writes and reads, the largest number of values it held, and how long its producer
+ * waited on it full and its consumer waited on it empty. Waits longer than FP_CSIM_STALL_US also go to a stall
+ * timeline. FIFOs are reported by their name in FP_STREAM_DEPTH ("-" without one) and by their producer and
+ * consumer processes; the FIFOs of an array and of successive calls add up in one line.
+ *
+ * The occupancy depends on the thread schedule, not on the clock cycles of the hardware, so it is a hint for a
+ * smaller depth. The environment variable FP_CSIM_DEPTH="cost_tmp_0=64,l_dst_fifo=16" overrides the depths of
+ * named FIFOs without recompiling: a depth that is too small deadlocks in any schedule, which the deadlock
+ * detection reports.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <set>
+#include <mutex>
+#include <chrono>
+#include "ap_int.h"
+
+#ifndef FP_CSIM_STALL_US
+#define FP_CSIM_STALL_US 50
+#endif
+
+#ifndef FP_CSIM_TIMELINE_MAX
+#define FP_CSIM_TIMELINE_MAX 10000
+#endif
+
+namespace fp{
+namespace csim{
+
+/* Bits of a FIFO word, as stored by the hardware */
+template<typename T>
+struct fifo_bits {
+	static const int value = sizeof(T)*8;
+};
+
+template<int W>
+struct fifo_bits< ap_uint<W> > {
+	static const int value = W;
+};
+
+template<int W>
+struct fifo_bits< ap_int<W> > {
+	static const int value = W;
+};
+
+struct FifoStall {
+	double start_us;
+	double end_us;
+};
+
+/* Side of a stall: the producer on a full FIFO or the consumer on an empty one */
+enum FifoSide {
+	FIFO_FULL = 0,
+	FIFO_EMPTY = 1
+};
+
+/* The producer only updates the writes and the full side, the consumer the reads and the empty side */
+struct FifoStats {
+	std::string name;
+	std::string producer;
+	std::string consumer;
+	int bits;
+	int depth;
+	int instances;
+	uint64_t writes;
+	uint64_t reads;
+	uint64_t max_occupancy;
+	uint64_t stalls[2];
+	double stall_ms[2];
+	uint64_t dropped[2];    // stalls left out of the timeline
+	std::vector<FifoStall> timeline[2];
+
+	FifoStats() : name("-"), producer("?"), consumer("?"), bits(0), depth(0), instances(1), writes(0), reads(0),
+			max_occupancy(0) {
+		for (int side=0; side<2; side++) {
+			stalls[side] = 0;
+			stall_ms[side] = 0;
+			dropped[side] = 0;
+		}
+	}
+
+	void stall(int side, double start_us, double end_us) {
+		stalls[side]++;
+		stall_ms[side] += (end_us-start_us)/1000;
+		if (end_us-start_us < FP_CSIM_STALL_US)
+			return;
+		if (timeline[side].size() < FP_CSIM_TIMELINE_MAX) {
+			FifoStall s = {start_us, end_us};
+			timeline[side].push_back(s);
+		}
+		else {
+			dropped[side]++;
+		}
+	}
+
+	void add(const FifoStats &other) {
+		instances += other.instances;
+		depth = std::max(depth, other.depth);
+		writes += other.writes;
+		reads += other.reads;
+		max_occupancy = std::max(max_occupancy, other.max_occupancy);
+		for (int side=0; side<2; side++) {
+			stalls[side] += other.stalls[side];
+			stall_ms[side] += other.stall_ms[side];
+			dropped[side] += other.dropped[side];
+			for (size_t k=0; k<other.timeline[side].size(); k++) {
+				if (timeline[side].size() < FP_CSIM_TIMELINE_MAX)
+					timeline[side].push_back(other.timeline[side][k]);
+				else
+					dropped[side]++;
+			}
+		}
+	}
+};
+
+/* Statistics of the FIFOs alive and of the FIFOs already destroyed */
+class FifoProfile {
+public:
+	static FifoProfile &get() {
+		static FifoProfile profile;
+		return profile;
+	}
+
+	/* Microseconds since the start of the simulation */
+	double now_us() const {
+		return std::chrono::duration<double, std::micro>(Clock::now()-start).count();
+	}
+
+	/* Depth from FP_CSIM_DEPTH for the FIFO name, or depth */
+	int depth(const char *name, int depth) {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::map<std::string, int>::const_iterator it = overrides.find(name);
+		return (it == overrides.end()) ? depth : it->second;
+	}
+
+	void attach(const FifoStats *stats) {
+		std::lock_guard<std::mutex> lock(mutex);
+		live.insert(stats);
+	}
+
+	void detach(const FifoStats *stats) {
+		std::lock_guard<std::mutex> lock(mutex);
+		live.erase(stats);
+		merge(*stats);
+	}
+
+	/* Writes <prefix>.txt with a line per FIFO and <prefix>_timeline.csv with the stalls; -1 on failure */
+	int write(const char *prefix, const char *title) {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::map<std::string, FifoStats> all = merged;
+		for (std::set<const FifoStats*>::const_iterator it = live.begin(); it != live.end(); ++it) {
+			add(all, **it);
+		}
+
+		std::string path = std::string(prefix) + ".txt";
+		FILE *fp = fopen(path.c_str(), "w");
+		if (!fp) {
+			printf("Failed to open %s..! \n", path.c_str());
+			return -1;
+		}
+		fprintf(fp, "FIFO profile: %s\n", title);
+		fprintf(fp, "occupancy follows the thread schedule of the C-simulation, not the clock cycles of the hardware\n\n");
+		fprintf(fp, "%-22s %-44s %4s %5s %6s %7s %12s %12s %10s %9s %10s %9s %10s %10s\n", "fifo", "producer -> consumer",
+				"inst", "width", "depth", "max_occ", "writes", "reads", "full", "full_ms", "empty", "empty_ms",
+				"bits_decl", "bits_used");
+		for (std::map<std::string, FifoStats>::const_iterator it = all.begin(); it != all.end(); ++it) {
+			const FifoStats &s = it->second;
+			std::string route = s.producer + " -> " + s.consumer;
+			long bits_decl = (long)s.bits*s.depth*s.instances;
+			long bits_used = (long)s.bits*std::max<uint64_t>(s.max_occupancy, 1)*s.instances;
+			fprintf(fp, "%-22s %-44s %4d %5d %6d %7lu %12lu %12lu %10lu %9.1f %10lu %9.1f %10ld %10ld\n", s.name.c_str(),
+					route.c_str(), s.instances, s.bits, s.depth, (unsigned long)s.max_occupancy, (unsigned long)s.writes,
+					(unsigned long)s.reads, (unsigned long)s.stalls[FIFO_FULL], s.stall_ms[FIFO_FULL],
+					(unsigned long)s.stalls[FIFO_EMPTY], s.stall_ms[FIFO_EMPTY], bits_decl, bits_used);
+		}
+		fclose(fp);
+
+		path = std::string(prefix) + "_timeline.csv";
+		fp = fopen(path.c_str(), "w");
+		if (!fp) {
+			printf("Failed to open %s..! \n", path.c_str());
+			return -1;
+		}
+		fprintf(fp, "fifo,producer,consumer,side,start_us,end_us\n");
+		for (std::map<std::string, FifoStats>::const_iterator it = all.begin(); it != all.end(); ++it) {
+			const FifoStats &s = it->second;
+			for (int side=0; side<2; side++) {
+				for (size_t k=0; k<s.timeline[side].size(); k++) {
+					fprintf(fp, "%s,%s,%s,%s,%.1f,%.1f\n", s.name.c_str(), s.producer.c_str(), s.consumer.c_str(),
+							(side == FIFO_FULL) ? "full" : "empty", s.timeline[side][k].start_us, s.timeline[side][k].end_us);
+				}
+			}
+			if (s.dropped[FIFO_FULL] || s.dropped[FIFO_EMPTY])
+				fprintf(stderr, "WARNING: %lu stalls of FIFO %s left out of %s\n", (unsigned long)(s.dropped[FIFO_FULL]+s.dropped[FIFO_EMPTY]),
+						s.name.c_str(), path.c_str());
+		}
+		fclose(fp);
+		return 0;
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	FifoProfile() : start(Clock::now()) {
+		const char *spec = getenv("FP_CSIM_DEPTH");
+		while (spec && *spec) {
+			char name[128];
+			int depth, used;
+			if (sscanf(spec, " %127[^=,] = %d%n", name, &depth, &used) != 2 || depth <= 0) {
+				fprintf(stderr, "Invalid FP_CSIM_DEPTH at %s, expected <fifo>=<depth>[,...]\n", spec);
+				break;
+			}
+			overrides[name] = depth;
+			spec += used;
+			while (*spec == ',' || *spec == ' ')
+				spec++;
+		}
+	}
+
+	static void add(std::map<std::string, FifoStats> &all, const FifoStats &stats) {
+		if (stats.writes == 0 && stats.reads == 0)
+			return;
+		std::string key = stats.name + "|" + stats.producer + "|" + stats.consumer;
+		std::map<std::string, FifoStats>::iterator it = all.find(key);
+		if (it == all.end())
+			all[key] = stats;
+		else
+			it->second.add(stats);
+	}
+
+	void merge(const FifoStats &stats) {
+		add(merged, stats);
+	}
+
+	std::mutex mutex;
+	Clock::time_point start;
+	std::map<std::string, int> overrides;
+	std::set<const FifoStats*> live;
+	std::map<std::string, FifoStats> merged;
+};
+
+/* Report of the FIFOs of the simulation so far, named after the configuration */
+inline int write_fifo_report(const char *prefix, const char *title) {
+	return FifoProfile::get().write(prefix, title);
+}
+
+}
+}
+
+#endif//_FP_FIFO_PROFILE_H_
@@ -26,105 +26,132 @@
 namespace fp{
 
 template<int COST_VALUE, int BW_INPUT, int ROWS, int COLS, int WINDOW_SIZE, int SHD_WINDOW, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpComputeCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap_uint<BW_INPUT> > &src_r, 
-		hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DISPARITIES], ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpComputeCost(FP_STREAM< ap_uint<BW_INPUT> > &src_l, FP_STREAM< ap_uint<BW_INPUT> > &src_r, 
+		FP_STREAM< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DISPARITIES], ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width,
+		ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 #pragma HLS INLINE
 #if COST_FUNCTION==0
-	fpComputeCensusCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, cost, img_height, img_width);
+	fpComputeCensusCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, cost, img_height, img_width, num_disparity);
 #elif COST_FUNCTION==1
-	fpComputeRankCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, cost, img_height, img_width);
+	fpComputeRankCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, cost, img_height, img_width, num_disparity);
 #elif COST_FUNCTION==2
-	fpComputeSADCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, cost, img_height, img_width);
+	fpComputeSADCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, cost, img_height, img_width, num_disparity);
 #elif COST_FUNCTION==3
-	fpComputeZSADCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, cost, img_height, img_width);
+	fpComputeZSADCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, cost, img_height, img_width, num_disparity);
 #elif COST_FUNCTION==4
-	fpComputeSHDCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, cost, img_height, img_width);
+	fpComputeSHDCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, cost, img_height, img_width, num_disparity);
 #endif
 }
 
 template<int COST_VALUE, int BW_INPUT, int ROWS, int COLS, int WINDOW_SIZE, int SHD_WINDOW, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpLRComputeCost(hls::stream< ap_uint<BW_INPUT> > &src_l, hls::stream< ap_uint<BW_INPUT> > &src_r, 
-		hls::stream< DATA_TYPE(COST_VALUE) > left_cost[PARALLEL_DISPARITIES], hls::stream< DATA_TYPE(COST_VALUE) > right_cost[PARALLEL_DISPARITIES],
-        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpLRComputeCost(FP_STREAM< ap_uint<BW_INPUT> > &src_l, FP_STREAM< ap_uint<BW_INPUT> > &src_r, 
+		FP_STREAM< DATA_TYPE(COST_VALUE) > left_cost[PARALLEL_DISPARITIES], FP_STREAM< DATA_TYPE(COST_VALUE) > right_cost[PARALLEL_DISPARITIES],
+        ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
 {
 #pragma HLS INLINE
 #if COST_FUNCTION==0
-	fpLRComputeCensusCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, left_cost, right_cost, img_height, img_width);
+	fpLRComputeCensusCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, left_cost, right_cost, img_height, img_width, num_disparity);
 #elif COST_FUNCTION==1
-	fpLRComputeRankCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, left_cost, right_cost, img_height, img_width);
+	fpLRComputeRankCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, left_cost, right_cost, img_height, img_width, num_disparity);
 #elif COST_FUNCTION==2
-	fpLRComputeSADCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, left_cost, right_cost, img_height, img_width);
+	fpLRComputeSADCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, left_cost, right_cost, img_height, img_width, num_disparity);
 #elif COST_FUNCTION==3
-	fpLRComputeZSADCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, left_cost, right_cost, img_height, img_width);
+	fpLRComputeZSADCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, left_cost, right_cost, img_height, img_width, num_disparity);
 #elif COST_FUNCTION==4
-	fpLRComputeSHDCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, left_cost, right_cost, img_height, img_width);
+	fpLRComputeSHDCost<BW_INPUT,ROWS,COLS,WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l, src_r, left_cost, right_cost, img_height, img_width, num_disparity);
 #endif	
 }
 
 template<typename T, int ROWS, int COLS, int COST_VALUE, int NUM_DISPARITY, int PARALLEL_DISPARITIES, int P1, int P2>
-void fpAggregateCostRasterPath(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DISPARITIES], hls::stream< T > aggregated_cost[PARALLEL_DISPARITIES], 
-		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpAggregateCostRasterPath(FP_STREAM< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DISPARITIES], FP_STREAM< T > aggregated_cost[PARALLEL_DISPARITIES], 
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity, ap_uint<BIT_WIDTH(P1)> p1, ap_uint<BIT_WIDTH(P2)> p2)
 {
 #pragma HLS INLINE
-	fpAggregateCost4Path<ROWS,COLS,COST_VALUE,NUM_DISPARITY,PARALLEL_DISPARITIES,P1,P2>(cost, aggregated_cost, img_height, img_width);
+	fpAggregateCost4Path<ROWS,COLS,COST_VALUE,NUM_DISPARITY,PARALLEL_DISPARITIES,P1,P2>(cost, aggregated_cost, img_height, img_width, num_disparity, p1, p2);
 }
 
 template<typename T, int ROWS, int COLS, int COST_VALUE, int NUM_DISPARITY, int PARALLEL_DISPARITIES, int P1, int P2>
-void fpAggregateCostRasterPath_copy(hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DISPARITIES], hls::stream< T > aggregated_cost[PARALLEL_DISPARITIES], 
-		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpAggregateCostRasterPath_copy(FP_STREAM< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DISPARITIES], FP_STREAM< T > aggregated_cost[PARALLEL_DISPARITIES], 
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity, ap_uint<BIT_WIDTH(P1)> p1, ap_uint<BIT_WIDTH(P2)> p2)
 {
 #pragma HLS INLINE
-	fpAggregateCost4Path_copy<ROWS,COLS,COST_VALUE,NUM_DISPARITY,PARALLEL_DISPARITIES,P1,P2>(cost, aggregated_cost, img_height, img_width);
+	fpAggregateCost4Path_copy<ROWS,COLS,COST_VALUE,NUM_DISPARITY,PARALLEL_DISPARITIES,P1,P2>(cost, aggregated_cost, img_height, img_width, num_disparity, p1, p2);
 }
 
 template<typename T, int ROWS, int COLS, int DST_TYPE, int NPC, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpComputeDisparityMap(hls::stream< T > aggregated_cost[PARALLEL_DISPARITIES], hls::stream< XF_TNAME(DST_TYPE,NPC) > &dst_fifo, 
-		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpComputeDisparityMap(FP_STREAM< T > aggregated_cost[PARALLEL_DISPARITIES], FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &dst_fifo, 
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity, ap_uint<7> uniq_ratio)
 {
 #pragma HLS INLINE	
 #if UNIQ==0
-	fpComputeDisparity<T,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY,PARALLEL_DISPARITIES>(aggregated_cost, dst_fifo, img_height, img_width);
+	fpComputeDisparity<T,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY,PARALLEL_DISPARITIES>(aggregated_cost, dst_fifo, img_height, img_width, num_disparity);
 #elif UNIQ==1
-	fpComputeDisparityUniqueness<T,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY,PARALLEL_DISPARITIES>(aggregated_cost, dst_fifo, img_height, img_width);
+	fpComputeDisparityUniqueness<T,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY,PARALLEL_DISPARITIES>(aggregated_cost, dst_fifo, img_height, img_width, num_disparity, uniq_ratio);
 #endif
 }
 
 template<typename T, int ROWS, int COLS, int DST_TYPE, int NPC, int NUM_DISPARITY, int PARALLEL_DISPARITIES>
-void fpLRComputeDisparityMap(hls::stream< T > aggregated_cost[PARALLEL_DISPARITIES], hls::stream< XF_TNAME(DST_TYPE,NPC) > &left_dst_fifo, 
-		hls::stream< XF_TNAME(DST_TYPE,NPC) > &right_dst_fifo, ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+void fpLRComputeDisparityMap(FP_STREAM< T > aggregated_cost[PARALLEL_DISPARITIES], FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &left_dst_fifo, 
+		FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &right_dst_fifo, ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width,
+		ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity, ap_uint<7> uniq_ratio)
 {
 #pragma HLS INLINE	
 #if UNIQ==0
-	fpLRComputeDisparity<T,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY,PARALLEL_DISPARITIES>(aggregated_cost, left_dst_fifo, right_dst_fifo, img_height, img_width);
+	fpLRComputeDisparity<T,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY,PARALLEL_DISPARITIES>(aggregated_cost, left_dst_fifo, right_dst_fifo, img_height, img_width, num_disparity);
 #elif UNIQ==1
-	fpLRComputeDisparityUniqueness<T,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY,PARALLEL_DISPARITIES>(aggregated_cost, left_dst_fifo, right_dst_fifo, img_height, img_width);
+	fpLRComputeDisparityUniqueness<T,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY,PARALLEL_DISPARITIES>(aggregated_cost, left_dst_fifo, right_dst_fifo, img_height, img_width, num_disparity, uniq_ratio);
+#endif
+}
+
+template<int COST_VALUE, int BW_INPUT, int ROWS, int COLS, int NPC, int WINDOW_SIZE, int NUM_DISPARITY>
+void fpComputeCostNPC(FP_STREAM< ap_uint<BW_INPUT*XF_NPIXPERCYCLE(NPC)> > &src_l, FP_STREAM< ap_uint<BW_INPUT*XF_NPIXPERCYCLE(NPC)> > &src_r, 
+		FP_STREAM< ap_uint<BIT_WIDTH(COST_VALUE)*XF_NPIXPERCYCLE(NPC)> > cost[NUM_DISPARITY], ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width)
+{
+#pragma HLS INLINE
+#if COST_FUNCTION==0
+	fpComputeCensusCostNPC<BW_INPUT,ROWS,COLS,NPC,WINDOW_SIZE,NUM_DISPARITY>(src_l, src_r, cost, img_height, img_width);
+#endif
+}
+
+template<int AGGR_WIDTH, int ROWS, int COLS, int DST_TYPE, int NPC, int NUM_DISPARITY>
+void fpComputeDisparityMapNPC(FP_STREAM< ap_uint<AGGR_WIDTH*XF_NPIXPERCYCLE(NPC)> > aggregated_cost[NUM_DISPARITY], FP_STREAM< XF_TNAME(DST_TYPE,NPC) > &dst_fifo, 
+		ap_uint<BIT_WIDTH(ROWS)> img_height, ap_uint<BIT_WIDTH(COLS)> img_width, ap_uint<7> uniq_ratio)
+{
+#pragma HLS INLINE	
+#if UNIQ==0
+	fpComputeDisparityNPC<AGGR_WIDTH,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY>(aggregated_cost, dst_fifo, img_height, img_width);
+#elif UNIQ==1
+	fpComputeDisparityUniquenessNPC<AGGR_WIDTH,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY>(aggregated_cost, dst_fifo, img_height, img_width, uniq_ratio);
 #endif
 }
 
 // SGM without L-R check
 template<int WINDOW_SIZE, int SHD_WINDOW, int NUM_DISPARITY, int PARALLEL_DISPARITIES, int FilterWin, int SRC_TYPE, int DST_TYPE, int ROWS, int COLS, int NPC, int P1, int P2>
-void SemiGlobalBMNLR(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_r, xf::Mat<DST_TYPE, ROWS, COLS, NPC> &dst_mat)
+void SemiGlobalBMNLR(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_r, xf::Mat<DST_TYPE, ROWS, COLS, NPC> &dst_mat,
+		ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity, ap_uint<BIT_WIDTH(P1)> p1, ap_uint<BIT_WIDTH(P2)> p2, ap_uint<7> uniq_ratio)
 {
 	#pragma HLS INLINE
 
-	hls::stream< XF_TNAME(SRC_TYPE,NPC) > src_l_fifo;
-	hls::stream< XF_TNAME(SRC_TYPE,NPC) > src_r_fifo;
-	hls::stream< XF_TNAME(DST_TYPE,NPC) > out_dst_fifo;
-	hls::stream< XF_TNAME(DST_TYPE,NPC) > dst_fifo;
+	FP_STREAM< XF_TNAME(SRC_TYPE,NPC) > src_l_fifo;
+	FP_STREAM< XF_TNAME(SRC_TYPE,NPC) > src_r_fifo;
+	FP_STREAM< XF_TNAME(DST_TYPE,NPC) > out_dst_fifo;
+	FP_STREAM< XF_TNAME(DST_TYPE,NPC) > dst_fifo;
 
 	const int COST_VALUE = COST_MAP(COST_FUNCTION,XF_DTPIXELDEPTH(SRC_TYPE,NPC),WINDOW_SIZE,SHD_WINDOW);
 	const int AGGR_WIDTH = AGGR_MAP(NUM_DIR,COST_VALUE,P2);
 
-	hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DISPARITIES];
+	FP_STREAM< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DISPARITIES];
 	#pragma HLS ARRAY_PARTITION variable=cost complete dim=1
 
-	hls::stream< ap_uint<AGGR_WIDTH> > aggregated_cost[PARALLEL_DISPARITIES];
+	FP_STREAM< ap_uint<AGGR_WIDTH> > aggregated_cost[PARALLEL_DISPARITIES];
 	#pragma HLS ARRAY_PARTITION variable=aggregated_cost complete dim=1	
 
 	ap_uint<BIT_WIDTH(ROWS)> height = src_mat_l.rows;
 	ap_uint<BIT_WIDTH(COLS)> width = src_mat_l.cols;	
 
+	FP_DATAFLOW_BEGIN
+	FP_PROCESS_BEGIN("loop_access_src")
 	loop_access_src:
 	for(ap_uint<BIT_WIDTH(ROWS)> i = 0; i < height; i++)
 	{
@@ -137,16 +164,18 @@ void SemiGlobalBMNLR(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_
 			src_r_fifo.write(*(src_mat_r.data+i*width+j));
 		}
 	}
+	FP_PROCESS_END
 
-	fpComputeCost<COST_VALUE,XF_DTPIXELDEPTH(SRC_TYPE,NPC),ROWS,COLS,WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l_fifo,src_r_fifo,cost,height,width);
+	FP_DATAFLOW_PROCESS(fpComputeCost<COST_VALUE,XF_DTPIXELDEPTH(SRC_TYPE,NPC),ROWS,COLS,WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l_fifo,src_r_fifo,cost,height,width,num_disparity));
 
-	fpAggregateCostRasterPath<ap_uint<AGGR_WIDTH>,ROWS,COLS,COST_VALUE,NUM_DISPARITY,PARALLEL_DISPARITIES,P1,P2>(cost, aggregated_cost, height, width);
+	FP_DATAFLOW_PROCESS(fpAggregateCostRasterPath<ap_uint<AGGR_WIDTH>,ROWS,COLS,COST_VALUE,NUM_DISPARITY,PARALLEL_DISPARITIES,P1,P2>(cost, aggregated_cost, height, width, num_disparity, p1, p2));
 
-	fpComputeDisparityMap<ap_uint<AGGR_WIDTH>,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY,PARALLEL_DISPARITIES>(aggregated_cost,out_dst_fifo,height,width);
+	FP_DATAFLOW_PROCESS(fpComputeDisparityMap<ap_uint<AGGR_WIDTH>,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY,PARALLEL_DISPARITIES>(aggregated_cost,out_dst_fifo,height,width,num_disparity,uniq_ratio));
 
-	fpMedianFilter<ROWS,COLS,DST_TYPE,NPC,FilterWin>(out_dst_fifo, dst_fifo, height, width);
+	FP_DATAFLOW_PROCESS(fpMedianFilter<ROWS,COLS,DST_TYPE,NPC,FilterWin>(out_dst_fifo, dst_fifo, height, width));
 
 	// write back from stream to Mat
+	FP_PROCESS_BEGIN("write_back")
 	for(int i=0; i<dst_mat.rows;i++)
 	{
 		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS
@@ -157,35 +186,134 @@ void SemiGlobalBMNLR(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_
 			*(dst_mat.data + i*dst_mat.cols +j) = (dst_fifo.read());
 		}
 	}
+	FP_PROCESS_END
+	FP_DATAFLOW_END
+}
+
+// SGM without L-R check, NPC pixels per clock with all the disparities at once. num_disparity is always
+// NUM_DISPARITY here (see fpLegalDisparity), the pipeline has no disparity iterations to skip.
+template<int WINDOW_SIZE, int SHD_WINDOW, int NUM_DISPARITY, int PARALLEL_DISPARITIES, int FilterWin, int SRC_TYPE, int DST_TYPE, int ROWS, int COLS, int NPC, int P1, int P2>
+void SemiGlobalBMNLRNPC(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_r, xf::Mat<DST_TYPE, ROWS, COLS, NPC> &dst_mat,
+		ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity, ap_uint<BIT_WIDTH(P1)> p1, ap_uint<BIT_WIDTH(P2)> p2, ap_uint<7> uniq_ratio)
+{
+	#pragma HLS INLINE
+
+	FP_STREAM< XF_TNAME(SRC_TYPE,NPC) > src_l_fifo;
+	FP_STREAM< XF_TNAME(SRC_TYPE,NPC) > src_r_fifo;
+	FP_STREAM< XF_TNAME(DST_TYPE,NPC) > out_dst_fifo;
+	FP_STREAM< XF_TNAME(DST_TYPE,NPC) > dst_fifo;
+
+	const int COST_VALUE = COST_MAP(COST_FUNCTION,XF_DTPIXELDEPTH(SRC_TYPE,NPC),WINDOW_SIZE,SHD_WINDOW);
+	const int AGGR_WIDTH = AGGR_MAP(NUM_DIR,COST_VALUE,P2);
+
+	FP_STREAM< ap_uint<BIT_WIDTH(COST_VALUE)*XF_NPIXPERCYCLE(NPC)> > cost[NUM_DISPARITY];
+	#pragma HLS ARRAY_PARTITION variable=cost complete dim=1
+
+	FP_STREAM< ap_uint<AGGR_WIDTH*XF_NPIXPERCYCLE(NPC)> > aggregated_cost[NUM_DISPARITY];
+	#pragma HLS ARRAY_PARTITION variable=aggregated_cost complete dim=1	
+
+	ap_uint<BIT_WIDTH(ROWS)> height = src_mat_l.rows;
+	ap_uint<BIT_WIDTH(COLS)> width = src_mat_l.cols;	
+	ap_uint<BIT_WIDTH(COLS)> steps = width >> XF_BITSHIFT(NPC);
+
+	FP_DATAFLOW_BEGIN
+	FP_PROCESS_BEGIN("loop_access_src")
+	loop_access_src:
+	for(ap_uint<BIT_WIDTH(ROWS)> i = 0; i < height; i++)
+	{
+		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS //This pragma is to get the HLS estimation.
+		for(ap_uint<BIT_WIDTH(COLS)> j = 0; j < steps; j++)
+		{
+			#pragma HLS LOOP_TRIPCOUNT min=COLS/XF_NPIXPERCYCLE(NPC) max=COLS/XF_NPIXPERCYCLE(NPC)
+			#pragma HLS PIPELINE 
+			src_l_fifo.write(*(src_mat_l.data+i*steps+j));
+			src_r_fifo.write(*(src_mat_r.data+i*steps+j));
+		}
+	}
+	FP_PROCESS_END
+
+	FP_DATAFLOW_PROCESS(fpComputeCostNPC<COST_VALUE,XF_DTPIXELDEPTH(SRC_TYPE,NPC),ROWS,COLS,NPC,WINDOW_SIZE,NUM_DISPARITY>(src_l_fifo,src_r_fifo,cost,height,width));
+
+	FP_DATAFLOW_PROCESS(fpAggregateCost4PathNPC<ROWS,COLS,COST_VALUE,NUM_DISPARITY,NPC,P1,P2>(cost, aggregated_cost, height, width, p1, p2));
+
+	FP_DATAFLOW_PROCESS(fpComputeDisparityMapNPC<AGGR_WIDTH,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY>(aggregated_cost,out_dst_fifo,height,width,uniq_ratio));
+
+	FP_DATAFLOW_PROCESS(fpMedianFilterNPC<ROWS,COLS,DST_TYPE,NPC,FilterWin>(out_dst_fifo, dst_fifo, height, width));
+
+	// write back from stream to Mat
+	FP_PROCESS_BEGIN("write_back")
+	for(int i=0; i<dst_mat.rows;i++)
+	{
+		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS
+		for(int j=0; j<(dst_mat.cols>>XF_BITSHIFT(NPC)); j++)
+		{
+			#pragma HLS LOOP_TRIPCOUNT min=COLS/XF_NPIXPERCYCLE(NPC) max=COLS/XF_NPIXPERCYCLE(NPC)
+			#pragma HLS PIPELINE
+			*(dst_mat.data + i*(dst_mat.cols>>XF_BITSHIFT(NPC)) +j) = (dst_fifo.read());
+		}
+	}
+	FP_PROCESS_END
+	FP_DATAFLOW_END
 }
 
+// Selects the pipeline without L-R check: SemiGlobalBMNLR for one pixel per clock, SemiGlobalBMNLRNPC otherwise
+template<int NPC>
+class fpSemiGlobalBMNLR
+{
+public:
+	template<int WINDOW_SIZE, int SHD_WINDOW, int NUM_DISPARITY, int PARALLEL_DISPARITIES, int FilterWin, int SRC_TYPE, int DST_TYPE, int ROWS, int COLS, int P1, int P2>
+	static void run(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_r, xf::Mat<DST_TYPE, ROWS, COLS, NPC> &dst_mat,
+			ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity, ap_uint<BIT_WIDTH(P1)> p1, ap_uint<BIT_WIDTH(P2)> p2, ap_uint<7> uniq_ratio)
+	{
+		#pragma HLS INLINE
+		SemiGlobalBMNLRNPC<WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES,FilterWin,SRC_TYPE,DST_TYPE,ROWS,COLS,NPC,P1,P2>(src_mat_l,src_mat_r,dst_mat,num_disparity,p1,p2,uniq_ratio);
+	}
+};
+
+template<>
+class fpSemiGlobalBMNLR<XF_NPPC1>
+{
+public:
+	template<int WINDOW_SIZE, int SHD_WINDOW, int NUM_DISPARITY, int PARALLEL_DISPARITIES, int FilterWin, int SRC_TYPE, int DST_TYPE, int ROWS, int COLS, int P1, int P2>
+	static void run(xf::Mat<SRC_TYPE, ROWS, COLS, XF_NPPC1> &src_mat_l, xf::Mat<SRC_TYPE, ROWS, COLS, XF_NPPC1> &src_mat_r, xf::Mat<DST_TYPE, ROWS, COLS, XF_NPPC1> &dst_mat,
+			ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity, ap_uint<BIT_WIDTH(P1)> p1, ap_uint<BIT_WIDTH(P2)> p2, ap_uint<7> uniq_ratio)
+	{
+		#pragma HLS INLINE
+		SemiGlobalBMNLR<WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES,FilterWin,SRC_TYPE,DST_TYPE,ROWS,COLS,XF_NPPC1,P1,P2>(src_mat_l,src_mat_r,dst_mat,num_disparity,p1,p2,uniq_ratio);
+	}
+};
+
 // SGM with L-R consistency check (LR1 method)
 template<int WINDOW_SIZE, int SHD_WINDOW, int NUM_DISPARITY, int PARALLEL_DISPARITIES, int FilterWin, int SRC_TYPE, int DST_TYPE, int ROWS, int COLS, int NPC, int P1, int P2>
-void SemiGlobalBMLR1(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_r, xf::Mat<DST_TYPE, ROWS, COLS, NPC> &dst_mat)
+void SemiGlobalBMLR1(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_r, xf::Mat<DST_TYPE, ROWS, COLS, NPC> &dst_mat,
+		ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity, ap_uint<BIT_WIDTH(P1)> p1, ap_uint<BIT_WIDTH(P2)> p2, ap_uint<7> uniq_ratio)
 {
 	#pragma HLS INLINE 
 
-	hls::stream< XF_TNAME(SRC_TYPE,NPC) > src_l_fifo;
-	hls::stream< XF_TNAME(SRC_TYPE,NPC) > src_r_fifo;
-	hls::stream< XF_TNAME(DST_TYPE,NPC) > left_dst_fifo;
-	hls::stream< XF_TNAME(DST_TYPE,NPC) > right_dst_fifo;
-	static hls::stream< XF_TNAME(DST_TYPE,NPC) > l_dst_fifo;
+	FP_STREAM< XF_TNAME(SRC_TYPE,NPC) > src_l_fifo;
+	FP_STREAM< XF_TNAME(SRC_TYPE,NPC) > src_r_fifo;
+	FP_STREAM< XF_TNAME(DST_TYPE,NPC) > left_dst_fifo;
+	FP_STREAM< XF_TNAME(DST_TYPE,NPC) > right_dst_fifo;
+	static FP_STREAM< XF_TNAME(DST_TYPE,NPC) > l_dst_fifo;
 	#pragma HLS STREAM variable=l_dst_fifo depth=NUM_DISPARITY
-	hls::stream< XF_TNAME(DST_TYPE,NPC) > r_dst_fifo;
-	hls::stream< XF_TNAME(DST_TYPE,NPC) > dst_fifo;
+	FP_STREAM_DEPTH(l_dst_fifo, NUM_DISPARITY);
+	FP_STREAM< XF_TNAME(DST_TYPE,NPC) > r_dst_fifo;
+	FP_STREAM< XF_TNAME(DST_TYPE,NPC) > dst_fifo;
 
 	const int COST_VALUE = COST_MAP(COST_FUNCTION,XF_DTPIXELDEPTH(SRC_TYPE,NPC),WINDOW_SIZE,SHD_WINDOW);
 	const int AGGR_WIDTH = AGGR_MAP(NUM_DIR,COST_VALUE,P2);
 
-	hls::stream< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DISPARITIES];
+	FP_STREAM< DATA_TYPE(COST_VALUE) > cost[PARALLEL_DISPARITIES];
 	#pragma HLS ARRAY_PARTITION variable=cost complete dim=1
 
-	hls::stream< ap_uint<AGGR_WIDTH> > aggregated_cost[PARALLEL_DISPARITIES];
+	FP_STREAM< ap_uint<AGGR_WIDTH> > aggregated_cost[PARALLEL_DISPARITIES];
 	#pragma HLS ARRAY_PARTITION variable=aggregated_cost complete dim=1	
 
 	ap_uint<BIT_WIDTH(ROWS)> height = src_mat_l.rows;
 	ap_uint<BIT_WIDTH(COLS)> width = src_mat_l.cols;	
 
+	FP_DATAFLOW_BEGIN
+	FP_PROCESS_BEGIN("loop_access_src")
 	loop_access_src:
 	for(ap_uint<BIT_WIDTH(ROWS)> i = 0; i < height; i++)
 	{
@@ -198,19 +326,21 @@ void SemiGlobalBMLR1(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_
 			src_r_fifo.write(*(src_mat_r.data+i*width+j));
 		}
 	}
+	FP_PROCESS_END
 
-	fpComputeCost<COST_VALUE,XF_DTPIXELDEPTH(SRC_TYPE,NPC),ROWS,COLS,WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l_fifo,src_r_fifo,cost,height,width);
+	FP_DATAFLOW_PROCESS(fpComputeCost<COST_VALUE,XF_DTPIXELDEPTH(SRC_TYPE,NPC),ROWS,COLS,WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l_fifo,src_r_fifo,cost,height,width,num_disparity));
 
-	fpAggregateCostRasterPath<ap_uint<AGGR_WIDTH>,ROWS,COLS,COST_VALUE,NUM_DISPARITY,PARALLEL_DISPARITIES,P1,P2>(cost, aggregated_cost, height, width);
+	FP_DATAFLOW_PROCESS(fpAggregateCostRasterPath<ap_uint<AGGR_WIDTH>,ROWS,COLS,COST_VALUE,NUM_DISPARITY,PARALLEL_DISPARITIES,P1,P2>(cost, aggregated_cost, height, width, num_disparity, p1, p2));
 
-	fpLRComputeDisparityMap<ap_uint<AGGR_WIDTH>,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY,PARALLEL_DISPARITIES>(aggregated_cost, left_dst_fifo, right_dst_fifo, height, width);
+	FP_DATAFLOW_PROCESS(fpLRComputeDisparityMap<ap_uint<AGGR_WIDTH>,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY,PARALLEL_DISPARITIES>(aggregated_cost, left_dst_fifo, right_dst_fifo, height, width, num_disparity, uniq_ratio));
 
-	fpMedianFilter<ROWS,COLS,DST_TYPE,NPC,FilterWin>(left_dst_fifo, l_dst_fifo, height, width);
-	fpMedianFilter<ROWS,COLS,DST_TYPE,NPC,FilterWin>(right_dst_fifo, r_dst_fifo, height, width);
+	FP_DATAFLOW_PROCESS(fpMedianFilter<ROWS,COLS,DST_TYPE,NPC,FilterWin>(left_dst_fifo, l_dst_fifo, height, width));
+	FP_DATAFLOW_PROCESS(fpMedianFilter<ROWS,COLS,DST_TYPE,NPC,FilterWin>(right_dst_fifo, r_dst_fifo, height, width));
 
-	fpLRCheckConsistency<ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY>(l_dst_fifo, r_dst_fifo, dst_fifo, height, width);
+	FP_DATAFLOW_PROCESS(fpLRCheckConsistency<ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY>(l_dst_fifo, r_dst_fifo, dst_fifo, height, width));
 
 	// write back from stream to Mat
+	FP_PROCESS_BEGIN("write_back")
 	for(int i=0; i<dst_mat.rows;i++)
 	{
 		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS
@@ -221,37 +351,42 @@ void SemiGlobalBMLR1(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_
 			*(dst_mat.data + i*dst_mat.cols +j) = (dst_fifo.read());
 		}
 	}
+	FP_PROCESS_END
+	FP_DATAFLOW_END
 }
 
 // SGM with L-R consistency check (LR2 method)
 template<int WINDOW_SIZE, int SHD_WINDOW, int NUM_DISPARITY, int PARALLEL_DISPARITIES, int FilterWin, int SRC_TYPE, int DST_TYPE, int ROWS, int COLS, int NPC, int P1, int P2>
-void SemiGlobalBMLR2(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_r, xf::Mat<DST_TYPE, ROWS, COLS, NPC> &dst_mat)
+void SemiGlobalBMLR2(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_r, xf::Mat<DST_TYPE, ROWS, COLS, NPC> &dst_mat,
+		ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity, ap_uint<BIT_WIDTH(P1)> p1, ap_uint<BIT_WIDTH(P2)> p2, ap_uint<7> uniq_ratio)
 {
 	#pragma HLS INLINE
 
-	hls::stream< XF_TNAME(SRC_TYPE,NPC) > src_l_fifo;
-	hls::stream< XF_TNAME(SRC_TYPE,NPC) > src_r_fifo;
-	hls::stream< XF_TNAME(DST_TYPE,NPC) > left_dst_fifo;
-	hls::stream< XF_TNAME(DST_TYPE,NPC) > right_dst_fifo;
-	hls::stream< XF_TNAME(DST_TYPE,NPC) > r_dst_fifo;
-	hls::stream< XF_TNAME(DST_TYPE,NPC) > dst_fifo;
+	FP_STREAM< XF_TNAME(SRC_TYPE,NPC) > src_l_fifo;
+	FP_STREAM< XF_TNAME(SRC_TYPE,NPC) > src_r_fifo;
+	FP_STREAM< XF_TNAME(DST_TYPE,NPC) > left_dst_fifo;
+	FP_STREAM< XF_TNAME(DST_TYPE,NPC) > right_dst_fifo;
+	FP_STREAM< XF_TNAME(DST_TYPE,NPC) > r_dst_fifo;
+	FP_STREAM< XF_TNAME(DST_TYPE,NPC) > dst_fifo;
 
 	const int COST_VALUE = COST_MAP(COST_FUNCTION,XF_DTPIXELDEPTH(SRC_TYPE,NPC),WINDOW_SIZE,SHD_WINDOW);
 	const int AGGR_WIDTH = AGGR_MAP(NUM_DIR,COST_VALUE,P2);
 
-	hls::stream< DATA_TYPE(COST_VALUE) > left_cost[PARALLEL_DISPARITIES];
+	FP_STREAM< DATA_TYPE(COST_VALUE) > left_cost[PARALLEL_DISPARITIES];
 	#pragma HLS ARRAY_PARTITION variable=left_cost complete dim=1
-	hls::stream< DATA_TYPE(COST_VALUE) > right_cost[PARALLEL_DISPARITIES];
+	FP_STREAM< DATA_TYPE(COST_VALUE) > right_cost[PARALLEL_DISPARITIES];
 	#pragma HLS ARRAY_PARTITION variable=right_cost complete dim=1
 
-	hls::stream< ap_uint<AGGR_WIDTH> > left_aggregated_cost[PARALLEL_DISPARITIES];
+	FP_STREAM< ap_uint<AGGR_WIDTH> > left_aggregated_cost[PARALLEL_DISPARITIES];
 	#pragma HLS ARRAY_PARTITION variable=left_aggregated_cost complete dim=1	
-	hls::stream< ap_uint<AGGR_WIDTH> > right_aggregated_cost[PARALLEL_DISPARITIES];
+	FP_STREAM< ap_uint<AGGR_WIDTH> > right_aggregated_cost[PARALLEL_DISPARITIES];
 	#pragma HLS ARRAY_PARTITION variable=right_aggregated_cost complete dim=1	
 
 	ap_uint<BIT_WIDTH(ROWS)> height = src_mat_l.rows;
 	ap_uint<BIT_WIDTH(COLS)> width = src_mat_l.cols;	
 
+	FP_DATAFLOW_BEGIN
+	FP_PROCESS_BEGIN("loop_access_src")
 	loop_access_src:
 	for(ap_uint<BIT_WIDTH(ROWS)> i = 0; i < height; i++)
 	{
@@ -264,23 +399,26 @@ void SemiGlobalBMLR2(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_
 			src_r_fifo.write(*(src_mat_r.data+i*width+j));
 		}
 	}
+	FP_PROCESS_END
 
-	fpLRComputeCost<COST_VALUE,XF_DTPIXELDEPTH(SRC_TYPE,NPC),ROWS,COLS,WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l_fifo,src_r_fifo,left_cost,right_cost,height,width);
+	FP_DATAFLOW_PROCESS(fpLRComputeCost<COST_VALUE,XF_DTPIXELDEPTH(SRC_TYPE,NPC),ROWS,COLS,WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES>(src_l_fifo,src_r_fifo,left_cost,right_cost,height,width,num_disparity));
 
-	fpAggregateCostRasterPath<ap_uint<AGGR_WIDTH>,ROWS,COLS,COST_VALUE,NUM_DISPARITY,PARALLEL_DISPARITIES,P1,P2>(left_cost, left_aggregated_cost, height, width);
-	fpAggregateCostRasterPath_copy<ap_uint<AGGR_WIDTH>,ROWS,COLS,COST_VALUE,NUM_DISPARITY,PARALLEL_DISPARITIES,P1,P2>(right_cost, right_aggregated_cost, height, width);
+	FP_DATAFLOW_PROCESS(fpAggregateCostRasterPath<ap_uint<AGGR_WIDTH>,ROWS,COLS,COST_VALUE,NUM_DISPARITY,PARALLEL_DISPARITIES,P1,P2>(left_cost, left_aggregated_cost, height, width, num_disparity, p1, p2));
+	FP_DATAFLOW_PROCESS(fpAggregateCostRasterPath_copy<ap_uint<AGGR_WIDTH>,ROWS,COLS,COST_VALUE,NUM_DISPARITY,PARALLEL_DISPARITIES,P1,P2>(right_cost, right_aggregated_cost, height, width, num_disparity, p1, p2));
 
-	fpComputeDisparityMap<ap_uint<AGGR_WIDTH>,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY,PARALLEL_DISPARITIES>(left_aggregated_cost,left_dst_fifo,height,width);
-	fpComputeDisparityMap<ap_uint<AGGR_WIDTH>,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY,PARALLEL_DISPARITIES>(right_aggregated_cost,right_dst_fifo,height,width);
+	FP_DATAFLOW_PROCESS(fpComputeDisparityMap<ap_uint<AGGR_WIDTH>,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY,PARALLEL_DISPARITIES>(left_aggregated_cost,left_dst_fifo,height,width,num_disparity,uniq_ratio));
+	FP_DATAFLOW_PROCESS(fpComputeDisparityMap<ap_uint<AGGR_WIDTH>,ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY,PARALLEL_DISPARITIES>(right_aggregated_cost,right_dst_fifo,height,width,num_disparity,uniq_ratio));
 
-	fpMedianFilter<ROWS,COLS,DST_TYPE,NPC,FilterWin>(right_dst_fifo, r_dst_fifo, height, width);
+	FP_DATAFLOW_PROCESS(fpMedianFilter<ROWS,COLS,DST_TYPE,NPC,FilterWin>(right_dst_fifo, r_dst_fifo, height, width));
 
-	static hls::stream< XF_TNAME(DST_TYPE,NPC) > l_dst_fifo;
+	static FP_STREAM< XF_TNAME(DST_TYPE,NPC) > l_dst_fifo;
 	#pragma HLS STREAM variable=l_dst_fifo depth=NUM_DISPARITY
-	fpMedianFilter<ROWS,COLS,DST_TYPE,NPC,FilterWin>(left_dst_fifo, l_dst_fifo, height, width);
-	fpLRCheckConsistency<ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY>(l_dst_fifo, r_dst_fifo, dst_fifo, height, width);
+	FP_STREAM_DEPTH(l_dst_fifo, NUM_DISPARITY);
+	FP_DATAFLOW_PROCESS(fpMedianFilter<ROWS,COLS,DST_TYPE,NPC,FilterWin>(left_dst_fifo, l_dst_fifo, height, width));
+	FP_DATAFLOW_PROCESS(fpLRCheckConsistency<ROWS,COLS,DST_TYPE,NPC,NUM_DISPARITY>(l_dst_fifo, r_dst_fifo, dst_fifo, height, width));
 
 	// write back from stream to Mat
+	FP_PROCESS_BEGIN("write_back")
 	for(int i=0; i<dst_mat.rows;i++)
 	{
 		#pragma HLS LOOP_TRIPCOUNT min=ROWS max=ROWS
@@ -291,10 +429,36 @@ void SemiGlobalBMLR2(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_
 			*(dst_mat.data + i*dst_mat.cols +j) = (dst_fifo.read());
 		}
 	}
+	FP_PROCESS_END
+	FP_DATAFLOW_END
 }
 
 
+// Run-time disparity range the pipeline can run for num_disparity. Without disparity iterations
+// (NUM_DISPARITY == PARALLEL_DISPARITIES, which every NPC > 1 build is) that is NUM_DISPARITY; otherwise num_disparity
+// rounded down to a multiple of PARALLEL_DISPARITIES, from 2*PARALLEL_DISPARITIES up to NUM_DISPARITY.
+template<int NUM_DISPARITY, int PARALLEL_DISPARITIES>
+ap_uint<BIT_WIDTH(NUM_DISPARITY)> fpLegalDisparity(ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity)
+{
+	#pragma HLS INLINE
+	if(NUM_DISPARITY == PARALLEL_DISPARITIES){
+		return NUM_DISPARITY;
+	}
+	ap_uint<BIT_WIDTH(NUM_DISPARITY)> legal = (num_disparity/PARALLEL_DISPARITIES)*PARALLEL_DISPARITIES;
+	if(legal > NUM_DISPARITY){
+		legal = NUM_DISPARITY;
+	}
+	if(legal < 2*PARALLEL_DISPARITIES){
+		legal = 2*PARALLEL_DISPARITIES;
+	}
+	return legal;
+}
+
 // Top function for SGM accelerator
+// NUM_DISPARITY, P1 and P2 size the hardware; num_disparity, p1, p2 and uniq_ratio are AXI-Lite arguments bounded by
+// them, so the range, the penalties and the uniqueness ratio (percent, 5 by default) change without resynthesis and a
+// smaller range takes fewer iterations per pixel. The asserts vanish in hardware, so num_disparity is clamped to
+// fpLegalDisparity instead of being trusted.
 
 #pragma SDS data mem_attribute("src_mat_l.data":NON_CACHEABLE|PHYSICAL_CONTIGUOUS)
 #pragma SDS data mem_attribute("src_mat_r.data":NON_CACHEABLE|PHYSICAL_CONTIGUOUS)
@@ -303,26 +467,33 @@ void SemiGlobalBMLR2(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_
 #pragma SDS data copy("src_mat_l.data"[0:"src_mat_l.size"], "src_mat_r.data"[0:"src_mat_r.size"], "dst_mat.data"[0:"dst_mat.size"])
 
 template<int WINDOW_SIZE, int SHD_WINDOW, int NUM_DISPARITY, int PARALLEL_DISPARITIES, int FilterWin, int SRC_TYPE, int DST_TYPE, int ROWS, int COLS, int NPC, int P1, int P2>
-void SemiGlobalBM(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_r, xf::Mat<DST_TYPE, ROWS, COLS, NPC> &dst_mat)
+void SemiGlobalBM(xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_l, xf::Mat<SRC_TYPE, ROWS, COLS, NPC> &src_mat_r, xf::Mat<DST_TYPE, ROWS, COLS, NPC> &dst_mat,
+		ap_uint<BIT_WIDTH(NUM_DISPARITY)> num_disparity, ap_uint<BIT_WIDTH(P1)> p1, ap_uint<BIT_WIDTH(P2)> p2, ap_uint<7> uniq_ratio)
 {
 	assert((SRC_TYPE == XF_8UC1) && " WORDWIDTH_SRC must be XF_8UC1 ");
 	assert((DST_TYPE == XF_8UC1) && " WORDWIDTH_DST must be XF_8UC1 ");
-	assert((NPC == XF_NPPC1) && " NPC must be XF_NPPC1 ");	
+	assert(((NPC == XF_NPPC1) || (NPC == XF_NPPC2) || (NPC == XF_NPPC4)) && " NPC must be XF_NPPC1, XF_NPPC2 or XF_NPPC4 ");
+	assert(((NPC == XF_NPPC1) || (NUM_DISPARITY == PARALLEL_DISPARITIES)) && " XF_NPPC2 and XF_NPPC4 need NUM_DISPARITY == PARALLEL_DISPARITIES ");
+	assert(((NPC == XF_NPPC1) || ((COST_FUNCTION == 0) && (LR_CHECK == 0))) && " XF_NPPC2 and XF_NPPC4 support the census cost without L-R check ");
+	assert(((COLS % (2*XF_NPIXPERCYCLE(NPC))) == 0) && ((src_mat_l.cols % (2*XF_NPIXPERCYCLE(NPC))) == 0) && " COLS and the width must be a multiple of 2*NPC ");
 	assert(((NUM_DISPARITY > 1) && (NUM_DISPARITY <= 256)) && " The number of disparities must be greater than '1' and less than or equal to '256' ");
 	assert((NUM_DISPARITY >= PARALLEL_DISPARITIES) && " The number of disparities must not be lesser than (parallel units)");
 	assert((((NUM_DISPARITY/PARALLEL_DISPARITIES)*PARALLEL_DISPARITIES) == NUM_DISPARITY) && " NUM_DISPARITY/PARALLEL_DISPARITIES must be a non-fractional number ");
 	assert(((ROWS/2)*2 == ROWS) && ((COLS/2)*2 == COLS) && "ROWS and COLS must be a even number ");
 	assert((P1 < P2) && "P1 must be always less than P2");
+	assert((p1 <= P1) && (p2 <= P2) && (p1 < p2) && " p1 and p2 must not exceed P1 and P2, p1 must be less than p2 ");
+	assert((uniq_ratio < 100) && " uniq_ratio must be less than 100 ");
 	assert((WINDOW_SIZE==3)||(WINDOW_SIZE==5)||(WINDOW_SIZE==7)||(WINDOW_SIZE==9)||(WINDOW_SIZE==11)||(WINDOW_SIZE==13)||(WINDOW_SIZE==15) && " WSIZE must be set to '3,5,7,9,11,13,15' ");
 
 	#pragma HLS INLINE OFF
 	#pragma HLS DATAFLOW
+	ap_uint<BIT_WIDTH(NUM_DISPARITY)> legal_disparity = fpLegalDisparity<NUM_DISPARITY,PARALLEL_DISPARITIES>(num_disparity);
 #if LR_CHECK==0
-	SemiGlobalBMNLR<WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES,FilterWin,SRC_TYPE,DST_TYPE,ROWS,COLS,NPC,P1,P2>(src_mat_l,src_mat_r,dst_mat);	
+	fpSemiGlobalBMNLR<NPC>::template run<WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES,FilterWin,SRC_TYPE,DST_TYPE,ROWS,COLS,P1,P2>(src_mat_l,src_mat_r,dst_mat,legal_disparity,p1,p2,uniq_ratio);	
 #elif LR_CHECK==1
-	SemiGlobalBMLR1<WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES,FilterWin,SRC_TYPE,DST_TYPE,ROWS,COLS,NPC,P1,P2>(src_mat_l,src_mat_r,dst_mat);
+	SemiGlobalBMLR1<WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES,FilterWin,SRC_TYPE,DST_TYPE,ROWS,COLS,NPC,P1,P2>(src_mat_l,src_mat_r,dst_mat,legal_disparity,p1,p2,uniq_ratio);
 #elif LR_CHECK==2
-	SemiGlobalBMLR2<WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES,FilterWin,SRC_TYPE,DST_TYPE,ROWS,COLS,NPC,P1,P2>(src_mat_l,src_mat_r,dst_mat);
+	SemiGlobalBMLR2<WINDOW_SIZE,SHD_WINDOW,NUM_DISPARITY,PARALLEL_DISPARITIES,FilterWin,SRC_TYPE,DST_TYPE,ROWS,COLS,NPC,P1,P2>(src_mat_l,src_mat_r,dst_mat,legal_disparity,p1,p2,uniq_ratio);
 #endif
 }
 
@@ -0,0 +1,304 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+/*
+ * Microbenchmarks of the kernels of the CPU SGM pipeline on synthetic image pairs, without the KITTI folder
+ * test_fp_sgbm needs. Every kernel runs over a grid of resolutions, disparity ranges and window sizes and is
+ * reported in ms and in time per pixel and per pixel-disparity, as TSC cycles where the CPU has a time stamp
+ * counter, so that kernels can be compared across machines. The aggregation is timed both single-threaded
+ * (cost_aggregation_simd) and on a thread pool (cost_aggregation_parallel, the engine compute_SGM runs).
+ */
+
+#define FP_SGBM_NO_MAIN
+#include "fp_sgbm_c.cpp"
+
+#ifdef FP_SIMD_X86
+#include <x86intrin.h>
+#endif
+
+struct BenchResolution {
+	const char *name;
+	int rows;
+	int cols;
+};
+
+static const BenchResolution resolutions[] = {
+	{"vga", 480, 640},
+	{"kitti", 375, 1242},
+	{"1080p", 1080, 1920}
+};
+
+/* Penalties of the aggregation kernels, as the census defaults of run_dse_hls.py */
+#define BENCH_P1 10
+#define BENCH_P2 80
+/* SHD window of the SHD cost, as in the benchmark runs of test_fp_sgbm */
+#define BENCH_SHD_WINDOW 3
+
+/* Time stamp counter; 0 where there is none and only the times are reported */
+inline uint64_t read_cycles() {
+#ifdef FP_SIMD_X86
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+struct BenchTiming {
+	double ms;
+	double cycles;
+};
+
+/* Best of repeats runs of kernel after one warm-up run, which also maps the workspace buffers */
+BenchTiming time_kernel(int repeats, const std::function<void()> &kernel) {
+	kernel();
+	BenchTiming best = {0, 0};
+	for (int k=0; k<repeats; k++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		uint64_t c0 = read_cycles();
+		kernel();
+		uint64_t c1 = read_cycles();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count();
+		if (k == 0 || ms < best.ms) {
+			best.ms = ms;
+			best.cycles = (double)(c1-c0);
+		}
+	}
+	return best;
+}
+
+/* Whether kernel is selected by the comma separated prefixes of filter ("all" selects everything) */
+bool selected(const std::string &filter, const std::string &kernel) {
+	if (filter == "all")
+		return true;
+	std::stringstream ss(filter);
+	std::string item;
+	while (std::getline(ss, item, ',')) {
+		if (!item.empty() && kernel.compare(0, item.size(), item) == 0)
+			return true;
+	}
+	return false;
+}
+
+void report(const char *kernel, const BenchResolution &res, int max_disp, int window_size, const BenchTiming &t) {
+	double pixels = (double)res.rows*res.cols;
+	printf("%-16s %-6s %5d %4d %10.3f %10.3f %10.4f", kernel, res.name, max_disp, window_size,
+			t.ms, t.ms*1e6/pixels, t.ms*1e6/(pixels*max_disp));
+	if (t.cycles > 0)
+		printf(" %10.2f %10.4f\n", t.cycles/pixels, t.cycles/(pixels*max_disp));
+	else
+		printf(" %10s %10s\n", "-", "-");
+}
+
+/* Single path r over the whole image in the 16-bit layout, the inner loop of cost_aggregation_simd */
+template <typename CostT>
+int aggregate_path(CostT *cost, int rows, int cols, int ndisparity, int r, fp::StereoWorkspace *ws) {
+	path_update_u16_t path_update_u16 = select_path_update_u16();
+	int stride = simd_pixel_stride(ndisparity);
+	int rowSize = cols*stride;
+	uint16_t *buf = (uint16_t*)fp::workspace_buffer(ws, fp::StereoWorkspace::AGGR_SCRATCH, 3*rowSize*sizeof(uint16_t));
+	if (!buf) {
+		printf("Memory allocation failed for buf..! \n");
+		return -1;
+	}
+	for (int k=0; k<3*rowSize; k++) {
+		buf[k] = SIMD_COST_MAX;
+	}
+	uint16_t *C_row = buf;
+	uint16_t *Lr_prev = buf+rowSize;
+	uint16_t *Lr_cur = buf+2*rowSize;
+	for (int n=0; n<rows; n++) {
+		int i = (r<4) ? n : rows-1-n;
+		cost_row_u16(C_row, cost, i, cols, ndisparity, stride);
+		path_row_u16(path_update_u16, Lr_cur, Lr_prev, C_row, r, i, 0, cols, rows, cols, stride, BENCH_P1, BENCH_P2);
+		std::swap(Lr_prev, Lr_cur);
+	}
+	fp::release_buffer(ws, buf);
+	return 0;
+}
+
+/* Initial costs of function type into a volume of T */
+template <typename T>
+BenchTiming time_cost(cv::Mat left, cv::Mat right, int type, int window_size, int max_disp, int repeats, fp::StereoWorkspace *ws) {
+	T *cost = (T*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_R, (size_t)left.rows*left.cols*max_disp*sizeof(T));
+	if (!cost) {
+		printf("Memory allocation failed for cost..! \n");
+		BenchTiming none = {0, 0};
+		return none;
+	}
+	return time_kernel(repeats, [&]{ compute_initial_cost(left, right, cost, type, window_size, BENCH_SHD_WINDOW, max_disp, ws); });
+}
+
+// Each cost function on the narrowest volume its costs fit in, as compute_SGM picks it
+BenchTiming time_cost(cv::Mat left, cv::Mat right, int type, int window_size, int max_disp, int repeats, fp::StereoWorkspace *ws) {
+	if (cost_fits<CpuVolume>(type, window_size, BENCH_SHD_WINDOW))
+		return time_cost<CpuVolume::cost_type>(left, right, type, window_size, max_disp, repeats, ws);
+	if (cost_fits<VolumeStorageWide>(type, window_size, BENCH_SHD_WINDOW))
+		return time_cost<VolumeStorageWide::cost_type>(left, right, type, window_size, max_disp, repeats, ws);
+	return time_cost<int>(left, right, type, window_size, max_disp, repeats, ws);
+}
+
+/* All kernels at one resolution, disparity range and window size, on volumes of CostT/AggrT */
+template <typename CostT, typename AggrT>
+int bench_point(const BenchResolution &res, int max_disp, int window_size, int filter_win, int repeats, const std::string &filter, fp::ThreadPool *pool, fp::StereoWorkspace *ws) {
+	int rows = res.rows;
+	int cols = res.cols;
+	size_t volume = (size_t)rows*cols*max_disp;
+	size_t plane = (size_t)rows*cols*sizeof(float);
+	fp::SyntheticPair pair;
+	fp::make_synthetic_pair(fp::TEXTURED_PLANES, rows, cols, max_disp, 0, pair);
+	cv::Mat left = pair.left;
+	cv::Mat right = pair.right;
+
+	CostT *cost = (CostT*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST, volume*sizeof(CostT));
+	AggrT *aggregatedCost = (AggrT*)fp::workspace_buffer(ws, fp::StereoWorkspace::AGGR, volume*sizeof(AggrT));
+	float *disparity_l = (float*)fp::workspace_buffer(ws, fp::StereoWorkspace::DISP_L, plane);
+	float *disparity_r = (float*)fp::workspace_buffer(ws, fp::StereoWorkspace::DISP_R, plane);
+	float *disparity_f = (float*)fp::workspace_buffer(ws, fp::StereoWorkspace::DISP_FILTERED_L, plane);
+	float *disparity = (float*)fp::workspace_buffer(ws, fp::StereoWorkspace::DISP, plane);
+	if (!cost || !aggregatedCost || !disparity_l || !disparity_r || !disparity_f || !disparity) {
+		printf("Memory allocation failed for the %s volumes..! \n", res.name);
+		return -1;
+	}
+
+	if (selected(filter, "census_transform")) {
+		__int128_t *ct = (__int128_t*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_SCRATCH, (size_t)rows*cols*sizeof(__int128_t));
+		if (!ct) {
+			printf("Memory allocation failed for ct..! \n");
+			return -1;
+		}
+		report("census_transform", res, max_disp, window_size,
+				time_kernel(repeats, [&]{ compute_census_transform(left, ct, window_size); }));
+	}
+	static const char *cost_names[] = {"cost_census", "cost_rank", "cost_sad", "cost_zsad", "cost_shd"};
+	for (int type=0; type<5; type++) {
+		if (selected(filter, cost_names[type]))
+			report(cost_names[type], res, max_disp, window_size, time_cost(left, right, type, window_size, max_disp, repeats, ws));
+	}
+	// The census volume is the input of the kernels below
+	compute_initial_cost(left, right, cost, 0, window_size, BENCH_SHD_WINDOW, max_disp, ws);
+
+	for (int r=0; r<8; r++) {
+		char name[32];
+		sprintf(name, "aggr_r%d", r);
+		if (selected(filter, name))
+			report(name, res, max_disp, window_size, time_kernel(repeats, [&]{ aggregate_path(cost, rows, cols, max_disp, r, ws); }));
+	}
+	long cost_max = max_initial_cost(0, window_size, BENCH_SHD_WINDOW);
+	for (int dir=4; dir<=8; dir+=4) {
+		char name[32];
+		char name_mt[32];
+		sprintf(name, "aggregation_%d", dir);
+		sprintf(name_mt, "aggregation_mt_%d", dir);
+		long aggr_max = dir*(cost_max+BENCH_P2);
+		if (aggr_max > (long)std::numeric_limits<AggrT>::max())
+			continue;
+		if (selected(filter, name))
+			report(name, res, max_disp, window_size, time_kernel(repeats, [&]{
+				cost_aggregation_simd(aggregatedCost, cost, rows, cols, dir, max_disp, BENCH_P1, BENCH_P2, cost_max, ws);
+			}));
+		if (selected(filter, name_mt))
+			report(name_mt, res, max_disp, window_size, time_kernel(repeats, [&]{
+				cost_aggregation_parallel(aggregatedCost, cost, rows, cols, dir, max_disp, BENCH_P1, BENCH_P2, cost_max, pool, ws);
+			}));
+	}
+	cost_aggregation_simd(aggregatedCost, cost, rows, cols, NUM_DIR, max_disp, BENCH_P1, BENCH_P2, cost_max, ws);
+
+	if (selected(filter, "wta"))
+		report("wta", res, max_disp, window_size, time_kernel(repeats, [&]{ compute_disparity(disparity_l, aggregatedCost, rows, cols, max_disp); }));
+	if (selected(filter, "wta_lr"))
+		report("wta_lr", res, max_disp, window_size, time_kernel(repeats, [&]{
+			compute_lr_disparity(disparity_l, disparity_r, aggregatedCost, rows, cols, max_disp, ws);
+		}));
+	compute_lr_disparity(disparity_l, disparity_r, aggregatedCost, rows, cols, max_disp, ws);
+
+	// the window column of the median is its own window
+	if (selected(filter, "median"))
+		report("median", res, max_disp, filter_win, time_kernel(repeats, [&]{ median_filter(disparity_l, disparity_f, rows, cols, filter_win, ws); }));
+	if (selected(filter, "lr_check"))
+		report("lr_check", res, max_disp, window_size, time_kernel(repeats, [&]{ check_consistency(disparity_l, disparity_r, disparity, rows, cols); }));
+	if (selected(filter, "interpolation")) {
+		cv::Mat disp_checked(rows, cols, CV_8UC1);
+		cv::Mat disp_8u(rows, cols, CV_8UC1);
+		check_consistency(disparity_l, disparity_r, disparity, rows, cols);
+		for (int k=0; k<rows*cols; k++) {
+			disp_checked.data[k] = (unsigned char)disparity[k];
+		}
+		report("interpolation", res, max_disp, window_size, time_kernel(repeats, [&]{
+			// interpolateDisp works in place, every run starts from the same map
+			disp_checked.copyTo(disp_8u);
+			interpolateDisp(disp_8u);
+		}));
+	}
+	return 0;
+}
+
+// Volumes as in compute_SGM: hardware bit widths when the census costs of the window fit, 16/32-bit otherwise
+int bench_point(const BenchResolution &res, int max_disp, int window_size, int filter_win, int repeats, const std::string &filter, fp::ThreadPool *pool, fp::StereoWorkspace *ws) {
+	if (storage_fits<CpuVolume>(0, window_size, BENCH_SHD_WINDOW, NUM_DIR, BENCH_P2))
+		return bench_point<CpuVolume::cost_type, CpuVolume::aggr_type>(res, max_disp, window_size, filter_win, repeats, filter, pool, ws);
+	return bench_point<VolumeStorageWide::cost_type, VolumeStorageWide::aggr_type>(res, max_disp, window_size, filter_win, repeats, filter, pool, ws);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 8)
+	{
+		fprintf(stderr,"Invalid Number of Arguments!\nUsage:\n");
+		fprintf(stderr,"<Executable Name> [RESOLUTIONS] [DISPARITIES] [WINDOWS] [REPEATS] [KERNELS] [FILTER_WINDOW] [NUM_THREADS] \n");
+		fprintf(stderr,"defaults: vga,kitti,1080p 64,128,256 5,7 5 all %d <cores>; KERNELS are comma separated name prefixes\n", FilterWin);
+		return -1;
+	}
+	std::string res_list = (argc >= 2) ? argv[1] : "vga,kitti,1080p";
+	std::vector<int> disp_list = parse_list((argc >= 3) ? argv[2] : "64,128,256");
+	std::vector<int> window_list = parse_list((argc >= 4) ? argv[3] : "5,7");
+	int repeats = (argc >= 5) ? std::atoi(argv[4]) : 5;
+	std::string filter = (argc >= 6) ? argv[5] : "all";
+	int filter_win = (argc >= 7) ? std::atoi(argv[6]) : FilterWin;
+	int num_threads = (argc >= 8) ? std::atoi(argv[7]) : std::max(1, (int)std::thread::hardware_concurrency());
+
+	for (size_t k=0; k<window_list.size(); k++) {
+		if (window_list[k] < 3 || window_list[k]%2 == 0 || window_list[k] > CENSUS_PACKED_MAX_WINDOW) {
+			fprintf(stderr,"WINDOWS should be odd, from 3 to %d\n", CENSUS_PACKED_MAX_WINDOW);
+			return -1;
+		}
+	}
+	for (size_t k=0; k<disp_list.size(); k++) {
+		if (disp_list[k] < 1 || disp_list[k] > 256) {
+			fprintf(stderr,"DISPARITIES should be from 1 to 256\n");
+			return -1;
+		}
+	}
+	if (repeats < 1) {
+		fprintf(stderr,"REPEATS should be at least 1\n");
+		return -1;
+	}
+	if (filter_win < 1 || filter_win%2 == 0) {
+		fprintf(stderr,"FILTER_WINDOW should be odd\n");
+		return -1;
+	}
+	if (num_threads < 1) {
+		fprintf(stderr,"NUM_THREADS should be at least 1\n");
+		return -1;
+	}
+
+	printf("%-16s %-6s %5s %4s %10s %10s %10s %10s %10s\n", "kernel", "res", "disp", "win",
+			"ms", "ns/px", "ns/px/d", "cyc/px", "cyc/px/d");
+	fp::StereoWorkspace workspace;
+	fp::ThreadPool pool(num_threads);
+	for (size_t n=0; n<sizeof(resolutions)/sizeof(resolutions[0]); n++) {
+		if (!selected(res_list, resolutions[n].name))
+			continue;
+		for (size_t d=0; d<disp_list.size(); d++) {
+			for (size_t w=0; w<window_list.size(); w++) {
+				if (bench_point(resolutions[n], disp_list[d], window_list[w], filter_win, repeats, filter, &pool, &workspace) != 0)
+					return -1;
+			}
+		}
+	}
+	return 0;
+}
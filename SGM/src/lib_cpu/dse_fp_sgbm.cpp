@@ -0,0 +1,577 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+/*
+ * Design space exploration in one process. Every design point (cost function, window, disparity range, parallel
+ * disparities, P1/P2, uniqueness and left-right check) gets an error rate over the dataset and the cycles and
+ * resources of fp_hw_estimate.hpp. The points that fit the platform and that no other point beats on error rate,
+ * FPS and BRAM form the Pareto front, written as CSV and JSON next to the table of all points.
+ *
+ * The error rate is that of the accelerator's own disparity maps, from the bit-exact HwSgbmModel: four paths at
+ * the widths of the kernel, the median filter it always applies, and the uniqueness check, whose ties depend on
+ * PARALLEL_DISPARITIES. A point without uniqueness check gives the same map at every parallelism and is run
+ * once; a point with it runs once per parallelism. NPPC does not change the map.
+ *
+ * engine=cpu scores with the CPU engine instead, which shares the work between the points (initial cost volumes
+ * once per cost function, window and disparity range, kept in the cost cache, aggregated volumes once per
+ * P1/P2, see compute_SGM_sweep) and is much faster, but it is not the accelerator: it aggregates dir paths in
+ * full precision and ignores PARALLEL_DISPARITIES, so its error rates only approximate those of the designs.
+ *
+ * Every image pair is decoded once. The pairs run in parallel on batch workers as in test_fp_sgbm, each with its
+ * own workspace.
+ */
+
+#define FP_SGBM_NO_MAIN
+#include "fp_sgbm_c.cpp"
+#include "fp_hw_estimate.hpp"
+#include <set>
+#include <chrono>
+#include <thread>
+
+/* P1/P2 pairs of run_dse_hls.py per cost function, for window 5 and 7, used when no penalties are given; SHD
+   scales the census ones */
+static const int dse_penalties[4][2][2] = {
+	{{5, 36}, {5, 56}},
+	{{5, 26}, {5, 46}},
+	{{50, 1500}, {80, 3200}},
+	{{10, 600}, {30, 1290}}
+};
+
+/* Design space, with the defaults of run_dse_hls.py */
+struct DseSpace {
+	std::vector<int> cost_types;
+	std::vector<int> windows;
+	std::vector<int> disparities;
+	std::vector<int> parallel;
+	std::vector<int> npc;           // pixels per clock, only for points with NUM_DISPARITY == PARALLEL_DISPARITIES
+	std::vector<int> p1;            // with p2 the penalties of every cost function, or empty for dse_penalties
+	std::vector<int> p2;
+	std::vector<int> uniq;
+	std::vector<int> lr_check;
+	bool model;                     // score with HwSgbmModel, or with the CPU engine
+	int dir;
+	int filter_win;
+	int shd_window;
+};
+
+/* Parameters the disparity maps depend on, and the error rates of their maps over the dataset */
+struct DsePoint {
+	fp::HwSgbmConfig cfg;           // parallel_disparities of the ties of the uniqueness check; 1 with engine=cpu
+	double error_noc;
+	double error_occ;
+	double density;
+};
+
+/* Points sharing their initial cost volumes, evaluated with one compute_SGM_sweep per image pair */
+struct DseGroup {
+	int cost_type;
+	int window_size;
+	int max_disp;
+	std::vector<SweepPoint> sweep;
+	std::vector<int> points;        // DsePoint of each entry of sweep
+};
+
+/* Design point: a DsePoint at one parallelism and number of pixels per clock */
+struct DseDesign {
+	int point;
+	int parallel;
+	int npc;
+	fp::HwEstimate est;
+	bool pareto;
+};
+
+// Penalties of cost_type and window_size: the given pairs for every window, or those of run_dse_hls.py, where
+// window 5 takes the first pair and window 7 the second; other windows take both
+std::vector<std::pair<int, int> > dse_penalty_pairs(const DseSpace &space, int cost_type, int window_size)
+{
+	std::vector<std::pair<int, int> > pairs;
+	if (!space.p1.empty()) {
+		for (size_t k=0; k<space.p1.size(); k++) {
+			pairs.push_back(std::make_pair(space.p1[k], space.p2[k]));
+		}
+		return pairs;
+	}
+	int scale = (cost_type == 4) ? space.shd_window*space.shd_window : 1;
+	for (int k=0; k<2; k++) {
+		if ((window_size == 5 && k != 0) || (window_size == 7 && k != 1))
+			continue;
+		const int *pen = dse_penalties[(cost_type == 4) ? 0 : cost_type][k];
+		pairs.push_back(std::make_pair(pen[0]*scale, pen[1]*scale));
+	}
+	return pairs;
+}
+
+// Enumerates the points of the design space, grouped by initial cost volumes. For the model, a point with
+// uniqueness check is repeated for every parallelism dividing its disparity range, and one without it takes the
+// first. Points the accelerator does not support are reported and left out. Returns -1 when none is left.
+int build_design_space(const DseSpace &space, std::vector<DsePoint> &points, std::vector<DseGroup> &groups)
+{
+	for (size_t c=0; c<space.cost_types.size(); c++) {
+		for (size_t w=0; w<space.windows.size(); w++) {
+			for (size_t d=0; d<space.disparities.size(); d++) {
+				DseGroup group;
+				group.cost_type = space.cost_types[c];
+				group.window_size = space.windows[w];
+				group.max_disp = space.disparities[d];
+				std::vector<std::pair<int, int> > pairs = dse_penalty_pairs(space, group.cost_type, group.window_size);
+				std::vector<int> parallel;
+				for (size_t k=0; k<space.parallel.size(); k++) {
+					if (space.parallel[k] >= 1 && group.max_disp%space.parallel[k] == 0)
+						parallel.push_back(space.parallel[k]);
+				}
+				if (!space.model)
+					parallel.assign(1, 1);
+				for (size_t p=0; p<pairs.size(); p++) {
+					for (size_t u=0; u<space.uniq.size(); u++) {
+						for (size_t l=0; l<space.lr_check.size(); l++) {
+							size_t runs = (space.model && space.uniq[u] != 0) ? parallel.size() : std::min<size_t>(parallel.size(), 1);
+							for (size_t r=0; r<runs; r++) {
+								DsePoint point;
+								fp::HwSgbmConfig cfg = {group.cost_type, group.window_size, space.shd_window, group.max_disp, parallel[r],
+										pairs[p].first, pairs[p].second, space.uniq[u], space.lr_check[l], space.filter_win, space.dir, 1};
+								if (!fp::HwSgbmModel(cfg).valid()) {
+									fprintf(stderr,"Skipping cost %d window %d disparities %d P1 %d P2 %d\n", cfg.cost_function,
+											cfg.window_size, cfg.num_disparity, cfg.p1, cfg.p2);
+									continue;
+								}
+								point.cfg = cfg;
+								point.error_noc = 0;
+								point.error_occ = 0;
+								point.density = 0;
+								SweepPoint sweep = {cfg.p1, cfg.p2, cfg.lr_check, cfg.uniq};
+								group.sweep.push_back(sweep);
+								group.points.push_back(points.size());
+								points.push_back(point);
+							}
+						}
+					}
+				}
+				if (!group.sweep.empty())
+					groups.push_back(group);
+			}
+		}
+	}
+	return points.empty() ? -1 : 0;
+}
+
+// Disparity maps of the accelerator for every point on the loaded image pair i, from HwSgbmModel, and their
+// errors, 2x13 values per point as evaluate_frame. Returns -1 when the model rejects the pair.
+int evaluate_model_frame(int i, const FrameData &frame, const std::vector<DsePoint> &points, fp::ThreadPool *pool, fp::StereoWorkspace *workspace, float *errors)
+{
+	int height = frame.left_gray.rows;
+	int width = frame.left_gray.cols;
+	cv::Mat left = frame.left_gray.isContinuous() ? frame.left_gray : frame.left_gray.clone();
+	cv::Mat right = frame.right_gray.isContinuous() ? frame.right_gray : frame.right_gray.clone();
+	// the 8-bit map as the accelerator writes it, and as score_frame reads it
+	unsigned char *hw_disp = (unsigned char*)workspace->buffer(fp::StereoWorkspace::DISP_L, (size_t)height*width);
+	float *disparity = (float*)workspace->buffer(fp::StereoWorkspace::DISP, (size_t)height*width*sizeof(float));
+	if (!hw_disp || !disparity) {
+		printf("Memory allocation failed for disparity..! \n");
+		return -1;
+	}
+	for (size_t k=0; k<points.size(); k++) {
+		fp::HwSgbmModel model(points[k].cfg);
+		{
+			fp::ScopedStage stage(fp::StageTimer::SGM);
+			if (model.run(left.data, right.data, height, width, hw_disp, pool) != 0)
+				return -1;
+		}
+		for (size_t p=0; p<(size_t)height*width; p++) {
+			disparity[p] = hw_disp[p];
+		}
+		float *point_errors = errors+k*2*13;
+		if (score_frame(i,frame,disparity,"",NULL,point_errors,point_errors+13) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+// Disparity maps of every point on the loaded image pair i and their errors, 2x13 values per point as
+// evaluate_frame. Returns 1 when an input image is missing, -1 when the engine fails.
+int evaluate_design_frame(int i, const FrameData &frame, const EvalConfig &cfg, const std::vector<DsePoint> &points, const std::vector<DseGroup> &groups, bool model, fp::ThreadPool *pool, fp::StereoWorkspace *workspace, float *errors)
+{
+	if (frame.status != 0)
+		return frame.status;
+	if (model)
+		return evaluate_model_frame(i,frame,points,pool,workspace,errors);
+	char prefix[256];
+	sprintf(prefix,"%06d_10",i);
+	std::string frame_key = (cfg.synthetic_scene >= 0) ? cfg.ImageFolderDir + "_" + prefix : std::string(prefix);
+	int height = frame.left_gray.rows;
+	int width = frame.left_gray.cols;
+
+	for (size_t g=0; g<groups.size(); g++) {
+		const DseGroup &group = groups[g];
+		float *disparity = (float*)workspace->buffer(fp::StereoWorkspace::DISP, group.sweep.size()*height*width*sizeof(float));
+		if (!disparity) {
+			printf("Memory allocation failed for disparity..! \n");
+			return -1;
+		}
+		if (compute_SGM_sweep(frame.left_gray,frame.right_gray,disparity,cfg.dir,group.max_disp,group.cost_type,group.window_size,cfg.filter_win,
+				cfg.shd_window,group.sweep,cfg.cache,frame_key,pool,workspace) != 0)
+			return -1;
+		for (size_t k=0; k<group.sweep.size(); k++) {
+			float *point_errors = errors+group.points[k]*2*13;
+			if (score_frame(i,frame,disparity+k*height*width,"",NULL,point_errors,point_errors+13) != 0)
+				return -1;
+		}
+	}
+	return 0;
+}
+
+// Whether design a is at least as good as b on error rate, FPS and BRAM, and better on one of them
+bool dominates(const DseDesign &a, const DseDesign &b, const std::vector<DsePoint> &points)
+{
+	double err_a = points[a.point].error_occ;
+	double err_b = points[b.point].error_occ;
+	double bram_a = a.est.value[fp::HW_BRAM];
+	double bram_b = b.est.value[fp::HW_BRAM];
+	if (err_a > err_b || a.est.fps < b.est.fps || bram_a > bram_b)
+		return false;
+	return err_a < err_b || a.est.fps > b.est.fps || bram_a < bram_b;
+}
+
+// Marks the Pareto front among the designs that fit the platform
+void mark_pareto_front(std::vector<DseDesign> &designs, const std::vector<DsePoint> &points)
+{
+	for (size_t k=0; k<designs.size(); k++) {
+		designs[k].pareto = designs[k].est.fits;
+		for (size_t l=0; l<designs.size() && designs[k].pareto; l++) {
+			if (designs[l].est.fits && dominates(designs[l], designs[k], points))
+				designs[k].pareto = false;
+		}
+	}
+}
+
+void write_design_csv_header(FILE *file)
+{
+	fprintf(file,"cost_function,window_size,shd_window,num_disparity,parallel_disparities,npc,num_dir,uniq,lr_check,filter_win,p1,p2,"
+			"error_noc,error_occ,density,cycles,fps,bram18k,dsp,lut,ff,fits,pareto\n");
+}
+
+void write_design_csv(FILE *file, const DseDesign &design, const std::vector<DsePoint> &points)
+{
+	const DsePoint &point = points[design.point];
+	const fp::HwSgbmConfig &c = point.cfg;
+	fprintf(file,"%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%.6f,%.6f,%.6f,%.0f,%.3f,%.0f,%.0f,%.0f,%.0f,%d,%d\n", c.cost_function,
+			c.window_size, c.shd_window, c.num_disparity, design.parallel, design.npc, c.num_dir, c.uniq, c.lr_check, c.filter_win,
+			c.p1, c.p2, point.error_noc, point.error_occ, point.density, design.est.value[fp::HW_CYCLES], design.est.fps,
+			design.est.value[fp::HW_BRAM], design.est.value[fp::HW_DSP], design.est.value[fp::HW_LUT],
+			design.est.value[fp::HW_FF], design.est.fits ? 1 : 0, design.pareto ? 1 : 0);
+}
+
+void write_design_json(FILE *file, const DseDesign &design, const std::vector<DsePoint> &points, bool first)
+{
+	const DsePoint &point = points[design.point];
+	const fp::HwSgbmConfig &c = point.cfg;
+	fprintf(file,"%s\n    {\"cost_function\": %d, \"window_size\": %d, \"shd_window\": %d, \"num_disparity\": %d, "
+			"\"parallel_disparities\": %d, \"npc\": %d, \"num_dir\": %d, \"uniq\": %d, \"lr_check\": %d, \"filter_win\": %d, "
+			"\"p1\": %d, \"p2\": %d, \"error_noc\": %.6f, \"error_occ\": %.6f, \"density\": %.6f, \"cycles\": %.0f, "
+			"\"fps\": %.3f, \"bram18k\": %.0f, \"dsp\": %.0f, \"lut\": %.0f, \"ff\": %.0f}", first ? "" : ",",
+			c.cost_function, c.window_size, c.shd_window, c.num_disparity, design.parallel, design.npc, c.num_dir, c.uniq,
+			c.lr_check, c.filter_win, c.p1, c.p2, point.error_noc, point.error_occ, point.density,
+			design.est.value[fp::HW_CYCLES], design.est.fps, design.est.value[fp::HW_BRAM], design.est.value[fp::HW_DSP],
+			design.est.value[fp::HW_LUT], design.est.value[fp::HW_FF]);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr,"Invalid Number of Arguments!\nUsage:\n");
+		fprintf(stderr,"<Executable Name> <Dataset folder path> [option=value ...] \n");
+		fprintf(stderr,"Design space, comma separated lists (defaults of run_dse_hls.py):\n");
+		fprintf(stderr,"  cost=0,1,2,3 window=5,7 disp=64,128 parallel=4,8,16,32 uniq=0,1 lr=0,1,2\n");
+		fprintf(stderr,"  npc=1  pixels per clock; 2 and 4 apply to census points with parallel == disp and lr=0\n");
+		fprintf(stderr,"  penalties=<p1>:<p2>,...  for every cost function and window, default: the pairs of run_dse_hls.py per\n");
+		fprintf(stderr,"             cost function, the first for window 5 and the second for window 7 (both for other windows)\n");
+		fprintf(stderr,"  dir=4 filter=5 shd=3\n");
+		fprintf(stderr,"Scoring: engine=model  the bit-exact accelerator model (default)\n");
+		fprintf(stderr,"         engine=cpu    shares the cost volumes between the points and is much faster, but it\n");
+		fprintf(stderr,"                       aggregates dir paths in full precision and ignores PARALLEL_DISPARITIES,\n");
+		fprintf(stderr,"                       so its error rates only approximate the designs'\n");
+		fprintf(stderr,"Run: images=%d threads=<cores> batch=<threads> size=1242x374 (frame of the estimate, <width>x<height>)\n", NUM_TEST_IMAGES);
+		fprintf(stderr,"     out=dse (dse_all.csv, dse_pareto.csv, dse_pareto.json) reports=<csv to calibrate the estimate>\n");
+		fprintf(stderr,"     cache=<cost cache dir, engine=cpu>\n");
+		fprintf(stderr,"The dataset folder may be synthetic:<dots|planes>:<width>x<height>, generated in memory.\n");
+		return -1;
+	}
+
+	std::string ImageFolderDir = argv[1];
+	DseSpace space;
+	space.cost_types = parse_list("0,1,2,3");
+	space.windows = parse_list("5,7");
+	space.disparities = parse_list("64,128");
+	space.parallel = parse_list("4,8,16,32");
+	space.npc = parse_list("1");
+	space.uniq = parse_list("0,1");
+	space.lr_check = parse_list("0,1,2");
+	space.model = true;
+	space.dir = 4;
+	space.filter_win = 5;
+	space.shd_window = 3;
+	int num_images = NUM_TEST_IMAGES;
+	int num_threads = std::max(1, (int)std::thread::hardware_concurrency());
+	int batch = 0;
+	int hw_rows = 374;
+	int hw_cols = 1242;
+	bool hw_size = false;
+	std::string out = "dse";
+	std::string reports_csv;
+	std::string cache_dir;
+
+	for (int a=2; a<argc; a++) {
+		std::string arg = argv[a];
+		size_t eq = arg.find('=');
+		std::string key = arg.substr(0, eq);
+		const char *value = (eq == std::string::npos) ? "" : argv[a]+eq+1;
+		if (key == "cost") space.cost_types = parse_list(value);
+		else if (key == "window") space.windows = parse_list(value);
+		else if (key == "disp") space.disparities = parse_list(value);
+		else if (key == "parallel") space.parallel = parse_list(value);
+		else if (key == "npc") space.npc = parse_list(value);
+		else if (key == "uniq") space.uniq = parse_list(value);
+		else if (key == "lr") space.lr_check = parse_list(value);
+		else if (key == "engine") {
+			if (std::string(value) != "model" && std::string(value) != "cpu") {
+				fprintf(stderr,"engine should be model or cpu\n");
+				return -1;
+			}
+			space.model = (std::string(value) == "model");
+		}
+		else if (key == "dir") space.dir = std::atoi(value);
+		else if (key == "filter") space.filter_win = std::atoi(value);
+		else if (key == "shd") space.shd_window = std::atoi(value);
+		else if (key == "images") num_images = std::atoi(value);
+		else if (key == "threads") num_threads = std::atoi(value);
+		else if (key == "batch") batch = std::atoi(value);
+		else if (key == "out") out = value;
+		else if (key == "reports") reports_csv = value;
+		else if (key == "cache") cache_dir = value;
+		else if (key == "size") {
+			hw_size = true;
+			if (sscanf(value,"%dx%d",&hw_cols,&hw_rows) != 2) {
+				fprintf(stderr,"size should be <width>x<height>\n");
+				return -1;
+			}
+		}
+		else if (key == "penalties") {
+			std::stringstream ss(value);
+			std::string item;
+			while (std::getline(ss,item,',')) {
+				int p1, p2;
+				if (sscanf(item.c_str(),"%d:%d",&p1,&p2) != 2) {
+					fprintf(stderr,"penalties should be <p1>:<p2>,...\n");
+					return -1;
+				}
+				space.p1.push_back(p1);
+				space.p2.push_back(p2);
+			}
+		}
+		else {
+			fprintf(stderr,"Unknown option %s\n",argv[a]);
+			return -1;
+		}
+	}
+	if (space.cost_types.empty() || space.windows.empty() || space.disparities.empty() || space.parallel.empty() ||
+			space.npc.empty() || space.uniq.empty() || space.lr_check.empty()) {
+		fprintf(stderr,"The lists of the design space should not be empty\n");
+		return -1;
+	}
+	if (num_images<1 || num_images>NUM_TEST_IMAGES) {
+		fprintf(stderr,"images should be from 1 to %d\n",NUM_TEST_IMAGES);
+		return -1;
+	}
+	if (num_threads<1) {
+		fprintf(stderr,"threads should be at least 1\n");
+		return -1;
+	}
+	batch = (batch > 0) ? batch : std::min(num_threads, num_images);
+
+	std::vector<DsePoint> points;
+	std::vector<DseGroup> groups;
+	if (build_design_space(space,points,groups) != 0) {
+		fprintf(stderr,"No point of the design space is supported by the accelerator\n");
+		return -1;
+	}
+	int num_points = points.size();
+
+	EvalConfig cfg;
+	cfg.synthetic_scene = -1;
+	if (fp::parse_synthetic_spec(ImageFolderDir,cfg.synthetic_scene,cfg.synthetic_rows,cfg.synthetic_cols)) {
+		if (cfg.synthetic_scene < 0)
+			return -1;
+		char folder[64];
+		sprintf(folder,"synthetic_%s_%dx%d",(cfg.synthetic_scene == fp::RANDOM_DOT) ? "dots" : "planes",cfg.synthetic_cols,cfg.synthetic_rows);
+		ImageFolderDir = folder;
+		if (!hw_size) {
+			hw_rows = cfg.synthetic_rows;
+			hw_cols = cfg.synthetic_cols;
+		}
+	}
+	cfg.ImageFolderDir = ImageFolderDir;
+	cfg.max_disp = *std::max_element(space.disparities.begin(), space.disparities.end());
+	cfg.dir = space.dir;
+	cfg.filter_win = space.filter_win;
+	cfg.shd_window = space.shd_window;
+	cfg.fused = 0;
+
+	if (space.model && !cache_dir.empty())
+		fprintf(stderr,"The cost cache only applies to engine=cpu\n");
+	fp::CostCache cost_cache(cache_dir);
+	cfg.cache = cache_dir.empty() ? NULL : &cost_cache;
+	if (cfg.cache && std::system(("mkdir -p " + cache_dir).c_str()) != 0)
+		fprintf(stderr,"Cannot create %s\n",cache_dir.c_str());
+
+	fp::HwEstimator estimator;
+	if (!reports_csv.empty()) {
+		std::vector<fp::HwReport> reports;
+		if (fp::read_hw_reports(reports_csv,reports) != 0 || estimator.calibrate(reports) != 0)
+			return -1;
+		printf("Estimate calibrated on %lu reports\n",(unsigned long)reports.size());
+	}
+
+	if (space.model) {
+		printf("%d points, per image pair %d runs of the accelerator model, on up to %d image pairs\n",
+				num_points,num_points,num_images);
+	}
+	else {
+		int num_aggregations = 0;
+		for (size_t g=0; g<groups.size(); g++) {
+			std::set<std::pair<int, int> > penalties;
+			for (size_t k=0; k<groups[g].sweep.size(); k++)
+				penalties.insert(std::make_pair(groups[g].sweep[k].p1, groups[g].sweep[k].p2));
+			num_aggregations += penalties.size();
+		}
+		printf("%d points, per image pair %lu initial cost volumes and %d aggregations, on up to %d image pairs\n",
+				num_points,(unsigned long)groups.size(),num_aggregations,num_images);
+	}
+
+	// Errors of every pair and point, summed up in image order afterwards as in test_fp_sgbm
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<float> frame_errors((size_t)num_images*num_points*2*13, 0.0f);
+	std::vector<int> frame_status(num_images, 1);
+	{
+		fp::PrefetchQueue<FrameData> loader(num_images, FRAME_PREFETCH*batch, batch,
+				[&cfg](int i, FrameData &frame){ load_frame(i,cfg,frame); });
+		fp::ThreadPool frames(batch);
+		frames.run(batch, [&](int) {
+			fp::ThreadPool pool(std::max(1, num_threads/batch));
+			fp::StereoWorkspace workspace;
+			int i;
+			FrameData frame;
+			while (loader.pop(i,frame)) {
+				frame_status[i] = evaluate_design_frame(i,frame,cfg,points,groups,space.model,&pool,&workspace,&frame_errors[(size_t)i*num_points*2*13]);
+				// the pairs before a failed one are still summed up, those after it are not
+				if (frame_status[i] != 0)
+					loader.stop_after(i);
+			}
+		});
+	}
+
+	std::vector<float> noc_sum(num_points*12, 0.0f);
+	std::vector<float> occ_sum(num_points*12, 0.0f);
+	int num_frames = 0;
+	for (; num_frames<num_images && frame_status[num_frames] == 0; num_frames++) {
+		for (int k=0; k<num_points; k++) {
+			const float *noc_errors = &frame_errors[((size_t)num_frames*num_points+k)*2*13];
+			const float *occ_errors = noc_errors+13;
+			for (int num=0; num<12; num++) {
+				noc_sum[k*12+num] += noc_errors[num];
+				occ_sum[k*12+num] += occ_errors[num];
+			}
+		}
+	}
+	if (num_frames<num_images && frame_status[num_frames]<0)
+		return -1;
+	if (num_frames == 0) {
+		fprintf(stderr,"No image pair could be read from %s\n",ImageFolderDir.c_str());
+		return -1;
+	}
+	for (int k=0; k<num_points; k++) {
+		points[k].error_noc = noc_sum[k*12+8]/std::max(noc_sum[k*12+9],1.0f);
+		points[k].error_occ = occ_sum[k*12+8]/std::max(occ_sum[k*12+9],1.0f);
+		points[k].density = occ_sum[k*12+11]/std::max(occ_sum[k*12+9],1.0f);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+	printf("Error rates of %d points on %d image pairs in %.1f s\n",num_points,num_frames,seconds);
+
+	// Every point at every parallelism that divides its disparity range, and at every number of pixels per clock
+	// the accelerator supports for it. The disparity map does not depend on NPPC. A model point with uniqueness
+	// check was scored at one parallelism and only serves that one.
+	std::vector<DseDesign> designs;
+	for (int k=0; k<num_points; k++) {
+		for (size_t p=0; p<space.parallel.size(); p++) {
+			if (space.model && points[k].cfg.uniq != 0 && space.parallel[p] != points[k].cfg.parallel_disparities)
+				continue;
+			for (size_t n=0; n<space.npc.size(); n++) {
+				DseDesign design;
+				design.point = k;
+				design.parallel = space.parallel[p];
+				design.npc = space.npc[n];
+				design.pareto = false;
+				fp::HwSgbmConfig hw = points[k].cfg;
+				hw.parallel_disparities = design.parallel;
+				hw.npc = design.npc;
+				if (design.parallel<1 || hw.num_disparity%design.parallel != 0)
+					continue;
+				if (hw.npc != 1 && ((hw.npc != 2 && hw.npc != 4) || hw.num_disparity != hw.parallel_disparities ||
+						hw.cost_function != 0 || hw.lr_check != 0 || hw_cols%(2*hw.npc) != 0))
+					continue;
+				if (estimator.estimate(hw,hw_rows,hw_cols,design.est) != 0)
+					return -1;
+				designs.push_back(design);
+			}
+		}
+	}
+	mark_pareto_front(designs,points);
+
+	std::vector<std::pair<double, int> > front;
+	for (size_t k=0; k<designs.size(); k++) {
+		if (designs[k].pareto)
+			front.push_back(std::make_pair(points[designs[k].point].error_occ, (int)k));
+	}
+	std::sort(front.begin(), front.end());
+
+	FILE *all_file = fopen((out + "_all.csv").c_str(),"w");
+	FILE *front_file = fopen((out + "_pareto.csv").c_str(),"w");
+	FILE *json_file = fopen((out + "_pareto.json").c_str(),"w");
+	if (!all_file || !front_file || !json_file) {
+		printf("Failed to open %s_*..! \n",out.c_str());
+		return -1;
+	}
+	write_design_csv_header(all_file);
+	for (size_t k=0; k<designs.size(); k++)
+		write_design_csv(all_file,designs[k],points);
+	fclose(all_file);
+
+	const fp::HwPlatform &platform = estimator.target();
+	write_design_csv_header(front_file);
+	fprintf(json_file,"{\n  \"dataset\": \"%s\",\n  \"image_pairs\": %d,\n  \"platform\": \"%s\",\n  \"clock_mhz\": %.1f,\n"
+			"  \"frame\": {\"rows\": %d, \"cols\": %d},\n  \"designs\": %lu,\n  \"pareto\": [",ImageFolderDir.c_str(),num_frames,
+			platform.name,platform.clock_mhz,hw_rows,hw_cols,(unsigned long)designs.size());
+	printf("Pareto front of %lu designs (error rate of all pixels, FPS at %.0f MHz for %dx%d, BRAM_18K):\n",
+			(unsigned long)designs.size(),platform.clock_mhz,hw_cols,hw_rows);
+	printf("  %4s %6s %4s %4s %3s %4s %8s %4s %3s %9s %9s %8s %8s\n","cost","window","disp","par","npc","p1","p2","uniq","lr",
+			"error_noc","error_occ","fps","bram18k");
+	for (size_t k=0; k<front.size(); k++) {
+		const DseDesign &design = designs[front[k].second];
+		const DsePoint &point = points[design.point];
+		write_design_csv(front_file,design,points);
+		write_design_json(json_file,design,points,k == 0);
+		printf("  %4d %6d %4d %4d %3d %4d %8d %4d %3d %9.4f %9.4f %8.1f %8.0f\n",point.cfg.cost_function,point.cfg.window_size,
+				point.cfg.num_disparity,design.parallel,design.npc,point.cfg.p1,point.cfg.p2,point.cfg.uniq,point.cfg.lr_check,
+				point.error_noc,point.error_occ,design.est.fps,design.est.value[fp::HW_BRAM]);
+	}
+	fprintf(json_file,"\n  ]\n}\n");
+	fclose(front_file);
+	fclose(json_file);
+
+	printf("Finish successfully!\n");
+	return 0;
+}
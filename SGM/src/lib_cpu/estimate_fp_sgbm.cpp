@@ -0,0 +1,106 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+/*
+ * Cycles, FPS, resources and AXI traffic of one design point of the accelerator, from the analytical model of
+ * fp_hw_estimate.hpp instead of an sds++ run. The arguments are those of run_sdx.py, NPPC included; with a CSV of
+ * synthesized points the model is calibrated first and its error on every point is printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include "fp_hw_estimate.hpp"
+
+int main(int argc, char** argv)
+{
+	if (argc < 14 || argc > 16)
+	{
+		fprintf(stderr,"Invalid Number of Arguments!\nUsage:\n");
+		fprintf(stderr,"<Executable Name> <height> <width> <cost_function> <window_size> <max_disp> <parallel_disp> <num_dir> "
+				"<uniqueness> <lr_check> <filter_win> <shd_window> <p1> <p2> [npc] [reports.csv] \n");
+		return -1;
+	}
+	int rows = atoi(argv[1]);
+	int cols = atoi(argv[2]);
+	// the 14th argument is NPPC when it is a number, as in run_sdx.py
+	int arg = 14;
+	int npc = 1;
+	if (argc > arg && strspn(argv[arg], "0123456789") == strlen(argv[arg]))
+		npc = atoi(argv[arg++]);
+	const char *reports_csv = (argc > arg) ? argv[arg++] : NULL;
+	if (argc > arg)
+	{
+		fprintf(stderr,"Unexpected argument %s\n", argv[arg]);
+		return -1;
+	}
+	fp::HwSgbmConfig cfg = {atoi(argv[3]), atoi(argv[4]), atoi(argv[11]), atoi(argv[5]), atoi(argv[6]),
+			atoi(argv[12]), atoi(argv[13]), atoi(argv[8]), atoi(argv[9]), atoi(argv[10]), atoi(argv[7]), npc};
+
+	fp::HwEstimator estimator;
+	if (reports_csv)
+	{
+		std::vector<fp::HwReport> reports;
+		if (fp::read_hw_reports(reports_csv, reports) != 0 || estimator.calibrate(reports) != 0)
+			return -1;
+		const fp::HwCalibration &calib = estimator.calibration();
+		printf("Calibration on %lu reports\n", (unsigned long)reports.size());
+		for (int m=0; m<fp::HW_NUM_METRICS; m++)
+		{
+			printf("  %-8s scale %8.4f offset %12.1f (%d points)\n", fp::hw_metric_names[m], calib.scale[m],
+					calib.offset[m], calib.points[m]);
+		}
+		printf("Error of the calibrated model, %%\n");
+		printf("  %-40s", "report");
+		for (int m=0; m<fp::HW_NUM_METRICS; m++)
+			printf(" %8s", fp::hw_metric_names[m]);
+		printf("\n");
+		for (size_t k=0; k<reports.size(); k++)
+		{
+			fp::HwEstimate est;
+			estimator.estimate(reports[k].cfg, reports[k].rows, reports[k].cols, est);
+			const fp::HwSgbmConfig &c = reports[k].cfg;
+			char name[64];
+			snprintf(name, sizeof(name), "%dx%d c%d w%d d%d p%d u%d lr%d n%d", reports[k].cols, reports[k].rows,
+					c.cost_function, c.window_size, c.num_disparity, c.parallel_disparities, c.uniq, c.lr_check, c.npc);
+			printf("  %-40s", name);
+			for (int m=0; m<fp::HW_NUM_METRICS; m++)
+			{
+				if (reports[k].value[m] > 0)
+					printf(" %8.1f", 100.0*(est.value[m]-reports[k].value[m])/reports[k].value[m]);
+				else
+					printf(" %8s", "-");
+			}
+			printf("\n");
+		}
+	}
+
+	fp::HwEstimate est;
+	if (estimator.estimate(cfg, rows, cols, est) != 0)
+		return -1;
+	const fp::HwPlatform &platform = estimator.target();
+	printf("Stage trip counts, cycles\n");
+	for (int s=0; s<fp::HW_NUM_STAGES; s++)
+	{
+		if (est.stage_cycles[s] > 0)
+			printf("  %-10s %12.0f%s\n", fp::hw_stage_names[s], est.stage_cycles[s], (s == est.bottleneck) ? "  <- bottleneck" : "");
+	}
+	printf("Cycles per frame: %.0f\n", est.value[fp::HW_CYCLES]);
+	printf("FPS at %.0f MHz: %.2f\n", platform.clock_mhz, est.fps);
+	for (int m=fp::HW_BRAM; m<fp::HW_NUM_METRICS; m++)
+	{
+		printf("%-8s %10.0f of %8.0f (%5.1f%%)\n", fp::hw_metric_names[m], est.value[m], platform.available[m],
+				100.0*est.value[m]/platform.available[m]);
+	}
+	printf("AXI traffic: %.2f MB per frame, %.1f MB/s, %.1f MB/s on the busiest %d-bit port\n", est.axi_bytes/1e6,
+			est.axi_mbps, est.port_mbps, platform.port_bw);
+	printf("Fits %s: %s\n", platform.name, est.fits ? "yes" : "no");
+	return 0;
+}
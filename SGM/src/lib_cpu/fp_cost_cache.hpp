@@ -0,0 +1,122 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+#ifndef _FP_COST_CACHE_HPP_
+#define _FP_COST_CACHE_HPP_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace fp{
+
+/* FNV-1a of bytes, continued from h, for keys that have to follow the content of the images */
+inline uint64_t cache_hash(const void *data, size_t bytes, uint64_t h = 14695981039346656037ULL) {
+	const unsigned char *p = (const unsigned char*)data;
+	for (size_t k=0; k<bytes; k++) {
+		h = (h ^ p[k])*1099511628211ULL;
+	}
+	return h;
+}
+
+/* Read-only view of a cached cost volume, unmapped when it goes out of scope */
+class MappedVolume {
+public:
+	MappedVolume() : ptr(0), bytes(0) {}
+
+	~MappedVolume() {
+		close();
+	}
+
+	void *data() const {
+		return ptr;
+	}
+
+	void close() {
+		if (ptr)
+			munmap(ptr, bytes);
+		ptr = 0;
+		bytes = 0;
+	}
+
+private:
+	friend class CostCache;
+	MappedVolume(const MappedVolume &);
+	MappedVolume &operator=(const MappedVolume &);
+
+	void *ptr;
+	size_t bytes;
+};
+
+/*
+ * Initial cost volumes kept as files in a directory, one per key (image and cost parameters), so that runs
+ * which only differ in the penalties or the post-processing map the volume instead of computing it again.
+ * Volumes are written to a temporary file and renamed, so concurrent runs sharing the directory only ever
+ * see complete files. The pages are mapped copy-on-write: the cost engines may treat them as writable.
+ */
+class CostCache {
+public:
+	explicit CostCache(const std::string &dir) : dir(dir) {}
+
+	/* Map the volume of key into volume; false when the cache has no volume of exactly bytes bytes */
+	bool load(const std::string &key, size_t bytes, MappedVolume &volume) const {
+		volume.close();
+		int fd = open(path(key).c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		bool ok = (fstat(fd, &st) == 0 && (size_t)st.st_size == bytes && bytes > 0);
+		void *ptr = ok ? mmap(0, bytes, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		::close(fd);
+		if (ptr == MAP_FAILED)
+			return false;
+		volume.ptr = ptr;
+		volume.bytes = bytes;
+		return true;
+	}
+
+	/* Store the volume of key; a volume that cannot be written is only reported, the run goes on */
+	void store(const std::string &key, const void *data, size_t bytes) const {
+		std::string tmp = path(key) + ".XXXXXX";
+		int fd = mkstemp(&tmp[0]);
+		if (fd < 0) {
+			fprintf(stderr, "CostCache: cannot create %s\n", tmp.c_str());
+			return;
+		}
+		const char *p = (const char*)data;
+		size_t left = bytes;
+		while (left > 0) {
+			ssize_t n = write(fd, p, left);
+			if (n <= 0)
+				break;
+			p += n;
+			left -= n;
+		}
+		::close(fd);
+		if (left > 0 || rename(tmp.c_str(), path(key).c_str()) != 0) {
+			fprintf(stderr, "CostCache: cannot write %s\n", path(key).c_str());
+			unlink(tmp.c_str());
+		}
+	}
+
+private:
+	std::string path(const std::string &key) const {
+		return dir + "/" + key + ".cost";
+	}
+
+	std::string dir;
+};
+
+}
+
+#endif // _FP_COST_CACHE_HPP_
@@ -0,0 +1,173 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+#ifndef _FP_FRAME_IO_HPP_
+#define _FP_FRAME_IO_HPP_
+
+#include "opencv2/opencv.hpp"
+#include "opencv2/highgui/highgui.hpp"
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+
+namespace fp{
+
+/*
+ * Loads items 0..num_items-1 ahead of their use on num_threads background threads. pop() hands them out in
+ * index order; at most depth items are loaded and not yet popped, which bounds the memory they take.
+ * stop_after() cuts the sequence short behind a failed item while the items before it are still handed out.
+ */
+template <typename Item>
+class PrefetchQueue {
+public:
+	PrefetchQueue(int num_items, int depth, int num_threads, const std::function<void(int, Item&)> &load)
+			: load(load), depth(depth), limit(num_items), next_load(0), next_pop(0), stopped(false) {
+		for (int t=0; t<num_threads; t++) {
+			loaders.push_back(std::thread(&PrefetchQueue::loader_loop, this));
+		}
+	}
+
+	~PrefetchQueue() {
+		stop();
+		for (size_t t=0; t<loaders.size(); t++) {
+			loaders[t].join();
+		}
+	}
+
+	/* Next item in index order, waiting for it to be loaded; false once all items were handed out, for an item
+	   behind stop_after() or after stop() */
+	bool pop(int &index, Item &item) {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (stopped || next_pop >= limit)
+			return false;
+		index = next_pop++;
+		ready.wait(lock, [this, index]{ return stopped || index >= limit || loaded.count(index) > 0; });
+		if (stopped || index >= limit)
+			return false;
+		item = loaded[index];
+		loaded.erase(index);
+		space.notify_all();
+		return true;
+	}
+
+	/* Hand out no item behind index; the items up to index are still loaded and popped */
+	void stop_after(int index) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			limit = std::min(limit, index+1);
+		}
+		ready.notify_all();
+		space.notify_all();
+	}
+
+	/* Hand out no more items and let the loaders finish */
+	void stop() {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			stopped = true;
+		}
+		ready.notify_all();
+		space.notify_all();
+	}
+
+private:
+	void loader_loop() {
+		for (;;) {
+			int index;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				space.wait(lock, [this]{ return stopped || next_load >= limit || next_load < next_pop+depth; });
+				if (stopped || next_load >= limit)
+					return;
+				index = next_load++;
+			}
+			Item item;
+			load(index, item);
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				loaded[index] = item;
+			}
+			ready.notify_all();
+		}
+	}
+
+	std::function<void(int, Item&)> load;
+	std::vector<std::thread> loaders;
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::condition_variable space;
+	std::map<int, Item> loaded;
+	int depth;
+	int limit;              // items below it are handed out, num_items until stop_after()
+	int next_load;
+	int next_pop;
+	bool stopped;
+};
+
+/*
+ * Encodes and writes images on a background thread. write() queues the image and returns; it only waits when
+ * max_pending images are queued already. The destructor writes everything still queued.
+ */
+class ImageWriter {
+public:
+	explicit ImageWriter(int max_pending) : max_pending(max_pending), stopped(false) {
+		writer = std::thread(&ImageWriter::writer_loop, this);
+	}
+
+	~ImageWriter() {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			stopped = true;
+		}
+		queued.notify_all();
+		writer.join();
+	}
+
+	/* The pixels of image are shared, not copied: they must not be changed after the call */
+	void write(const std::string &path, const cv::Mat &image) {
+		std::unique_lock<std::mutex> lock(mutex);
+		space.wait(lock, [this]{ return (int)pending.size() < max_pending; });
+		pending.push_back(std::make_pair(path, image));
+		queued.notify_one();
+	}
+
+private:
+	void writer_loop() {
+		for (;;) {
+			std::pair<std::string, cv::Mat> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				queued.wait(lock, [this]{ return stopped || !pending.empty(); });
+				if (pending.empty())
+					return;
+				job = pending.front();
+				pending.pop_front();
+			}
+			space.notify_all();
+			cv::imwrite(job.first, job.second);
+		}
+	}
+
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable queued;
+	std::condition_variable space;
+	std::deque<std::pair<std::string, cv::Mat> > pending;
+	int max_pending;
+	bool stopped;
+};
+
+}
+
+#endif // _FP_FRAME_IO_HPP_
@@ -0,0 +1,472 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+#ifndef _FP_HW_ESTIMATE_HPP_
+#define _FP_HW_ESTIMATE_HPP_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "fp_hw_model.hpp"
+
+namespace fp{
+
+/* Metrics of a design point, as in the csynth report of the accelerator */
+enum HwMetric {
+	HW_CYCLES = 0,      // latency of one frame
+	HW_BRAM,            // BRAM_18K
+	HW_DSP,             // DSP48E
+	HW_LUT,
+	HW_FF,
+	HW_NUM_METRICS
+};
+
+static const char *const hw_metric_names[HW_NUM_METRICS] = {"cycles", "bram18k", "dsp", "lut", "ff"};
+
+/* Dataflow processes of SemiGlobalBM, each bounding the frame time by its trip count */
+enum HwStage {
+	HW_STAGE_READ = 0,
+	HW_STAGE_TRANSFORM,     // census/rank transform, once per pixel and image
+	HW_STAGE_COST,
+	HW_STAGE_AGGREGATE,
+	HW_STAGE_WTA,
+	HW_STAGE_MEDIAN,
+	HW_STAGE_LR_CHECK,
+	HW_STAGE_WRITE,
+	HW_NUM_STAGES
+};
+
+static const char *const hw_stage_names[HW_NUM_STAGES] = {"read", "transform", "cost", "aggregate", "wta", "median",
+		"lr_check", "write"};
+
+/* The device and the clock of the accelerator */
+struct HwPlatform {
+	const char *name;
+	double clock_mhz;
+	int port_bw;            // MAX_PORT_BW, bits of the HP AXI port of each image and of the disparity map
+	double available[HW_NUM_METRICS];   // cycles unused
+};
+
+/* ZCU102 (XCZU9EG) at the clock of the SDSoC builds of run_sdx.py */
+inline HwPlatform zcu102_platform() {
+	HwPlatform platform = {"zcu102", 200.0, 128, {0, 1824, 2520, 274080, 548160}};
+	return platform;
+}
+
+struct HwEstimate {
+	double value[HW_NUM_METRICS];
+	double stage_cycles[HW_NUM_STAGES];
+	int bottleneck;         // HwStage with the largest trip count
+	double fps;
+	double axi_bytes;       // per frame, both images in and the disparity map out
+	double axi_mbps;        // at fps
+	double port_mbps;       // busiest port at fps
+	bool fits;              // every resource within the platform
+};
+
+/* A synthesized design point: the configuration and the metrics of its report, negative where unknown */
+struct HwReport {
+	HwSgbmConfig cfg;
+	int rows;
+	int cols;
+	double value[HW_NUM_METRICS];
+};
+
+/* Per metric, calibrated = scale*analytical + offset */
+struct HwCalibration {
+	double scale[HW_NUM_METRICS];
+	double offset[HW_NUM_METRICS];
+	int points[HW_NUM_METRICS];     // reports the metric was fitted on
+
+	HwCalibration() {
+		for (int m=0; m<HW_NUM_METRICS; m++) {
+			scale[m] = 1;
+			offset[m] = 0;
+			points[m] = 0;
+		}
+	}
+};
+
+/*
+ * Analytical estimate of SemiGlobalBM from the structure of its kernels, so that the design space can be swept
+ * without a tool run per point:
+ *
+ * - cycles: every dataflow process is a pipelined loop of II=1 over the pixels times ITERATION (NUM_DISPARITY/
+ *   PARALLEL_DISPARITIES), over the columns plus NUM_DISPARITY-1 for the right views of the L-R check; the
+ *   aggregation runs II=2 when ITERATION is 1. With NPPC 2 or 4 the loops step over NPPC pixels, so the columns
+ *   are divided by NPPC. A frame takes the slowest process, plus the rows the window, aggregation and median delay
+ *   the output by, plus the pipeline refill of every row.
+ * - BRAM: the line buffers, the Lr/Lr_Disparity/Lr_min rows of the aggregation and the FIFOs with a STREAM pragma,
+ *   each in the BRAM_18K aspect ratio that needs the fewest blocks; small memories go to LUTRAM/SRL.
+ * - LUT/FF/DSP: the datapath of a disparity unit (cost, four paths at AGGR_DISPARITY_WIDTH, winner-takes-all)
+ *   times PARALLEL_DISPARITIES, the transforms and the median filter, all times NPPC. The line buffers and the
+ *   aggregation rows of NPPC > 1 hold NPPC-pixel words, the latter split per pixel of a word.
+ *
+ * The absolute numbers are only as good as the unit costs below; calibrate() fits a scale and an offset per
+ * metric to a few csynth reports, which keeps the ranking between design points and fixes the level.
+ */
+class HwEstimator {
+public:
+	explicit HwEstimator(const HwPlatform &target = zcu102_platform()) : platform(target) {}
+
+	const HwPlatform &target() const {
+		return platform;
+	}
+
+	const HwCalibration &calibration() const {
+		return calib;
+	}
+
+	void set_calibration(const HwCalibration &calibration) {
+		calib = calibration;
+	}
+
+	/* Uncalibrated metrics of cfg for a rows x cols frame; -1 for a configuration SemiGlobalBM rejects */
+	int analytical(const HwSgbmConfig &cfg, int rows, int cols, HwEstimate &est) const {
+		HwSgbmModel model(cfg);
+		if (!model.valid())
+			return -1;
+		if (rows < 1 || cols < 2*cfg.npc || cols%(2*cfg.npc) != 0) {
+			printf("The accelerator needs an image width that is a multiple of 2*NPPC, got %dx%d..! \n", cols, rows);
+			return -1;
+		}
+		memset(&est, 0, sizeof(est));
+		estimate_cycles(cfg, rows, cols, est);
+		estimate_resources(cfg, cols, est);
+		return 0;
+	}
+
+	/* Calibrated metrics, FPS, AXI traffic and whether the design fits the platform */
+	int estimate(const HwSgbmConfig &cfg, int rows, int cols, HwEstimate &est) const {
+		if (analytical(cfg, rows, cols, est) != 0)
+			return -1;
+		for (int m=0; m<HW_NUM_METRICS; m++) {
+			est.value[m] = std::max(0.0, calib.scale[m]*est.value[m] + calib.offset[m]);
+		}
+		est.fps = platform.clock_mhz*1e6/est.value[HW_CYCLES];
+		// 8-bit pixels: two images in, one disparity map out
+		est.axi_bytes = 3.0*rows*cols;
+		est.axi_mbps = est.axi_bytes*est.fps/1e6;
+		est.port_mbps = (double)rows*cols*est.fps/1e6;
+		est.fits = est.port_mbps <= platform.port_bw/8.0*platform.clock_mhz;
+		for (int m=HW_BRAM; m<HW_NUM_METRICS; m++) {
+			if (est.value[m] > platform.available[m])
+				est.fits = false;
+		}
+		return 0;
+	}
+
+	/*
+	 * Least-squares scale and offset of every metric over the reports that have it. One report only fixes the
+	 * scale; a metric without reports keeps the analytical value. Returns -1 when a report has an invalid
+	 * configuration.
+	 */
+	int calibrate(const std::vector<HwReport> &reports) {
+		std::vector<double> x[HW_NUM_METRICS];
+		std::vector<double> y[HW_NUM_METRICS];
+		for (size_t k=0; k<reports.size(); k++) {
+			HwEstimate est;
+			if (analytical(reports[k].cfg, reports[k].rows, reports[k].cols, est) != 0)
+				return -1;
+			for (int m=0; m<HW_NUM_METRICS; m++) {
+				if (reports[k].value[m] >= 0) {
+					x[m].push_back(est.value[m]);
+					y[m].push_back(reports[k].value[m]);
+				}
+			}
+		}
+		HwCalibration fitted;
+		for (int m=0; m<HW_NUM_METRICS; m++) {
+			fit_line(x[m], y[m], fitted.scale[m], fitted.offset[m]);
+			fitted.points[m] = (int)x[m].size();
+		}
+		calib = fitted;
+		return 0;
+	}
+
+private:
+	/* BRAM_18K blocks of a depth x width memory, in the aspect ratio needing the fewest */
+	static double bram18k(double depth, double width) {
+		static const int widths[] = {36, 18, 9, 4, 2, 1};
+		static const int depths[] = {512, 1024, 2048, 4096, 8192, 16384};
+		double best = 0;
+		for (int k=0; k<6; k++) {
+			double blocks = ceil(width/widths[k])*ceil(depth/depths[k]);
+			if (k == 0 || blocks < best)
+				best = blocks;
+		}
+		return best;
+	}
+
+	/* A memory of count copies; the small ones become LUTRAM or shift registers */
+	static void add_memory(double count, double depth, double width, HwEstimate &est) {
+		if (depth <= 64 || depth*width <= 1024)
+			est.value[HW_LUT] += count*ceil(depth/32)*width;
+		else
+			est.value[HW_BRAM] += count*bram18k(depth, width);
+	}
+
+	static void fit_line(const std::vector<double> &x, const std::vector<double> &y, double &scale, double &offset) {
+		scale = 1;
+		offset = 0;
+		size_t n = x.size();
+		if (n == 0)
+			return;
+		double sx = 0, sy = 0, sxx = 0, sxy = 0;
+		for (size_t k=0; k<n; k++) {
+			sx += x[k];
+			sy += y[k];
+			sxx += x[k]*x[k];
+			sxy += x[k]*y[k];
+		}
+		if (sxx == 0) {
+			// the analytical value is 0 everywhere, e.g. DSPs of census designs
+			offset = sy/n;
+			return;
+		}
+		double det = n*sxx - sx*sx;
+		if (n >= 2 && fabs(det) > 1e-9*sxx*n) {
+			scale = (n*sxy - sx*sy)/det;
+			offset = (sy - scale*sx)/n;
+		}
+		// One point, or a line falling with the analytical value that would invert the ranking: a scale only
+		if (n < 2 || scale <= 0) {
+			scale = sxy/sxx;
+			offset = 0;
+		}
+	}
+
+	void estimate_cycles(const HwSgbmConfig &cfg, int rows, int cols, HwEstimate &est) const {
+		double it = cfg.num_disparity/cfg.parallel_disparities;
+		double half_win = cfg.window_size >> 1;
+		double half_shd = (cfg.cost_function == 4) ? (cfg.shd_window >> 1) : 0;
+		double half_filter = cfg.filter_win >> 1;
+		// column steps of the pipelined loops, NPPC pixels each
+		double steps = (double)cols/cfg.npc;
+		// the right views of the L-R check run NUM_DISPARITY-1 columns longer
+		double lr_cols = steps + ((cfg.lr_check == 2) ? cfg.num_disparity-1 : 0);
+		double wta_cols = steps + ((cfg.lr_check == 1) ? cfg.num_disparity-1 : 0);
+
+		double *stage = est.stage_cycles;
+		stage[HW_STAGE_READ] = rows*steps;
+		if (cfg.cost_function == 0 || cfg.cost_function == 1 || cfg.cost_function == 4)
+			stage[HW_STAGE_TRANSFORM] = (rows+half_win)*steps;
+		switch (cfg.cost_function) {
+		case 2:
+		case 3:
+			stage[HW_STAGE_COST] = rows*(lr_cols+half_win)*it + half_win*steps;
+			break;
+		case 4:
+			stage[HW_STAGE_COST] = rows*(lr_cols+half_shd)*it + half_shd*steps;
+			break;
+		default:
+			stage[HW_STAGE_COST] = rows*lr_cols*it;
+			break;
+		}
+		stage[HW_STAGE_AGGREGATE] = (rows+1)*steps*((it == 1) ? 2 : it);
+		stage[HW_STAGE_WTA] = rows*wta_cols*it;
+		stage[HW_STAGE_MEDIAN] = rows*(steps+half_filter) + half_filter*steps;
+		if (cfg.lr_check != 0)
+			stage[HW_STAGE_LR_CHECK] = rows*steps;
+		stage[HW_STAGE_WRITE] = rows*steps;
+
+		est.bottleneck = 0;
+		for (int s=1; s<HW_NUM_STAGES; s++) {
+			if (stage[s] > stage[est.bottleneck])
+				est.bottleneck = s;
+		}
+		// Rows buffered before the first disparity leaves the median filter, at the pace of the bottleneck
+		double row_cycles = stage[est.bottleneck]/rows;
+		double delay_rows = half_win + half_shd + 1 + half_filter;
+		// Refill of the pipelined column loops at every row, about their depth
+		const double refill = 12;
+		est.value[HW_CYCLES] = stage[est.bottleneck] + delay_rows*row_cycles + rows*refill + cfg.num_disparity;
+	}
+
+	void estimate_resources(const HwSgbmConfig &cfg, int cols, HwEstimate &est) const {
+		double pd = cfg.parallel_disparities;
+		double it = cfg.num_disparity/cfg.parallel_disparities;
+		double npc = cfg.npc;
+		double steps = cols/npc;
+		double w = cfg.window_size;
+		double census = w*w-1;
+		int cost_value = hw_cost_value(cfg);
+		double cost_width = hw_bit_width(cost_value);
+		double path_width = hw_bit_width(cost_value+cfg.p2);
+		double aggr_width = path_width + ((cfg.num_dir == 4) ? 2 : 3);
+		// LR_CHECK 2 computes a second cost volume and aggregates it in fpAggregateCost4Path_copy
+		double volumes = (cfg.lr_check == 2) ? 2 : 1;
+		double medians = (cfg.lr_check == 0) ? 1 : 2;
+
+		// Line buffers of the images, and of the census words for SHD
+		add_memory(2*(w-1), steps, 8*npc, est);
+		if (cfg.cost_function == 4)
+			add_memory(2*(cfg.shd_window-1), cols, census, est);
+
+		// Aggregation: Lr, Lr_Disparity and Lr_min of the r1..r3 paths and the reordering FIFOs. NPPC > 1 keeps
+		// the costs and the minimum of a pixel in one word of Lr, one memory per pixel of a step.
+		if (npc > 1) {
+			add_memory(3*npc, steps+3, path_width*(pd+1), est);
+		}
+		else {
+			add_memory(volumes*3, (cols+2)*it, path_width*pd, est);
+			if (it > 1)
+				add_memory(volumes*3, (cols+2)*it, path_width, est);
+			add_memory(volumes*3, cols+2, path_width, est);
+		}
+		add_memory(volumes, steps*it/4, cost_width*pd*npc, est);
+		add_memory(volumes, steps*it/2, cost_width*pd*npc, est);
+		add_memory(volumes, steps*it/2, aggr_width*pd*npc, est);
+		add_memory(volumes, steps*it/4, aggr_width*pd*npc, est);
+
+		// Median filter line buffers, and l_dst_fifo of the L-R check
+		add_memory(medians*(cfg.filter_win-1), steps, 8*npc, est);
+		if (cfg.lr_check != 0)
+			add_memory(1, cfg.num_disparity, 8, est);
+
+		// Datapath of one disparity unit: matching cost
+		double cost_lut = 0;
+		double transform_lut = 0;
+		double dsp = 0;
+		switch (cfg.cost_function) {
+		case 0:
+			cost_lut = census + cost_width;
+			transform_lut = census*4;
+			break;
+		case 1:
+			cost_lut = 2*cost_width;
+			transform_lut = census*5;
+			break;
+		case 2:
+			cost_lut = 26*w*w;
+			break;
+		case 3:
+			cost_lut = 36*w*w;
+			dsp = 1;
+			break;
+		default:
+			cost_lut = cfg.shd_window*cfg.shd_window*(census + cost_width);
+			transform_lut = census*4;
+			break;
+		}
+		// four paths: the three candidates and the minimum over the previous pixel, the sum of the paths
+		double path_lut = 4*(8*path_width + 4*path_width) + 3*aggr_width;
+		// winner-takes-all over the unit, three minima for the uniqueness check, the right minima of LR_CHECK 1
+		double wta_lut = (aggr_width + 8)*((cfg.uniq != 0) ? 3 : 1);
+		if (cfg.lr_check == 1)
+			wta_lut += 2*(aggr_width + 8);
+
+		double lut = npc*(volumes*pd*(cost_lut + path_lut) + pd*wta_lut*volumes + 2*transform_lut);
+		// registers of the SAD/ZSAD windows over the disparity range, the right minima of LR_CHECK 1
+		double reg_bits = 0;
+		if (cfg.cost_function == 2 || cfg.cost_function == 3)
+			reg_bits += volumes*w*(cfg.num_disparity+w-1)*8;
+		if (cfg.lr_check == 1)
+			reg_bits += cfg.num_disparity*(aggr_width+8);
+		if (cfg.lr_check != 0)
+			reg_bits += cfg.num_disparity*8;
+		double filter = cfg.filter_win*cfg.filter_win;
+		double median_lut = npc*medians*8*filter*std::max(1.0, log2(filter));
+		lut += median_lut + reg_bits/4;
+
+		// AXI datamovers and the control of the dataflow processes
+		const double base_lut = 4000;
+		est.value[HW_LUT] += lut + base_lut;
+		est.value[HW_FF] = 1.2*lut + reg_bits + 1.5*base_lut;
+		est.value[HW_DSP] = dsp*volumes*(pd+1)*npc;
+	}
+
+	HwPlatform platform;
+	HwCalibration calib;
+};
+
+/*
+ * Reports of synthesized design points, one CSV line each after a header:
+ * rows,cols,cost_function,window_size,shd_window,num_disparity,parallel_disparities,num_dir,uniq,lr_check,filter_win,p1,p2,cycles,bram18k,dsp,lut,ff[,npc]
+ * An empty or negative metric is unknown, a missing npc is 1. Returns -1 when the file cannot be read or a line is malformed.
+ */
+inline int read_hw_reports(const std::string &path, std::vector<HwReport> &reports) {
+	std::ifstream in(path.c_str());
+	if (!in) {
+		printf("Failed to open %s..! \n", path.c_str());
+		return -1;
+	}
+	std::string line;
+	int line_no = 0;
+	while (std::getline(in, line)) {
+		line_no++;
+		if (line_no == 1 || line.empty() || line[0] == '#')
+			continue;
+		std::vector<double> fields;
+		std::stringstream ss(line);
+		std::string item;
+		while (std::getline(ss, item, ',')) {
+			fields.push_back(item.find_first_not_of(" \t\r") == std::string::npos ? -1 : atof(item.c_str()));
+		}
+		while (fields.size() < 14+HW_NUM_METRICS)
+			fields.push_back(-1);
+		if (fields[13+HW_NUM_METRICS] <= 0)
+			fields[13+HW_NUM_METRICS] = 1;
+		if (fields.size() > 14+HW_NUM_METRICS || fields[0] <= 0 || fields[1] <= 0) {
+			printf("Malformed report at %s:%d..! \n", path.c_str(), line_no);
+			return -1;
+		}
+		HwReport report;
+		report.rows = (int)fields[0];
+		report.cols = (int)fields[1];
+		HwSgbmConfig cfg = {(int)fields[2], (int)fields[3], (int)fields[4], (int)fields[5], (int)fields[6],
+				(int)fields[11], (int)fields[12], (int)fields[8], (int)fields[9], (int)fields[10], (int)fields[7],
+				(int)fields[13+HW_NUM_METRICS]};
+		report.cfg = cfg;
+		for (int m=0; m<HW_NUM_METRICS; m++) {
+			report.value[m] = fields[13+m];
+		}
+		reports.push_back(report);
+	}
+	return 0;
+}
+
+/* Number in the first <tag>...</tag> of an XML text, or -1 */
+inline double hw_xml_value(const std::string &xml, const char *tag) {
+	std::string open = std::string("<") + tag + ">";
+	size_t pos = xml.find(open);
+	if (pos == std::string::npos)
+		return -1;
+	return atof(xml.c_str()+pos+open.size());
+}
+
+/*
+ * Metrics of a Vivado HLS csynth.xml (syn/report/<top>_csynth.xml): the worst-case latency and the used
+ * resources, which come before the available ones in the report. Returns -1 when it cannot be read.
+ */
+inline int read_csynth_report(const std::string &path, double value[HW_NUM_METRICS]) {
+	std::ifstream in(path.c_str());
+	if (!in) {
+		printf("Failed to open %s..! \n", path.c_str());
+		return -1;
+	}
+	std::stringstream ss;
+	ss << in.rdbuf();
+	std::string xml = ss.str();
+	value[HW_CYCLES] = hw_xml_value(xml, "Worst-caseLatency");
+	value[HW_BRAM] = hw_xml_value(xml, "BRAM_18K");
+	value[HW_DSP] = hw_xml_value(xml, "DSP48E");
+	value[HW_LUT] = hw_xml_value(xml, "LUT");
+	value[HW_FF] = hw_xml_value(xml, "FF");
+	return 0;
+}
+
+}
+
+#endif // _FP_HW_ESTIMATE_HPP_
@@ -0,0 +1,657 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+#ifndef _FP_HW_MODEL_HPP_
+#define _FP_HW_MODEL_HPP_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include "fp_thread_pool.hpp"
+
+namespace fp{
+
+/* The compile-time parameters of SemiGlobalBM (fp_config_arch.h and fp_config_params.h), as run-time values */
+struct HwSgbmConfig {
+	int cost_function;          // COST_FUNCTION: 0 census, 1 rank, 2 SAD, 3 ZSAD, 4 SHD
+	int window_size;            // WINDOW_SIZE
+	int shd_window;             // SHD_WINDOW
+	int num_disparity;          // NUM_DISPARITY
+	int parallel_disparities;   // PARALLEL_DISPARITIES, which decides the ties of the uniqueness check
+	int p1;                     // SMALL_PENALTY
+	int p2;                     // LARGE_PENALTY
+	int uniq;                   // UNIQ
+	int lr_check;               // LR_CHECK: 0 none, 1 right map from the left volume, 2 from a right volume
+	int filter_win;             // FilterWin
+	int num_dir;                // NUM_DIR, only the width of the aggregated costs: the accelerator runs 4 paths
+	int npc;                    // NPPC, pixels per clock: 1, 2 or 4; the disparity map does not depend on it
+};
+
+/* Uniqueness ratio of the accelerator when the caller does not set one (UNIQ_RATIO of fp_config_params.h) */
+const int hw_uniq_ratio = 5;
+
+/*
+ * The run-time arguments of SemiGlobalBM, written over AXI-Lite at every call. NUM_DISPARITY, SMALL_PENALTY and
+ * LARGE_PENALTY of the configuration are their upper bounds.
+ */
+struct HwSgbmArgs {
+	int num_disparity;          // active disparity range, clamped as hw_legal_disparity does
+	int p1;
+	int p2;
+	int uniq_ratio;             // percent, 0 turns the uniqueness check of UNIQ off
+};
+
+/* BIT_WIDTH of fp_common.h */
+inline int hw_bit_width(uint32_t n) {
+	int width = 1;
+	while (n >> width) {
+		width++;
+	}
+	return width;
+}
+
+/* fpLegalDisparity of fp_sgbm.hpp: the range the accelerator runs for num_disparity, after the truncation to the
+   BIT_WIDTH(NUM_DISPARITY) bits of its AXI-Lite argument */
+inline int hw_legal_disparity(const HwSgbmConfig &cfg, int num_disparity) {
+	const int P = cfg.parallel_disparities;
+	if (cfg.num_disparity == P)
+		return cfg.num_disparity;
+	int legal = (int)((uint32_t)num_disparity & ((1u << hw_bit_width(cfg.num_disparity))-1));
+	legal = legal/P*P;
+	return std::max(std::min(legal, cfg.num_disparity), 2*P);
+}
+
+/* COST_MAP of fp_common.h: the largest matching cost, for 8-bit pixels */
+inline int hw_cost_value(const HwSgbmConfig &cfg) {
+	int w = cfg.window_size;
+	switch (cfg.cost_function) {
+	case 0:
+	case 1:
+		return w*w-1;
+	case 2:
+		return 255*w*w;
+	case 3:
+		return 255*w*w*2;
+	default:
+		return (w*w-1)*cfg.shd_window*cfg.shd_window;
+	}
+}
+
+/*
+ * Bit-exact model of the accelerator (SemiGlobalBM of lib_accel) on the CPU, without the HLS headers: the
+ * zero-padded windows of the cost kernels, the widths and MAX_VALUE_BOUND of fp_common.h in the 4-path
+ * aggregation, the tie-breaking of the winner-takes-all over chunks of PARALLEL_DISPARITIES, and the median
+ * filter replicating the borders. The image is streamed row by row as in the accelerator; the disparities of
+ * a row, the cost computation and the paths of the previous row are split into column bands over the pool.
+ *
+ * The accelerator only handles an even width equal to its COLS: the r3 path of the last column reads a
+ * border slot of the line buffer that is not written for narrower images, which the model does not emulate.
+ */
+class HwSgbmModel {
+public:
+	explicit HwSgbmModel(const HwSgbmConfig &config) : cfg(config) {
+		args.num_disparity = cfg.num_disparity;
+		args.p1 = cfg.p1;
+		args.p2 = cfg.p2;
+		args.uniq_ratio = hw_uniq_ratio;
+		cost_value = hw_cost_value(cfg);
+		path_width = hw_bit_width(cost_value+cfg.p2);
+		min_width = hw_bit_width(cost_value+cfg.p2*2);
+		aggr_width = path_width + ((cfg.num_dir == 4) ? 2 : 3);
+		path_mask = (1u << path_width)-1;
+		min_mask = (1u << min_width)-1;
+		path_bound = 1048575u & path_mask;
+		aggr_bound = 1048575u & ((1u << aggr_width)-1);
+	}
+
+	/* Checks the static assertions of SemiGlobalBM; prints the first one violated */
+	bool valid() const {
+		const char *msg = 0;
+		if (cfg.cost_function < 0 || cfg.cost_function > 4)
+			msg = "COST_FUNCTION must be 0..4";
+		else if (cfg.window_size < 3 || cfg.window_size > 15 || cfg.window_size%2 == 0)
+			msg = "WINDOW_SIZE must be odd, 3..15";
+		else if (cfg.cost_function == 4 && (cfg.shd_window < 1 || cfg.shd_window%2 == 0))
+			msg = "SHD_WINDOW must be odd";
+		else if (cfg.num_disparity <= 1 || cfg.num_disparity > 256)
+			msg = "NUM_DISPARITY must be 2..256";
+		else if (cfg.parallel_disparities < 1 || cfg.num_disparity%cfg.parallel_disparities != 0)
+			msg = "NUM_DISPARITY must be a multiple of PARALLEL_DISPARITIES";
+		else if (cfg.p1 < 0 || cfg.p1 >= cfg.p2)
+			msg = "SMALL_PENALTY must be below LARGE_PENALTY";
+		else if (path_width > 20)
+			msg = "the aggregated costs of a path exceed 20 bits";
+		else if (cfg.lr_check < 0 || cfg.lr_check > 2)
+			msg = "LR_CHECK must be 0..2";
+		else if (cfg.filter_win < 1 || cfg.filter_win%2 == 0)
+			msg = "FilterWin must be odd";
+		else if (cfg.num_dir != 4 && cfg.num_dir != 5 && cfg.num_dir != 8)
+			msg = "NUM_DIR must be 4, 5 or 8";
+		else if (cfg.npc != 1 && cfg.npc != 2 && cfg.npc != 4)
+			msg = "NPPC must be 1, 2 or 4";
+		else if (cfg.npc > 1 && (cfg.num_disparity != cfg.parallel_disparities || cfg.cost_function != 0 || cfg.lr_check != 0))
+			msg = "NPPC 2 and 4 need NUM_DISPARITY == PARALLEL_DISPARITIES, census and no L-R check";
+		if (msg)
+			printf("Invalid accelerator configuration: %s..! \n", msg);
+		return msg == 0;
+	}
+
+	/* Run-time arguments of the next runs; num_disparity is clamped as the accelerator clamps it. Prints the first
+	   other bound violated and keeps the previous arguments */
+	int set_args(const HwSgbmArgs &a) {
+		const char *msg = 0;
+		if (a.p1 < 0 || a.p1 > cfg.p1 || a.p2 > cfg.p2 || a.p1 >= a.p2)
+			msg = "p1 < p2 must hold, up to SMALL_PENALTY and LARGE_PENALTY";
+		else if (a.uniq_ratio < 0 || a.uniq_ratio > 99)
+			msg = "uniq_ratio must be 0..99";
+		if (msg) {
+			printf("Invalid accelerator arguments: %s..! \n", msg);
+			return -1;
+		}
+		args = a;
+		args.num_disparity = hw_legal_disparity(cfg, a.num_disparity);
+		if (args.num_disparity != a.num_disparity)
+			printf("num_disparity %d runs as %d on this accelerator\n", a.num_disparity, args.num_disparity);
+		return 0;
+	}
+
+	/*
+	 * Disparity map of the rows x cols pair into dst, 8 bits per pixel as the accelerator writes it. Returns -1
+	 * for a configuration or an image size the accelerator does not support.
+	 */
+	int run(const unsigned char *left, const unsigned char *right, int rows, int cols, unsigned char *dst, ThreadPool *pool = 0) {
+		if (!valid())
+			return -1;
+		if (rows < 1 || cols < 2*cfg.npc || cols%(2*cfg.npc) != 0) {
+			printf("The accelerator needs an image width that is a multiple of 2*NPPC, got %dx%d..! \n", cols, rows);
+			return -1;
+		}
+		height = rows;
+		width = cols;
+		img[0] = left;
+		img[1] = right;
+		num_sides = (cfg.lr_check == 2) ? 2 : 1;
+		num_bands = pool ? std::max(1, std::min(cols/2, pool->size())) : 1;
+		prepare_transforms(pool);
+
+		const int D = args.num_disparity;
+		for (int s=0; s<num_sides; s++) {
+			Side &side = sides[s];
+			side.cost.assign((size_t)cols*D, 0);
+			side.aggr.assign((size_t)cols*D, 0);
+			side.path0.assign((size_t)cols*D, 0);
+			side.min0.assign(cols, 0);
+			for (int r=0; r<3; r++) {
+				side.prev[r].assign((size_t)cols*D, 0);
+				side.cur[r].assign((size_t)cols*D, 0);
+				side.prev_min[r].assign(cols, 0);
+				side.cur_min[r].assign(cols, 0);
+			}
+		}
+		scratch.resize(num_sides*num_bands);
+		for (size_t k=0; k<scratch.size(); k++) {
+			scratch[k].resize(cols/num_bands + 2*(cfg.window_size/2 + cfg.shd_window) + 2);
+		}
+		std::vector<unsigned char> disp[2], filtered[2];
+		int num_maps = (cfg.lr_check > 0) ? 2 : 1;
+		for (int m=0; m<num_maps; m++) {
+			disp[m].assign((size_t)rows*cols, 0);
+			filtered[m].assign((size_t)rows*cols, 0);
+		}
+
+		for (int y=0; y<rows; y++) {
+			parallel(pool, num_sides*num_bands, [&](int k) {
+				int s = k/num_bands, b = k%num_bands;
+				compute_cost_row(s, y, band_begin(b), band_begin(b+1), scratch[k]);
+			});
+			// Task 0 of a side runs its horizontal path over the row, the others the 3 paths from the previous row
+			parallel(pool, num_sides*(num_bands+1), [&](int k) {
+				int s = k/(num_bands+1), b = k%(num_bands+1);
+				if (b == 0)
+					aggregate_horizontal(sides[s]);
+				else
+					aggregate_vertical(sides[s], y, band_begin(b-1), band_begin(b));
+			});
+			parallel(pool, num_sides*num_bands, [&](int k) {
+				int s = k/num_bands, b = k%num_bands;
+				Side &side = sides[s];
+				unsigned char *out = &disp[s][(size_t)y*cols];
+				for (int x=band_begin(b); x<band_begin(b+1); x++) {
+					uint32_t *a = &side.aggr[(size_t)x*D];
+					for (int d=0; d<D; d++) {
+						size_t i = (size_t)x*D+d;
+						a[d] = side.path0[i] + side.cur[0][i] + side.cur[1][i] + side.cur[2][i];
+					}
+					out[x] = cfg.uniq ? wta_uniqueness(a) : wta(a);
+				}
+			});
+			if (cfg.lr_check == 1) {
+				parallel(pool, num_bands, [&](int b) {
+					unsigned char *out = &disp[1][(size_t)y*cols];
+					for (int x=band_begin(b); x<band_begin(b+1); x++) {
+						out[x] = wta_right(x);
+					}
+				});
+			}
+			for (int s=0; s<num_sides; s++) {
+				for (int r=0; r<3; r++) {
+					sides[s].prev[r].swap(sides[s].cur[r]);
+					sides[s].prev_min[r].swap(sides[s].cur_min[r]);
+				}
+			}
+		}
+
+		for (int m=0; m<num_maps; m++) {
+			parallel(pool, rows, [&](int y) {
+				median_row(disp[m], filtered[m], y);
+			});
+		}
+		if (cfg.lr_check == 0) {
+			std::copy(filtered[0].begin(), filtered[0].end(), dst);
+		}
+		else {
+			parallel(pool, rows, [&](int y) {
+				lr_check_row(filtered[0], filtered[1], dst, y);
+			});
+		}
+		return 0;
+	}
+
+	int cost_value;             // COST_MAP
+	int path_width;             // AGGR_DISPARITY_WIDTH(COST_VALUE,P2), the costs of one path
+	int min_width;              // AGGR_DISPARITY_WIDTH(COST_VALUE,P2*2), the candidates of the minimum of a path
+	int aggr_width;             // AGGR_MAP(NUM_DIR,COST_VALUE,P2), the aggregated costs
+
+private:
+	/* Costs and paths of the row in flight, for the left view and, with LR_CHECK 2, the right view */
+	struct Side {
+		std::vector<uint32_t> cost;             // cols x D, the current row
+		std::vector<uint32_t> path0;            // r0, from the left
+		std::vector<uint32_t> min0;
+		std::vector<uint32_t> prev[3];          // r1 upper-left, r2 upper, r3 upper-right, the previous row
+		std::vector<uint32_t> cur[3];
+		std::vector<uint32_t> prev_min[3];
+		std::vector<uint32_t> cur_min[3];
+		std::vector<uint32_t> aggr;             // sum of the 4 paths, the current row
+	};
+
+	static void parallel(ThreadPool *pool, int tasks, const std::function<void(int)> &fn) {
+		if (pool) {
+			pool->run(tasks, fn);
+			return;
+		}
+		for (int k=0; k<tasks; k++) {
+			fn(k);
+		}
+	}
+
+	int band_begin(int b) const {
+		return (int)((long)width*b/num_bands);
+	}
+
+	/* Census or rank maps of both views, or the window means of ZSAD, with the zero padding of the kernels */
+	void prepare_transforms(ThreadPool *pool) {
+		const int h = cfg.window_size/2;
+		const int area = cfg.window_size*cfg.window_size;
+		census_words = (area-1+63)/64;
+		for (int v=0; v<2; v++) {
+			census[v].clear();
+			rank[v].clear();
+			mean8[v].clear();
+			if (cfg.cost_function == 0 || cfg.cost_function == 4)
+				census[v].assign((size_t)height*width*census_words, 0);
+			else if (cfg.cost_function == 1)
+				rank[v].assign((size_t)height*width, 0);
+			else if (cfg.cost_function == 3)
+				mean8[v].assign((size_t)height*(width+2*h), 0);
+			else
+				continue;
+			parallel(pool, height, [&](int y) {
+				if (cfg.cost_function == 3) {
+					// Eighths of the mean of the windows centred at -h..cols+h-1, floor(8*sum/area) as the ap_ufixed division
+					for (int c=-h; c<width+h; c++) {
+						int sum = 0;
+						for (int i=-h; i<=h; i++) {
+							for (int j=-h; j<=h; j++) {
+								sum += pixel(v, y+i, c+j);
+							}
+						}
+						mean8[v][(size_t)y*(width+2*h)+c+h] = (uint32_t)(8*sum/area);
+					}
+					return;
+				}
+				for (int x=0; x<width; x++) {
+					int centre = pixel(v, y, x);
+					int bit = 0;
+					uint32_t count = 0;
+					uint64_t *words = census[v].empty() ? 0 : &census[v][((size_t)y*width+x)*census_words];
+					for (int i=-h; i<=h; i++) {
+						for (int j=-h; j<=h; j++) {
+							if (i == 0 && j == 0)
+								continue;
+							if (pixel(v, y+i, x+j) < centre) {
+								count++;
+								if (words)
+									words[bit >> 6] |= (uint64_t)1 << (bit & 63);
+							}
+							bit++;
+						}
+					}
+					if (!rank[v].empty())
+						rank[v][(size_t)y*width+x] = count;
+				}
+			});
+		}
+	}
+
+	/* Pixel of view v, 0 outside the image as in the line buffers of the cost kernels */
+	int pixel(int v, int y, int x) const {
+		if (y < 0 || y >= height || x < 0 || x >= width)
+			return 0;
+		return img[v][(size_t)y*width+x];
+	}
+
+	uint32_t census_distance(int va, int ya, int xa, int vb, int yb, int xb) const {
+		const uint64_t *a = census_at(va, ya, xa);
+		const uint64_t *b = census_at(vb, yb, xb);
+		uint32_t distance = 0;
+		for (int k=0; k<census_words; k++) {
+			distance += __builtin_popcountll((a ? a[k] : 0) ^ (b ? b[k] : 0));
+		}
+		return distance;
+	}
+
+	const uint64_t *census_at(int v, int y, int x) const {
+		if (y < 0 || y >= height || x < 0 || x >= width)
+			return 0;
+		return &census[v][((size_t)y*width+x)*census_words];
+	}
+
+	uint32_t mean_at(int v, int y, int c) const {
+		const int h = cfg.window_size/2;
+		if (c < -h || c >= width+h)
+			return 0;
+		return mean8[v][(size_t)y*(width+2*h)+c+h];
+	}
+
+	/*
+	 * Costs of row y, columns x0..x1-1, of side s: the left view matched at x-d of the right one, or with
+	 * LR_CHECK 2 the right view matched at x+d of the left one, as fpLRCompute*Cost mirror the left kernels.
+	 */
+	void compute_cost_row(int s, int y, int x0, int x1, std::vector<uint32_t> &colsum) {
+		const int D = args.num_disparity;
+		const int va = s, vb = 1-s;
+		const int sign = s ? -1 : 1;
+		uint32_t *cost = &sides[s].cost[0];
+		switch (cfg.cost_function) {
+		case 0:
+			for (int x=x0; x<x1; x++) {
+				for (int d=0; d<D; d++) {
+					cost[(size_t)x*D+d] = census_distance(va, y, x, vb, y, x-sign*d);
+				}
+			}
+			break;
+		case 1:
+			for (int x=x0; x<x1; x++) {
+				int ra = rank[va][(size_t)y*width+x];
+				for (int d=0; d<D; d++) {
+					int xb = x-sign*d;
+					int rb = (xb >= 0 && xb < width) ? rank[vb][(size_t)y*width+xb] : 0;
+					cost[(size_t)x*D+d] = (uint32_t)abs(ra-rb);
+				}
+			}
+			break;
+		case 3: {
+			// ZSAD: |(mean_b + a) - (mean_a + b)| per pixel in eighths, rounded half up to an integer
+			const int h = cfg.window_size/2;
+			for (int x=x0; x<x1; x++) {
+				int ma = mean_at(va, y, x);
+				for (int d=0; d<D; d++) {
+					int mb = mean_at(vb, y, x-sign*d);
+					uint32_t sum = 0;
+					for (int i=-h; i<=h; i++) {
+						for (int j=-h; j<=h; j++) {
+							int diff = abs((mb + 8*pixel(va, y+i, x+j)) - (ma + 8*pixel(vb, y+i, x+j-sign*d)));
+							sum += (diff >> 3) + ((diff & 7) >= 4);
+						}
+					}
+					cost[(size_t)x*D+d] = sum;
+				}
+			}
+			break;
+		}
+		default: {
+			// SAD over the window, SHD as the sum of the census distances over the SHD window: column sums slid along the row
+			const int h = ((cfg.cost_function == 2) ? cfg.window_size : cfg.shd_window)/2;
+			for (int d=0; d<D; d++) {
+				for (int c=x0-h; c<x1+h; c++) {
+					int cb = c-sign*d;
+					uint32_t sum = 0;
+					for (int i=-h; i<=h; i++) {
+						if (cfg.cost_function == 2)
+							sum += (uint32_t)abs(pixel(va, y+i, c) - pixel(vb, y+i, cb));
+						else
+							sum += census_distance(va, y+i, c, vb, y+i, cb);
+					}
+					colsum[c-x0+h] = sum;
+				}
+				uint32_t window = 0;
+				for (int k=0; k<2*h; k++) {
+					window += colsum[k];
+				}
+				for (int x=x0; x<x1; x++) {
+					window += colsum[x-x0+2*h];
+					cost[(size_t)x*D+d] = window;
+					window -= colsum[x-x0];
+				}
+			}
+			break;
+		}
+		}
+	}
+
+	/*
+	 * One pixel of a path, as an iteration of fpAggregateCost4Path: L(d) = C(d) - min(Lp) + min(Lp(d),
+	 * Lp(d-1)+P1, Lp(d+1)+P1, min(Lp)+P2) at its widths, where the neighbours beyond the disparity range are
+	 * MAX_VALUE_BOUND-P1. A path restarts with the costs at the border it enters the image from. Returns min(L).
+	 */
+	uint32_t path_step(const uint32_t *C, const uint32_t *Lp, uint32_t mp, bool restart, uint32_t *L) const {
+		const int D = args.num_disparity;
+		uint32_t minimum = path_bound;
+		if (restart) {
+			for (int d=0; d<D; d++) {
+				L[d] = C[d] & path_mask;
+				minimum = std::min(minimum, L[d]);
+			}
+			return minimum;
+		}
+		const uint32_t edge = (path_bound - (uint32_t)args.p1) & path_mask;
+		const uint32_t jump = (mp + (uint32_t)args.p2) & min_mask;
+		for (int d=0; d<D; d++) {
+			uint32_t lp = (d > 0) ? Lp[d-1] : edge;
+			uint32_t ln = (d < D-1) ? Lp[d+1] : edge;
+			uint32_t m = std::min(std::min(Lp[d], (lp + (uint32_t)args.p1) & min_mask),
+					std::min((ln + (uint32_t)args.p1) & min_mask, jump));
+			L[d] = ((m & path_mask) + ((C[d] - mp) & path_mask)) & path_mask;
+			minimum = std::min(minimum, L[d]);
+		}
+		return minimum;
+	}
+
+	void aggregate_horizontal(Side &side) {
+		const int D = args.num_disparity;
+		for (int x=0; x<width; x++) {
+			const uint32_t *Lp = (x > 0) ? &side.path0[(size_t)(x-1)*D] : 0;
+			side.min0[x] = path_step(&side.cost[(size_t)x*D], Lp, x ? side.min0[x-1] : 0, x == 0, &side.path0[(size_t)x*D]);
+		}
+	}
+
+	void aggregate_vertical(Side &side, int y, int x0, int x1) {
+		const int D = args.num_disparity;
+		for (int x=x0; x<x1; x++) {
+			const uint32_t *C = &side.cost[(size_t)x*D];
+			for (int r=0; r<3; r++) {
+				int xp = x + r-1;
+				bool restart = (y == 0) || (r == 0 && x == 0) || (r == 2 && x == width-1);
+				const uint32_t *Lp = restart ? 0 : &side.prev[r][(size_t)xp*D];
+				uint32_t mp = restart ? 0 : side.prev_min[r][xp];
+				side.cur_min[r][x] = path_step(C, Lp, mp, restart, &side.cur[r][(size_t)x*D]);
+			}
+		}
+	}
+
+	/* fpComputeDisparity: the lowest disparity of the minimum, strict comparisons from MAX_VALUE_BOUND */
+	unsigned char wta(const uint32_t *a) const {
+		uint32_t best = aggr_bound;
+		int disp = 0;
+		for (int d=0; d<args.num_disparity; d++) {
+			if (a[d] < best) {
+				best = a[d];
+				disp = d;
+			}
+		}
+		return (unsigned char)disp;
+	}
+
+	/*
+	 * fpComputeDisparityUniqueness: the three smallest costs of every chunk of PARALLEL_DISPARITIES
+	 * (fpSortArray) merged into the running ones, then with the ratio u in percent 100*min0 > (100-u)*min1 (for
+	 * a second minimum more than 1 away) and 100*min0 > (100-u)*min2 reject the pixel.
+	 */
+	unsigned char wta_uniqueness(const uint32_t *a) const {
+		const int P = cfg.parallel_disparities;
+		uint32_t m[3] = {aggr_bound, aggr_bound, aggr_bound};
+		int min_disp = 0, second_disp = 0;
+		int index = 0, second_index = 0;
+		for (int base=0; base<args.num_disparity; base+=P) {
+			uint32_t t[3] = {aggr_bound, aggr_bound, aggr_bound};
+			index = 0;
+			second_index = 0;
+			for (int i=0; i<P; i++) {
+				uint32_t v = a[base+i];
+				if (v < t[0]) {
+					t[2] = t[1];
+					t[1] = t[0];
+					t[0] = v;
+					second_index = index;
+					index = i;
+				}
+				else if (v < t[1]) {
+					t[2] = t[1];
+					t[1] = v;
+					second_index = i;
+				}
+				else if (v < t[2]) {
+					t[2] = v;
+				}
+			}
+			if (t[0] < m[0]) {
+				m[2] = m[1];
+				m[1] = m[0];
+				m[0] = t[0];
+				second_disp = min_disp;
+				min_disp = base+index;
+			}
+			else if (t[0] < m[1]) {
+				m[2] = m[1];
+				m[1] = t[0];
+				second_disp = base+index;
+			}
+			else if (t[0] < m[2]) {
+				m[2] = t[0];
+			}
+			if (t[1] < m[1]) {
+				m[2] = m[1];
+				m[1] = t[1];
+				second_disp = base+second_index;
+			}
+			else if (t[1] < m[2]) {
+				m[2] = t[1];
+			}
+			if (t[2] < m[2]) {
+				m[2] = t[2];
+			}
+		}
+		int min0 = 100*(int)m[0], min1 = (100-args.uniq_ratio)*(int)m[1], min2 = (100-args.uniq_ratio)*(int)m[2];
+		if (abs(min_disp-second_disp) > 1 && min0 > min1)
+			return 0;
+		if (min0 > min2)
+			return 0;
+		return (unsigned char)min_disp;
+	}
+
+	/* Right disparity of fpLRComputeDisparity: the lowest d of the minimum of the left costs at x+d, no uniqueness check */
+	unsigned char wta_right(int x) const {
+		const int D = args.num_disparity;
+		const uint32_t *a = &sides[0].aggr[0];
+		uint32_t best = aggr_bound;
+		int disp = 0;
+		for (int d=0; d<D && x+d<width; d++) {
+			if (a[(size_t)(x+d)*D+d] < best) {
+				best = a[(size_t)(x+d)*D+d];
+				disp = d;
+			}
+		}
+		return (unsigned char)disp;
+	}
+
+	/* fpMedianFilter: exact median of the FilterWin window, replicating the borders */
+	void median_row(const std::vector<unsigned char> &src, std::vector<unsigned char> &dst, int y) const {
+		const int h = cfg.filter_win/2;
+		std::vector<unsigned char> window(cfg.filter_win*cfg.filter_win);
+		for (int x=0; x<width; x++) {
+			int n = 0;
+			for (int i=-h; i<=h; i++) {
+				int yy = std::min(std::max(y+i, 0), height-1);
+				for (int j=-h; j<=h; j++) {
+					int xx = std::min(std::max(x+j, 0), width-1);
+					window[n++] = src[(size_t)yy*width+xx];
+				}
+			}
+			std::nth_element(window.begin(), window.begin()+n/2, window.end());
+			dst[(size_t)y*width+x] = window[n/2];
+		}
+	}
+
+	/* fpLRCheckConsistency: the left disparity where the right one it points to is within 1, otherwise 0 */
+	void lr_check_row(const std::vector<unsigned char> &left, const std::vector<unsigned char> &right, unsigned char *dst, int y) const {
+		const unsigned char *l = &left[(size_t)y*width];
+		const unsigned char *r = &right[(size_t)y*width];
+		for (int x=0; x<width; x++) {
+			int xr = x-l[x];
+			int right_disp = (xr >= 0) ? r[xr] : 0;
+			dst[(size_t)y*width+x] = (abs(l[x]-right_disp) <= 1) ? l[x] : 0;
+		}
+	}
+
+	HwSgbmConfig cfg;
+	HwSgbmArgs args;
+	uint32_t path_mask;
+	uint32_t min_mask;
+	uint32_t path_bound;
+	uint32_t aggr_bound;
+
+	int height;
+	int width;
+	int num_sides;
+	int num_bands;
+	const unsigned char *img[2];
+	int census_words;
+	std::vector<uint64_t> census[2];
+	std::vector<uint32_t> rank[2];
+	std::vector<uint32_t> mean8[2];
+	Side sides[2];
+	std::vector<std::vector<uint32_t> > scratch;
+};
+
+}
+
+#endif // _FP_HW_MODEL_HPP_
@@ -7,11 +7,23 @@
  */
  
 #include "fp_sgbm_c.h"
+#include "fp_sgbm_simd.hpp"
+#include "fp_sgbm_census.hpp"
+#include "fp_sgbm_storage.hpp"
+#include "fp_thread_pool.hpp"
+#include "fp_stereo_workspace.hpp"
+#include "fp_frame_io.hpp"
+#include "fp_cost_cache.hpp"
+#include "fp_stage_timer.hpp"
+#include "fp_synthetic_stereo.hpp"
 #include <string>
+#include <vector>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 #include <math.h>
 #include <time.h>
@@ -40,7 +52,8 @@ int compute_SAD(int *window1, int *window2, int window_size){
     return sad;
 }
 
-int compute_SAD_cost(cv::Mat img1, cv::Mat img2, int *cost, int window_size, int max_disp){
+template <typename CostT>
+int compute_SAD_cost(cv::Mat img1, cv::Mat img2, CostT *cost, int window_size, int max_disp){
     int *window1 = (int*)malloc(window_size*window_size*sizeof(int));
     if (!window1) {
         printf("Memory allocation failed for window1..! \n");
@@ -85,7 +98,8 @@ int compute_SAD_cost(cv::Mat img1, cv::Mat img2, int *cost, int window_size, int
     return 0;
 }
 
-int compute_lr_SAD_cost(cv::Mat img1, cv::Mat img2, int *cost_l, int *cost_r, int window_size, int max_disp){
+template <typename CostT>
+int compute_lr_SAD_cost(cv::Mat img1, cv::Mat img2, CostT *cost_l, CostT *cost_r, int window_size, int max_disp){
     int *window_l1 = (int*)malloc(window_size*window_size*sizeof(int));
     if (!window_l1) {
         printf("Memory allocation failed for window_l1..! \n");
@@ -181,7 +195,8 @@ int compute_ZSAD(int *window1, int *window2, int window_size){
     return zsad;    
 }
 
-int compute_ZSAD_cost(cv::Mat img1, cv::Mat img2, int *cost, int window_size, int max_disp){
+template <typename CostT>
+int compute_ZSAD_cost(cv::Mat img1, cv::Mat img2, CostT *cost, int window_size, int max_disp){
     int *window1 = (int*)malloc(window_size*window_size*sizeof(int));
     if (!window1) {
         printf("Memory allocation failed for window1..! \n");
@@ -226,7 +241,8 @@ int compute_ZSAD_cost(cv::Mat img1, cv::Mat img2, int *cost, int window_size, in
     return 0;
 }
 
-int compute_lr_ZSAD_cost(cv::Mat img1, cv::Mat img2, int *cost_l, int *cost_r, int window_size, int max_disp){
+template <typename CostT>
+int compute_lr_ZSAD_cost(cv::Mat img1, cv::Mat img2, CostT *cost_l, CostT *cost_r, int window_size, int max_disp){
     int *window_l1 = (int*)malloc(window_size*window_size*sizeof(int));
     if (!window_l1) {
         printf("Memory allocation failed for window_l1..! \n");
@@ -293,6 +309,163 @@ int compute_lr_ZSAD_cost(cv::Mat img1, cv::Mat img2, int *cost_l, int *cost_r, i
     return 0;  
 }
 
+/*------------------------------SAD/ZSAD with integral images of differences------------------------------*/
+// Signed differences ref(i,j)-tgt(i,j+step*d) for columns j=-pad..cols+pad-1, stored at column j+pad.
+// Each image is zero outside of itself, the same padding as the window loops above: a window column beyond the
+// border of ref can still hit a pixel of the shifted tgt.
+void compute_diff_image(cv::Mat ref, cv::Mat tgt, int *diff, int d, int step, int pad){
+    int width = ref.cols+2*pad;
+    for(int i=0; i<ref.rows; i++){
+        for(int jj=0; jj<width; jj++){
+            int j = jj-pad;
+            int kj = j+step*d;
+            int ref_val = (j<0 || j>ref.cols-1) ? 0 : (int)ref.at<uchar>(i,j);
+            int tgt_val = (kj<0 || kj>ref.cols-1) ? 0 : (int)tgt.at<uchar>(i,kj);
+            diff[i*width+jj] = ref_val - tgt_val;
+        }
+    }
+}
+
+// integral[(i+1)*(cols+1)+(j+1)] is the sum of src over rows 0..i and columns 0..j. The sums are 64-bit: 255 per
+// pixel over a padded 4K frame already exceeds INT_MAX.
+void compute_integral_image(int *src, int64_t *integral, int rows, int cols){
+    for(int j=0; j<=cols; j++){
+        integral[j] = 0;
+    }
+    for(int i=0; i<rows; i++){
+        int64_t row_sum = 0;
+        integral[(i+1)*(cols+1)] = 0;
+        for(int j=0; j<cols; j++){
+            row_sum += src[i*cols+j];
+            integral[(i+1)*(cols+1)+j+1] = integral[i*(cols+1)+j+1] + row_sum;
+        }
+    }
+}
+
+// Sum over rows i0..i1 and columns j0..j1 (inclusive), small enough for an int once taken from the integral.
+inline int box_sum(int64_t *integral, int cols, int i0, int j0, int i1, int j1){
+    return (int)(integral[(i1+1)*(cols+1)+j1+1] - integral[i0*(cols+1)+j1+1] - integral[(i1+1)*(cols+1)+j0] + integral[i0*(cols+1)+j0]);
+}
+
+// SAD of ref against tgt shifted by step*d for every d, O(1) per (pixel, disparity) whatever the window size.
+// Window rows outside of the image are 0 on both sides and add nothing, so the box sum clipped to the image rows
+// equals compute_SAD.
+template <typename CostT>
+int box_SAD_cost(cv::Mat ref, cv::Mat tgt, CostT *cost, int window_size, int max_disp, int step, fp::StereoWorkspace *ws){
+    int rows = ref.rows;
+    int cols = ref.cols;
+    int pad = window_size/2;
+    int width = cols+2*pad;
+    // Integral image followed by the difference image
+    int64_t *integral = (int64_t*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_SCRATCH, (size_t)(rows+1)*(width+1)*sizeof(int64_t)+(size_t)rows*width*sizeof(int));
+    if (!integral) {
+        printf("Memory allocation failed for diff..! \n");
+        return -1;
+    }
+    int *diff = (int*)(integral+(size_t)(rows+1)*(width+1));
+    for (int d=0; d<max_disp; d++){
+        compute_diff_image(ref,tgt,diff,d,step,pad);
+        for(int k=0; k<rows*width; k++){
+            diff[k] = abs(diff[k]);
+        }
+        compute_integral_image(diff,integral,rows,width);
+        for(int i=0; i<rows; i++){
+            int i0 = std::max(i-window_size/2,0);
+            int i1 = std::min(i+window_size/2,rows-1);
+            for(int j=0; j<cols; j++){
+                cost[(i*cols+j)*max_disp+d] = box_sum(integral,width,i0,j,i1,j+2*pad);
+            }
+        }
+    }
+    fp::release_buffer(ws, integral);
+    return 0;
+}
+
+// ZSAD of ref against tgt shifted by step*d for every d.
+// With N=window_size^2 odd, the mean S/N is never halfway between two integers, so compute_ZSAD's float terms
+// round(|x-S/N|) equal the integer terms |x-R| with R the nearest integer to S/N. S comes from an integral image,
+// and window rows outside of the image (x=0) add |R| per element.
+// The sum of |x-R| itself stays O(window_size^2): R is a function of the window, and splitting the terms at R
+// would need the count and the sum of the values below R per window, i.e. an integral image per value of R.
+// Subtracting a per-pixel mean image first would make it a box sum, but then each pixel is centred on the
+// mean of its own window instead of the mean of the window of p, which is a different cost from compute_ZSAD.
+template <typename CostT>
+int box_ZSAD_cost(cv::Mat ref, cv::Mat tgt, CostT *cost, int window_size, int max_disp, int step, fp::StereoWorkspace *ws){
+    int rows = ref.rows;
+    int cols = ref.cols;
+    int pad = window_size/2;
+    int width = cols+2*pad;
+    int N = window_size*window_size;
+    // Integral image followed by the difference image
+    int64_t *integral = (int64_t*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_SCRATCH, (size_t)(rows+1)*(width+1)*sizeof(int64_t)+(size_t)rows*width*sizeof(int));
+    if (!integral) {
+        printf("Memory allocation failed for diff..! \n");
+        return -1;
+    }
+    int *diff = (int*)(integral+(size_t)(rows+1)*(width+1));
+    for (int d=0; d<max_disp; d++){
+        compute_diff_image(ref,tgt,diff,d,step,pad);
+        compute_integral_image(diff,integral,rows,width);
+        for(int i=0; i<rows; i++){
+            int i0 = std::max(i-window_size/2,0);
+            int i1 = std::min(i+window_size/2,rows-1);
+            for(int j=0; j<cols; j++){
+                int S = box_sum(integral,width,i0,j,i1,j+2*pad);
+                // Nearest integer to S/N, with floor division for negative S
+                int num = 2*S+N;
+                int R = (num>=0) ? num/(2*N) : -((-num+2*N-1)/(2*N));
+                int zsad = (N-(i1-i0+1)*window_size)*abs(R);
+                for(int ki=i0; ki<=i1; ki++){
+                    int *diff_row = diff+ki*width+j;
+                    for(int kj=0; kj<window_size; kj++){
+                        zsad += abs(diff_row[kj]-R);
+                    }
+                }
+                cost[(i*cols+j)*max_disp+d] = zsad;
+            }
+        }
+    }
+    fp::release_buffer(ws, integral);
+    return 0;
+}
+
+template <typename CostT>
+int compute_SAD_cost_box(cv::Mat img1, cv::Mat img2, CostT *cost, int window_size, int max_disp, fp::StereoWorkspace *ws){
+    return box_SAD_cost(img1,img2,cost,window_size,max_disp,-1,ws);
+}
+
+template <typename CostT>
+int compute_lr_SAD_cost_box(cv::Mat img1, cv::Mat img2, CostT *cost_l, CostT *cost_r, int window_size, int max_disp, fp::StereoWorkspace *ws){
+    int ret = box_SAD_cost(img1,img2,cost_l,window_size,max_disp,-1,ws);
+    if(ret!=0){
+        return ret;
+    }
+    return box_SAD_cost(img2,img1,cost_r,window_size,max_disp,1,ws);
+}
+
+// Even windows cover (window_size+1)^2 pixels but divide by window_size^2, they are rejected
+template <typename CostT>
+int compute_ZSAD_cost_box(cv::Mat img1, cv::Mat img2, CostT *cost, int window_size, int max_disp, fp::StereoWorkspace *ws){
+    if(window_size%2==0){
+        printf("ZSAD window size should be odd..! \n");
+        return -1;
+    }
+    return box_ZSAD_cost(img1,img2,cost,window_size,max_disp,-1,ws);
+}
+
+template <typename CostT>
+int compute_lr_ZSAD_cost_box(cv::Mat img1, cv::Mat img2, CostT *cost_l, CostT *cost_r, int window_size, int max_disp, fp::StereoWorkspace *ws){
+    if(window_size%2==0){
+        printf("ZSAD window size should be odd..! \n");
+        return -1;
+    }
+    int ret = box_ZSAD_cost(img1,img2,cost_l,window_size,max_disp,-1,ws);
+    if(ret!=0){
+        return ret;
+    }
+    return box_ZSAD_cost(img2,img1,cost_r,window_size,max_disp,1,ws);
+}
+
 /*-------------------------------------------Rank Transform-----------------------------------------*/
 void compute_rank_transform(cv::Mat img, int *rank, int window_size){
     for(int i=0; i<img.rows; i++){
@@ -319,7 +492,8 @@ void compute_rank_transform(cv::Mat img, int *rank, int window_size){
     }
 }
 
-void compute_rank_cost(int *rank1, int *rank2, int *cost, int rows, int cols, int max_disp){
+template <typename CostT>
+void compute_rank_cost(int *rank1, int *rank2, CostT *cost, int rows, int cols, int max_disp){
     for(int i=0; i<rows; i++){
         for(int j=0; j<cols; j++){
             for (int d=0; d<max_disp; d++){
@@ -336,7 +510,8 @@ void compute_rank_cost(int *rank1, int *rank2, int *cost, int rows, int cols, in
     }
 }
 
-void compute_lr_rank_cost(int *rank1, int *rank2, int *cost_l, int *cost_r, int rows, int cols, int max_disp){
+template <typename CostT>
+void compute_lr_rank_cost(int *rank1, int *rank2, CostT *cost_l, CostT *cost_r, int rows, int cols, int max_disp){
     for(int i=0; i<rows; i++){
         for(int j=0; j<cols; j++){
             for (int d=0; d<max_disp; d++){
@@ -389,17 +564,13 @@ void compute_census_transform(cv::Mat img, __int128_t *census, int window_size){
 }
 
 int compute_hamming_distance (__int128_t a, __int128_t b) {
-	__int128_t tmp = a ^ b;
-	int sum = 0;
-	while (tmp>0) {
-		short int c = tmp & 0x1;
-		sum += c;
-		tmp >>= 1;
-	}
-	return sum;
+	// count on the unsigned value: a set top bit must not end the count
+	unsigned __int128 tmp = (unsigned __int128)(a ^ b);
+	return __builtin_popcountll((uint64_t)tmp) + __builtin_popcountll((uint64_t)(tmp>>64));
 } // end compute_hamming_distance()
 
-void compute_census_cost(__int128_t *census1, __int128_t *census2, int *cost, int rows, int cols, int max_disp){
+template <typename CostT>
+void compute_census_cost(__int128_t *census1, __int128_t *census2, CostT *cost, int rows, int cols, int max_disp){
     for(int i=0; i<rows; i++){
         for(int j=0; j<cols; j++){
             for (int d=0; d<max_disp; d++){
@@ -416,7 +587,8 @@ void compute_census_cost(__int128_t *census1, __int128_t *census2, int *cost, in
     }
 }
 
-void compute_lr_census_cost(__int128_t *census1, __int128_t *census2, int *cost_l, int *cost_r, int rows, int cols, int max_disp){
+template <typename CostT>
+void compute_lr_census_cost(__int128_t *census1, __int128_t *census2, CostT *cost_l, CostT *cost_r, int rows, int cols, int max_disp){
     for(int i=0; i<rows; i++){
         for(int j=0; j<cols; j++){
             for (int d=0; d<max_disp; d++){
@@ -441,40 +613,133 @@ void compute_lr_census_cost(__int128_t *census1, __int128_t *census2, int *cost_
     }
 }
 
+/*------Census with packed descriptors and hardware popcount------*/
+// Packs the left and right census descriptors into lo/hi words (rows*cols each)
+int compute_packed_census(cv::Mat img1, cv::Mat img2, uint64_t *lo1, uint64_t *hi1, uint64_t *lo2, uint64_t *hi2, int window_size){
+    if(census_transform_packed(img1.ptr<unsigned char>(0), (int)img1.step, img1.rows, img1.cols, window_size, lo1, hi1) != 0){
+        printf("Memory allocation failed for census padding..! \n");
+        return -1;
+    }
+    if(census_transform_packed(img2.ptr<unsigned char>(0), (int)img2.step, img2.rows, img2.cols, window_size, lo2, hi2) != 0){
+        printf("Memory allocation failed for census padding..! \n");
+        return -1;
+    }
+    return 0;
+}
+
+// Target row laid out so that the max_disp candidates of each pixel are contiguous:
+// forward (row[j+d], right view) or reversed (row[j-d] at index cols-1-j+d, left view),
+// followed by max_disp zero descriptors standing for the out-of-image matches.
+void packed_census_row(uint64_t *lo, uint64_t *hi, uint64_t *row_lo, uint64_t *row_hi, int cols, int max_disp, bool reverse){
+    for(int k=0; k<cols; k++){
+        int j = reverse ? cols-1-k : k;
+        row_lo[k] = lo[j];
+        row_hi[k] = hi[j];
+    }
+    memset(row_lo+cols, 0, max_disp*sizeof(uint64_t));
+    memset(row_hi+cols, 0, max_disp*sizeof(uint64_t));
+}
+
+// Copy n costs computed as int into the cost volume storage
+template <typename CostT>
+inline void store_costs(CostT *dst, int *src, int n){
+    for(int d=0; d<n; d++){
+        dst[d] = (CostT)src[d];
+    }
+}
+
+// Same costs as compute_census_cost for window_size <= CENSUS_PACKED_MAX_WINDOW
+template <typename CostT>
+int compute_census_cost_packed(cv::Mat img1, cv::Mat img2, CostT *cost, int window_size, int max_disp, fp::StereoWorkspace *ws){
+    int rows = img1.rows;
+    int cols = img1.cols;
+    // Descriptors of both images, the target rows, then the costs of one pixel
+    int num_desc = 4*rows*cols+2*(cols+max_disp);
+    uint64_t *desc = (uint64_t*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_SCRATCH, num_desc*sizeof(uint64_t)+max_disp*sizeof(int));
+    if (!desc) {
+        printf("Memory allocation failed for desc..! \n");
+        return -1;
+    }
+    int *dist = (int*)(desc+num_desc);
+    uint64_t *lo1 = desc, *hi1 = lo1+rows*cols;
+    uint64_t *lo2 = hi1+rows*cols, *hi2 = lo2+rows*cols;
+    uint64_t *row_lo = hi2+rows*cols, *row_hi = row_lo+cols+max_disp;
+    if(compute_packed_census(img1, img2, lo1, hi1, lo2, hi2, window_size) != 0){
+        fp::release_buffer(ws, desc);
+        return -1;
+    }
+    hamming_costs_t hamming_costs = select_hamming_costs();
+    for(int i=0; i<rows; i++){
+        packed_census_row(lo2+i*cols, hi2+i*cols, row_lo, row_hi, cols, max_disp, true);
+        for(int j=0; j<cols; j++){
+            hamming_costs(lo1[i*cols+j], hi1[i*cols+j], row_lo+cols-1-j, row_hi+cols-1-j, dist, max_disp);
+            store_costs(cost+(i*cols+j)*max_disp, dist, max_disp);
+        }
+    }
+    fp::release_buffer(ws, desc);
+    return 0;
+}
+
+template <typename CostT>
+int compute_lr_census_cost_packed(cv::Mat img1, cv::Mat img2, CostT *cost_l, CostT *cost_r, int window_size, int max_disp, fp::StereoWorkspace *ws){
+    int rows = img1.rows;
+    int cols = img1.cols;
+    // Descriptors of both images, the target rows, then the costs of one pixel
+    int num_desc = 4*rows*cols+4*(cols+max_disp);
+    uint64_t *desc = (uint64_t*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_SCRATCH, num_desc*sizeof(uint64_t)+max_disp*sizeof(int));
+    if (!desc) {
+        printf("Memory allocation failed for desc..! \n");
+        return -1;
+    }
+    int *dist = (int*)(desc+num_desc);
+    uint64_t *lo1 = desc, *hi1 = lo1+rows*cols;
+    uint64_t *lo2 = hi1+rows*cols, *hi2 = lo2+rows*cols;
+    uint64_t *rev_lo = hi2+rows*cols, *rev_hi = rev_lo+cols+max_disp;
+    uint64_t *fwd_lo = rev_hi+cols+max_disp, *fwd_hi = fwd_lo+cols+max_disp;
+    if(compute_packed_census(img1, img2, lo1, hi1, lo2, hi2, window_size) != 0){
+        fp::release_buffer(ws, desc);
+        return -1;
+    }
+    hamming_costs_t hamming_costs = select_hamming_costs();
+    for(int i=0; i<rows; i++){
+        packed_census_row(lo2+i*cols, hi2+i*cols, rev_lo, rev_hi, cols, max_disp, true);
+        packed_census_row(lo1+i*cols, hi1+i*cols, fwd_lo, fwd_hi, cols, max_disp, false);
+        for(int j=0; j<cols; j++){
+            hamming_costs(lo1[i*cols+j], hi1[i*cols+j], rev_lo+cols-1-j, rev_hi+cols-1-j, dist, max_disp);
+            store_costs(cost_l+(i*cols+j)*max_disp, dist, max_disp);
+            hamming_costs(lo2[i*cols+j], hi2[i*cols+j], fwd_lo+j, fwd_hi+j, dist, max_disp);
+            store_costs(cost_r+(i*cols+j)*max_disp, dist, max_disp);
+        }
+    }
+    fp::release_buffer(ws, desc);
+    return 0;
+}
+
 /*-------------------------------------------SHD: sum of Hamming Distance-----------------------------------------*/
 int compute_SHD(long int *window1, long int *window2, int window_size){
     int sad = 0;    
     for(int i=0; i<window_size; i++){
         for(int j=0; j<window_size; j++){
-            sad += compute_hamming_distance(window1[i*window_size+j],window2[i*window_size+j]);
+            sad += compute_hamming_distance((uint64_t)window1[i*window_size+j],(uint64_t)window2[i*window_size+j]);
         }
     }
     return sad;
 }
 
-int compute_SHD_cost(cv::Mat img1, cv::Mat img2, int *cost, int window_size, int shd_window, int max_disp){
-    __int128_t *ct1 = (__int128_t*)malloc(img1.rows*img1.cols*sizeof(__int128_t));
+template <typename CostT>
+int compute_SHD_cost(cv::Mat img1, cv::Mat img2, CostT *cost, int window_size, int shd_window, int max_disp, fp::StereoWorkspace *ws){
+    // Census transforms of both images followed by the two SHD windows
+    int shd_size = shd_window*shd_window;
+    __int128_t *ct1 = (__int128_t*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_SCRATCH, 2*img1.rows*img1.cols*sizeof(__int128_t)+2*shd_size*sizeof(long int));
     if (!ct1) {
         printf("Memory allocation failed for ct1..! \n");
         return -1;
     }
-    __int128_t *ct2 = (__int128_t*)malloc(img1.rows*img1.cols*sizeof(__int128_t));
-    if (!ct2) {
-        printf("Memory allocation failed for ct2..! \n");
-        return -1;
-    }
+    __int128_t *ct2 = ct1+img1.rows*img1.cols;
     compute_census_transform(img1, ct1, window_size);
     compute_census_transform(img2, ct2, window_size);
-    long int *window1 = (long int*)malloc(shd_window*shd_window*sizeof(long int));
-    if (!window1) {
-        printf("Memory allocation failed for window1..! \n");
-        return -1;
-    }
-    long int *window2 = (long int*)malloc(shd_window*shd_window*sizeof(long int));
-    if (!window2) {
-        printf("Memory allocation failed for window2..! \n");
-        return -1;
-    }     
+    long int *window1 = (long int*)(ct2+img1.rows*img1.cols);
+    long int *window2 = window1+shd_size;
     for(int i=0; i<img1.rows; i++){
         for(int j=0; j<img1.cols; j++){
             for (int d=0; d<max_disp; d++){
@@ -503,46 +768,26 @@ int compute_SHD_cost(cv::Mat img1, cv::Mat img2, int *cost, int window_size, int
             }
         }
     }     
-    free(ct1);
-    free(ct2);
-    free(window1);
-    free(window2);
+    fp::release_buffer(ws, ct1);
     return 0;
 }
 
-int compute_lr_SHD_cost(cv::Mat img1, cv::Mat img2, int *cost_l, int *cost_r, int window_size, int shd_window, int max_disp){
-    __int128_t *ct1 = (__int128_t*)malloc(img1.rows*img1.cols*sizeof(__int128_t));
+template <typename CostT>
+int compute_lr_SHD_cost(cv::Mat img1, cv::Mat img2, CostT *cost_l, CostT *cost_r, int window_size, int shd_window, int max_disp, fp::StereoWorkspace *ws){
+    // Census transforms of both images followed by the four SHD windows
+    int shd_size = shd_window*shd_window;
+    __int128_t *ct1 = (__int128_t*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_SCRATCH, 2*img1.rows*img1.cols*sizeof(__int128_t)+4*shd_size*sizeof(long int));
     if (!ct1) {
         printf("Memory allocation failed for ct1..! \n");
         return -1;
     }
-    __int128_t *ct2 = (__int128_t*)malloc(img1.rows*img1.cols*sizeof(__int128_t));
-    if (!ct2) {
-        printf("Memory allocation failed for ct2..! \n");
-        return -1;
-    }
+    __int128_t *ct2 = ct1+img1.rows*img1.cols;
     compute_census_transform(img1, ct1, window_size);
-    compute_census_transform(img2, ct2, window_size);    
-    long int *window_l1 = (long int*)malloc(shd_window*shd_window*sizeof(long int));
-    if (!window_l1) {
-        printf("Memory allocation failed for window_l1..! \n");
-        return -1;
-    }
-    long int *window_l2 = (long int*)malloc(shd_window*shd_window*sizeof(long int));
-    if (!window_l2) {
-        printf("Memory allocation failed for window_l2..! \n");
-        return -1;
-    }
-    long int *window_r1 = (long int*)malloc(shd_window*shd_window*sizeof(long int));
-    if (!window_r1) {
-        printf("Memory allocation failed for window_r1..! \n");
-        return -1;
-    }
-    long int *window_r2 = (long int*)malloc(shd_window*shd_window*sizeof(long int));
-    if (!window_r2) {
-        printf("Memory allocation failed for window_r2..! \n");
-        return -1;
-    }             
+    compute_census_transform(img2, ct2, window_size);
+    long int *window_l1 = (long int*)(ct2+img1.rows*img1.cols);
+    long int *window_l2 = window_l1+shd_size;
+    long int *window_r1 = window_l2+shd_size;
+    long int *window_r2 = window_r1+shd_size;
     for(int i=0; i<img1.rows; i++){
         for(int j=0; j<img1.cols; j++){
             for (int d=0; d<max_disp; d++){
@@ -582,113 +827,100 @@ int compute_lr_SHD_cost(cv::Mat img1, cv::Mat img2, int *cost_l, int *cost_r, in
             }
         }
     }
-    free(ct1);
-    free(ct2);    
-    free(window_l1);
-    free(window_l2); 
-    free(window_r1);
-    free(window_r2); 
-    return 0;   
+    fp::release_buffer(ws, ct1);
+    return 0;
 }
 
 /*-------------------------------------------Compute Initial Costs-----------------------------------------*/
-int compute_initial_cost(cv::Mat img1, cv::Mat img2, int *cost, int function_type, int window_size, int shd_window, int max_disp){
-    if(function_type==0){
-        __int128_t *ct1 = (__int128_t*)malloc(img1.rows*img1.cols*sizeof(__int128_t));
+template <typename CostT>
+int compute_initial_cost(cv::Mat img1, cv::Mat img2, CostT *cost, int function_type, int window_size, int shd_window, int max_disp, fp::StereoWorkspace *ws){
+    fp::ScopedStage stage(fp::StageTimer::COST);
+    if(function_type==0 && window_size<=CENSUS_PACKED_MAX_WINDOW){
+        int census = compute_census_cost_packed(img1,img2,cost,window_size,max_disp,ws);
+        return census;
+    }
+    else if(function_type==0){
+        __int128_t *ct1 = (__int128_t*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_SCRATCH, 2*img1.rows*img1.cols*sizeof(__int128_t));
         if (!ct1) {
             printf("Memory allocation failed for ct1..! \n");
             return -1;
         }
-        __int128_t *ct2 = (__int128_t*)malloc(img1.rows*img1.cols*sizeof(__int128_t));
-        if (!ct2) {
-            printf("Memory allocation failed for ct2..! \n");
-            return -1;
-        }
+        __int128_t *ct2 = ct1+img1.rows*img1.cols;
         // Compute census transform
         compute_census_transform(img1, ct1, window_size);
         compute_census_transform(img2, ct2, window_size);
         compute_census_cost(ct1,ct2,cost,img1.rows,img1.cols,max_disp);
-        free(ct1);
-	    free(ct2);
+        fp::release_buffer(ws, ct1);
     }
     else if(function_type==1){
-        int *rt1 = (int*)malloc(img1.rows*img1.cols*sizeof(int));
+        int *rt1 = (int*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_SCRATCH, 2*img1.rows*img1.cols*sizeof(int));
         if (!rt1) {
             printf("Memory allocation failed for rt1..! \n");
             return -1;
         }
-        int *rt2 = (int*)malloc(img1.rows*img1.cols*sizeof(int));
-        if (!rt2) {
-            printf("Memory allocation failed for rt2..! \n");
-            return -1;
-        }
+        int *rt2 = rt1+img1.rows*img1.cols;
         compute_rank_transform(img1,rt1,window_size);
         compute_rank_transform(img2,rt2,window_size);
         compute_rank_cost(rt1,rt2,cost,img1.rows,img1.cols,max_disp);
-        free(rt1);
-        free(rt2);
+        fp::release_buffer(ws, rt1);
     }
     else if(function_type == 2){
-        int sad = compute_SAD_cost(img1,img2,cost,window_size,max_disp);
+        int sad = compute_SAD_cost_box(img1,img2,cost,window_size,max_disp,ws);
         return sad;
     }
     else if(function_type == 3){
-        int zsad = compute_ZSAD_cost(img1,img2,cost,window_size,max_disp);
+        int zsad = compute_ZSAD_cost_box(img1,img2,cost,window_size,max_disp,ws);
         return zsad;
     }
     else if(function_type == 4){
-        int shd = compute_SHD_cost(img1,img2,cost,window_size,shd_window,max_disp);
+        int shd = compute_SHD_cost(img1,img2,cost,window_size,shd_window,max_disp,ws);
         return shd;
     }
     return 0;
 }
 
-int compute_lr_initial_cost(cv::Mat img1, cv::Mat img2, int *cost_l, int *cost_r, int function_type, int window_size, int shd_window, int max_disp){
-    if(function_type==0){
-        __int128_t *ct1 = (__int128_t*)malloc(img1.rows*img1.cols*sizeof(__int128_t));
+template <typename CostT>
+int compute_lr_initial_cost(cv::Mat img1, cv::Mat img2, CostT *cost_l, CostT *cost_r, int function_type, int window_size, int shd_window, int max_disp, fp::StereoWorkspace *ws){
+    fp::ScopedStage stage(fp::StageTimer::COST);
+    if(function_type==0 && window_size<=CENSUS_PACKED_MAX_WINDOW){
+        int census = compute_lr_census_cost_packed(img1,img2,cost_l,cost_r,window_size,max_disp,ws);
+        return census;
+    }
+    else if(function_type==0){
+        __int128_t *ct1 = (__int128_t*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_SCRATCH, 2*img1.rows*img1.cols*sizeof(__int128_t));
         if (!ct1) {
             printf("Memory allocation failed for ct1..! \n");
             return -1;
         }
-        __int128_t *ct2 = (__int128_t*)malloc(img1.rows*img1.cols*sizeof(__int128_t));
-        if (!ct2) {
-            printf("Memory allocation failed for ct2..! \n");
-            return -1;
-        }
+        __int128_t *ct2 = ct1+img1.rows*img1.cols;
         // Compute census transform
         compute_census_transform(img1, ct1, window_size);
         compute_census_transform(img2, ct2, window_size);
         compute_lr_census_cost(ct1,ct2,cost_l,cost_r,img1.rows,img1.cols,max_disp);
-        free(ct1);
-	    free(ct2);
+        fp::release_buffer(ws, ct1);
     }
     else if(function_type==1){
-        int *rt1 = (int*)malloc(img1.rows*img1.cols*sizeof(int));
+        int *rt1 = (int*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_SCRATCH, 2*img1.rows*img1.cols*sizeof(int));
         if (!rt1) {
             printf("Memory allocation failed for rt1..! \n");
             return -1;
         }
-        int *rt2 = (int*)malloc(img1.rows*img1.cols*sizeof(int));
-        if (!rt2) {
-            printf("Memory allocation failed for rt2..! \n");
-            return -1;
-        }
+        int *rt2 = rt1+img1.rows*img1.cols;
         compute_rank_transform(img1,rt1,window_size);
         compute_rank_transform(img2,rt2,window_size);
         compute_lr_rank_cost(rt1,rt2,cost_l,cost_r,img1.rows,img1.cols,max_disp);
-        free(rt1);
-        free(rt2);
+        fp::release_buffer(ws, rt1);
     }
     else if(function_type == 2){
-        int sad = compute_lr_SAD_cost(img1,img2,cost_l,cost_r,window_size,max_disp);
+        int sad = compute_lr_SAD_cost_box(img1,img2,cost_l,cost_r,window_size,max_disp,ws);
         return sad;
     }
     else if(function_type == 3){
-        int zsad = compute_lr_ZSAD_cost(img1,img2,cost_l,cost_r,window_size,max_disp);
+        int zsad = compute_lr_ZSAD_cost_box(img1,img2,cost_l,cost_r,window_size,max_disp,ws);
         return zsad;
     }
     else if(function_type == 4){
-        int shd = compute_lr_SHD_cost(img1,img2,cost_l,cost_r,window_size,shd_window,max_disp);
+        int shd = compute_lr_SHD_cost(img1,img2,cost_l,cost_r,window_size,shd_window,max_disp,ws);
         return shd;
     }
     return 0;
@@ -704,21 +936,6 @@ void init_Lr(int *Lr, int *cost, int sizeOfCpd, int dir) {
 	}
 } // end init_Lr()
 
-int find_minLri(int *Lrpr, int d, int ndisparity) {
-	int minLri = INT_MAX;
-	for (int i=0; i<d-1; i++) {
-		if (minLri > Lrpr[i]) {
-			minLri = Lrpr[i];
-		}
-	}
-	for (int i=d+2; i<ndisparity; i++) {
-		if (minLri > Lrpr[i]) {
-			minLri = Lrpr[i];
-		}
-	}
-	return minLri;
-} // end find_minLri()
-
 int find_min(int a, int b, int c, int d) {
 
 	int minimum = a;
@@ -731,34 +948,71 @@ int find_min(int a, int b, int c, int d) {
 	return minimum;
 } // end find_min()
 
+// Update L(r,p,:) of one pixel from L(r,p-r,:) of its predecessor on the path.
+// min_i{Lr(p-r,i)} is found once per pixel and reused for all d, so the update is O(D) instead of O(D^2).
+void path_update(int *Lrp, int *Lrpr, int *Cp, int ndisparity, int P1, int P2) {
+	int minLri = Lrpr[0];
+	for (int i=1; i<ndisparity; i++) {
+		if (minLri > Lrpr[i])
+			minLri = Lrpr[i];
+	}
+	for (int d=0; d<ndisparity; d++) {
+		int Lrpdm1, Lrpdp1;
+		if (d==0)
+			Lrpdm1 = INT_MAX-P1;
+		else
+			Lrpdm1 = Lrpr[d-1];
+		if (d==ndisparity-1)
+			Lrpdp1 = INT_MAX-P1;
+		else
+			Lrpdp1 = Lrpr[d+1];
+
+		int v1 = find_min(Lrpr[d], Lrpdm1+P1, Lrpdp1+P1, minLri+P2);
+
+		Lrp[d] = Cp[d] + v1 - minLri;
+	}
+} // end path_update()
+
+// First pixel of a path: L(r,p,d) = C(p,d).
+void path_init(int *Lrp, int *Cp, int ndisparity) {
+	for (int d=0; d<ndisparity; d++) {
+		Lrp[d] = Cp[d];
+	}
+} // end path_init()
+
+// Offset from p to its predecessor p-r on path r.
+void path_direction(int r, int *iDisp, int *jDisp) {
+	if (r==0) {
+		*iDisp = 0; *jDisp = -1;
+	}
+	else if (r==1) {
+		*iDisp = -1; *jDisp = -1;
+	}
+	else if (r==2) {
+		*iDisp = -1; *jDisp = 0;
+	}
+	else if (r==3) {
+		*iDisp = -1; *jDisp = 1;
+	}
+	else if (r==4) {
+		*iDisp = 0; *jDisp = 1;
+	}
+	else if (r==5) {
+		*iDisp = 1; *jDisp = 1;
+	}
+	else if (r==6) {
+		*iDisp = 1; *jDisp = 0;
+	}
+	else if (r==7) {
+		*iDisp = 1; *jDisp = -1;
+	}
+} // end path_direction()
+
 void cost_computation(int *Lr, int *cost, int rows, int cols, int numDir, int ndisparity, int P1, int P2) {
 	// Computing cost. (i,j-1) (i-1,j-1) (i-1,j) (i-1,j+1) (i,j+1) (i+1,j+1) (i+1,j) (i+1,j-1)
 	int iDisp = 0, jDisp = 0;
 	for (int r=0; r<numDir; r++) {
-		if (r==0) {
-			iDisp = 0; jDisp = -1;
-		}
-		else if (r==1) {
-			iDisp = -1; jDisp = -1;
-		}
-		else if (r==2) {
-			iDisp = -1; jDisp = 0;
-		}
-		else if (r==3) {
-			iDisp = -1; jDisp = 1;
-		}
-		else if (r==4) {
-			iDisp = 0; jDisp = 1;
-		}
-        else if (r==5) {
-            iDisp = 1; jDisp = 1;
-        }
-        else if (r==6) {
-            iDisp = 1; jDisp = 0;            
-        }
-        else if (r==7) {
-            iDisp = 1; jDisp = -1;            
-        }       
+		path_direction(r, &iDisp, &jDisp);
 
 		// Changed the indices of the loop below to accommodate for number of directions = 8.
 		if(r<4){
@@ -768,34 +1022,13 @@ void cost_computation(int *Lr, int *cost, int rows, int cols, int numDir, int nd
                     int iNorm = i + iDisp;
                     int jNorm = j + jDisp;
 
-                    int *Lrpr = Lr+((r*rows+iNorm)*cols+jNorm)*ndisparity;
-
-                    for (int d=0; d<ndisparity; d++) {
-                        int Cpd = cost[(i*cols+j)*ndisparity+d];
-
-                        int tmp;
-                        if ( (((r==0)||(r==1))&&(j==0)) || (((r==1)||(r==2)||(r==3))&&(i==0)) || ((r==3)&&(j==cols-1)) )
-                            tmp = Cpd;
-                        else {
-                            // Find min_i{Lr(p-r,i)}
-                            int minLri = find_minLri(Lrpr, d, ndisparity);
-                            int Lrpdm1, Lrpdp1;
-                            if (d==0)
-                                Lrpdm1 = INT_MAX-P1;
-                            else
-                                Lrpdm1 = Lrpr[d-1];
-                            if (d==ndisparity-1)
-                                Lrpdp1 = INT_MAX-P1;
-                            else
-                                Lrpdp1 = Lrpr[d+1];
-
-                            int v2 = std::min(std::min(std::min(minLri,Lrpdp1),Lrpdm1),Lrpr[d]);
-                            int v1 = find_min(Lrpr[d], Lrpdm1+P1, Lrpdp1+P1, v2+P2);
-
-                            tmp = Cpd + v1 - v2;
-                        }
-                        Lr[((r*rows+i)*cols+j)*ndisparity+d] = tmp;
-                    }
+                    int *Lrp = Lr+((r*rows+i)*cols+j)*ndisparity;
+                    int *Cp = cost+(i*cols+j)*ndisparity;
+
+                    if ( (((r==0)||(r==1))&&(j==0)) || (((r==1)||(r==2)||(r==3))&&(i==0)) || ((r==3)&&(j==cols-1)) )
+                        path_init(Lrp, Cp, ndisparity);
+                    else
+                        path_update(Lrp, Lr+((r*rows+iNorm)*cols+jNorm)*ndisparity, Cp, ndisparity, P1, P2);
                 }
             }
         }
@@ -806,34 +1039,13 @@ void cost_computation(int *Lr, int *cost, int rows, int cols, int numDir, int nd
                     int iNorm = i + iDisp;
                     int jNorm = j + jDisp;
 
-                    int *Lrpr = Lr+((r*rows+iNorm)*cols+jNorm)*ndisparity;
-
-                    for (int d=0; d<ndisparity; d++) {
-                        int Cpd = cost[(i*cols+j)*ndisparity+d];
-
-                        int tmp;
-                        if ( ((r==7)&&(j==0)) || (((r==4)||(r==5))&&(j==cols-1)) || (((r==5)||(r==6)||(r==7))&&(i==rows-1)) )
-                            tmp = Cpd;
-                        else {
-                            // Find min_i{Lr(p-r,i)}
-                            int minLri = find_minLri(Lrpr, d, ndisparity);
-                            int Lrpdm1, Lrpdp1;
-                            if (d==0)
-                                Lrpdm1 = INT_MAX-P1;
-                            else
-                                Lrpdm1 = Lrpr[d-1];
-                            if (d==ndisparity-1)
-                                Lrpdp1 = INT_MAX-P1;
-                            else
-                                Lrpdp1 = Lrpr[d+1];
-
-                            int v2 = std::min(std::min(std::min(minLri,Lrpdp1),Lrpdm1),Lrpr[d]);
-                            int v1 = find_min(Lrpr[d], Lrpdm1+P1, Lrpdp1+P1, v2+P2);
-
-                            tmp = Cpd + v1 - v2;
-                        }
-                        Lr[((r*rows+i)*cols+j)*ndisparity+d] = tmp;
-                    }
+                    int *Lrp = Lr+((r*rows+i)*cols+j)*ndisparity;
+                    int *Cp = cost+(i*cols+j)*ndisparity;
+
+                    if ( ((r==7)&&(j==0)) || (((r==4)||(r==5))&&(j==cols-1)) || (((r==5)||(r==6)||(r==7))&&(i==rows-1)) )
+                        path_init(Lrp, Cp, ndisparity);
+                    else
+                        path_update(Lrp, Lr+((r*rows+iNorm)*cols+jNorm)*ndisparity, Cp, ndisparity, P1, P2);
                 }
             }
         }
@@ -854,13 +1066,267 @@ void cost_aggregation(int *aggregatedCost, int *Lr, int rows, int cols, int ndir
 	}
 }// end cost_aggregation()
 
+// Streaming aggregation without the dir x rows x cols x ndisparity Lr volume.
+// Like fpAggregateCost4Path, each path only keeps L(r,p,:) of the previous row (the previous pixel for
+// horizontal paths), and its result is added straight into aggregatedCost.
+template <typename CostT, typename AggrT>
+int cost_aggregation_streaming(AggrT *aggregatedCost, CostT *cost, int rows, int cols, int numDir, int ndisparity, int P1, int P2, fp::StereoWorkspace *ws) {
+	int rowSize = cols*ndisparity;
+	// Two rows of L(r,p,:) and the costs of the current pixel widened to int
+	int *Lr_rows = (int*)fp::workspace_buffer(ws, fp::StereoWorkspace::AGGR_SCRATCH, (2*rowSize+ndisparity)*sizeof(int));
+	if (!Lr_rows) {
+		printf("Memory allocation failed for Lr_rows..! \n");
+		return -1;
+	}
+	int *Cp = Lr_rows+2*rowSize;
+	memset(aggregatedCost, 0, rows*rowSize*sizeof(AggrT));
+
+	int iDisp = 0, jDisp = 0;
+	for (int r=0; r<numDir; r++) {
+		fp::ScopedStage stage(fp::StageTimer::AGGR_PATH0+r);
+		path_direction(r, &iDisp, &jDisp);
+		int *Lr_prev = Lr_rows;
+		int *Lr_cur = Lr_rows+rowSize;
+		// r<4 scans in raster order, r>=4 in reverse raster order.
+		for (int n=0; n<rows; n++) {
+			int i = (r<4) ? n : rows-1-n;
+			for (int m=0; m<cols; m++) {
+				int j = (r<4) ? m : cols-1-m;
+				// Compute p-r
+				int iNorm = i + iDisp;
+				int jNorm = j + jDisp;
+
+				int *Lrp = Lr_cur+j*ndisparity;
+				for (int d=0; d<ndisparity; d++) {
+					Cp[d] = cost[(i*cols+j)*ndisparity+d];
+				}
+
+				if (iNorm<0 || iNorm>rows-1 || jNorm<0 || jNorm>cols-1)
+					path_init(Lrp, Cp, ndisparity);
+				else
+					path_update(Lrp, ((iDisp==0) ? Lr_cur : Lr_prev)+jNorm*ndisparity, Cp, ndisparity, P1, P2);
+
+				AggrT *aggrp = aggregatedCost+(i*cols+j)*ndisparity;
+				for (int d=0; d<ndisparity; d++) {
+					aggrp[d] += Lrp[d];
+				}
+			}
+			int *tmp = Lr_prev;
+			Lr_prev = Lr_cur;
+			Lr_cur = tmp;
+		}
+	}
+	fp::release_buffer(ws, Lr_rows);
+	return 0;
+} // end cost_aggregation_streaming()
+
+// Copy row i of the cost volume into the padded 16-bit layout of fp_sgbm_simd.hpp.
+template <typename CostT>
+void cost_row_u16(uint16_t *C_row, CostT *cost, int i, int cols, int ndisparity, int stride) {
+	for (int j=0; j<cols; j++) {
+		for (int d=0; d<ndisparity; d++) {
+			C_row[j*stride+1+d] = (uint16_t)cost[(i*cols+j)*ndisparity+d];
+		}
+	}
+} // end cost_row_u16()
+
+// Scan positions m0..m1-1 of image row i along path r in the 16-bit layout.
+// Lr_prev holds row i-iDisp of the same path, Lr_cur receives row i.
+void path_row_u16(path_update_u16_t path_update_u16, uint16_t *Lr_cur, uint16_t *Lr_prev, uint16_t *C_row,
+		int r, int i, int m0, int m1, int rows, int cols, int stride, int P1, int P2) {
+	int iDisp = 0, jDisp = 0;
+	path_direction(r, &iDisp, &jDisp);
+	int ndisparity_pad = stride-2;
+	for (int m=m0; m<m1; m++) {
+		int j = (r<4) ? m : cols-1-m;
+		// Compute p-r
+		int iNorm = i + iDisp;
+		int jNorm = j + jDisp;
+
+		uint16_t *Lrp = Lr_cur+j*stride+1;
+		uint16_t *Cp = C_row+j*stride+1;
+
+		if (iNorm<0 || iNorm>rows-1 || jNorm<0 || jNorm>cols-1)
+			memcpy(Lrp, Cp, ndisparity_pad*sizeof(uint16_t));
+		else
+			path_update_u16(Lrp, ((iDisp==0) ? Lr_cur : Lr_prev)+jNorm*stride+1, Cp, ndisparity_pad, P1, P2);
+	}
+} // end path_row_u16()
+
+// cost_aggregation_streaming with L(r,p,:) kept in 16-bit saturated lanes and updated SIMD_DISPARITIES at a time
+// by the kernel select_path_update_u16() picks for this CPU (AVX2, NEON or scalar).
+// costMax bounds the initial costs (max_initial_cost() of the cost function). Costs that could saturate
+// (costMax+P2 >= SIMD_COST_MAX) go through the 32-bit engine, so the output never changes.
+template <typename CostT, typename AggrT>
+int cost_aggregation_simd(AggrT *aggregatedCost, CostT *cost, int rows, int cols, int numDir, int ndisparity, int P1, int P2, long costMax, fp::StereoWorkspace *ws) {
+	if (costMax+P2 >= SIMD_COST_MAX)
+		return cost_aggregation_streaming(aggregatedCost, cost, rows, cols, numDir, ndisparity, P1, P2, ws);
+
+	path_update_u16_t path_update_u16 = select_path_update_u16();
+	int stride = simd_pixel_stride(ndisparity);
+	int rowSize = cols*stride;
+	// One row of 16-bit costs followed by two rows of L(r,p,:)
+	uint16_t *buf = (uint16_t*)fp::workspace_buffer(ws, fp::StereoWorkspace::AGGR_SCRATCH, 3*rowSize*sizeof(uint16_t));
+	if (!buf) {
+		printf("Memory allocation failed for buf..! \n");
+		return -1;
+	}
+	for (int k=0; k<3*rowSize; k++) {
+		buf[k] = SIMD_COST_MAX;
+	}
+	uint16_t *C_row = buf;
+	memset(aggregatedCost, 0, rows*cols*ndisparity*sizeof(AggrT));
+
+	for (int r=0; r<numDir; r++) {
+		fp::ScopedStage stage(fp::StageTimer::AGGR_PATH0+r);
+		uint16_t *Lr_prev = buf+rowSize;
+		uint16_t *Lr_cur = buf+2*rowSize;
+		// r<4 scans in raster order, r>=4 in reverse raster order.
+		for (int n=0; n<rows; n++) {
+			int i = (r<4) ? n : rows-1-n;
+			cost_row_u16(C_row, cost, i, cols, ndisparity, stride);
+			path_row_u16(path_update_u16, Lr_cur, Lr_prev, C_row, r, i, 0, cols, rows, cols, stride, P1, P2);
+			for (int j=0; j<cols; j++) {
+				AggrT *aggrp = aggregatedCost+(i*cols+j)*ndisparity;
+				uint16_t *Lrp = Lr_cur+j*stride+1;
+				for (int d=0; d<ndisparity; d++) {
+					aggrp[d] += Lrp[d];
+				}
+			}
+			uint16_t *tmp = Lr_prev;
+			Lr_prev = Lr_cur;
+			Lr_cur = tmp;
+		}
+	}
+	fp::release_buffer(ws, buf);
+	return 0;
+} // end cost_aggregation_simd()
+
+// Multithreaded version of cost_aggregation_simd.
+// The raster paths (r=0..3) and then the reverse paths (r=4..7) advance together, AGGR_BAND_ROWS rows at a time.
+// Inside a band, each path is cut into chunks of independent scanlines that run on the workers in parallel, and
+// each path writes its own band of L(r,p,:), which is then summed into aggregatedCost in direction order.
+// Only integer sums are regrouped, so the result does not depend on the number of threads.
+// The time of path r is the time its chunks ran, summed over the workers.
+template <typename CostT, typename AggrT>
+int cost_aggregation_parallel(AggrT *aggregatedCost, CostT *cost, int rows, int cols, int numDir, int ndisparity, int P1, int P2, long costMax, fp::ThreadPool *pool, fp::StereoWorkspace *ws) {
+	if (!pool || pool->size()==1)
+		return cost_aggregation_simd(aggregatedCost, cost, rows, cols, numDir, ndisparity, P1, P2, costMax, ws);
+	if (costMax+P2 >= SIMD_COST_MAX)
+		return cost_aggregation_streaming(aggregatedCost, cost, rows, cols, numDir, ndisparity, P1, P2, ws);
+
+	path_update_u16_t path_update_u16 = select_path_update_u16();
+	int stride = simd_pixel_stride(ndisparity);
+	int rowSize = cols*stride;
+	int band = AGGR_BAND_ROWS;
+	int groupDir = std::min(numDir, 4);
+	// Scanline chunks per path, a few per worker for load balance
+	int chunks = AGGR_CHUNKS_PER_THREAD*pool->size();
+	// A band of 16-bit costs, then per path a band of L(r,p,:) whose slot 0 carries the last row of the previous band
+	long bufSize = (long)(band + groupDir*(band+1))*rowSize;
+	uint16_t *buf = (uint16_t*)fp::workspace_buffer(ws, fp::StereoWorkspace::AGGR_SCRATCH, bufSize*sizeof(uint16_t));
+	if (!buf) {
+		printf("Memory allocation failed for buf..! \n");
+		return -1;
+	}
+	for (long k=0; k<bufSize; k++) {
+		buf[k] = SIMD_COST_MAX;
+	}
+	uint16_t *C_band = buf;
+	uint16_t *Lr_bands = buf+band*rowSize;
+	// Workers do not see the timer of the calling thread, so every chunk keeps its own time
+	fp::StageTimer *timer = fp::StageTimer::current();
+	std::vector<double> chunk_ms(timer ? groupDir*chunks : 0);
+
+	for (int r0=0; r0<numDir; r0+=4) {
+		int nr = std::min(4, numDir-r0);
+		std::fill(chunk_ms.begin(), chunk_ms.end(), 0.0);
+		for (int n0=0; n0<rows; n0+=band) {
+			int nb = std::min(band, rows-n0);
+			pool->run(nb, [&](int k) {
+				int i = (r0<4) ? n0+k : rows-1-(n0+k);
+				cost_row_u16(C_band+k*rowSize, cost, i, cols, ndisparity, stride);
+			});
+			// Every path is split into chunks of independent scanlines: rows for horizontal paths, columns for
+			// vertical paths and diagonal lines (a parallelogram of the band) for diagonal paths.
+			pool->run(nr*chunks, [&](int task) {
+				std::chrono::steady_clock::time_point start;
+				if (timer)
+					start = std::chrono::steady_clock::now();
+				int t = task/chunks;
+				int c = task%chunks;
+				int r = r0+t;
+				int iDisp = 0, jDisp = 0;
+				path_direction(r, &iDisp, &jDisp);
+				uint16_t *Lr_band = Lr_bands+t*(band+1)*rowSize;
+				if (iDisp==0) {
+					for (int k=c*nb/chunks; k<(c+1)*nb/chunks; k++) {
+						int i = (r0<4) ? n0+k : rows-1-(n0+k);
+						path_row_u16(path_update_u16, Lr_band+(k+1)*rowSize, Lr_band+k*rowSize, C_band+k*rowSize,
+								r, i, 0, cols, rows, cols, stride, P1, P2);
+					}
+				}
+				else {
+					// p-r is at scan position m+sm of the previous row, so scanline s covers m = s-sm*k in band row k.
+					int sm = (r<4) ? jDisp : -jDisp;
+					int smin = (sm<0) ? -(nb-1) : 0;
+					int snum = (sm==0) ? cols : cols+nb-1;
+					int s0 = smin + c*snum/chunks;
+					int s1 = smin + (c+1)*snum/chunks;
+					for (int k=0; k<nb; k++) {
+						int i = (r0<4) ? n0+k : rows-1-(n0+k);
+						int m0 = std::max(0, s0-sm*k);
+						int m1 = std::min(cols, s1-sm*k);
+						if (m0<m1)
+							path_row_u16(path_update_u16, Lr_band+(k+1)*rowSize, Lr_band+k*rowSize, C_band+k*rowSize,
+									r, i, m0, m1, rows, cols, stride, P1, P2);
+					}
+				}
+				if (timer)
+					chunk_ms[task] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count();
+			});
+			for (int t=0; t<nr; t++) {
+				uint16_t *Lr_band = Lr_bands+t*(band+1)*rowSize;
+				memcpy(Lr_band, Lr_band+nb*rowSize, rowSize*sizeof(uint16_t));
+			}
+			pool->run(nb, [&](int k) {
+				int i = (r0<4) ? n0+k : rows-1-(n0+k);
+				for (int j=0; j<cols; j++) {
+					AggrT *aggrp = aggregatedCost+(i*cols+j)*ndisparity;
+					for (int t=0; t<nr; t++) {
+						uint16_t *Lrp = Lr_bands+(t*(band+1)+k+1)*rowSize+j*stride+1;
+						for (int d=0; d<ndisparity; d++) {
+							if (r0==0 && t==0)
+								aggrp[d] = Lrp[d];
+							else
+								aggrp[d] += Lrp[d];
+						}
+					}
+				}
+			});
+		}
+		if (timer) {
+			for (int t=0; t<nr; t++) {
+				double ms = 0;
+				for (int c=0; c<chunks; c++) {
+					ms += chunk_ms[t*chunks+c];
+				}
+				timer->add(fp::StageTimer::AGGR_PATH0+r0+t, ms);
+			}
+		}
+	}
+	fp::release_buffer(ws, buf);
+	return 0;
+} // end cost_aggregation_parallel()
+
 
 /*-------------------------------------------Post Processing-----------------------------------------*/
-void compute_disparity(float *disparity, int *aggregatedCost, int rows, int cols, int ndisparity) {
+template <typename AggrT>
+void compute_disparity(float *disparity, AggrT *aggregatedCost, int rows, int cols, int ndisparity) {
 	for (int i=0; i<rows; i++) {
 		for (int j=0; j<cols; j++) {
-			int *costPtr = aggregatedCost + (i*cols+j)*ndisparity;
-			int minCost = costPtr[0];
+			AggrT *costPtr = aggregatedCost + (i*cols+j)*ndisparity;
+			AggrT minCost = costPtr[0];
 			int mind = 0;
 			for (int d=1; d<ndisparity; d++) {
 				if (costPtr[d] < minCost) {
@@ -873,61 +1339,76 @@ void compute_disparity(float *disparity, int *aggregatedCost, int rows, int cols
 	}
 }
 
-void compute_lr_disparity(float *disparity_l, float *disparity_r, int *aggregatedCost, int rows, int cols, int ndisparity) {
+// The right disparities are found while the left volume is read in order: left pixel (i,j) at disparity d is
+// right pixel (i,j-d) at disparity d. Same results as scanning C(i,j+d,d) for each right pixel.
+template <typename AggrT>
+int compute_lr_disparity(float *disparity_l, float *disparity_r, AggrT *aggregatedCost, int rows, int cols, int ndisparity, fp::StereoWorkspace *ws) {
+	// the aggregation is done, so its scratch holds the row of right minima
+	AggrT *minCost_r = (AggrT*)fp::workspace_buffer(ws, fp::StereoWorkspace::AGGR_SCRATCH, cols*sizeof(AggrT));
+	if (!minCost_r) {
+		printf("Memory allocation failed for minCost_r..! \n");
+		return -1;
+	}
 	for (int i=0; i<rows; i++) {
+		float *disp_r = disparity_r+i*cols;
 		for (int j=0; j<cols; j++) {
-			int *costPtr = aggregatedCost + (i*cols+j)*ndisparity;
-			int minCost = costPtr[0];
+			AggrT *costPtr = aggregatedCost + (i*cols+j)*ndisparity;
+			AggrT minCost = costPtr[0];
 			int mind = 0;
-            int minCost_r = costPtr[0];
-            int mind_r = 0;
+			minCost_r[j] = costPtr[0];
+			disp_r[j] = 0;
 			for (int d=1; d<ndisparity; d++) {
 				if (costPtr[d] < minCost) {
 					minCost = costPtr[d];
 					mind = d;
 				}
-                if(j+d<cols){
-                    if (aggregatedCost[(i*cols+j+d)*ndisparity+d] < minCost_r){
-                        minCost_r = aggregatedCost[(i*cols+j+d)*ndisparity+d];
-                        mind_r = d;
-                    }
-                }
+			}
+			int dmax = std::min(ndisparity, j+1);
+			for (int d=1; d<dmax; d++) {
+				if (costPtr[d] < minCost_r[j-d]) {
+					minCost_r[j-d] = costPtr[d];
+					disp_r[j-d] = d;
+				}
 			}
 			disparity_l[i*cols+j] = mind;
-            disparity_r[i*cols+j] = mind_r;
 		}
 	}
+	fp::release_buffer(ws, minCost_r);
+	return 0;
 }
 
-void sort_array(int *array, int *min_value, int *min_d, int ndisparity){
+template <typename AggrT>
+void sort_array(AggrT *array, int *min_value, int *min_d, int ndisparity){
     min_value[0] = INT_MAX;
     min_value[1] = INT_MAX;
     min_value[2] = INT_MAX;
     min_d[0] = 0;
     min_d[1] = 0;    
     for(int i=0; i<ndisparity; i++){
-        if(array[i]<min_value[0]){
+        int value = array[i];
+        if(value<min_value[0]){
             min_value[2] = min_value[1];
             min_value[1] = min_value[0];
-            min_value[0] = array[i];
+            min_value[0] = value;
             min_d[1] = min_d[0];
             min_d[0] = i;
         }
-        else if(array[i]<min_value[1]){
+        else if(value<min_value[1]){
             min_value[2] = min_value[1];
-            min_value[1] = array[i];
+            min_value[1] = value;
             min_d[1] = i; 
         }
-        else if(array[i]<min_value[2]){
-            min_value[2] = array[i];
+        else if(value<min_value[2]){
+            min_value[2] = value;
         }
     }
 }
 
-void compute_disparity_uniqueness(float *disparity, int *aggregatedCost, int rows, int cols, int ndisparity) {
+template <typename AggrT>
+void compute_disparity_uniqueness(float *disparity, AggrT *aggregatedCost, int rows, int cols, int ndisparity) {
 	for (int i=0; i<rows; i++) {
 		for (int j=0; j<cols; j++) {
-			int *costPtr = aggregatedCost + (i*cols+j)*ndisparity;
+			AggrT *costPtr = aggregatedCost + (i*cols+j)*ndisparity;
             int min_value[3];
             int min_d[2];
             sort_array(costPtr,min_value,min_d,ndisparity);
@@ -947,11 +1428,12 @@ void compute_disparity_uniqueness(float *disparity, int *aggregatedCost, int row
 	}
 }
 
-void compute_lr_disparity_uniqueness(float *disparity_l, float *disparity_r, int *aggregatedCost, int rows, int cols, int ndisparity) {
+template <typename AggrT>
+void compute_lr_disparity_uniqueness(float *disparity_l, float *disparity_r, AggrT *aggregatedCost, int rows, int cols, int ndisparity) {
 	for (int i=0; i<rows; i++) {
 		for (int j=0; j<cols; j++) {
-			int *costPtr = aggregatedCost + (i*cols+j)*ndisparity;
-            int minCost_r = costPtr[0];
+			AggrT *costPtr = aggregatedCost + (i*cols+j)*ndisparity;
+            AggrT minCost_r = costPtr[0];
             int mind_r = 0;            
             int min_value[3];
             int min_d[2];
@@ -1022,8 +1504,9 @@ T compute_median(T *window, int size){
     return median;
 }
 
-int median_filter(float *disparity_src, float *disparity_dst, int rows, int cols, int filter_win){
-    float *window = (float*)malloc(filter_win*filter_win*sizeof(float));
+// Median of the sorted window of every pixel, for maps that are not integer disparities
+int median_filter_window(float *disparity_src, float *disparity_dst, int rows, int cols, int filter_win, fp::StereoWorkspace *ws){
+    float *window = (float*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_SCRATCH, filter_win*filter_win*sizeof(float));
     if (!window) {
         printf("Memory allocation failed for window..! \n");
         return -1;
@@ -1072,9 +1555,96 @@ int median_filter(float *disparity_src, float *disparity_dst, int rows, int cols
             disparity_dst[i*cols+j] = compute_median<float>(window, filter_win*filter_win);
 		}
 	}
+    fp::release_buffer(ws, window);
     return 0;   
 }
 
+inline int clamp_index(int x, int n){
+    return std::min(std::max(x, 0), n-1);
+}
+
+// Sliding-histogram median (Perreault and Hebert): one histogram per image column over the rows of the window,
+// updated with one pixel in and one out per row, and a kernel histogram updated with one column histogram in and
+// one out per pixel. The median is tracked from the previous pixel through the number of values below it, so the
+// cost per pixel depends on the number of bins only. Rows and columns outside the image replicate the border.
+int median_filter_hist(const float *disparity_src, float *disparity_dst, int rows, int cols, int filter_win, int bins, fp::StereoWorkspace *ws){
+    int r = filter_win/2;
+    int rank = ((2*r+1)*(2*r+1)-1)/2;
+    // the column histograms followed by the kernel histogram, in the scratch of the cost engines
+    uint16_t *col_hist = (uint16_t*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_SCRATCH, (size_t)(cols+1)*bins*sizeof(uint16_t));
+    if (!col_hist) {
+        printf("Memory allocation failed for median histograms..! \n");
+        return -1;
+    }
+    uint16_t *kernel = col_hist+(size_t)cols*bins;
+    memset(col_hist, 0, (size_t)cols*bins*sizeof(uint16_t));
+    for (int c=0; c<cols; c++) {
+        for (int ki=-r; ki<=r; ki++) {
+            col_hist[c*bins+(int)disparity_src[clamp_index(ki,rows)*cols+c]]++;
+        }
+    }
+    for (int i=0; i<rows; i++) {
+        if (i > 0) {
+            const float *out_row = disparity_src+clamp_index(i-1-r,rows)*cols;
+            const float *in_row = disparity_src+clamp_index(i+r,rows)*cols;
+            for (int c=0; c<cols; c++) {
+                col_hist[c*bins+(int)out_row[c]]--;
+                col_hist[c*bins+(int)in_row[c]]++;
+            }
+        }
+        memset(kernel, 0, bins*sizeof(uint16_t));
+        for (int kj=-r; kj<=r; kj++) {
+            const uint16_t *h = col_hist+clamp_index(kj,cols)*bins;
+            for (int v=0; v<bins; v++) {
+                kernel[v] += h[v];
+            }
+        }
+        // kernel holds the window of (i,j), below counts its values smaller than med
+        int med = 0;
+        int below = 0;
+        for (int j=0; j<cols; j++) {
+            if (j > 0) {
+                const uint16_t *h_in = col_hist+clamp_index(j+r,cols)*bins;
+                const uint16_t *h_out = col_hist+clamp_index(j-1-r,cols)*bins;
+                int delta = 0;
+                for (int v=0; v<med; v++) {
+                    int dv = h_in[v]-h_out[v];
+                    kernel[v] += dv;
+                    delta += dv;
+                }
+                for (int v=med; v<bins; v++) {
+                    kernel[v] += h_in[v]-h_out[v];
+                }
+                below += delta;
+            }
+            while (below > rank) {
+                med--;
+                below -= kernel[med];
+            }
+            while (below+kernel[med] <= rank) {
+                below += kernel[med];
+                med++;
+            }
+            disparity_dst[i*cols+j] = med;
+        }
+    }
+    fp::release_buffer(ws, col_hist);
+    return 0;
+}
+
+// Disparity maps hold integers below the number of disparities and go through the histogram filter; anything
+// else (negative, fractional or larger values) through the window sort.
+int median_filter(float *disparity_src, float *disparity_dst, int rows, int cols, int filter_win, fp::StereoWorkspace *ws){
+    int max_value = 0;
+    for (int k=0; k<rows*cols; k++) {
+        float value = disparity_src[k];
+        if (!(value >= 0 && value < MEDIAN_HIST_BINS) || value != (float)(int)value)
+            return median_filter_window(disparity_src, disparity_dst, rows, cols, filter_win, ws);
+        max_value = std::max(max_value, (int)value);
+    }
+    return median_filter_hist(disparity_src, disparity_dst, rows, cols, filter_win, max_value+1, ws);
+}
+
 int interpolateDisp (cv::Mat &disp)
 {
 	int32_t height_ = disp.rows;
@@ -1169,112 +1739,429 @@ int interpolateDisp (cv::Mat &disp)
 
 /*-----------------------------------------------SGBM---------------------------------------------*/
 // input images are 1 channel grayscale images.
-int compute_SGM(cv::Mat img1, cv::Mat img2, float *disparity,int dir,int max_disp,int p1,int p2,int cost_type,int window_size,int filter_win, int shd_window)
+
+/* Penalties, left-right check and uniqueness check of one setting of a parameter sweep */
+struct SweepPoint {
+	int p1;
+	int p2;
+	int lr_check;
+	int uniq;       // UNIQ of fp_config_arch.h: ambiguous minima of the WTA give disparity 0
+};
+
+// Disparities of aggregated volumes. aggregatedCost_r is only read with lr_check LR_TWO_VOLUMES; lr_check 0
+// returns the WTA disparities, the left-right checks the checked median filtered disparities.
+template <typename AggrT>
+int compute_disparity_refined(AggrT *aggregatedCost_l, AggrT *aggregatedCost_r, int rows, int cols, float *disparity,int max_disp,int filter_win,int lr_check,int uniq, fp::StereoWorkspace *ws)
 {
-	// Memory to store cost of size height x width x number of disparities
-	int *cost = (int*)malloc(img1.rows*img1.cols*max_disp*sizeof(int));
-	if (!cost) {
-		printf("Memory allocation failed for accumulatedCost..! \n");
-		return -1;
+	size_t plane = (size_t)rows*cols*sizeof(float);
+	if (lr_check == 0) {
+		fp::ScopedStage stage(fp::StageTimer::WTA);
+		if (uniq)
+			compute_disparity_uniqueness(disparity, aggregatedCost_l, rows, cols, max_disp);
+		else
+			compute_disparity(disparity, aggregatedCost_l, rows, cols, max_disp);
+		return 0;
 	}
-    compute_initial_cost(img1,img2,cost,cost_type,window_size,shd_window,max_disp);
-    //Create array for L(r,p,d)
-	int *Lr = (int*)malloc(dir*img1.rows*img1.cols*max_disp*sizeof(int));
-	if (!Lr) {
-		printf("Memory allocation failed for Lr..! \n");
-		return -1;
+    float *disparity_src_l = (float*)fp::workspace_buffer(ws, fp::StereoWorkspace::DISP_L, plane);
+    float *disparity_src_r = (float*)fp::workspace_buffer(ws, fp::StereoWorkspace::DISP_R, plane);
+    float *disparity_dst_l = (float*)fp::workspace_buffer(ws, fp::StereoWorkspace::DISP_FILTERED_L, plane);
+    float *disparity_dst_r = (float*)fp::workspace_buffer(ws, fp::StereoWorkspace::DISP_FILTERED_R, plane);
+    int ret = 0;
+    if (!disparity_src_l||!disparity_src_r||!disparity_dst_l||!disparity_dst_r) {
+        printf("Memory allocation failed for the disparity maps..! \n");
+        ret = -1;
+    }
+	if (ret == 0) {
+		fp::ScopedStage stage(fp::StageTimer::WTA);
+		if (lr_check == LR_TWO_VOLUMES) {
+			if (uniq)
+				compute_disparity_uniqueness(disparity_src_l, aggregatedCost_l, rows, cols, max_disp);
+			else
+				compute_disparity(disparity_src_l, aggregatedCost_l, rows, cols, max_disp);
+			compute_disparity(disparity_src_r, aggregatedCost_r, rows, cols, max_disp);
+		}
+		else if (uniq) {
+			compute_lr_disparity_uniqueness(disparity_src_l, disparity_src_r, aggregatedCost_l, rows, cols, max_disp);
+		}
+		else {
+			// Right view: C_r(p,d) = C_l(p+d,d), read diagonally from the left volume as fpLRComputeDisparity does
+			ret = compute_lr_disparity(disparity_src_l, disparity_src_r, aggregatedCost_l, rows, cols, max_disp, ws);
+		}
 	}
-	// Initialize Lr(p,d) to C(p,d)
-	init_Lr(Lr, cost, img1.rows*img1.cols*max_disp,dir);
+    if (ret == 0) {
+        fp::ScopedStage stage(fp::StageTimer::MEDIAN);
+        ret = median_filter(disparity_src_l,disparity_dst_l,rows, cols, filter_win, ws);
+        if (ret == 0)
+            ret = median_filter(disparity_src_r,disparity_dst_r,rows, cols, filter_win, ws);
+    }
+    if (ret == 0) {
+        fp::ScopedStage stage(fp::StageTimer::LR_CONSISTENCY);
+        check_consistency(disparity_dst_l,disparity_dst_r,disparity,rows,cols);
+    }
 
-	// Compute cost along different directions
-	cost_computation(Lr, cost, img1.rows, img1.cols, dir, max_disp, p1, p2);
+    fp::release_buffer(ws, disparity_src_l);
+    fp::release_buffer(ws, disparity_src_r);
+    fp::release_buffer(ws, disparity_dst_l);
+    fp::release_buffer(ws, disparity_dst_r);
+	return ret;
+}
+
+// Aggregation and post-processing of initial cost volumes for the points of members, which share P1 and P2:
+// the aggregated volumes only depend on the penalties, so they are computed once and every left-right and
+// uniqueness check of the group reads them. The map of point k goes to disparity+k*rows*cols. cost_r is only
+// read when a member has lr_check LR_TWO_VOLUMES. cost_max bounds the initial costs, see max_initial_cost.
+template <typename CostT, typename AggrT>
+int compute_SGM_group(CostT *cost_l, CostT *cost_r, int rows, int cols, float *disparity,int dir,int max_disp,int filter_win, long cost_max, const std::vector<SweepPoint> &points, const std::vector<int> &members, fp::ThreadPool *pool, fp::StereoWorkspace *ws)
+{
+	size_t volume = (size_t)rows*cols*max_disp;
+	int p1 = points[members[0]].p1;
+	int p2 = points[members[0]].p2;
+	bool two_volumes = false;
+	for (size_t m=0; m<members.size(); m++) {
+		two_volumes |= (points[members[m]].lr_check == LR_TWO_VOLUMES);
+	}
 
 	// Array for aggregated cost
-	int *aggregatedCost = (int*)malloc(img1.rows*img1.cols*max_disp*sizeof(int));
-	if (!aggregatedCost) {
+	AggrT *aggregatedCost_l = (AggrT*)fp::workspace_buffer(ws, fp::StereoWorkspace::AGGR, volume*sizeof(AggrT));
+	AggrT *aggregatedCost_r = 0;
+	if (two_volumes)
+		aggregatedCost_r = (AggrT*)fp::workspace_buffer(ws, fp::StereoWorkspace::AGGR_R, volume*sizeof(AggrT));
+	if (!aggregatedCost_l||(two_volumes && !aggregatedCost_r)) {
 		printf("Memory allocation failed for aggregatedCost..! \n");
 		return -1;
 	}
-	cost_aggregation(aggregatedCost, Lr, img1.rows, img1.cols, dir, max_disp);
-
-	// Disparity computation
-    float *disparity_src = (float*)malloc(img1.rows*img1.cols*sizeof(float));
-	compute_disparity(disparity, aggregatedCost, img1.rows, img1.cols, max_disp);
+	// Compute cost along different directions and sum them up
+	int ret;
+	{
+		fp::ScopedStage stage(fp::StageTimer::AGGREGATION);
+		ret = cost_aggregation_parallel(aggregatedCost_l, cost_l, rows, cols, dir, max_disp, p1, p2, cost_max, pool, ws);
+		if (ret == 0 && two_volumes)
+			ret = cost_aggregation_parallel(aggregatedCost_r, cost_r, rows, cols, dir, max_disp, p1, p2, cost_max, pool, ws);
+	}
 
-    //median_filter(disparity_src,disparity,img1.rows, img1.cols, filter_win);
+	for (size_t m=0; m<members.size() && ret==0; m++) {
+		const SweepPoint &point = points[members[m]];
+		ret = compute_disparity_refined(aggregatedCost_l, aggregatedCost_r, rows, cols, disparity+(size_t)members[m]*rows*cols, max_disp, filter_win, point.lr_check, point.uniq, ws);
+	}
 
-	free(cost);
-	free(Lr);
-	free(aggregatedCost);
-    free(disparity_src);
+	fp::release_buffer(ws, aggregatedCost_l);
+	if (two_volumes)
+		fp::release_buffer(ws, aggregatedCost_r);
+	return ret;
+}
 
-	return 0;
+// Aggregation and post-processing of initial cost volumes for a single point, see compute_disparity_refined
+template <typename CostT, typename AggrT>
+int compute_SGM_from_cost(CostT *cost_l, CostT *cost_r, int rows, int cols, float *disparity,int dir,int max_disp,int p1,int p2,int filter_win,int lr_check, long cost_max, fp::ThreadPool *pool, fp::StereoWorkspace *ws)
+{
+	SweepPoint point = {p1, p2, lr_check, 0};
+	return compute_SGM_group<CostT, AggrT>(cost_l, cost_r, rows, cols, disparity, dir, max_disp, filter_win, cost_max, std::vector<SweepPoint>(1, point), std::vector<int>(1, 0), pool, ws);
 }
 
-int compute_SGM_lr(cv::Mat img1, cv::Mat img2, float *disparity,int dir,int max_disp,int p1,int p2,int cost_type,int window_size,int filter_win,int shd_window)
+template <typename CostT, typename AggrT>
+int compute_SGM_volume(cv::Mat img1, cv::Mat img2, float *disparity,int dir,int max_disp,int p1,int p2,int cost_type,int window_size,int filter_win, int shd_window, fp::ThreadPool *pool, fp::StereoWorkspace *ws)
 {
 	// Memory to store cost of size height x width x number of disparities
-	int *cost_l = (int*)malloc(img1.rows*img1.cols*max_disp*sizeof(int));
-	if (!cost_l) {
+	CostT *cost = (CostT*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST, (size_t)img1.rows*img1.cols*max_disp*sizeof(CostT));
+	if (!cost) {
 		printf("Memory allocation failed for accumulatedCost..! \n");
 		return -1;
 	}
-	int *cost_r = (int*)malloc(img1.rows*img1.cols*max_disp*sizeof(int));
-	if (!cost_r) {
+	int ret = compute_initial_cost(img1,img2,cost,cost_type,window_size,shd_window,max_disp,ws);
+	if (ret == 0)
+		ret = compute_SGM_from_cost<CostT, AggrT>(cost, 0, img1.rows, img1.cols, disparity, dir, max_disp, p1, p2, filter_win, 0,
+				max_initial_cost(cost_type, window_size, shd_window), pool, ws);
+
+	fp::release_buffer(ws, cost);
+	return ret;
+}
+
+template <typename CostT, typename AggrT>
+int compute_SGM_lr_volume(cv::Mat img1, cv::Mat img2, float *disparity,int dir,int max_disp,int p1,int p2,int cost_type,int window_size,int filter_win,int shd_window,int lr_check, fp::ThreadPool *pool, fp::StereoWorkspace *ws)
+{
+	size_t volume = (size_t)img1.rows*img1.cols*max_disp;
+	bool two_volumes = (lr_check == LR_TWO_VOLUMES);
+	// Memory to store cost of size height x width x number of disparities
+	CostT *cost_l = (CostT*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST, volume*sizeof(CostT));
+	if (!cost_l) {
 		printf("Memory allocation failed for accumulatedCost..! \n");
 		return -1;
-	}   
-    compute_lr_initial_cost(img1,img2,cost_l,cost_r,cost_type,window_size,shd_window,max_disp);
-    //Create array for L(r,p,d)
-	int *Lr_l = (int*)malloc(dir*img1.rows*img1.cols*max_disp*sizeof(int));
-    int *Lr_r = (int*)malloc(dir*img1.rows*img1.cols*max_disp*sizeof(int));
-	if (!Lr_l||!Lr_r) {
-		printf("Memory allocation failed for Lr..! \n");
-		return -1;
 	}
-	// Initialize Lr(p,d) to C(p,d)
-	init_Lr(Lr_l, cost_l, img1.rows*img1.cols*max_disp, dir);
-	init_Lr(Lr_r, cost_r, img1.rows*img1.cols*max_disp, dir);
+	CostT *cost_r = 0;
+	if (two_volumes) {
+		cost_r = (CostT*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_R, volume*sizeof(CostT));
+		if (!cost_r) {
+			printf("Memory allocation failed for accumulatedCost..! \n");
+			fp::release_buffer(ws, cost_l);
+			return -1;
+		}
+	}
+	int ret;
+	if (two_volumes)
+		ret = compute_lr_initial_cost(img1,img2,cost_l,cost_r,cost_type,window_size,shd_window,max_disp,ws);
+	else
+		ret = compute_initial_cost(img1,img2,cost_l,cost_type,window_size,shd_window,max_disp,ws);
+	if (ret == 0)
+		ret = compute_SGM_from_cost<CostT, AggrT>(cost_l, cost_r, img1.rows, img1.cols, disparity, dir, max_disp, p1, p2, filter_win, lr_check,
+				max_initial_cost(cost_type, window_size, shd_window), pool, ws);
+
+	fp::release_buffer(ws, cost_l);
+	if (two_volumes)
+		fp::release_buffer(ws, cost_r);
+	return ret;
+}
 
-	// Compute cost along different directions
-	cost_computation(Lr_l, cost_l, img1.rows, img1.cols, dir, max_disp, p1, p2);
-    cost_computation(Lr_r, cost_r, img1.rows, img1.cols, dir, max_disp, p1, p2);
+// Volumes as narrow as the hardware bit widths (CpuVolume) when the run fits in them, then 16/32-bit, then int
+int compute_SGM(cv::Mat img1, cv::Mat img2, float *disparity,int dir,int max_disp,int p1,int p2,int cost_type,int window_size,int filter_win, int shd_window, fp::ThreadPool *pool, fp::StereoWorkspace *ws)
+{
+	if (storage_fits<CpuVolume>(cost_type, window_size, shd_window, dir, p2))
+		return compute_SGM_volume<CpuVolume::cost_type, CpuVolume::aggr_type>(img1,img2,disparity,dir,max_disp,p1,p2,cost_type,window_size,filter_win,shd_window,pool,ws);
+	if (storage_fits<VolumeStorageWide>(cost_type, window_size, shd_window, dir, p2))
+		return compute_SGM_volume<VolumeStorageWide::cost_type, VolumeStorageWide::aggr_type>(img1,img2,disparity,dir,max_disp,p1,p2,cost_type,window_size,filter_win,shd_window,pool,ws);
+	return compute_SGM_volume<int, int>(img1,img2,disparity,dir,max_disp,p1,p2,cost_type,window_size,filter_win,shd_window,pool,ws);
+}
 
-	// Array for aggregated cost
-	int *aggregatedCost_l = (int*)malloc(img1.rows*img1.cols*max_disp*sizeof(int));
-    int *aggregatedCost_r = (int*)malloc(img1.rows*img1.cols*max_disp*sizeof(int));
-	if (!aggregatedCost_l||!aggregatedCost_r) {
-		printf("Memory allocation failed for aggregatedCost..! \n");
-		return -1;
+// lr_check selects how the right disparities are found: LR_SINGLE_VOLUME or LR_TWO_VOLUMES (fp_sgbm_c.h)
+int compute_SGM_lr(cv::Mat img1, cv::Mat img2, float *disparity,int dir,int max_disp,int p1,int p2,int cost_type,int window_size,int filter_win,int shd_window,int lr_check, fp::ThreadPool *pool, fp::StereoWorkspace *ws)
+{
+	if (storage_fits<CpuVolume>(cost_type, window_size, shd_window, dir, p2))
+		return compute_SGM_lr_volume<CpuVolume::cost_type, CpuVolume::aggr_type>(img1,img2,disparity,dir,max_disp,p1,p2,cost_type,window_size,filter_win,shd_window,lr_check,pool,ws);
+	if (storage_fits<VolumeStorageWide>(cost_type, window_size, shd_window, dir, p2))
+		return compute_SGM_lr_volume<VolumeStorageWide::cost_type, VolumeStorageWide::aggr_type>(img1,img2,disparity,dir,max_disp,p1,p2,cost_type,window_size,filter_win,shd_window,lr_check,pool,ws);
+	return compute_SGM_lr_volume<int, int>(img1,img2,disparity,dir,max_disp,p1,p2,cost_type,window_size,filter_win,shd_window,lr_check,pool,ws);
+}
+
+// Fused pipeline for the raster paths r=0..3, the way SemiGlobalBMNLR streams through its FIFOs: the image is
+// processed in bands of FUSED_BAND_ROWS rows. The initial costs of a band are computed on the band plus the halo
+// rows its windows reach, the paths advance over the band in the 16-bit layout of fp_sgbm_simd.hpp and each row
+// goes through the WTA as soon as its paths are summed. Neither the cost nor the aggregated volume of the whole
+// image is ever allocated, and the first disparity rows are ready after the first band. The halo rows are computed
+// again with every band (2*halo extra rows per FUSED_BAND_ROWS).
+// The paths of a band start from the last row of the previous one, so the bands are aggregated in order; with a
+// pool, the costs of the next band are computed on a worker meanwhile, as the cost and aggregation modules of the
+// hardware overlap. A band is timed once, as aggregation: its paths and the WTA of its rows are interleaved.
+template <typename CostT, typename AggrT>
+int compute_SGM_fused_volume(cv::Mat img1, cv::Mat img2, float *disparity,int dir,int max_disp,int p1,int p2,int cost_type,int window_size,int shd_window, fp::ThreadPool *pool, fp::StereoWorkspace *ws)
+{
+	int rows = img1.rows;
+	int cols = img1.cols;
+	int band = FUSED_BAND_ROWS;
+	int nbands = (rows+band-1)/band;
+	int halo = window_size/2 + ((cost_type==4) ? shd_window/2 : 0);
+	bool pipelined = pool && pool->size()>1 && nbands>1;
+	path_update_u16_t path_update_u16 = select_path_update_u16();
+	int stride = simd_pixel_stride(max_disp);
+	int rowSize = cols*stride;
+	size_t bandCost = (size_t)(band+2*halo)*cols*max_disp;
+	// Band b is in cost[b&1]; the pipeline has no right view, so COST_R holds the second band
+	CostT *cost[2];
+	cost[0] = (CostT*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST, bandCost*sizeof(CostT));
+	cost[1] = pipelined ? (CostT*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_R, bandCost*sizeof(CostT)) : cost[0];
+	AggrT *aggregatedCost = (AggrT*)fp::workspace_buffer(ws, fp::StereoWorkspace::AGGR, (size_t)cols*max_disp*sizeof(AggrT));
+	// One row of 16-bit costs followed by two rows of L(r,p,:) per path
+	uint16_t *buf = (uint16_t*)fp::workspace_buffer(ws, fp::StereoWorkspace::AGGR_SCRATCH, (size_t)(1+2*dir)*rowSize*sizeof(uint16_t));
+	int ret = 0;
+	if (!cost[0]||!cost[1]||!aggregatedCost||!buf) {
+		printf("Memory allocation failed for the fused pipeline..! \n");
+		ret = -1;
 	}
-	cost_aggregation(aggregatedCost_l, Lr_l, img1.rows, img1.cols, dir, max_disp);
-    cost_aggregation(aggregatedCost_r, Lr_r, img1.rows, img1.cols, dir, max_disp);
-
-	// Disparity computation
-    float *disparity_src_l = (float*)malloc(img1.rows*img1.cols*sizeof(float));
-    float *disparity_src_r = (float*)malloc(img1.rows*img1.cols*sizeof(float));
-	compute_disparity(disparity_src_l, aggregatedCost_l, img1.rows, img1.cols, max_disp);
-    compute_disparity(disparity_src_r, aggregatedCost_r, img1.rows, img1.cols, max_disp);
-    
-    float *disparity_dst_l = (float*)malloc(img1.rows*img1.cols*sizeof(float));
-    float *disparity_dst_r = (float*)malloc(img1.rows*img1.cols*sizeof(float));    
-    median_filter(disparity_src_l,disparity_dst_l,img1.rows, img1.cols, filter_win);
-    median_filter(disparity_src_r,disparity_dst_r,img1.rows, img1.cols, filter_win);
-    check_consistency(disparity_dst_l,disparity_dst_r,disparity,img1.rows,img1.cols);
-
-	free(cost_l);
-    free(cost_r);
-	free(Lr_l);
-    free(Lr_r);
-	free(aggregatedCost_l);
-    free(aggregatedCost_r);
-    free(disparity_src_l);
-    free(disparity_src_r);
-    free(disparity_dst_l);
-    free(disparity_dst_r);
+	for (int k=0; ret==0 && k<(1+2*dir)*rowSize; k++) {
+		buf[k] = SIMD_COST_MAX;
+	}
+	uint16_t *C_row = buf;
+
+	auto band_cost = [&](int b) {
+		int b0 = b*band;
+		int top = std::max(0, b0-halo);
+		int bottom = std::min(rows, b0+band+halo);
+		cv::Rect roi(0, top, cols, bottom-top);
+		return compute_initial_cost(img1(roi), img2(roi), cost[b&1], cost_type, window_size, shd_window, max_disp, ws);
+	};
+	auto band_disparity = [&](int b) {
+		int b0 = b*band;
+		int nb = std::min(band, rows-b0);
+		int top = std::max(0, b0-halo);
+		fp::ScopedStage stage(fp::StageTimer::AGGREGATION);
+		for (int k=0; k<nb; k++) {
+			int i = b0+k;
+			cost_row_u16(C_row, cost[b&1], i-top, cols, max_disp, stride);
+			for (int r=0; r<dir; r++) {
+				uint16_t *Lr_cur = buf+(1+2*r+(i&1))*rowSize;
+				uint16_t *Lr_prev = buf+(1+2*r+1-(i&1))*rowSize;
+				path_row_u16(path_update_u16, Lr_cur, Lr_prev, C_row, r, i, 0, cols, rows, cols, stride, p1, p2);
+			}
+			for (int j=0; j<cols; j++) {
+				AggrT *aggrp = aggregatedCost+j*max_disp;
+				for (int d=0; d<max_disp; d++) {
+					aggrp[d] = 0;
+				}
+				for (int r=0; r<dir; r++) {
+					uint16_t *Lrp = buf+(1+2*r+(i&1))*rowSize+j*stride+1;
+					for (int d=0; d<max_disp; d++) {
+						aggrp[d] += Lrp[d];
+					}
+				}
+			}
+			compute_disparity(disparity+(size_t)i*cols, aggregatedCost, 1, cols, max_disp);
+		}
+	};
+
+	if (ret == 0)
+		ret = band_cost(0);
+	// Workers do not see the timer of the calling thread: the two tasks take it over, they time different stages
+	fp::StageTimer *timer = fp::StageTimer::current();
+	for (int b=0; ret==0 && b<nbands; b++) {
+		int next_ret = 0;
+		if (pipelined && b+1<nbands) {
+			pool->run(2, [&](int task) {
+				fp::StageTimer *own = fp::StageTimer::current();
+				fp::StageTimer::current() = timer;
+				if (task == 0)
+					next_ret = band_cost(b+1);
+				else
+					band_disparity(b);
+				fp::StageTimer::current() = own;
+			});
+		}
+		else {
+			band_disparity(b);
+			if (b+1<nbands)
+				next_ret = band_cost(b+1);
+		}
+		ret = next_ret;
+	}
+	fp::release_buffer(ws, cost[0]);
+	if (pipelined)
+		fp::release_buffer(ws, cost[1]);
+	fp::release_buffer(ws, aggregatedCost);
+	fp::release_buffer(ws, buf);
+	return ret;
+}
 
-	return 0;
+// Same disparity map as compute_SGM. Runs with more than 4 paths, even windows or costs that could saturate the
+// 16-bit path values go through compute_SGM.
+int compute_SGM_fused(cv::Mat img1, cv::Mat img2, float *disparity,int dir,int max_disp,int p1,int p2,int cost_type,int window_size,int filter_win, int shd_window, fp::ThreadPool *pool, fp::StereoWorkspace *ws)
+{
+	if (dir>4 || window_size%2==0 || max_initial_cost(cost_type, window_size, shd_window)+p2 >= SIMD_COST_MAX)
+		return compute_SGM(img1,img2,disparity,dir,max_disp,p1,p2,cost_type,window_size,filter_win,shd_window,pool,ws);
+	if (storage_fits<CpuVolume>(cost_type, window_size, shd_window, dir, p2))
+		return compute_SGM_fused_volume<CpuVolume::cost_type, CpuVolume::aggr_type>(img1,img2,disparity,dir,max_disp,p1,p2,cost_type,window_size,shd_window,pool,ws);
+	return compute_SGM_fused_volume<VolumeStorageWide::cost_type, VolumeStorageWide::aggr_type>(img1,img2,disparity,dir,max_disp,p1,p2,cost_type,window_size,shd_window,pool,ws);
+}
+
+// Aggregated volumes of a group of sweep points as narrow as their P2 allows, on initial costs of any CostT
+template <typename CostT>
+int compute_SGM_penalties(CostT *cost_l, CostT *cost_r, int rows, int cols, float *disparity,int dir,int max_disp,int cost_type,int window_size,int filter_win,int shd_window, const std::vector<SweepPoint> &points, const std::vector<int> &members, fp::ThreadPool *pool, fp::StereoWorkspace *ws)
+{
+	int p2 = points[members[0]].p2;
+	long cost_max = max_initial_cost(cost_type, window_size, shd_window);
+	if (aggr_fits<CpuVolume>(cost_type, window_size, shd_window, dir, p2))
+		return compute_SGM_group<CostT, CpuVolume::aggr_type>(cost_l,cost_r,rows,cols,disparity,dir,max_disp,filter_win,cost_max,points,members,pool,ws);
+	if (aggr_fits<VolumeStorageWide>(cost_type, window_size, shd_window, dir, p2))
+		return compute_SGM_group<CostT, VolumeStorageWide::aggr_type>(cost_l,cost_r,rows,cols,disparity,dir,max_disp,filter_win,cost_max,points,members,pool,ws);
+	return compute_SGM_group<CostT, int>(cost_l,cost_r,rows,cols,disparity,dir,max_disp,filter_win,cost_max,points,members,pool,ws);
+}
+
+template <typename CostT>
+int compute_SGM_sweep_volume(cv::Mat img1, cv::Mat img2, float *disparity,int dir,int max_disp,int cost_type,int window_size,int filter_win,int shd_window, const std::vector<SweepPoint> &points, const fp::CostCache *cache, const std::string &frame_key, fp::ThreadPool *pool, fp::StereoWorkspace *ws)
+{
+	int rows = img1.rows;
+	int cols = img1.cols;
+	size_t bytes = (size_t)rows*cols*max_disp*sizeof(CostT);
+	bool two_volumes = false;
+	for (size_t k=0; k<points.size(); k++) {
+		two_volumes |= (points[k].lr_check == LR_TWO_VOLUMES);
+	}
+	// The frame name does not tell datasets or regenerated images apart: the key also holds a hash of both images
+	uint64_t image_hash = 0;
+	if (cache) {
+		image_hash = fp::cache_hash(0, 0);
+		for (int r=0; r<rows; r++) {
+			image_hash = fp::cache_hash(img1.ptr(r), cols*img1.elemSize(), image_hash);
+			image_hash = fp::cache_hash(img2.ptr(r), cols*img2.elemSize(), image_hash);
+		}
+	}
+	char params[160];
+	sprintf(params, "_%016llx_c%d_w%d_s%d_d%d_%dx%d_%dB", (unsigned long long)image_hash, cost_type, window_size, shd_window,
+			max_disp, rows, cols, (int)sizeof(CostT));
+	std::string key = frame_key + params;
+
+	fp::MappedVolume cached_l, cached_r;
+	CostT *cost_l = 0;
+	CostT *cost_r = 0;
+	bool hit = false;
+	if (cache) {
+		fp::ScopedStage stage(fp::StageTimer::COST);
+		hit = cache->load(key + "_L", bytes, cached_l) && (!two_volumes || cache->load(key + "_R", bytes, cached_r));
+	}
+	if (hit) {
+		cost_l = (CostT*)cached_l.data();
+		cost_r = (CostT*)cached_r.data();
+	}
+	else {
+		cost_l = (CostT*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST, bytes);
+		if (two_volumes)
+			cost_r = (CostT*)fp::workspace_buffer(ws, fp::StereoWorkspace::COST_R, bytes);
+		if (!cost_l || (two_volumes && !cost_r)) {
+			printf("Memory allocation failed for accumulatedCost..! \n");
+			return -1;
+		}
+		int cost_ret;
+		if (two_volumes)
+			cost_ret = compute_lr_initial_cost(img1,img2,cost_l,cost_r,cost_type,window_size,shd_window,max_disp,ws);
+		else
+			cost_ret = compute_initial_cost(img1,img2,cost_l,cost_type,window_size,shd_window,max_disp,ws);
+		// a failed volume is never cached: later runs would load it as a valid one
+		if (cost_ret != 0) {
+			fp::release_buffer(ws, cost_l);
+			if (two_volumes)
+				fp::release_buffer(ws, cost_r);
+			return -1;
+		}
+		if (cache) {
+			fp::ScopedStage stage(fp::StageTimer::COST);
+			cache->store(key + "_L", cost_l, bytes);
+			if (two_volumes)
+				cache->store(key + "_R", cost_r, bytes);
+		}
+	}
+
+	// Points with the same penalties share their aggregated volumes
+	std::vector<bool> done(points.size(), false);
+	int ret = 0;
+	for (size_t k=0; k<points.size() && ret==0; k++) {
+		if (done[k])
+			continue;
+		std::vector<int> members;
+		for (size_t l=k; l<points.size(); l++) {
+			if (!done[l] && points[l].p1 == points[k].p1 && points[l].p2 == points[k].p2) {
+				members.push_back(l);
+				done[l] = true;
+			}
+		}
+		ret = compute_SGM_penalties(cost_l, cost_r, rows, cols, disparity, dir, max_disp, cost_type, window_size, filter_win, shd_window, points, members, pool, ws);
+	}
+
+	if (!hit) {
+		fp::release_buffer(ws, cost_l);
+		if (two_volumes)
+			fp::release_buffer(ws, cost_r);
+	}
+	return ret;
+}
+
+// Sweep over penalties, left-right and uniqueness checks: the initial costs only depend on the images and the
+// cost parameters, so they are computed once and shared by all points, which write their disparity maps one
+// after the other into disparity; points with the same penalties also share the aggregated volumes. With a cache,
+// the initial volumes are also kept on disk under frame_key, a hash of the images and the cost parameters for
+// later runs. Each point without uniqueness check gives the same map as a compute_SGM/compute_SGM_lr run of its own.
+int compute_SGM_sweep(cv::Mat img1, cv::Mat img2, float *disparity,int dir,int max_disp,int cost_type,int window_size,int filter_win,int shd_window, const std::vector<SweepPoint> &points, const fp::CostCache *cache, const std::string &frame_key, fp::ThreadPool *pool, fp::StereoWorkspace *ws)
+{
+	if (cost_fits<CpuVolume>(cost_type, window_size, shd_window))
+		return compute_SGM_sweep_volume<CpuVolume::cost_type>(img1,img2,disparity,dir,max_disp,cost_type,window_size,filter_win,shd_window,points,cache,frame_key,pool,ws);
+	if (cost_fits<VolumeStorageWide>(cost_type, window_size, shd_window))
+		return compute_SGM_sweep_volume<VolumeStorageWide::cost_type>(img1,img2,disparity,dir,max_disp,cost_type,window_size,filter_win,shd_window,points,cache,frame_key,pool,ws);
+	return compute_SGM_sweep_volume<int>(img1,img2,disparity,dir,max_disp,cost_type,window_size,filter_win,shd_window,points,cache,frame_key,pool,ws);
 }
 
 void saveDisparityMap(float *disparity, int rows, int cols, int ndisparity, char* outputFile) {
@@ -1414,12 +2301,231 @@ void get_gt_disp(cv::Mat gt_disp, cv::Mat &actual_disp)
 }
 
 
+/* Settings of a benchmark run, shared by all image pairs */
+struct EvalConfig {
+    std::string ImageFolderDir;
+    int synthetic_scene;                    // fp::SyntheticScene generated instead of reading ImageFolderDir, or -1
+    int synthetic_rows;
+    int synthetic_cols;
+    int max_disp;
+    int dir;
+    int cost_type;
+    int window_size;
+    int filter_win;
+    int shd_window;
+    int fused;
+    std::vector<SweepPoint> points;         // penalties, left-right and uniqueness check of each result
+    std::vector<std::string> ResultsDirs;   // results folder of each point
+    const fp::CostCache *cache;             // initial costs kept on disk, or none
+};
+
+/* Decoded inputs of one image pair */
+struct FrameData {
+    int status;                 // 0: loaded, 1: an input image is missing
+    cv::Mat left_gray;
+    cv::Mat right_gray;
+    cv::Mat gt_disp_noc;
+    cv::Mat gt_disp_occ;
+    cv::Mat obj_map;
+};
+
+// Reads and decodes image pair i with its ground truth, on the threads of the prefetch queue
+void load_frame(int i, const EvalConfig &cfg, FrameData &frame)
+{
+    if (cfg.synthetic_scene >= 0)
+    {
+        // Pair i of the synthetic dataset, seeded with its number
+        fp::SyntheticPair pair;
+        fp::make_synthetic_pair(cfg.synthetic_scene,cfg.synthetic_rows,cfg.synthetic_cols,cfg.max_disp,i,pair);
+        frame.left_gray = pair.left;
+        frame.right_gray = pair.right;
+        frame.gt_disp_noc = pair.disp_noc;
+        frame.gt_disp_occ = pair.disp_occ;
+        frame.obj_map = pair.obj_map;
+        frame.status = 0;
+        return;
+    }
+    char prefix[256];
+    sprintf(prefix,"%06d_10",i);
+    std::string leftImageName = cfg.ImageFolderDir + "/image_2/" + prefix + ".png";
+    std::string rightImageName = cfg.ImageFolderDir + "/image_3/" + prefix + ".png";
+    std::string GTDispNocImage = cfg.ImageFolderDir + "/disp_noc_0/" + prefix + ".png";
+    std::string GTDispOccImage = cfg.ImageFolderDir + "/disp_occ_0/" + prefix + ".png";
+    std::string ObjectMap = cfg.ImageFolderDir + "/obj_map/" + prefix + ".png";
+
+    cv::Mat in_imgL_ori = cv::imread(leftImageName);
+    cv::Mat in_imgR_ori = cv::imread(rightImageName);
+    if (in_imgL_ori.data == NULL || in_imgR_ori.data == NULL)
+    {
+        fprintf(stderr,"Cannot open image at %s or %s\n",leftImageName.c_str(),rightImageName.c_str());
+        frame.status = 1;
+        return;
+    }
+
+    int crop_height = in_imgL_ori.rows;
+    int crop_width = in_imgL_ori.cols;
+    cv::Rect roi(0, 0, crop_width, crop_height);
+
+    cv::Mat in_imgL = in_imgL_ori(roi);
+    cv::Mat in_imgR = in_imgR_ori(roi);
+
+    cv::cvtColor(in_imgL, frame.left_gray, CV_BGR2GRAY);
+    cv::cvtColor(in_imgR, frame.right_gray, CV_BGR2GRAY);
+
+    cv::Mat gt_disp_noc_roi = cv::imread(GTDispNocImage,cv::IMREAD_UNCHANGED);
+    cv::Mat gt_disp_occ_roi = cv::imread(GTDispOccImage,cv::IMREAD_UNCHANGED);
+
+    frame.gt_disp_noc = gt_disp_noc_roi(roi);
+    frame.gt_disp_occ = gt_disp_occ_roi(roi);        
+
+    cv::Mat obj_map_roi;
+    obj_map_roi = cv::imread(ObjectMap,0);
+    frame.obj_map = obj_map_roi(roi);
+    frame.status = 0;
+}
+
+// Interpolates the disparity map of image pair i, measures its errors against the ground truth and queues its
+// result images on writer; without a writer only the errors are measured
+int score_frame(int i, const FrameData &frame, const float *disparity, const std::string &ResultsDir, fp::ImageWriter *writer, float *noc_errors, float *occ_errors)
+{
+    char prefix[256];
+    sprintf(prefix,"%06d_10",i);
+
+    unsigned short height  = frame.left_gray.rows;
+    unsigned short width  = frame.left_gray.cols;
+
+    // Write disparity to file
+    cv::Mat original_disp(height,width,CV_8UC1);
+    cv::Mat interpolate_disp(height,width,CV_8UC1);
+    for (int r = 0; r < height; r++)
+    {
+        for (int c = 0; c < width; c++)
+        {
+            original_disp.at<unsigned char>(r,c) = (unsigned char) (disparity[r*width+c]);
+            interpolate_disp.at<unsigned char>(r,c) = (unsigned char) (disparity[r*width+c]);
+        }
+    }
+
+    std::string DisparityImage = ResultsDir + "/results_disp/" + prefix + ".png";      
+
+    if (interpolate_disp.empty() == true)
+    {
+        fprintf(stderr,"Cannot open disparity image\n");
+        return 1;
+    }
+
+    {
+        fp::ScopedStage stage(fp::StageTimer::INTERPOLATION);
+        interpolateDisp(interpolate_disp);
+    }
+
+    cv::Mat gt_disp_noc = frame.gt_disp_noc;
+    cv::Mat gt_disp_occ = frame.gt_disp_occ;
+    cv::Mat obj_map = frame.obj_map;
+
+    compute_disparity_errors(original_disp,interpolate_disp,gt_disp_noc,obj_map,noc_errors);
+    compute_disparity_errors(original_disp,interpolate_disp,gt_disp_occ,obj_map,occ_errors);
+    
+    if(i<NUM_ERROR_IMAGES && writer){
+        //cv::Mat noc_error_mat(original_disp.rows,original_disp.cols,CV_8UC1,0);
+        cv::Mat occ_error_mat(original_disp.rows,original_disp.cols,CV_8UC1);
+        write_error_map(interpolate_disp,gt_disp_noc,gt_disp_occ,occ_error_mat); 
+        double min = 0;
+        double max = 10;
+        cv::Mat adjMap;
+        occ_error_mat.convertTo(adjMap,CV_8UC1, 255/(max-min), min);
+        cv::Mat falseColorMap;
+        cv::applyColorMap(adjMap, falseColorMap, cv::COLORMAP_JET);
+        writer->write(ResultsDir + "/errors_disp_occ_0/" + prefix + ".png", falseColorMap); 
+        
+        // cv::Mat actual_disp(original_disp.rows,original_disp.cols,CV_8UC1);
+        // cv::Mat falseColorMap_gt;
+        // get_gt_disp(gt_disp_occ, actual_disp);
+        // cv::applyColorMap(actual_disp, falseColorMap_gt, cv::COLORMAP_JET);
+        // cv::imwrite(ResultsDir + "/gt_disp_occ_0/" + prefix + ".png", falseColorMap_gt);                  
+        
+        cv::Mat falseColorMap_disp;
+        cv::applyColorMap(interpolate_disp, falseColorMap_disp, cv::COLORMAP_JET);
+        writer->write(ResultsDir + "/inter_disp_occ_0/" + prefix + ".png", falseColorMap_disp);
+        writer->write(DisparityImage, original_disp);        
+    }
+    return 0;
+}
+
+// Runs SGM on the loaded image pair i for every point of the run, queues the result images on writer and
+// fills the error counts of each point (2x13 values as compute_disparity_errors, noc then occ, per point).
+// The stages of the frame are added to timer. Returns 1 when an input image is missing, -1 when memory runs out.
+int evaluate_frame(int i, const FrameData &frame, const EvalConfig &cfg, fp::ThreadPool *pool, fp::StereoWorkspace *workspace, fp::ImageWriter *writer, fp::StageTimer *timer, float *errors)
+{
+    if (frame.status != 0)
+        return frame.status;
+    char prefix[256];
+    sprintf(prefix,"%06d_10",i);
+
+    cv::Mat in_imgL_gray = frame.left_gray;
+    cv::Mat in_imgR_gray = frame.right_gray;
+
+    unsigned short height  = in_imgL_gray.rows;
+    unsigned short width  = in_imgL_gray.cols;
+    int num_points = cfg.points.size();
+
+    // Array to store disparity, one map per point
+    float *disparity = (float*)workspace->buffer(fp::StereoWorkspace::DISP, num_points*height*width*sizeof(float));
+    if (!disparity) {
+        printf("Memory allocation failed for disparity..! \n");
+        return -1;
+    }
+
+    // One disparity map of height x width x max_disp pixel-disparities per point
+    timer->begin_frame(i, (long)num_points*height*width*cfg.max_disp);
+    int ret = 0;
+    {
+        fp::ScopedStage stage(fp::StageTimer::SGM);
+        const SweepPoint &point = cfg.points[0];
+        if(num_points > 1 || cfg.cache)
+            ret = compute_SGM_sweep(in_imgL_gray,in_imgR_gray,disparity,cfg.dir,cfg.max_disp,cfg.cost_type,cfg.window_size,cfg.filter_win,cfg.shd_window,cfg.points,cfg.cache,
+                    (cfg.synthetic_scene >= 0) ? cfg.ImageFolderDir + "_" + prefix : std::string(prefix),pool,workspace);
+        else if(point.lr_check)
+            ret = compute_SGM_lr(in_imgL_gray,in_imgR_gray,disparity,cfg.dir,cfg.max_disp,point.p1,point.p2,cfg.cost_type,cfg.window_size,cfg.filter_win,cfg.shd_window,point.lr_check,pool,workspace);
+        else if(cfg.fused)
+            ret = compute_SGM_fused(in_imgL_gray,in_imgR_gray,disparity,cfg.dir,cfg.max_disp,point.p1,point.p2,cfg.cost_type,cfg.window_size,cfg.filter_win,cfg.shd_window,pool,workspace);
+        else
+            ret = compute_SGM(in_imgL_gray,in_imgR_gray,disparity,cfg.dir,cfg.max_disp,point.p1,point.p2,cfg.cost_type,cfg.window_size,cfg.filter_win,cfg.shd_window,pool,workspace);
+    }
+    // a failed frame has no disparities to score
+    if (ret != 0) {
+        printf("SGM failed on pair %d..! \n", i);
+        timer->end_frame();
+        return -1;
+    }
+
+    for(int k=0; k<num_points && ret==0; k++){
+        ret = score_frame(i,frame,disparity+k*height*width,cfg.ResultsDirs[k],writer,errors+k*2*13,errors+k*2*13+13);
+    }
+    timer->end_frame();
+    return ret;
+}
+
+// Splits a comma separated list of integers, e.g. "10,20,40"
+std::vector<int> parse_list(const char *arg)
+{
+    std::vector<int> values;
+    std::stringstream ss(arg);
+    std::string item;
+    while(std::getline(ss,item,','))
+        values.push_back(std::atoi(item.c_str()));
+    return values;
+}
+
+#ifndef FP_SGBM_NO_MAIN
 int main(int argc, char** argv)
 {
-	if (argc != 10)
+	if (argc < 10 || argc > 16)
 	{
 		fprintf(stderr,"Invalid Number of Arguments!\nUsage:\n");
-		fprintf(stderr,"<Executable Name> <Dataset folder path> <MAX_DISPARITY> <NUM_DIR> <P1> <P2> <COST_TYPE> <COST_WINDOW> <FILTER_WINDOW> <SHD_WINDOW> \n");
+		fprintf(stderr,"<Executable Name> <Dataset folder path> <MAX_DISPARITY> <NUM_DIR> <P1> <P2> <COST_TYPE> <COST_WINDOW> <FILTER_WINDOW> <SHD_WINDOW> [NUM_THREADS] [FUSED] [WORKSPACE_FLAGS] [LR_CHECK] [BATCH] [COST_CACHE_DIR] \n");
+		fprintf(stderr,"P1, P2 and LR_CHECK may be comma separated lists: P1/P2 are taken pairwise, each pair with each LR_CHECK.\n");
+		fprintf(stderr,"The dataset folder may be synthetic:<dots|planes>:<width>x<height>, generated in memory with results in ./synthetic_<dots|planes>_<width>x<height>.\n");
 		return -1;
 	}
 
@@ -1427,186 +2533,222 @@ int main(int argc, char** argv)
 
     int max_disp = std::atoi(argv[2]);
     int dir = std::atoi(argv[3]);
-    int p1 = std::atoi(argv[4]); 
-    int p2 = std::atoi(argv[5]);
+    std::vector<int> p1_list = parse_list(argv[4]);
+    std::vector<int> p2_list = parse_list(argv[5]);
     int cost_type = std::atoi(argv[6]);
     int window_size = std::atoi(argv[7]);
     int filter_win = std::atoi(argv[8]);
     int shd_window = std::atoi(argv[9]);
-
-    if(p1>=p2){
-        fprintf(stderr,"P1 should be smaller than P2\n");
+    // Worker threads for the cost aggregation, and with FUSED for the costs of the next band; the results do not depend on it.
+    int num_threads = (argc >= 11) ? std::atoi(argv[10]) : 1;
+    // 1: band-fused cost/aggregation/WTA pipeline (compute_SGM_fused), same results
+    int fused = (argc >= 12) ? std::atoi(argv[11]) : 0;
+    // Buffers reused across the image pairs, 1: huge pages, 2: locked in memory (fp::StereoWorkspace::Flags)
+    int ws_flags = (argc >= 13) ? std::atoi(argv[12]) : 0;
+    // Left-right check as LR_CHECK of fp_config_arch.h, 0: none, 1: single aggregated volume, 2: left and right volumes
+    std::vector<int> lr_list = (argc >= 14) ? parse_list(argv[13]) : std::vector<int>(1, 0);
+    // Image pairs processed at the same time, each worker with its own workspace; the results do not depend on it.
+    int batch = (argc >= 15) ? std::atoi(argv[14]) : 1;
+    // Directory keeping the initial cost volumes between runs, see fp::CostCache
+    std::string cache_dir = (argc == 16) ? argv[15] : "";
+
+    if(p1_list.empty() || p2_list.empty() || lr_list.empty()){
+        fprintf(stderr,"P1, P2 and LR_CHECK should not be empty\n");
         return -1;
     }
+    if(p1_list.size() != p2_list.size() && p1_list.size() != 1 && p2_list.size() != 1){
+        fprintf(stderr,"P1 and P2 should have the same number of values\n");
+        return -1;
+    }
+    // Points of the run: every P1/P2 pair with every left-right check
+    std::vector<SweepPoint> points;
+    int num_pairs = std::max(p1_list.size(), p2_list.size());
+    for(int k=0; k<num_pairs; k++){
+        for(size_t l=0; l<lr_list.size(); l++){
+            SweepPoint point;
+            point.p1 = p1_list[std::min<int>(k, p1_list.size()-1)];
+            point.p2 = p2_list[std::min<int>(k, p2_list.size()-1)];
+            point.lr_check = lr_list[l];
+            point.uniq = 0;
+            if(point.p1>=point.p2){
+                fprintf(stderr,"P1 should be smaller than P2\n");
+                return -1;
+            }
+            if(point.lr_check<0 || point.lr_check>LR_TWO_VOLUMES){
+                fprintf(stderr,"LR_CHECK should be 0, 1 or 2\n");
+                return -1;
+            }
+            points.push_back(point);
+        }
+    }
+    if(num_threads<1){
+        fprintf(stderr,"NUM_THREADS should be at least 1\n");
+        return -1;
+    }
+    if(batch<1){
+        fprintf(stderr,"BATCH should be at least 1\n");
+        return -1;
+    }
+    int num_points = points.size();
 
-    std::string option = std::string(argv[2]) + "_" + std::string(argv[3]) + "_" + std::string(argv[4]) + "_" + std::string(argv[5]) + "_" + std::string(argv[6]) + "_" + std::string(argv[7]) + "_" + std::string(argv[8]) + "_" + std::string(argv[9]);
-    std::string ResultsDir = ImageFolderDir + "/results/" + option;
-
-    int succeed = std::system(("mkdir " + ResultsDir).c_str());
-    int succeed1 = std::system(("mkdir " + ResultsDir + "/results_disp").c_str());
-    int succeed2 = std::system(("mkdir " + ResultsDir + "/errors_disp_occ_0").c_str());
-    int succeed3 = std::system(("mkdir " + ResultsDir + "/inter_disp_occ_0").c_str());
-
-    if(!succeed && !succeed1 && !succeed2 && !succeed3){
-        fprintf(stderr,"Successfully construct new directories.\n");
+    EvalConfig cfg;
+    cfg.synthetic_scene = -1;
+    if(fp::parse_synthetic_spec(ImageFolderDir,cfg.synthetic_scene,cfg.synthetic_rows,cfg.synthetic_cols)){
+        if(cfg.synthetic_scene < 0)
+            return -1;
+        // The results of a synthetic dataset go to a folder of the working directory
+        char folder[64];
+        sprintf(folder,"synthetic_%s_%dx%d",(cfg.synthetic_scene == fp::RANDOM_DOT) ? "dots" : "planes",cfg.synthetic_cols,cfg.synthetic_rows);
+        ImageFolderDir = folder;
+        if(std::system(("mkdir -p " + ImageFolderDir + "/results").c_str()) != 0)
+            fprintf(stderr,"Cannot create %s/results\n",ImageFolderDir.c_str());
     }
+    cfg.ImageFolderDir = ImageFolderDir;
+    cfg.max_disp = max_disp;
+    cfg.dir = dir;
+    cfg.cost_type = cost_type;
+    cfg.window_size = window_size;
+    cfg.filter_win = filter_win;
+    cfg.shd_window = shd_window;
+    cfg.fused = fused;
+    cfg.points = points;
+
+    fp::CostCache cost_cache(cache_dir);
+    cfg.cache = cache_dir.empty() ? NULL : &cost_cache;
+    if(cfg.cache && std::system(("mkdir -p " + cache_dir).c_str()) != 0)
+        fprintf(stderr,"Cannot create %s\n",cache_dir.c_str());
+
+    std::vector<FILE*> stats_noc_files(num_points);
+    std::vector<FILE*> stats_occ_files(num_points);
+    for(int k=0; k<num_points; k++){
+        char option[256];
+        sprintf(option,"%s_%s_%d_%d_%s_%s_%s_%s",argv[2],argv[3],points[k].p1,points[k].p2,argv[6],argv[7],argv[8],argv[9]);
+        std::string ResultsDir = ImageFolderDir + "/results/" + option;
+        if(points[k].lr_check)
+            ResultsDir += "_lr" + std::to_string(points[k].lr_check);
+        cfg.ResultsDirs.push_back(ResultsDir);
+
+        int succeed = std::system(("mkdir " + ResultsDir).c_str());
+        int succeed1 = std::system(("mkdir " + ResultsDir + "/results_disp").c_str());
+        int succeed2 = std::system(("mkdir " + ResultsDir + "/errors_disp_occ_0").c_str());
+        int succeed3 = std::system(("mkdir " + ResultsDir + "/inter_disp_occ_0").c_str());
+
+        if(!succeed && !succeed1 && !succeed2 && !succeed3){
+            fprintf(stderr,"Successfully construct new directories.\n");
+        }
 
-    FILE *stats_noc_file = fopen((ResultsDir + "/stats_disp_noc_0.txt").c_str(),"w");
-    FILE *stats_occ_file = fopen((ResultsDir + "/stats_disp_occ_0.txt").c_str(),"w");
+        stats_noc_files[k] = fopen((ResultsDir + "/stats_disp_noc_0.txt").c_str(),"w");
+        stats_occ_files[k] = fopen((ResultsDir + "/stats_disp_occ_0.txt").c_str(),"w");
+    }
 
-    // accumulators
-    float errors_disp_noc_0[3*4] = {0,0,0,0,0,0,0,0,0,0,0,0};
-    float errors_disp_occ_0[3*4] = {0,0,0,0,0,0,0,0,0,0,0,0};       
+    // accumulators, 3*4 per point
+    std::vector<float> errors_disp_noc_0(num_points*3*4, 0.0f);
+    std::vector<float> errors_disp_occ_0(num_points*3*4, 0.0f);
    
     printf("Start runing SGM on image pairs...\n");    
-    //clock_t timer_start=clock();   
-    for(int i=0; i<NUM_TEST_IMAGES; i++){
-        char prefix[256];
-        sprintf(prefix,"%06d_10",i);
-        std::string leftImageName = ImageFolderDir + "/image_2/" + prefix + ".png";
-        std::string rightImageName = ImageFolderDir + "/image_3/" + prefix + ".png";
 
-        cv::Mat in_imgL_ori = cv::imread(leftImageName);
-        cv::Mat in_imgR_ori = cv::imread(rightImageName);
-        if (in_imgL_ori.data == NULL || in_imgR_ori.data == NULL)
-        {
-            fprintf(stderr,"Cannot open image at %s or %s\n",leftImageName.c_str(),rightImageName.c_str());
-            return 0;
-        }
-
-        int crop_height = in_imgL_ori.rows;
-        int crop_width = in_imgL_ori.cols;
-        cv::Rect roi(0, 0, crop_width, crop_height);
-
-        cv::Mat in_imgL = in_imgL_ori(roi);
-        cv::Mat in_imgR = in_imgR_ori(roi);
-        cv::Mat in_imgL_gray, in_imgR_gray;
+    // The image pairs are handed out in order to batch workers, which share the NUM_THREADS aggregation threads.
+    // The errors of every pair are kept and summed up in image order afterwards, so the stats files are the
+    // same for any batch and thread count.
+    std::vector<float> frame_errors(NUM_TEST_IMAGES*num_points*2*13, 0.0f);
+    std::vector<int> frame_status(NUM_TEST_IMAGES, 1);
+    std::vector<fp::StageTimer> timers(batch);
+    {
+        // PNG decoding runs ahead of the compute on one loader thread per worker and encoding behind it
+        // on the writer thread, so the workers do not wait on either.
+        fp::PrefetchQueue<FrameData> loader(NUM_TEST_IMAGES, FRAME_PREFETCH*batch, batch,
+                [&cfg](int i, FrameData &frame){ load_frame(i,cfg,frame); });
+        fp::ImageWriter writer(FRAME_WRITE_QUEUE);
+        fp::ThreadPool frames(batch);
+        //clock_t timer_start=clock();   
+        frames.run(batch, [&](int worker){
+            fp::ThreadPool pool(std::max(1, num_threads/batch));
+            fp::StereoWorkspace workspace(ws_flags);
+            int i;
+            FrameData frame;
+            while(loader.pop(i,frame)){
+                frame_status[i] = evaluate_frame(i,frame,cfg,&pool,&workspace,&writer,&timers[worker],&frame_errors[i*num_points*2*13]);
+                // the pairs before a failed one are still needed for the stats, those after it are not
+                if(frame_status[i] != 0)
+                    loader.stop_after(i);
+            }
+        });
+    }
 
-        unsigned short height  = in_imgL.rows;
-        unsigned short width  = in_imgL.cols;
-        
-        cv::cvtColor(in_imgL, in_imgL_gray, CV_BGR2GRAY);
-        cv::cvtColor(in_imgR, in_imgR_gray, CV_BGR2GRAY);
+    // Stage times of the whole run (all points of a sweep), next to the stats of the first point
+    fp::StageTimer timer;
+    for(int t=0; t<batch; t++)
+        timer.merge(timers[t]);
+    FILE *timing_file = fopen((cfg.ResultsDirs[0] + "/timing.txt").c_str(),"w");
+    FILE *timing_json = fopen((cfg.ResultsDirs[0] + "/timing.json").c_str(),"w");
+    if(timing_file){
+        timer.report(timing_file);
+        fclose(timing_file);
+    }
+    if(timing_json){
+        timer.report_json(timing_json);
+        fclose(timing_json);
+    }
 
-        // Array to store disparity
-        float *disparity = (float*)malloc(height*width*sizeof(float));
-        if (!disparity) {
-            printf("Memory allocation failed for disparity..! \n");
-            return -1;
-        }
+    for(int i=0; i<NUM_TEST_IMAGES; i++){
+        if(frame_status[i] != 0)
+            return (frame_status[i] > 0) ? 0 : -1;
+        char prefix[256];
+        sprintf(prefix,"%06d_10",i);
+        for(int k=0; k<num_points; k++){
+            float *noc_errors = &frame_errors[(i*num_points+k)*2*13];
+            float *occ_errors = noc_errors+13;
+            FILE *stats_noc_file = stats_noc_files[k];
+            FILE *stats_occ_file = stats_occ_files[k];
+
+            for(int num=0; num<12; num++){
+                errors_disp_noc_0[k*12+num] += noc_errors[num];
+                errors_disp_occ_0[k*12+num] += occ_errors[num];
+            }
 
-        compute_SGM(in_imgL_gray,in_imgR_gray,disparity,dir,max_disp,p1,p2,cost_type,window_size,filter_win,shd_window);
-        //compute_SGM_lr(in_imgL_gray,in_imgR_gray,disparity,dir,max_disp,p1,p2,cost_type,window_size,filter_win,shd_window);
-        
-        // Write disparity to file
-        cv::Mat original_disp(height,width,CV_8UC1);
-        cv::Mat interpolate_disp(height,width,CV_8UC1);
-        for (int r = 0; r < height; r++)
-        {
-            for (int c = 0; c < width; c++)
-            {
-                original_disp.at<unsigned char>(r,c) = (unsigned char) (disparity[r*width+c]);
-                interpolate_disp.at<unsigned char>(r,c) = (unsigned char) (disparity[r*width+c]);
+            if(i<NUM_ERROR_IMAGES){
+                fprintf(stats_noc_file,"%s: ",prefix);
+                for(int j=0; j<12; j+=2){
+                    fprintf(stats_noc_file,"%f ",noc_errors[j]/std::max(noc_errors[j+1],1.0f));
+                }
+                fprintf(stats_noc_file,"%f ",noc_errors[12]);
+                fprintf(stats_noc_file,"\n");
+                
+                fprintf(stats_occ_file,"%s: ",prefix);
+                for(int j=0; j<12; j+=2){
+                    fprintf(stats_occ_file,"%f ",occ_errors[j]/std::max(occ_errors[j+1],1.0f));
+                }
+                fprintf(stats_occ_file,"%f ",occ_errors[12]);
+                fprintf(stats_occ_file,"\n");
             }
         }
-
-        free(disparity);
-    
-    // clock_t timer_end=clock();
-    // double time_consume=(double)(timer_end-timer_start)/CLOCKS_PER_SEC;
-    // printf("Total time consumed for computing disparity maps: %f\n",time_consume);    
-   
-        std::string DisparityImage = ResultsDir + "/results_disp/" + prefix + ".png";      
-        std::string GTDispNocImage = ImageFolderDir + "/disp_noc_0/" + prefix + ".png";
-        std::string GTDispOccImage = ImageFolderDir + "/disp_occ_0/" + prefix + ".png";
-        std::string ObjectMap = ImageFolderDir + "/obj_map/" + prefix + ".png";
+    }
     
-        if (interpolate_disp.empty() == true)
-        {
-            fprintf(stderr,"Cannot open disparity image\n");
-            return 0;
+    for(int k=0; k<num_points; k++){
+        const float *noc_sum = &errors_disp_noc_0[k*12];
+        const float *occ_sum = &errors_disp_occ_0[k*12];
+        FILE *stats_noc_file = stats_noc_files[k];
+        FILE *stats_occ_file = stats_occ_files[k];
+
+        fprintf(stats_noc_file,"%s: ","Average");
+        for(int i=0; i<12; i+=2){
+            fprintf(stats_noc_file,"%f ",noc_sum[i]/std::max(noc_sum[i+1],1.0f));
         }
-
-        interpolateDisp(interpolate_disp);
-
-        cv::Mat gt_disp_noc_roi = cv::imread(GTDispNocImage,cv::IMREAD_UNCHANGED);
-        cv::Mat gt_disp_occ_roi = cv::imread(GTDispOccImage,cv::IMREAD_UNCHANGED);
-
-        cv::Mat gt_disp_noc = gt_disp_noc_roi(roi);
-        cv::Mat gt_disp_occ = gt_disp_occ_roi(roi);        
-
-        cv::Mat obj_map_roi;
-        obj_map_roi = cv::imread(ObjectMap,0);
-        cv::Mat obj_map = obj_map_roi(roi);
-
-        float noc_errors[13] = {0,0,0,0,0,0,0,0,0,0,0,0,0};
-        float occ_errors[13] = {0,0,0,0,0,0,0,0,0,0,0,0,0};
-
-        compute_disparity_errors(original_disp,interpolate_disp,gt_disp_noc,obj_map,noc_errors);
-        compute_disparity_errors(original_disp,interpolate_disp,gt_disp_occ,obj_map,occ_errors);
+        fprintf(stats_noc_file,"%f ",noc_sum[11]/std::max(noc_sum[9],1.0f));
+        fprintf(stats_noc_file,"\n");
+        fclose(stats_noc_file);
         
-        for(int num=0; num<12; num++){
-            errors_disp_noc_0[num] += noc_errors[num];
-            errors_disp_occ_0[num] += occ_errors[num];
+        fprintf(stats_occ_file,"%s: ","Average");
+        for(int i=0; i<12; i+=2){
+            fprintf(stats_occ_file,"%f ",occ_sum[i]/std::max(occ_sum[i+1],1.0f));
         }
+        fprintf(stats_occ_file,"%f ",occ_sum[11]/std::max(occ_sum[9],1.0f));
+        fprintf(stats_occ_file,"\n");
+        fclose(stats_occ_file);             
 
-        if(i<NUM_ERROR_IMAGES){
-            fprintf(stats_noc_file,"%s: ",prefix);
-            for(int j=0; j<12; j+=2){
-                fprintf(stats_noc_file,"%f ",noc_errors[j]/std::max(noc_errors[j+1],1.0f));
-            }
-            fprintf(stats_noc_file,"%f ",noc_errors[12]);
-            fprintf(stats_noc_file,"\n");
-            
-            fprintf(stats_occ_file,"%s: ",prefix);
-            for(int j=0; j<12; j+=2){
-                fprintf(stats_occ_file,"%f ",occ_errors[j]/std::max(occ_errors[j+1],1.0f));
-            }
-            fprintf(stats_occ_file,"%f ",occ_errors[12]);
-            fprintf(stats_occ_file,"\n");
-            
-            //cv::Mat noc_error_mat(original_disp.rows,original_disp.cols,CV_8UC1,0);
-            cv::Mat occ_error_mat(original_disp.rows,original_disp.cols,CV_8UC1);
-            write_error_map(interpolate_disp,gt_disp_noc,gt_disp_occ,occ_error_mat); 
-            double min = 0;
-            double max = 10;
-            cv::Mat adjMap;
-            occ_error_mat.convertTo(adjMap,CV_8UC1, 255/(max-min), min);
-            cv::Mat falseColorMap;
-            cv::applyColorMap(adjMap, falseColorMap, cv::COLORMAP_JET);
-            cv::imwrite(ResultsDir + "/errors_disp_occ_0/" + prefix + ".png", falseColorMap); 
-            
-            // cv::Mat actual_disp(original_disp.rows,original_disp.cols,CV_8UC1);
-            // cv::Mat falseColorMap_gt;
-            // get_gt_disp(gt_disp_occ, actual_disp);
-            // cv::applyColorMap(actual_disp, falseColorMap_gt, cv::COLORMAP_JET);
-            // cv::imwrite(ResultsDir + "/gt_disp_occ_0/" + prefix + ".png", falseColorMap_gt);                  
-            
-            cv::Mat falseColorMap_disp;
-            cv::applyColorMap(interpolate_disp, falseColorMap_disp, cv::COLORMAP_JET);
-            cv::imwrite(ResultsDir + "/inter_disp_occ_0/" + prefix + ".png", falseColorMap_disp);
-            cv::imwrite(DisparityImage, original_disp);        
-        }
-    }
-    
-    fprintf(stats_noc_file,"%s: ","Average");
-    for(int i=0; i<12; i+=2){
-        fprintf(stats_noc_file,"%f ",errors_disp_noc_0[i]/std::max(errors_disp_noc_0[i+1],1.0f));
+        printf("%f ",noc_sum[8]/std::max(noc_sum[9],1.0f));
+        printf("%f ",occ_sum[8]/std::max(occ_sum[9],1.0f));
     }
-    fprintf(stats_noc_file,"%f ",errors_disp_noc_0[11]/std::max(errors_disp_noc_0[9],1.0f));
-    fprintf(stats_noc_file,"\n");
-    fclose(stats_noc_file);
-    
-    fprintf(stats_occ_file,"%s: ","Average");
-    for(int i=0; i<12; i+=2){
-        fprintf(stats_occ_file,"%f ",errors_disp_occ_0[i]/std::max(errors_disp_occ_0[i+1],1.0f));
-    }
-    fprintf(stats_occ_file,"%f ",errors_disp_occ_0[11]/std::max(errors_disp_occ_0[9],1.0f));
-    fprintf(stats_occ_file,"\n");
-    fclose(stats_occ_file);             
-
-    printf("%f ",errors_disp_noc_0[8]/std::max(errors_disp_noc_0[9],1.0f));
-    printf("%f ",errors_disp_occ_0[8]/std::max(errors_disp_occ_0[9],1.0f));
 
     printf("Finish successfully!\n");
 	//clock_t timer_end1=clock();
@@ -1614,3 +2756,4 @@ int main(int argc, char** argv)
     //printf("Total time consumed for computing disparity maps: %f\n",time_consume); 
     return 0;
 }
+#endif // FP_SGBM_NO_MAIN
@@ -14,5 +14,26 @@
 #define ABS_THRESH 3.0
 #define REL_THRESH 0.05
 
+/* Rows each path advances between two synchronizations in cost_aggregation_parallel */
+#define AGGR_BAND_ROWS 16
+/* Scanline chunks per worker thread and path in cost_aggregation_parallel */
+#define AGGR_CHUNKS_PER_THREAD 2
+/* Image rows per band of compute_SGM_fused */
+#define FUSED_BAND_ROWS 16
+
+/* Histogram bins of median_filter, disparities from 0 to MEDIAN_HIST_BINS-1 */
+#define MEDIAN_HIST_BINS 256
+
+/* Image pairs decoded ahead of the benchmark loop, per batch worker */
+#define FRAME_PREFETCH 2
+/* Result images queued for encoding before the benchmark loop waits */
+#define FRAME_WRITE_QUEUE 16
+
+/* Left-right check of compute_SGM_lr, numbered as LR_CHECK in fp_config_arch.h */
+/* Right disparities read diagonally from the left aggregated volume */
+#define LR_SINGLE_VOLUME 1
+/* Right disparities from their own cost and aggregated volumes */
+#define LR_TWO_VOLUMES 2
+
 
 #endif  // end of _FP_SGBM_ACCEL_H_
\ No newline at end of file
@@ -0,0 +1,147 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+#ifndef _FP_SGBM_CENSUS_HPP_
+#define _FP_SGBM_CENSUS_HPP_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FP_CENSUS_X86 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FP_CENSUS_NEON 1
+#endif
+
+/* Largest census window whose descriptor (window_size^2-1 bits) fits in two 64-bit words */
+#define CENSUS_PACKED_MAX_WINDOW 11
+
+/*
+ * Census transform into packed descriptors: bit k of the descriptor (word k/64 of lo/hi) is set when the k-th
+ * window neighbour (raster order, centre skipped) is darker than the centre. Pixels outside of the image are 0,
+ * as in compute_census_transform. Each neighbour is compared for a whole row at once in a branch-free loop
+ * that the compiler turns into byte-wise SIMD compares.
+ */
+inline int census_transform_packed(const uint8_t *img, int step, int rows, int cols, int window_size, uint64_t *lo, uint64_t *hi) {
+	int h = window_size/2;
+	int pw = cols+2*h;
+	uint8_t *pad = (uint8_t*)calloc((rows+2*h)*pw, sizeof(uint8_t));
+	if (!pad)
+		return -1;
+	for (int i=0; i<rows; i++) {
+		memcpy(pad+(i+h)*pw+h, img+i*step, cols);
+	}
+	for (int i=0; i<rows; i++) {
+		uint64_t *lo_row = lo+i*cols;
+		uint64_t *hi_row = hi+i*cols;
+		const uint8_t *centre = pad+(i+h)*pw+h;
+		memset(lo_row, 0, cols*sizeof(uint64_t));
+		memset(hi_row, 0, cols*sizeof(uint64_t));
+		int k = 0;
+		for (int di=-h; di<=h; di++) {
+			for (int dj=-h; dj<=h; dj++) {
+				if (di==0 && dj==0)
+					continue;
+				const uint8_t *ref = centre+di*pw+dj;
+				if (k<64) {
+					for (int j=0; j<cols; j++)
+						lo_row[j] |= (uint64_t)(ref[j] < centre[j]) << k;
+				}
+				else {
+					for (int j=0; j<cols; j++)
+						hi_row[j] |= (uint64_t)(ref[j] < centre[j]) << (k-64);
+				}
+				k++;
+			}
+		}
+	}
+	free(pad);
+	return 0;
+}
+
+/*
+ * Hamming costs of one descriptor (lo,hi) against n consecutive descriptors (tlo[d],thi[d]):
+ * cost[d] = popcount(lo^tlo[d]) + popcount(hi^thi[d]).
+ */
+typedef void (*hamming_costs_t)(uint64_t lo, uint64_t hi, const uint64_t *tlo, const uint64_t *thi, int *cost, int n);
+
+inline void hamming_costs_scalar(uint64_t lo, uint64_t hi, const uint64_t *tlo, const uint64_t *thi, int *cost, int n) {
+	for (int d=0; d<n; d++) {
+		cost[d] = __builtin_popcountll(lo^tlo[d]) + __builtin_popcountll(hi^thi[d]);
+	}
+}
+
+#ifdef FP_CENSUS_X86
+/* Same code as hamming_costs_scalar, compiled to the POPCNT instruction */
+__attribute__((target("popcnt")))
+inline void hamming_costs_popcnt(uint64_t lo, uint64_t hi, const uint64_t *tlo, const uint64_t *thi, int *cost, int n) {
+	for (int d=0; d<n; d++) {
+		cost[d] = __builtin_popcountll(lo^tlo[d]) + __builtin_popcountll(hi^thi[d]);
+	}
+}
+
+/* 4 disparities per step: nibble lookup popcount (vpshufb) summed per 64-bit lane with vpsadbw */
+__attribute__((target("avx2")))
+inline void hamming_costs_avx2(uint64_t lo, uint64_t hi, const uint64_t *tlo, const uint64_t *thi, int *cost, int n) {
+	const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4, 0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	const __m256i vlo = _mm256_set1_epi64x((long long)lo);
+	const __m256i vhi = _mm256_set1_epi64x((long long)hi);
+	const __m256i pack = _mm256_setr_epi32(0,2,4,6,0,2,4,6);
+	int d = 0;
+	for (; d+4<=n; d+=4) {
+		__m256i xlo = _mm256_xor_si256(vlo, _mm256_loadu_si256((const __m256i*)(tlo+d)));
+		__m256i xhi = _mm256_xor_si256(vhi, _mm256_loadu_si256((const __m256i*)(thi+d)));
+		__m256i cnt = _mm256_add_epi8(
+				_mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(xlo, nibble)),
+						_mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(xlo, 4), nibble))),
+				_mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(xhi, nibble)),
+						_mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(xhi, 4), nibble))));
+		__m256i sum = _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+		_mm_storeu_si128((__m128i*)(cost+d), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(sum, pack)));
+	}
+	hamming_costs_popcnt(lo, hi, tlo+d, thi+d, cost+d, n-d);
+}
+#endif
+
+#ifdef FP_CENSUS_NEON
+/* 2 disparities per step: vcnt per byte, then pairwise widening adds per 64-bit lane */
+inline void hamming_costs_neon(uint64_t lo, uint64_t hi, const uint64_t *tlo, const uint64_t *thi, int *cost, int n) {
+	const uint64x2_t vlo = vdupq_n_u64(lo);
+	const uint64x2_t vhi = vdupq_n_u64(hi);
+	int d = 0;
+	for (; d+2<=n; d+=2) {
+		uint8x16_t cnt = vaddq_u8(vcntq_u8(vreinterpretq_u8_u64(veorq_u64(vlo, vld1q_u64(tlo+d)))),
+				vcntq_u8(vreinterpretq_u8_u64(veorq_u64(vhi, vld1q_u64(thi+d)))));
+		uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(cnt)));
+		cost[d] = (int)vgetq_lane_u64(sum, 0);
+		cost[d+1] = (int)vgetq_lane_u64(sum, 1);
+	}
+	hamming_costs_scalar(lo, hi, tlo+d, thi+d, cost+d, n-d);
+}
+#endif
+
+/* Pick the fastest Hamming cost kernel the running CPU supports. */
+inline hamming_costs_t select_hamming_costs() {
+#ifdef FP_CENSUS_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return hamming_costs_avx2;
+	if (__builtin_cpu_supports("popcnt"))
+		return hamming_costs_popcnt;
+#endif
+#ifdef FP_CENSUS_NEON
+	return hamming_costs_neon;
+#endif
+	return hamming_costs_scalar;
+}
+
+#endif // _FP_SGBM_CENSUS_HPP_
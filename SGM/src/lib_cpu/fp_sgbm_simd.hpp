@@ -0,0 +1,133 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+#ifndef _FP_SGBM_SIMD_HPP_
+#define _FP_SGBM_SIMD_HPP_
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FP_SIMD_X86 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FP_SIMD_NEON 1
+#endif
+
+/* Disparities processed per SIMD step; the 16-bit Lr buffers are padded to a multiple of it */
+#define SIMD_DISPARITIES 16
+
+/* Saturation value of the 16-bit costs. Padding lanes and the d=-1/d=ndisparity neighbours hold it,
+   so they never win a min, just like the INT_MAX-P1 sentinels of path_update. */
+#define SIMD_COST_MAX 0xFFFF
+
+/* Number of uint16_t per pixel in the 16-bit buffers: one sentinel on each side of the padded disparities. */
+inline int simd_pixel_stride(int ndisparity) {
+	return (ndisparity+SIMD_DISPARITIES-1)/SIMD_DISPARITIES*SIMD_DISPARITIES + 2;
+}
+
+/*
+ * 16-bit saturated version of path_update. Lrpr and Cp point at disparity 0 of a pixel slot laid out as
+ * [sentinel | ndisparity_pad values | sentinel], Lrpr[-1] and Lrpr[ndisparity_pad] being SIMD_COST_MAX.
+ * As long as max(C)+P2 < SIMD_COST_MAX nothing saturates and the result equals path_update.
+ */
+typedef void (*path_update_u16_t)(uint16_t *Lrp, const uint16_t *Lrpr, const uint16_t *Cp, int ndisparity_pad, uint16_t P1, uint16_t P2);
+
+inline uint16_t sat_add_u16(uint16_t a, uint16_t b) {
+	unsigned int sum = (unsigned int)a + b;
+	return (sum > SIMD_COST_MAX) ? SIMD_COST_MAX : (uint16_t)sum;
+}
+
+inline void path_update_u16_scalar(uint16_t *Lrp, const uint16_t *Lrpr, const uint16_t *Cp, int ndisparity_pad, uint16_t P1, uint16_t P2) {
+	uint16_t minLri = Lrpr[0];
+	for (int i=1; i<ndisparity_pad; i++) {
+		if (minLri > Lrpr[i])
+			minLri = Lrpr[i];
+	}
+	uint16_t minP2 = sat_add_u16(minLri, P2);
+	for (int d=0; d<ndisparity_pad; d++) {
+		uint16_t v1 = Lrpr[d];
+		uint16_t tmp = sat_add_u16(Lrpr[d-1], P1);
+		if (v1 > tmp)
+			v1 = tmp;
+		tmp = sat_add_u16(Lrpr[d+1], P1);
+		if (v1 > tmp)
+			v1 = tmp;
+		if (v1 > minP2)
+			v1 = minP2;
+		Lrp[d] = sat_add_u16(Cp[d], v1-minLri);
+	}
+}
+
+#ifdef FP_SIMD_X86
+__attribute__((target("avx2")))
+inline void path_update_u16_avx2(uint16_t *Lrp, const uint16_t *Lrpr, const uint16_t *Cp, int ndisparity_pad, uint16_t P1, uint16_t P2) {
+	__m256i vmin = _mm256_loadu_si256((const __m256i*)Lrpr);
+	for (int d=SIMD_DISPARITIES; d<ndisparity_pad; d+=SIMD_DISPARITIES) {
+		vmin = _mm256_min_epu16(vmin, _mm256_loadu_si256((const __m256i*)(Lrpr+d)));
+	}
+	__m128i hmin = _mm_min_epu16(_mm256_castsi256_si128(vmin), _mm256_extracti128_si256(vmin, 1));
+	uint16_t minLri = (uint16_t)_mm_cvtsi128_si32(_mm_minpos_epu16(hmin));
+
+	__m256i vminLri = _mm256_set1_epi16((short)minLri);
+	__m256i vminP2 = _mm256_adds_epu16(vminLri, _mm256_set1_epi16((short)P2));
+	__m256i vP1 = _mm256_set1_epi16((short)P1);
+	for (int d=0; d<ndisparity_pad; d+=SIMD_DISPARITIES) {
+		__m256i Lrpd = _mm256_loadu_si256((const __m256i*)(Lrpr+d));
+		__m256i Lrpdm1 = _mm256_loadu_si256((const __m256i*)(Lrpr+d-1));
+		__m256i Lrpdp1 = _mm256_loadu_si256((const __m256i*)(Lrpr+d+1));
+		__m256i v1 = _mm256_min_epu16(Lrpd, _mm256_adds_epu16(Lrpdm1, vP1));
+		v1 = _mm256_min_epu16(v1, _mm256_adds_epu16(Lrpdp1, vP1));
+		v1 = _mm256_min_epu16(v1, vminP2);
+		__m256i Cpd = _mm256_loadu_si256((const __m256i*)(Cp+d));
+		_mm256_storeu_si256((__m256i*)(Lrp+d), _mm256_adds_epu16(Cpd, _mm256_subs_epu16(v1, vminLri)));
+	}
+}
+#endif
+
+#ifdef FP_SIMD_NEON
+inline void path_update_u16_neon(uint16_t *Lrp, const uint16_t *Lrpr, const uint16_t *Cp, int ndisparity_pad, uint16_t P1, uint16_t P2) {
+	uint16x8_t vmin = vminq_u16(vld1q_u16(Lrpr), vld1q_u16(Lrpr+8));
+	for (int d=SIMD_DISPARITIES; d<ndisparity_pad; d+=SIMD_DISPARITIES) {
+		vmin = vminq_u16(vmin, vminq_u16(vld1q_u16(Lrpr+d), vld1q_u16(Lrpr+d+8)));
+	}
+#if defined(__aarch64__)
+	uint16_t minLri = vminvq_u16(vmin);
+#else
+	uint16x4_t hmin = vpmin_u16(vget_low_u16(vmin), vget_high_u16(vmin));
+	hmin = vpmin_u16(hmin, hmin);
+	hmin = vpmin_u16(hmin, hmin);
+	uint16_t minLri = vget_lane_u16(hmin, 0);
+#endif
+
+	uint16x8_t vminLri = vdupq_n_u16(minLri);
+	uint16x8_t vminP2 = vqaddq_u16(vminLri, vdupq_n_u16(P2));
+	uint16x8_t vP1 = vdupq_n_u16(P1);
+	for (int d=0; d<ndisparity_pad; d+=8) {
+		uint16x8_t v1 = vminq_u16(vld1q_u16(Lrpr+d), vqaddq_u16(vld1q_u16(Lrpr+d-1), vP1));
+		v1 = vminq_u16(v1, vqaddq_u16(vld1q_u16(Lrpr+d+1), vP1));
+		v1 = vminq_u16(v1, vminP2);
+		vst1q_u16(Lrp+d, vqaddq_u16(vld1q_u16(Cp+d), vqsubq_u16(v1, vminLri)));
+	}
+}
+#endif
+
+/* Pick the widest path update kernel the running CPU supports. */
+inline path_update_u16_t select_path_update_u16() {
+#ifdef FP_SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return path_update_u16_avx2;
+#endif
+#ifdef FP_SIMD_NEON
+	return path_update_u16_neon;
+#endif
+	return path_update_u16_scalar;
+}
+
+#endif // _FP_SGBM_SIMD_HPP_
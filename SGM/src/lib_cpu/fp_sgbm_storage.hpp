@@ -0,0 +1,108 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+#ifndef _FP_SGBM_STORAGE_HPP_
+#define _FP_SGBM_STORAGE_HPP_
+
+#include "fp_config_params.h"
+#include "fp_config_arch.h"
+#include <stdint.h>
+#include <limits>
+
+/* Narrowest unsigned word holding BW bits */
+template<int BW, bool FITS8 = (BW<=8), bool FITS16 = (BW<=16)>
+struct StorageWord {
+	typedef uint32_t type;
+};
+template<int BW>
+struct StorageWord<BW, true, true> {
+	typedef uint8_t type;
+};
+template<int BW>
+struct StorageWord<BW, false, true> {
+	typedef uint16_t type;
+};
+
+/*
+ * Element types of the initial and the aggregated cost volumes of the CPU engine, sized with the same
+ * CostMap/AggrMap traits as the hardware streams in fp_sgbm.hpp (8-bit input pixels).
+ */
+template<int COST_FUNCTION_Flags, int WINDOW_SIZE_Flags, int SHD_WINDOW_Flags, int NUM_DIR_Flags, int PENALTY_Flags>
+struct VolumeStorage {
+	static const int cost_value = COST_MAP(COST_FUNCTION_Flags,8,WINDOW_SIZE_Flags,SHD_WINDOW_Flags);
+	static const int aggr_width = AGGR_MAP(NUM_DIR_Flags,cost_value,PENALTY_Flags);
+	typedef typename StorageWord<BIT_WIDTH(cost_value)>::type cost_type;
+	typedef typename StorageWord<aggr_width>::type aggr_type;
+};
+
+/* Volumes for runs outside of the hardware configuration, e.g. SAD/ZSAD costs with a census build */
+struct VolumeStorageWide {
+	typedef uint16_t cost_type;
+	typedef uint32_t aggr_type;
+};
+
+/* Plain int volumes, for debugging */
+struct VolumeStorageInt32 {
+	typedef int cost_type;
+	typedef int aggr_type;
+};
+
+/* Storage the CPU engine is built with: the hardware configuration of fp_config_arch.h/fp_config_params.h */
+#ifdef FP_CPU_INT32_VOLUMES
+typedef VolumeStorageInt32 CpuVolume;
+#else
+typedef VolumeStorage<COST_FUNCTION,WINDOW_SIZE,SHD_WINDOW,NUM_DIR,LARGE_PENALTY> CpuVolume;
+#endif
+
+/* Run-time counterpart of CostMap: the largest initial cost of a cost function. Even windows read
+   (window_size+1)^2 pixels, so they are bounded as the next odd window */
+inline long max_initial_cost(int function_type, int window_size, int shd_window) {
+	window_size |= 1;
+	long census = (long)window_size*window_size-1;
+	switch (function_type) {
+	case 0:
+	case 1:
+		return census;
+	case 2:
+		return 255L*window_size*window_size;
+	case 3:
+		return 255L*window_size*window_size*2;
+	case 4:
+		return census*shd_window*shd_window;
+	}
+	return std::numeric_limits<int>::max();
+}
+
+/*
+ * Whether the volumes of Storage hold the costs of a run exactly. Every path value is at most max(C)+P2,
+ * so the aggregated costs stay below numDir*(max(C)+P2). Even windows read (window_size+1)^2 pixels and
+ * are left to the int volumes.
+ */
+template<typename Storage>
+inline bool cost_fits(int function_type, int window_size, int shd_window) {
+	if (window_size%2 == 0)
+		return false;
+	long cost_max = max_initial_cost(function_type, window_size, shd_window);
+	return cost_max <= (long)std::numeric_limits<typename Storage::cost_type>::max();
+}
+
+template<typename Storage>
+inline bool aggr_fits(int function_type, int window_size, int shd_window, int numDir, int P2) {
+	if (window_size%2 == 0)
+		return false;
+	long aggr_max = numDir*(max_initial_cost(function_type, window_size, shd_window)+P2);
+	return aggr_max <= (long)std::numeric_limits<typename Storage::aggr_type>::max();
+}
+
+template<typename Storage>
+inline bool storage_fits(int function_type, int window_size, int shd_window, int numDir, int P2) {
+	return cost_fits<Storage>(function_type, window_size, shd_window)
+			&& aggr_fits<Storage>(function_type, window_size, shd_window, numDir, P2);
+}
+
+#endif // _FP_SGBM_STORAGE_HPP_
@@ -0,0 +1,220 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+#ifndef _FP_STAGE_TIMER_HPP_
+#define _FP_STAGE_TIMER_HPP_
+
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+namespace fp{
+
+/*
+ * Wall-clock time of the stages of the SGM pipeline, per frame. A frame is timed on the thread that runs it:
+ * between begin_frame() and end_frame() every ScopedStage of that thread adds its time to the stage of the
+ * frame, so stages entered several times (the bands of compute_SGM_fused, the points of a sweep) are summed.
+ * Without a frame being timed, ScopedStage does nothing but read a thread-local pointer.
+ */
+class StageTimer {
+public:
+	enum Stage {
+		COST,               // initial costs, or loading them from the cost cache
+		AGGREGATION,        // all paths, including the sum into the aggregated volume; compute_SGM_fused adds its WTA
+		AGGR_PATH0,         // single path r; summed over the workers when the paths run on a thread pool
+		AGGR_PATH7 = AGGR_PATH0+7,
+		WTA,
+		MEDIAN,
+		LR_CONSISTENCY,
+		INTERPOLATION,
+		SGM,                // the disparity maps of the frame, everything above but the interpolation
+		TOTAL,              // the whole frame, from begin_frame() to end_frame(), including the error metrics
+		NUM_STAGES
+	};
+
+	static const char *name(int stage) {
+		static const char *names[NUM_STAGES] = {"cost", "aggregation", "aggr_r0", "aggr_r1", "aggr_r2", "aggr_r3",
+				"aggr_r4", "aggr_r5", "aggr_r6", "aggr_r7", "wta", "median", "lr_check", "interpolation", "sgm", "total"};
+		return names[stage];
+	}
+
+	/* Timer of the frame running on the calling thread, or none */
+	static StageTimer *&current() {
+		static thread_local StageTimer *timer = 0;
+		return timer;
+	}
+
+	/* Time frame on the calling thread; work is the pixel-disparities its SGM stage computes, for the throughput */
+	void begin_frame(int frame, long work) {
+		FrameTiming timing;
+		timing.frame = frame;
+		timing.work = work;
+		for (int s=0; s<NUM_STAGES; s++) {
+			timing.ms[s] = 0;
+			timing.timed[s] = false;
+		}
+		frames.push_back(timing);
+		start = Clock::now();
+		current() = this;
+	}
+
+	void end_frame() {
+		add(TOTAL, elapsed_ms(start));
+		current() = 0;
+	}
+
+	void add(int stage, double ms) {
+		frames.back().ms[stage] += ms;
+		frames.back().timed[stage] = true;
+	}
+
+	/* Take over the frames of other, e.g. of another batch worker */
+	void merge(const StageTimer &other) {
+		frames.insert(frames.end(), other.frames.begin(), other.frames.end());
+		std::sort(frames.begin(), frames.end(), by_frame);
+	}
+
+	/* Per-frame times in ms and throughput in Mpixel-disparities/s, then p50/p99/mean over the frames */
+	void report(FILE *file) const {
+		fprintf(file, "%-8s %10s", "frame", "MPD/s");
+		for (int s=0; s<NUM_STAGES; s++) {
+			fprintf(file, " %13s", name(s));
+		}
+		fprintf(file, "\n");
+		for (size_t f=0; f<frames.size(); f++) {
+			fprintf(file, "%06d   %10.2f", frames[f].frame, throughput(frames[f]));
+			for (int s=0; s<NUM_STAGES; s++) {
+				if (frames[f].timed[s])
+					fprintf(file, " %13.3f", frames[f].ms[s]);
+				else
+					fprintf(file, " %13s", "-");
+			}
+			fprintf(file, "\n");
+		}
+		fprintf(file, "\n%-14s %12s %12s %12s %7s\n", "stage", "p50", "p99", "mean", "frames");
+		for (int s=0; s<NUM_STAGES; s++) {
+			Summary sum = summary(s);
+			if (sum.count > 0)
+				fprintf(file, "%-14s %12.3f %12.3f %12.3f %7d\n", name(s), sum.p50, sum.p99, sum.mean, sum.count);
+		}
+		Summary tp = summary(-1);
+		if (tp.count > 0)
+			fprintf(file, "%-14s %12.2f %12.2f %12.2f %7d\n", "MPD/s", tp.p50, tp.p99, tp.mean, tp.count);
+	}
+
+	/* The same as report(), as a JSON object */
+	void report_json(FILE *file) const {
+		fprintf(file, "{\n  \"frames\": [");
+		for (size_t f=0; f<frames.size(); f++) {
+			fprintf(file, "%s\n    {\"frame\": %d, \"mpd_per_s\": %.3f", f ? "," : "", frames[f].frame, throughput(frames[f]));
+			for (int s=0; s<NUM_STAGES; s++) {
+				if (frames[f].timed[s])
+					fprintf(file, ", \"%s_ms\": %.4f", name(s), frames[f].ms[s]);
+			}
+			fprintf(file, "}");
+		}
+		fprintf(file, "\n  ],\n  \"summary\": {");
+		bool first = true;
+		for (int s=-1; s<NUM_STAGES; s++) {
+			Summary sum = summary(s);
+			if (sum.count == 0)
+				continue;
+			fprintf(file, "%s\n    \"%s\": {\"p50\": %.4f, \"p99\": %.4f, \"mean\": %.4f, \"frames\": %d}",
+					first ? "" : ",", (s < 0) ? "mpd_per_s" : name(s), sum.p50, sum.p99, sum.mean, sum.count);
+			first = false;
+		}
+		fprintf(file, "\n  }\n}\n");
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct FrameTiming {
+		int frame;
+		long work;
+		double ms[NUM_STAGES];
+		bool timed[NUM_STAGES];
+	};
+
+	struct Summary {
+		double p50;
+		double p99;
+		double mean;
+		int count;
+	};
+
+	static bool by_frame(const FrameTiming &a, const FrameTiming &b) {
+		return a.frame < b.frame;
+	}
+
+	static double throughput(const FrameTiming &timing) {
+		return (timing.ms[SGM] > 0) ? timing.work/(timing.ms[SGM]*1e3) : 0;
+	}
+
+	/* Nearest-rank percentiles of stage over the frames that ran it. Stage -1 is the throughput, ranked from
+	   the fastest frame down, so that its p99 is the slow tail as for the times */
+	Summary summary(int stage) const {
+		std::vector<double> values;
+		for (size_t f=0; f<frames.size(); f++) {
+			if (stage < 0)
+				values.push_back(throughput(frames[f]));
+			else if (frames[f].timed[stage])
+				values.push_back(frames[f].ms[stage]);
+		}
+		Summary sum = {0, 0, 0, (int)values.size()};
+		if (values.empty())
+			return sum;
+		std::sort(values.begin(), values.end());
+		if (stage < 0)
+			std::reverse(values.begin(), values.end());
+		for (size_t k=0; k<values.size(); k++) {
+			sum.mean += values[k];
+		}
+		sum.mean /= values.size();
+		sum.p50 = values[(size_t)ceil(0.50*values.size())-1];
+		sum.p99 = values[(size_t)ceil(0.99*values.size())-1];
+		return sum;
+	}
+
+	friend class ScopedStage;
+
+	static double elapsed_ms(Clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(Clock::now()-since).count();
+	}
+
+	std::vector<FrameTiming> frames;
+	Clock::time_point start;
+};
+
+/* Adds the time until the end of the scope to stage of the frame timed on this thread */
+class ScopedStage {
+public:
+	explicit ScopedStage(int stage) : timer(StageTimer::current()), stage(stage) {
+		if (timer)
+			start = StageTimer::Clock::now();
+	}
+
+	~ScopedStage() {
+		if (timer)
+			timer->add(stage, StageTimer::elapsed_ms(start));
+	}
+
+private:
+	ScopedStage(const ScopedStage &);
+	ScopedStage &operator=(const ScopedStage &);
+
+	StageTimer *timer;
+	int stage;
+	StageTimer::Clock::time_point start;
+};
+
+}
+
+#endif // _FP_STAGE_TIMER_HPP_
@@ -0,0 +1,155 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+#ifndef _FP_STEREO_WORKSPACE_HPP_
+#define _FP_STEREO_WORKSPACE_HPP_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+namespace fp{
+
+/*
+ * Buffers of the CPU SGM pipeline, kept from one frame to the next. buffer() hands out buffer id with at least
+ * the requested size and only maps memory when a frame needs more than all frames before it, so once the largest
+ * frame has been seen the pipeline allocates nothing. The content of a buffer is not preserved when it grows.
+ * Buffers can be backed by huge pages (explicit hugetlb pages if reserved, transparent huge pages otherwise)
+ * and locked in memory, which both need to be set up by the system (nr_hugepages, RLIMIT_MEMLOCK); when they
+ * are not, the workspace prints a warning and goes on with normal pages.
+ */
+class StereoWorkspace {
+public:
+	enum Buffer {
+		COST,               // initial cost volume (left view)
+		COST_R,             // initial cost volume (right view)
+		AGGR,               // aggregated cost volume (left view)
+		AGGR_R,             // aggregated cost volume (right view)
+		LR,                 // L(r,p,d) volume of the reference aggregation (left view)
+		LR_R,               // L(r,p,d) volume of the reference aggregation (right view)
+		COST_SCRATCH,       // transforms, descriptors and integral images of the cost engines
+		AGGR_SCRATCH,       // path buffers of the aggregation engines
+		DISP,               // output disparity map
+		DISP_L,             // disparity maps before post-processing
+		DISP_R,
+		DISP_FILTERED_L,    // median filtered disparity maps
+		DISP_FILTERED_R,
+		NUM_BUFFERS
+	};
+
+	enum Flags {
+		HUGE_PAGES = 1,
+		LOCK_MEMORY = 2
+	};
+
+	explicit StereoWorkspace(int flags = 0) : flags(flags), num_maps(0), warned(0) {
+		for (int id=0; id<NUM_BUFFERS; id++) {
+			blocks[id].ptr = 0;
+			blocks[id].bytes = 0;
+		}
+	}
+
+	~StereoWorkspace() {
+		for (int id=0; id<NUM_BUFFERS; id++) {
+			unmap(blocks[id]);
+		}
+	}
+
+	void *buffer(int id, size_t bytes) {
+		Block &block = blocks[id];
+		if (bytes <= block.bytes)
+			return block.ptr;
+		unmap(block);
+		map(block, bytes);
+		return block.ptr;
+	}
+
+	/* Number of times memory was mapped, constant once the pipeline runs allocation-free */
+	int maps() const {
+		return num_maps;
+	}
+
+	size_t bytes() const {
+		size_t total = 0;
+		for (int id=0; id<NUM_BUFFERS; id++) {
+			total += blocks[id].bytes;
+		}
+		return total;
+	}
+
+private:
+	struct Block {
+		void *ptr;
+		size_t bytes;
+	};
+
+	static const size_t PAGE_BYTES = 4096;
+	static const size_t HUGE_PAGE_BYTES = 2*1024*1024;
+
+	void map(Block &block, size_t bytes) {
+		size_t page = (flags & HUGE_PAGES) ? HUGE_PAGE_BYTES : PAGE_BYTES;
+		size_t size = (bytes+page-1)/page*page;
+		void *ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+		if (flags & HUGE_PAGES)
+			ptr = mmap(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+#endif
+		if (ptr == MAP_FAILED) {
+			ptr = mmap(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+			if (ptr == MAP_FAILED)
+				return;
+#ifdef MADV_HUGEPAGE
+			if ((flags & HUGE_PAGES) && madvise(ptr, size, MADV_HUGEPAGE) != 0)
+				warn(HUGE_PAGES, "huge pages are not available");
+#endif
+		}
+		if ((flags & LOCK_MEMORY) && mlock(ptr, size) != 0)
+			warn(LOCK_MEMORY, "mlock failed, check RLIMIT_MEMLOCK");
+		block.ptr = ptr;
+		block.bytes = size;
+		num_maps++;
+	}
+
+	void unmap(Block &block) {
+		if (!block.ptr)
+			return;
+		if (flags & LOCK_MEMORY)
+			munlock(block.ptr, block.bytes);
+		munmap(block.ptr, block.bytes);
+		block.ptr = 0;
+		block.bytes = 0;
+	}
+
+	void warn(int flag, const char *msg) {
+		if (!(warned & flag))
+			fprintf(stderr, "StereoWorkspace: %s\n", msg);
+		warned |= flag;
+	}
+
+	StereoWorkspace(const StereoWorkspace &);
+	StereoWorkspace &operator=(const StereoWorkspace &);
+
+	int flags;
+	int num_maps;
+	int warned;
+	Block blocks[NUM_BUFFERS];
+};
+
+/* Buffer id of the workspace, or a malloc'd buffer when there is none; give it back with release_buffer() */
+inline void *workspace_buffer(StereoWorkspace *ws, int id, size_t bytes) {
+	return ws ? ws->buffer(id, bytes) : malloc(bytes);
+}
+
+inline void release_buffer(StereoWorkspace *ws, void *ptr) {
+	if (!ws)
+		free(ptr);
+}
+
+}
+
+#endif // _FP_STEREO_WORKSPACE_HPP_
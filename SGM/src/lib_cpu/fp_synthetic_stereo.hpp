@@ -0,0 +1,187 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+#ifndef _FP_SYNTHETIC_STEREO_HPP_
+#define _FP_SYNTHETIC_STEREO_HPP_
+
+#include "opencv2/opencv.hpp"
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace fp{
+
+enum SyntheticScene {
+	RANDOM_DOT,         // black and white dots on every surface
+	TEXTURED_PLANES     // smooth value-noise texture, different for every surface
+};
+
+/* Rectified pair with its exact ground truth, in the formats of the KITTI folders read by test_fp_sgbm */
+struct SyntheticPair {
+	cv::Mat left;       // CV_8UC1
+	cv::Mat right;      // CV_8UC1
+	cv::Mat disp_noc;   // CV_16UC1, disparity*256 of the pixels visible in both views, 0 elsewhere
+	cv::Mat disp_occ;   // CV_16UC1, disparity*256 of every pixel
+	cv::Mat obj_map;    // CV_8UC1, 0 for the background, object number for the foreground
+};
+
+/* Integer hash of a surface point, so that a surface looks the same from both views */
+inline uint32_t synthetic_hash(uint32_t seed, int surface, int u, int v) {
+	uint32_t h = seed*0x9E3779B1u ^ (uint32_t)surface*0x85EBCA77u ^ (uint32_t)u*0xC2B2AE3Du ^ (uint32_t)v*0x27D4EB2Fu;
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	h ^= h >> 12;
+	h *= 0x297A2D39u;
+	h ^= h >> 15;
+	return h;
+}
+
+/* Intensity of surface at its point (u,v), u being the column in the left view */
+inline unsigned char synthetic_texture(int scene, uint32_t seed, int surface, int u, int v) {
+	if (scene == RANDOM_DOT)
+		return (synthetic_hash(seed, surface, u, v) & 1) ? 224 : 32;
+	// Bilinear value noise on an 8 pixel grid, a brightness per surface and a little fine grain
+	const int cell = 8;
+	int gu = (u >= 0) ? u/cell : (u-cell+1)/cell;
+	int gv = v/cell;
+	int fu = u-gu*cell;
+	int fv = v-gv*cell;
+	int v00 = synthetic_hash(seed, surface, gu, gv) & 255;
+	int v01 = synthetic_hash(seed, surface, gu+1, gv) & 255;
+	int v10 = synthetic_hash(seed, surface, gu, gv+1) & 255;
+	int v11 = synthetic_hash(seed, surface, gu+1, gv+1) & 255;
+	int top = v00*(cell-fu) + v01*fu;
+	int bottom = v10*(cell-fu) + v11*fu;
+	int value = (top*(cell-fv) + bottom*fv)/(cell*cell);
+	int base = (int)(synthetic_hash(seed, surface, -1, -1) % 96) - 48;
+	int grain = (int)(synthetic_hash(seed^0x5A5A5A5Au, surface, u, v) & 31) - 16;
+	return (unsigned char)std::max(0, std::min(255, value/2 + 64 + base + grain));
+}
+
+/*
+ * Renders a scene of a ground plane, whose disparity grows from the top to the bottom row, and a few
+ * fronto-parallel rectangles in front of it, with integer disparities below max_disp. The left view is the
+ * reference: a left pixel at column j with disparity d is seen at column j-d of the right view, where the
+ * nearest surface wins. Right pixels no left pixel reaches show the ground plane behind the objects. The same
+ * seed always gives the same pair.
+ */
+inline void make_synthetic_pair(int scene, int rows, int cols, int max_disp, uint32_t seed, SyntheticPair &pair) {
+	int dmax = std::max(2, std::min(255, max_disp*3/4));
+	int dmin = std::max(1, dmax/8);
+	int dground = std::max(dmin, dmax/2);
+
+	// Ground plane disparity of row i
+	std::vector<int> ground(rows);
+	for (int i=0; i<rows; i++) {
+		ground[i] = dmin + (int)((long)(dground-dmin)*i/std::max(1, rows-1));
+	}
+
+	struct Object {
+		int top, left, bottom, right, disp;
+	};
+	uint32_t state = synthetic_hash(seed, 0, rows, cols) | 1;
+	int num_objects = 3 + (int)(state % 4);
+	std::vector<Object> objects;
+	for (int k=0; k<num_objects; k++) {
+		uint32_t h = synthetic_hash(seed, k+1, rows, cols);
+		int w = cols/8 + (int)(h % (unsigned)std::max(1, cols/4));
+		int hgt = rows/6 + (int)((h >> 8) % (unsigned)std::max(1, rows/3));
+		Object obj;
+		obj.left = (int)((h >> 4) % (unsigned)std::max(1, cols-w));
+		obj.top = (int)((h >> 12) % (unsigned)std::max(1, rows-hgt));
+		obj.right = obj.left + w;
+		obj.bottom = obj.top + hgt;
+		obj.disp = dground + 1 + (int)((h >> 20) % (unsigned)std::max(1, dmax-dground));
+		objects.push_back(obj);
+	}
+
+	pair.left.create(rows, cols, CV_8UC1);
+	pair.right.create(rows, cols, CV_8UC1);
+	pair.disp_noc.create(rows, cols, CV_16UC1);
+	pair.disp_occ.create(rows, cols, CV_16UC1);
+	pair.obj_map.create(rows, cols, CV_8UC1);
+
+	std::vector<int> disp(cols);
+	std::vector<int> surface(cols);
+	std::vector<int> depth(cols);
+	std::vector<int> owner(cols);
+	for (int i=0; i<rows; i++) {
+		// Nearest surface of every left pixel
+		for (int j=0; j<cols; j++) {
+			disp[j] = ground[i];
+			surface[j] = 0;
+			for (int k=0; k<num_objects; k++) {
+				const Object &obj = objects[k];
+				if (i >= obj.top && i < obj.bottom && j >= obj.left && j < obj.right && obj.disp > disp[j]) {
+					disp[j] = obj.disp;
+					surface[j] = k+1;
+				}
+			}
+			pair.left.at<unsigned char>(i, j) = synthetic_texture(scene, seed, surface[j], j, i);
+			pair.obj_map.at<unsigned char>(i, j) = (unsigned char)surface[j];
+			pair.disp_occ.at<unsigned short>(i, j) = (unsigned short)(disp[j]*256);
+		}
+		// Right view, the largest disparity reaching a column wins
+		for (int x=0; x<cols; x++) {
+			depth[x] = -1;
+			owner[x] = -1;
+		}
+		for (int j=0; j<cols; j++) {
+			int x = j-disp[j];
+			if (x >= 0 && disp[j] > depth[x]) {
+				depth[x] = disp[j];
+				owner[x] = j;
+			}
+		}
+		for (int x=0; x<cols; x++) {
+			unsigned char value;
+			if (owner[x] >= 0)
+				value = pair.left.at<unsigned char>(i, owner[x]);
+			else
+				value = synthetic_texture(scene, seed, 0, x+ground[i], i);
+			pair.right.at<unsigned char>(i, x) = value;
+		}
+		for (int j=0; j<cols; j++) {
+			int x = j-disp[j];
+			bool visible = (x >= 0 && owner[x] == j);
+			pair.disp_noc.at<unsigned short>(i, j) = visible ? (unsigned short)(disp[j]*256) : 0;
+		}
+	}
+}
+
+/* Scene of name ("dots" or "planes"), -1 for anything else */
+inline int synthetic_scene(const std::string &name) {
+	if (name == "dots")
+		return RANDOM_DOT;
+	if (name == "planes")
+		return TEXTURED_PLANES;
+	return -1;
+}
+
+/*
+ * Parses "synthetic:<dots|planes>:<width>x<height>", which stands for a dataset folder. Returns false when
+ * spec is not a synthetic dataset; a malformed one is reported and gives scene -1.
+ */
+inline bool parse_synthetic_spec(const std::string &spec, int &scene, int &rows, int &cols) {
+	const std::string prefix = "synthetic:";
+	if (spec.compare(0, prefix.size(), prefix) != 0)
+		return false;
+	char name[32];
+	scene = -1;
+	if (sscanf(spec.c_str()+prefix.size(), "%31[a-z]:%dx%d", name, &cols, &rows) == 3 && rows > 0 && cols > 0)
+		scene = synthetic_scene(name);
+	if (scene < 0)
+		fprintf(stderr, "Invalid synthetic dataset %s, expected synthetic:<dots|planes>:<width>x<height>\n", spec.c_str());
+	return true;
+}
+
+}
+
+#endif // _FP_SYNTHETIC_STEREO_HPP_
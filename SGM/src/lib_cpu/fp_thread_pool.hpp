@@ -0,0 +1,128 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+#ifndef _FP_THREAD_POOL_HPP_
+#define _FP_THREAD_POOL_HPP_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+namespace fp{
+
+/*
+ * Fixed-size pool of worker threads. run() hands out task indices 0..num_tasks-1 to the workers
+ * (the calling thread takes part as well) and returns once every task has finished, so each call
+ * acts as a barrier between pipeline phases.
+ */
+class ThreadPool {
+public:
+	explicit ThreadPool(int num_threads) : stop(false), generation(0), task(0), num_tasks(0), next_task(0), pending(0), active(0) {
+		for (int t=1; t<num_threads; t++) {
+			workers.push_back(std::thread(&ThreadPool::worker_loop, this));
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			stop = true;
+		}
+		wake.notify_all();
+		for (size_t t=0; t<workers.size(); t++) {
+			workers[t].join();
+		}
+	}
+
+	int size() const {
+		return (int)workers.size()+1;
+	}
+
+	void run(int tasks, const std::function<void(int)> &fn) {
+		if (tasks <= 0)
+			return;
+		if (workers.empty() || tasks == 1) {
+			for (int k=0; k<tasks; k++) {
+				fn(k);
+			}
+			return;
+		}
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			task = &fn;
+			num_tasks = tasks;
+			next_task = 0;
+			pending = tasks;
+			generation++;
+		}
+		wake.notify_all();
+		execute(&fn, tasks);
+		// Workers that joined this generation still hold fn and next_task: wait for them to leave as well
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this]{ return pending == 0 && active == 0; });
+		task = 0;
+	}
+
+private:
+	void execute(const std::function<void(int)> *fn, int tasks) {
+		int finished = 0;
+		for (int k = next_task++; k < tasks; k = next_task++) {
+			(*fn)(k);
+			finished++;
+		}
+		if (finished > 0) {
+			std::unique_lock<std::mutex> lock(mutex);
+			pending -= finished;
+			if (pending == 0 && active == 0)
+				done.notify_all();
+		}
+	}
+
+	void worker_loop() {
+		unsigned long seen = 0;
+		for (;;) {
+			const std::function<void(int)> *fn;
+			int tasks;
+			{
+				// A worker that wakes after run() returned sees task == 0 and waits for the next generation
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this, seen]{ return stop || (generation != seen && task != 0); });
+				if (stop)
+					return;
+				seen = generation;
+				fn = task;
+				tasks = num_tasks;
+				active++;
+			}
+			execute(fn, tasks);
+			std::unique_lock<std::mutex> lock(mutex);
+			active--;
+			if (pending == 0 && active == 0)
+				done.notify_all();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool stop;
+	unsigned long generation;
+	const std::function<void(int)> *task;
+	int num_tasks;
+	std::atomic<int> next_task;
+	int pending;
+	int active;                 // workers between taking a generation and leaving it
+};
+
+}
+
+#endif // _FP_THREAD_POOL_HPP_
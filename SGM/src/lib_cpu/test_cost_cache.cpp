@@ -0,0 +1,91 @@
+/*
+ *  FP-Stereo
+ *  Copyright (C) 2020  RCSL, HKUST
+ *
+ *  GPL-3.0 License
+ *
+ */
+
+/*
+ * Checks that compute_SGM_sweep only caches cost volumes it computed: a cost engine that fails (here ZSAD with
+ * an even window, which the box engine rejects) must leave no .cost file behind, while the same frame with an odd
+ * window stores its volume. Returns 0 when both hold.
+ */
+
+#define FP_SGBM_NO_MAIN
+#include "fp_sgbm_c.cpp"
+#include <dirent.h>
+
+/* Number of files in dir whose name contains ".cost", complete volumes and temporary files alike */
+static int count_cost_files(const std::string &dir) {
+	int count = 0;
+	DIR *d = opendir(dir.c_str());
+	if (!d)
+		return -1;
+	struct dirent *entry;
+	while ((entry = readdir(d)) != 0) {
+		if (strstr(entry->d_name, ".cost"))
+			count++;
+	}
+	closedir(d);
+	return count;
+}
+
+static void remove_dir(const std::string &dir) {
+	DIR *d = opendir(dir.c_str());
+	if (!d)
+		return;
+	struct dirent *entry;
+	while ((entry = readdir(d)) != 0) {
+		if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+			unlink((dir + "/" + entry->d_name).c_str());
+	}
+	closedir(d);
+	rmdir(dir.c_str());
+}
+
+int main()
+{
+	const int rows = 24;
+	const int cols = 64;
+	const int max_disp = 16;
+	char dir_template[] = "/tmp/test_cost_cache.XXXXXX";
+	if (!mkdtemp(dir_template)) {
+		printf("Cannot create the cache directory..! \n");
+		return 1;
+	}
+	std::string dir = dir_template;
+	fp::CostCache cache(dir);
+	fp::ThreadPool pool(1);
+	fp::StereoWorkspace workspace;
+
+	fp::SyntheticPair pair;
+	fp::make_synthetic_pair(fp::TEXTURED_PLANES, rows, cols, max_disp, 1, pair);
+	std::vector<SweepPoint> points(1);
+	points[0].p1 = SMALL_PENALTY;
+	points[0].p2 = LARGE_PENALTY;
+	points[0].lr_check = 0;
+	points[0].uniq = 0;
+	std::vector<float> disparity((size_t)rows*cols);
+
+	int failures = 0;
+	// ZSAD (cost type 3) with an even window fails in the cost engine
+	int ret = compute_SGM_sweep(pair.left, pair.right, &disparity[0], 4, max_disp, 3, 4, FilterWin, 3, points, &cache, "even", &pool, &workspace);
+	int files = count_cost_files(dir);
+	if (ret != -1 || files != 0) {
+		printf("FAIL: failed cost volume, return %d and %d cached files, expected -1 and 0\n", ret, files);
+		failures++;
+	}
+	// The same frame with an odd window is cached
+	ret = compute_SGM_sweep(pair.left, pair.right, &disparity[0], 4, max_disp, 3, 5, FilterWin, 3, points, &cache, "odd", &pool, &workspace);
+	files = count_cost_files(dir);
+	if (ret != 0 || files != 1) {
+		printf("FAIL: computed cost volume, return %d and %d cached files, expected 0 and 1\n", ret, files);
+		failures++;
+	}
+
+	remove_dir(dir);
+	if (failures == 0)
+		printf("PASS: only computed cost volumes are cached\n");
+	return failures ? 1 : 0;
+}